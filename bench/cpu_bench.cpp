@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "CPU.hpp"
+#include "FunctionalCPU.hpp"
+#include "OoOCPU.hpp"
+#include "Program.hpp"
+#include "ProgramLoader.hpp"
+#include "SampledSimulation.hpp"
+#include "Simulation.hpp"
+#include "WideCPU.hpp"
+#include "Workloads.hpp"
+
+// Throughput suite: synthetic workloads at several sizes plus the programs/
+// corpus, timed on every engine. Only the run loops are timed; loading and
+// resets are not. Exits non-zero if the engines disagree on a result.
+
+namespace {
+std::atomic<uint64_t> g_allocs{0};
+}
+
+// Count every heap allocation in the process, the timed regions should make none
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::vector<uint64_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    std::vector<std::string> engines = {"pipeline", "cached", "dual", "ooo", "iss", "jit", "wide", "sampled"};
+    int lanes = 64;
+    int fileReps = 20000;   // the corpus programs are tiny, run each this often
+    bool workloads = true;
+    bool files = true;
+    bool csv = false;
+    std::string programsDir = SCS_PROGRAMS_DIR;
+};
+
+struct Measurement {
+    bool ran = false;
+    bool hasCycles = false;
+    uint64_t instrs = 0;
+    uint64_t cycles = 0;
+    double ns = 0.0;
+    uint64_t allocs = 0;
+    std::array<int,32> regs{};   // final state of the last run, for the cross-check
+};
+
+// Accumulates time and allocations over the timed regions of a measurement
+struct Timer {
+    Measurement& m;
+    Clock::time_point t0;
+    uint64_t a0;
+
+    explicit Timer(Measurement& m) : m(m), t0(Clock::now()), a0(g_allocs.load(std::memory_order_relaxed)) {}
+    ~Timer() {
+        m.ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+        m.allocs += g_allocs.load(std::memory_order_relaxed) - a0;
+    }
+};
+
+template <typename Engine>
+void captureRegs(const Engine& e, Measurement& m) {
+    for (int r = 0; r < 32; ++r) m.regs[r] = e.getReg(r);
+}
+
+Measurement runPipeline(const Program& prog, int reps, bool caches, int issueWidth = 1) {
+    Measurement m;
+    m.hasCycles = true;
+    CPU cpu;
+    cpu.loadProgram(prog);
+    if (caches) cpu.setCaches(defaultCacheHierarchy());
+    cpu.setIssueWidth(issueWidth);
+    for (int i = 0; i < reps; ++i) {
+        cpu.reset(true);
+        {
+            Timer t(m);
+            while (!cpu.isHalted()) cpu.tick();
+        }
+        m.instrs += cpu.retired;
+        m.cycles += (uint64_t)cpu.clock;
+    }
+    captureRegs(cpu, m);
+    return m;
+}
+
+Measurement runFunctional(const Program& prog, int reps, bool jit) {
+    Measurement m;
+    FunctionalCPU iss;
+    if (jit) iss.setBackend(FunctionalCPU::Backend::Jit);
+    iss.loadProgram(prog);
+    for (int i = 0; i < reps; ++i) {
+        iss.reset(true);
+        {
+            Timer t(m);
+            iss.run(UINT64_MAX);
+        }
+        m.instrs += iss.retired;
+    }
+    captureRegs(iss, m);
+    return m;
+}
+
+Measurement runOoO(const Program& prog, int reps) {
+    Measurement m;
+    m.hasCycles = true;
+    OoOCPU core;
+    core.loadProgram(prog);
+    for (int i = 0; i < reps; ++i) {
+        core.reset(true);
+        {
+            Timer t(m);
+            core.run(UINT64_MAX);
+        }
+        m.instrs += core.retired;
+        m.cycles += core.clock;
+    }
+    captureRegs(core, m);
+    return m;
+}
+
+Measurement runWide(const Program& prog, int reps, int lanes) {
+    Measurement m;
+    m.hasCycles = true;
+    WideCPU wide(lanes);
+    wide.loadProgram(prog);
+    for (int i = 0; i < reps; ++i) {
+        wide.reset(true);
+        {
+            Timer t(m);
+            wide.run(UINT64_MAX);
+        }
+        for (int l = 0; l < lanes; ++l) {
+            m.instrs += wide.retired(l);
+            m.cycles += wide.cycles(l);
+        }
+    }
+    for (int r = 0; r < 32; ++r) m.regs[r] = wide.getReg(lanes - 1, r);
+    return m;
+}
+
+Measurement runSampled(const Program& prog, int reps) {
+    Measurement m;
+    for (int i = 0; i < reps; ++i) {
+        SampledSimulation sim;
+        sim.loadProgram(prog);
+        SamplingResult res;
+        {
+            Timer t(m);
+            res = sim.run();
+        }
+        m.instrs += res.instructions;
+        // Only an estimate, and none without a single sample
+        if (!res.sampleCpi.empty()) {
+            m.hasCycles = true;
+            m.cycles += (uint64_t)(res.estimatedCycles + 0.5);
+        }
+        if (i + 1 == reps) captureRegs(sim.functional(), m);
+    }
+    return m;
+}
+
+Measurement measure(const std::string& engine, const Program& prog, int reps, const Options& opt) {
+    Measurement m;
+    if (engine == "pipeline") m = runPipeline(prog, reps, false);
+    else if (engine == "cached") m = runPipeline(prog, reps, true);
+    else if (engine == "dual") m = runPipeline(prog, reps, false, 2);
+    else if (engine == "ooo") m = runOoO(prog, reps);
+    else if (engine == "iss") m = runFunctional(prog, reps, false);
+    else if (engine == "jit") m = runFunctional(prog, reps, true);
+    else if (engine == "wide") m = runWide(prog, reps, opt.lanes);
+    else if (engine == "sampled") m = runSampled(prog, reps);
+    else return m;
+    m.ran = true;
+    return m;
+}
+
+void printHeader(const Options& opt) {
+    if (opt.csv) {
+        std::printf("workload,size,engine,instrs,cycles,ns_per_cycle,ns_per_instr,cycles_per_s,instrs_per_s,allocs\n");
+    } else {
+        std::printf("%-28s %9s %-9s %12s %12s %9s %9s %10s %10s %7s\n", "workload", "size", "engine",
+                    "instrs", "cycles", "ns/cycle", "ns/instr", "Mcycles/s", "MIPS", "allocs");
+    }
+}
+
+void printRow(const Options& opt, const std::string& workload, uint64_t size,
+              const std::string& engine, const Measurement& m) {
+    const double nsPerInstr = m.instrs ? m.ns / m.instrs : 0.0;
+    const double ips = m.ns > 0 ? m.instrs / m.ns * 1e9 : 0.0;
+    const double nsPerCycle = m.cycles ? m.ns / m.cycles : 0.0;
+    const double cps = m.ns > 0 ? m.cycles / m.ns * 1e9 : 0.0;
+
+    if (opt.csv) {
+        std::printf("%s,%llu,%s,%llu,", workload.c_str(), (unsigned long long)size, engine.c_str(),
+                    (unsigned long long)m.instrs);
+        if (m.hasCycles) std::printf("%llu,%.3f,", (unsigned long long)m.cycles, nsPerCycle);
+        else std::printf(",,");
+        std::printf("%.3f,", nsPerInstr);
+        if (m.hasCycles) std::printf("%.0f,", cps);
+        else std::printf(",");
+        std::printf("%.0f,%llu\n", ips, (unsigned long long)m.allocs);
+        return;
+    }
+
+    std::printf("%-28s %9llu %-9s %12llu ", workload.c_str(), (unsigned long long)size, engine.c_str(),
+                (unsigned long long)m.instrs);
+    if (m.hasCycles) std::printf("%12llu %9.2f ", (unsigned long long)m.cycles, nsPerCycle);
+    else std::printf("%12s %9s ", "-", "-");
+    std::printf("%9.2f ", nsPerInstr);
+    if (m.hasCycles) std::printf("%10.2f ", cps / 1e6);
+    else std::printf("%10s ", "-");
+    std::printf("%10.2f %7llu\n", ips / 1e6, (unsigned long long)m.allocs);
+}
+
+// Runs every engine on one program, false if any engine disagrees with the first
+bool benchProgram(const Options& opt, const std::string& name, uint64_t size, const Program& prog, int reps) {
+    bool ok = true;
+    const Measurement* ref = nullptr;
+    std::vector<Measurement> results;
+    results.reserve(opt.engines.size());
+
+    for (const auto& engine : opt.engines) {
+        results.push_back(measure(engine, prog, reps, opt));
+        const Measurement& m = results.back();
+        if (!m.ran) continue;
+        printRow(opt, name, size, engine, m);
+        std::fflush(stdout);
+
+        if (!ref) {
+            ref = &m;
+            continue;
+        }
+        // The wide engine reports every lane, compare per lane
+        const uint64_t perRun = engine == "wide" ? m.instrs / opt.lanes : m.instrs;
+        if (perRun != ref->instrs || m.regs != ref->regs) {
+            std::fprintf(stderr, "MISMATCH: %s on %s differs from %s\n", engine.c_str(), name.c_str(),
+                         opt.engines.front().c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= s.size()) {
+        const size_t comma = s.find(',', start);
+        const size_t end = comma == std::string::npos ? s.size() : comma;
+        if (end > start) out.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return out;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: cpu_bench [options]\n"
+        "  --sizes N,N,...        dynamic instructions per workload (default 1000..10000000)\n"
+        "  --engines a,b,...      pipeline, cached, dual, ooo, iss, jit, wide, sampled (default all)\n"
+        "  --lanes N              lanes of the wide engine (default 64)\n"
+        "  --file-reps N          runs of each programs/ file (default 20000)\n"
+        "  --programs DIR         corpus directory (default the source tree's programs/)\n"
+        "  --no-workloads         skip the synthetic workloads\n"
+        "  --no-files             skip the programs/ corpus\n"
+        "  --csv                  machine-readable output\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (a == "--sizes" && hasValue) {
+            opt.sizes.clear();
+            for (const auto& v : splitList(argv[++i])) opt.sizes.push_back(std::strtoull(v.c_str(), nullptr, 10));
+        } else if (a == "--engines" && hasValue) {
+            opt.engines = splitList(argv[++i]);
+        } else if (a == "--lanes" && hasValue) {
+            opt.lanes = std::max(1, std::atoi(argv[++i]));
+        } else if (a == "--file-reps" && hasValue) {
+            opt.fileReps = std::max(1, std::atoi(argv[++i]));
+        } else if (a == "--programs" && hasValue) {
+            opt.programsDir = argv[++i];
+        } else if (a == "--no-workloads") {
+            opt.workloads = false;
+        } else if (a == "--no-files") {
+            opt.files = false;
+        } else if (a == "--csv") {
+            opt.csv = true;
+        } else {
+            usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 2;
+
+    printHeader(opt);
+    bool ok = true;
+
+    if (opt.workloads) {
+        for (WorkloadKind kind : {WorkloadKind::Loop, WorkloadKind::LoadHeavy,
+                                  WorkloadKind::BranchHeavy, WorkloadKind::CallHeavy}) {
+            for (uint64_t size : opt.sizes) {
+                ok &= benchProgram(opt, workloadName(kind), size, makeWorkload(kind, size), 1);
+            }
+        }
+    }
+
+    if (opt.files) {
+        std::vector<std::filesystem::path> files;
+        for (const auto& e : std::filesystem::directory_iterator(opt.programsDir)) {
+            if (e.path().extension() == ".txt") files.push_back(e.path());
+        }
+        std::sort(files.begin(), files.end());
+
+        for (const auto& path : files) {
+            const Program prog = ProgramLoader::loadFromFile(path.string());
+            ok &= benchProgram(opt, path.filename().string(), prog.size(), prog, opt.fileReps);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
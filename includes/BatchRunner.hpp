@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Program.hpp"
+#include "Simulation.hpp"
+
+struct SimJob {
+    std::shared_ptr<const Program> program;
+    SimConfig config;
+    std::vector<std::pair<int,int>> initMem;   // (address, value) written before the run
+};
+
+struct BatchProgress {
+    uint64_t completedJobs = 0;
+    uint64_t totalJobs = 0;
+    uint64_t instructions = 0;   // retired by completed jobs
+    double seconds = 0.0;
+};
+
+// Runs independent simulation jobs on a work-stealing thread pool. Each
+// worker drains its own queue from the back and steals from the front of
+// the others once it runs dry. Results land in a slot per job and the
+// counters are per worker, so workers never write shared data.
+class BatchRunner {
+public:
+    // threads == 0 picks the hardware concurrency
+    explicit BatchRunner(unsigned threads = 0);
+
+    unsigned threadCount() const { return threads; }
+
+    // Called from the thread inside run() every `interval` until the batch completes
+    void onProgress(std::function<void(const BatchProgress&)> cb,
+                    std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+
+    // results[i] belongs to jobs[i]. A job that throws, for example on a
+    // config its engine rejects, gets the message in results[i].error and
+    // the others still run.
+    std::vector<SimResult> run(const std::vector<SimJob>& jobs);
+
+    // Safe to call from any thread, also while run() is active
+    BatchProgress progress() const;
+
+private:
+    struct alignas(64) WorkerCounters {
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> instructions{0};
+    };
+
+    unsigned threads;
+    std::function<void(const BatchProgress&)> progressCb;
+    std::chrono::milliseconds progressInterval{500};
+
+    std::unique_ptr<WorkerCounters[]> counters;
+    std::atomic<uint64_t> total{0};
+    std::atomic<int64_t> startedNs{0};   // steady_clock, read by progress() during run()
+    std::atomic<double> elapsed{0.0};    // frozen once the batch completes
+
+    // The last worker out wakes the thread waiting in run()
+    std::mutex doneLock;
+    std::condition_variable doneCv;
+    unsigned active = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "PipelineRegisters.hpp"
+
+// Direction policy for conditional branches. The policy is a fixed choice
+// that BranchPredictor branches on internally, not an interface: a new
+// policy is a new enumerator plus its cases in BranchPredictor.cpp.
+enum class PredictorKind {
+    NotTaken,        // static, the pipeline's original behaviour
+    BackwardTaken,   // static, loops: taken when the target lies behind
+    Bimodal,         // 2-bit counters indexed by pc
+    GShare           // 2-bit counters indexed by pc xor global history
+};
+
+const char* predictorName(PredictorKind kind);
+std::optional<PredictorKind> parsePredictor(std::string_view name);
+
+struct PredictorConfig {
+    PredictorKind kind = PredictorKind::NotTaken;
+    uint32_t tableBits = 10;      // 2^tableBits counters, bimodal and gshare
+    uint32_t historyBits = 8;     // gshare global history length
+    uint32_t btbEntries = 0;      // direct mapped, a power of two; 0 = none
+    uint32_t rasDepth = 0;        // return-address stack for JAL/JR $31; 0 = none
+};
+
+struct PredictorStats {
+    uint64_t branches = 0;           // BEQ/BNE
+    uint64_t branchMispredicts = 0;
+    uint64_t jumps = 0;              // J, JAL and JR other than returns
+    uint64_t jumpMispredicts = 0;
+    uint64_t returns = 0;            // JR $31
+    uint64_t returnMispredicts = 0;
+
+    uint64_t total() const { return branches + jumps + returns; }
+    uint64_t mispredicts() const { return branchMispredicts + jumpMispredicts + returnMispredicts; }
+    double accuracy() const { return total() ? 1.0 - double(mispredicts()) / double(total()) : 1.0; }
+
+    // Calls f(name, value) for every counter, in declaration order
+    template <typename F>
+    void forEach(F&& f) const {
+        f("branches", branches);
+        f("branch_mispredicts", branchMispredicts);
+        f("jumps", jumps);
+        f("jump_mispredicts", jumpMispredicts);
+        f("returns", returns);
+        f("return_mispredicts", returnMispredicts);
+    }
+};
+
+// Next-pc prediction for IF, verified in EX. IF only knows an instruction is
+// a branch or jump once the BTB has seen it resolve, so without a BTB every
+// prediction is pc + 1 and the pipeline behaves as it always did. The tables
+// are trained when EX resolves; the RAS is updated speculatively in IF and
+// restored from the checkpoint in the Prediction on a mispredict.
+class BranchPredictor {
+public:
+    enum class Kind : uint8_t { Branch, Jump, Call, Return };
+
+    BranchPredictor();
+    // Throws std::runtime_error for a btbEntries that is not a power of two
+    explicit BranchPredictor(const PredictorConfig& cfg);
+
+    // Forget everything learnt and zero the counters
+    void reset();
+
+    Prediction predict(int pc);
+
+    // Called by EX for every branch and jump with its actual successor
+    void resolve(int pc, Kind kind, int actualNext, const Prediction& pred);
+
+    const PredictorConfig& config() const { return cfg; }
+    const PredictorStats& stats() const { return counters; }
+
+private:
+    struct BtbEntry {
+        int32_t pc = -1;
+        int32_t target = 0;
+        Kind kind = Kind::Branch;
+    };
+
+    uint32_t counterIndex(int pc) const;
+    void push(int returnPc);
+    int pop();
+
+    PredictorConfig cfg;
+    std::vector<uint8_t> counters2;   // 2-bit saturating, >= 2 means taken
+    uint32_t history = 0;
+    std::vector<BtbEntry> btb;
+    std::vector<int32_t> ras;
+    int16_t rasPtr = 0;               // next free slot, wraps around
+    int16_t rasCount = 0;
+
+    PredictorStats counters;
+};
@@ -1,32 +1,157 @@
 #pragma once
-#include <vector>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include "Cache.hpp"
+#include "Coherence.hpp"
+#include "CommitJournal.hpp"
 #include "PipelineRegisters.hpp"
+#include "PipelineTrace.hpp"
 #include "PipelineStages.hpp"
 #include "Registerfile.hpp"
 #include "Memory.hpp"
-#include "Instructions.hpp"
+#include "Program.hpp"
 #include "HazardUnit.hpp"
+#include "PerfCounters.hpp"
 
 class CPU {
 public:
+    // Complete machine state apart from the program. The memory shares its
+    // pages copy-on-write with the CPU, so keeping many snapshots of a run
+    // costs page tables, not memory.
+    struct Snapshot {
+        int pc = 0;
+        int clock = 0;
+        uint64_t retired = 0;
+        bool fetchEnabled = true;
+        int issueWidth = 1;
+        PipelineRegisters pipe;
+        RegisterFile regs;
+        Memory mem;
+        PerfCounters perf;
+
+        std::optional<CacheHierarchy> caches;
+        BranchPredictor predictor;
+        int memWait = 0;
+        int fetchWait = 0;
+        int fetchPc = 0;
+        bool fetchPending = false;
+    };
+
     CPU();
 
-    void loadProgram(const std::vector<Instruction>& program);
+    // Also writes the program's data segments to memory
+    void loadProgram(const Program& program);
 
-    // Reset state while keeping the currently loaded program
+    // Reset state while keeping the currently loaded program, whose data
+    // segments are written again when memory is cleared
     void reset(bool clearMemory = true);
 
     void tick();
 
     bool isHalted() const;
 
+    // Replace the architectural state (pc, registers, memory) mid-run.
+    // The pipeline restarts empty, clock and retired keep counting.
+    void setArchState(int pc, const RegisterFile& regs, const Memory& mem);
+
+    // Capture the state and later return to it exactly. restore() expects the
+    // program that was loaded when the snapshot was taken, and throws
+    // std::runtime_error on a core attached with an outbound queue or for a
+    // dual-issue snapshot while branches resolve in ID.
+    Snapshot snapshot() const;
+    void restore(const Snapshot& snap);
+
+    // Cache timing model, off by default: every fetch and data access then
+    // completes within its pipeline cycle. When on, an instruction cache miss
+    // holds IF (bubbles enter the pipeline) and a data cache miss freezes the
+    // whole pipeline for the miss latency. Enabling starts with cold caches.
+    void setCaches(const CacheHierarchyConfig& cfg);
+    void disableCaches();
+    const CacheHierarchy* caches() const { return cacheModel ? &*cacheModel : nullptr; }
+
+    // Multi-core: work on memory shared with other cores, with loads and
+    // stores timed by bus as its L1D number core (see MultiCoreSystem). The
+    // cache model, if on, then only times instruction fetch. Every memory
+    // access of the core, setArchState, restore and stepBack included, goes
+    // to the shared memory until detachShared.
+    // With outbound set, each committed store is also appended there,
+    // stamped with clock; with deferStores it goes there only and the owner
+    // applies it to memory. Either way the owner decides what memory holds,
+    // so such a core can not be rewound: attaching drops the journal, and
+    // enableJournal and restore throw std::runtime_error until detachShared.
+    // Everything stays owned by the caller.
+    void attachShared(Memory& memory, SnoopBus& bus, int core,
+                      std::vector<MemWrite>* outbound = nullptr, bool deferStores = false);
+    void detachShared();
+    bool isShared() const { return sharedMem != nullptr; }
+
+    // Next-pc prediction in IF, verified in EX. The default (static
+    // not-taken, no BTB) redirects every taken branch and jump from EX.
+    // Replacing the predictor starts it untrained.
+    void setPredictor(const PredictorConfig& cfg);
+    const BranchPredictor& branchPredictor() const { return predictor; }
+
+    // Resolve branches and jumps in EX (default) or ID. In ID a mispredict
+    // squashes one instruction instead of two, but a branch or JR waits in
+    // ID for an operand still computed in EX or loaded by a LW in EX or MEM.
+    // Switching takes effect with the next instruction decoded. ID throws
+    // std::runtime_error while the issue width is 2.
+    void setBranchStage(BranchStage stage);
+    BranchStage branchStage() const { return branchAt; }
+
+    // In-order issue width, 1 (default) or 2. With 2, IF fetches sequential
+    // pairs and ID issues both unless HazardUnit::detectPair splits them;
+    // the younger instruction of a pair runs in the *2 latches and writes
+    // through the second register file port. Branches then resolve in EX,
+    // width 2 throws std::runtime_error while they are set to resolve in ID,
+    // as do other widths. Drains the pipeline before switching.
+    void setIssueWidth(int lanes);
+    int issueWidth() const { return width; }
+
+    // Reverse execution. With the journal on, every tick records what it
+    // overwrites and stepBack() undoes the latest ticks one by one. At most
+    // maxBytes of history is kept, the oldest cycles are forgotten first.
+    // Cache contents and predictor tables are not rewound, only the stalls
+    // and predictions in flight.
+    // loadProgram, reset, setArchState and restore start an empty journal.
+    // Throws std::runtime_error on a core attached with an outbound queue.
+    void enableJournal(size_t maxBytes = 64u << 20);
+    void disableJournal();
+    uint64_t journalDepth() const { return journal ? journal->frames() : 0; }
+
+    // Undo up to n ticks, returns how many were undone
+    uint64_t stepBack(uint64_t n = 1);
+
+    // Binary trace of every following tick: the instruction in each latch,
+    // stall and flush flags and the commits (see PipelineTrace.hpp), after
+    // the registers and memory as they are now. Whatever changes them other
+    // than a tick (loadProgram, reset, setArchState, restore, stepBack,
+    // setMemWord, attaching or detaching shared memory) records their new
+    // state in front of the next traced cycle. A background thread writes
+    // it, tick only queues the cycle. Throws std::runtime_error if path can
+    // not be created.
+    void enableTrace(const std::string& path, const TraceConfig& cfg = {});
+    // Flush and close the trace, throws std::runtime_error if writing failed
+    void disableTrace();
+    const TraceWriter* trace() const { return tracer.get(); }
+
+    // Stop fetching and tick until every in-flight instruction has left the
+    // pipeline, afterwards pc is the next instruction to execute
+    void drain();
+
     const PipelineRegisters& pipeline() const { return pipe; }
-    const std::vector<Instruction>& program() const { return instrMem; }
+    const Program& program() const { return instrMem; }
     const RegisterFile& regFile() const { return regs; }
-    const Memory& memory() const { return mem; }
+    const Memory& memory() const { return dataMem(); }
+
+    // Event counters since the last loadProgram/reset, all zero when built
+    // with SCS_PERF_COUNTERS=0. setArchState keeps counting, like clock.
+    const PerfCounters& stats() const { return perf; }
 
     void dumpRegisters() const;
     void dumpPipeline() const;
+    void dumpStats() const;
 
     int getReg(int idx) const;
     int getMemWord(int addr) const;
@@ -34,9 +159,29 @@ public:
 
     int pc = 0;
     int clock = 0;
+    uint64_t retired = 0;
 
 private:
-    std::vector<Instruction> instrMem;
+    bool pipelineEmpty() const;
+    void resetTimingState();
+    // A cycle that is not frozen by a data miss, one instantiation per issue
+    // width so single issue carries no second-lane checks
+    template <bool Dual>
+    void advance();
+    void journalBegin(bool frozen);
+    void journalEnd();
+    void queueStore(Memory& data);
+    TraceState traceState() const;
+    void traceCycle(uint8_t flags);
+
+    Memory& dataMem() { return sharedMem ? *sharedMem : mem; }
+    const Memory& dataMem() const { return sharedMem ? *sharedMem : mem; }
+
+    // Cleared while draining, IF then only inserts bubbles
+    bool fetchEnabled = true;
+    int width = 1;   // issue width
+
+    Program instrMem;
     PipelineRegisters pipe;
 
     RegisterFile regs;
@@ -49,4 +194,26 @@ private:
     WBStage wbStage;
 
     HazardUnit hazardUnit;
+    BranchPredictor predictor;
+    BranchStage branchAt = BranchStage::EX;
+
+    PerfCounters perf;
+
+    std::optional<CacheHierarchy> cacheModel;
+    int memWait = 0;             // cycles the pipeline stays frozen on a data miss
+    int fetchWait = 0;           // cycles until the line holding fetchPc arrives
+    int fetchPc = 0;
+    bool fetchPending = false;   // fetchPc was looked up and is waiting or ready
+
+    Memory* sharedMem = nullptr;   // set while attached to a multi-core system
+    SnoopBus* bus = nullptr;
+    int busPort = 0;
+    std::vector<MemWrite>* outbound = nullptr;
+    bool deferStores = false;
+
+    std::unique_ptr<CommitJournal> journal;   // null while reverse execution is off
+    PerfCounters perfBefore;                  // counters at the start of a journaled tick
+
+    std::unique_ptr<TraceWriter> tracer;      // null while not tracing
+    bool traceStale = false;                  // registers or memory changed since the last traced cycle
 };
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Timing model of the cache hierarchy. Only tags are kept, the data always
+// lives in Memory, so a cache can never change what a program computes,
+// only how many cycles its fetches, loads and stores take.
+
+enum class Replacement { LRU, PLRU };
+enum class WritePolicy {
+    WriteBack,      // write-allocate, dirty lines are written back on eviction
+    WriteThrough    // no-write-allocate, every store goes to the next level
+};
+
+struct CacheConfig {
+    uint32_t sizeBytes = 16 * 1024;
+    uint32_t ways = 4;
+    uint32_t lineBytes = 32;
+    Replacement replacement = Replacement::LRU;
+    WritePolicy writePolicy = WritePolicy::WriteBack;
+    uint32_t hitLatency = 1;    // cycles of a hit, an L1 hit of 1 adds no stall
+};
+
+// MESI state of a line. A cache on its own only ever holds Exclusive (clean)
+// and Modified (dirty) lines; SnoopBus adds Shared and invalidates.
+enum class LineState : uint8_t { Invalid, Shared, Exclusive, Modified };
+
+struct CacheStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t readMisses = 0;
+    uint64_t writeMisses = 0;
+    uint64_t writebacks = 0;    // dirty lines evicted
+
+    uint64_t accesses() const { return reads + writes; }
+    uint64_t misses() const { return readMisses + writeMisses; }
+    uint64_t hits() const { return accesses() - misses(); }
+};
+
+// One level: sets of `ways` lines. The tags of a set sit next to each other
+// in one flat array so a lookup is a single short (SIMD) scan.
+class Cache {
+public:
+    // Throws std::runtime_error unless sizes and ways are powers of two that fit
+    explicit Cache(const CacheConfig& cfg);
+
+    struct Outcome {
+        bool hit = false;
+        bool writeback = false;      // a dirty victim has to go to the next level
+        uint32_t victimAddr = 0;     // first word of that victim line
+        bool forward = false;        // write-through store, also goes to the next level
+    };
+
+    // addr is a word address, as everywhere in the simulator
+    Outcome access(uint32_t addr, bool write);
+
+    // Drop every line, keep the counters
+    void invalidate();
+
+    // Snoop side, for coherence: neither counts as an access nor changes the
+    // replacement order. Setting Invalid drops the line, a missing line stays
+    // missing.
+    LineState state(uint32_t addr) const;
+    void setState(uint32_t addr, LineState s);
+
+    const CacheConfig& config() const { return cfg; }
+    const CacheStats& stats() const { return counters; }
+    void clearStats() { counters = {}; }
+
+private:
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+
+    int find(uint32_t set, uint32_t tag) const;
+    int slotOf(uint32_t addr) const;   // -1 if the line is missing
+    uint32_t victim(uint32_t set) const;
+    void touch(uint32_t set, uint32_t way);
+
+    CacheConfig cfg;
+    uint32_t lineShift;     // log2 of words per line
+    uint32_t setBits;
+    uint32_t sets;
+
+    std::vector<uint32_t> tags;     // [set * ways + way], kInvalid when empty
+    std::vector<LineState> states;
+    std::vector<uint64_t> stamps;   // LRU: last use of each line
+    std::vector<uint64_t> plru;     // PLRU: tree bits of each set
+    uint64_t clock = 0;
+
+    // Last line hit, most accesses go to it again
+    uint32_t lastLine = kInvalid;
+    uint32_t lastSlot = 0;
+
+    CacheStats counters;
+};
+
+struct CacheHierarchyConfig {
+    CacheConfig l1i;
+    CacheConfig l1d;
+    std::optional<CacheConfig> l2;    // shared by both L1s when present
+    uint32_t memoryLatency = 50;      // cycles behind the last level
+};
+
+// Split L1s over an optional unified L2 and main memory. The access methods
+// return the cycles the access takes beyond the pipeline's own cycle.
+class CacheHierarchy {
+public:
+    // Instruction indices are fetched from this word address up, where MIPS
+    // puts its text segment, so code and data do not alias in the L2
+    static constexpr uint32_t kTextBase = 0x00400000 / 4;
+
+    explicit CacheHierarchy(const CacheHierarchyConfig& cfg);
+
+    uint32_t fetch(uint32_t pc);
+    uint32_t load(uint32_t addr);
+    uint32_t store(uint32_t addr);
+
+    // Cold caches and zero counters
+    void reset();
+
+    const Cache& l1i() const { return icache; }
+    const Cache& l1d() const { return dcache; }
+    const Cache* l2() const { return level2 ? &*level2 : nullptr; }
+
+    // Calls f(name, stats) for every level, L1I, L1D, then L2
+    template <typename F>
+    void forEachLevel(F&& f) const {
+        f("l1i", icache.stats());
+        f("l1d", dcache.stats());
+        if (level2) f("l2", level2->stats());
+    }
+
+private:
+    uint32_t l1Access(Cache& l1, uint32_t addr, bool write);
+    uint32_t nextLevel(uint32_t addr, bool write);
+
+    Cache icache;
+    Cache dcache;
+    std::optional<Cache> level2;
+    uint32_t memoryLatency;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Cache.hpp"
+
+struct CoherenceConfig {
+    CacheConfig l1d;                // every core's private L1D, must be write-back
+    uint32_t busLatency = 4;        // cycles a transaction holds the bus
+    uint32_t memoryLatency = 50;    // extra cycles of a fill no other L1 can supply
+};
+
+// Per-core coherence traffic. Transactions are counted on the core that
+// puts them on the bus, snoop hits on the core whose line they hit.
+struct CoherenceStats {
+    uint64_t busReads = 0;            // BusRd, a read miss
+    uint64_t busReadExclusive = 0;    // BusRdX, a write miss
+    uint64_t busUpgrades = 0;         // BusUpgr, a write hit on a Shared line
+    uint64_t invalidationsSent = 0;   // copies in other L1s this core's writes invalidated
+    uint64_t invalidationsReceived = 0;
+    uint64_t interventions = 0;       // lines this L1 supplied to another core
+    uint64_t snoopWritebacks = 0;     // Modified lines written back because another core asked
+    uint64_t busWaitCycles = 0;       // cycles waiting for a bus another core held
+    uint64_t busBusyCycles = 0;       // cycles this core's transactions held the bus
+
+    uint64_t transactions() const { return busReads + busReadExclusive + busUpgrades; }
+
+    // Calls f(name, value) for every counter, in declaration order
+    template <typename F>
+    void forEach(F&& f) const {
+        f("bus_reads", busReads);
+        f("bus_read_exclusive", busReadExclusive);
+        f("bus_upgrades", busUpgrades);
+        f("invalidations_sent", invalidationsSent);
+        f("invalidations_received", invalidationsReceived);
+        f("interventions", interventions);
+        f("snoop_writebacks", snoopWritebacks);
+        f("bus_wait_cycles", busWaitCycles);
+        f("bus_busy_cycles", busBusyCycles);
+    }
+};
+
+// Private L1 data caches kept coherent with MESI over one snooping bus.
+// Like Cache it models timing only: the data stays in the shared Memory,
+// so coherence decides how long a load or store takes, never its value.
+//
+// Hits in E or M and read hits in S stay inside the core. Everything else
+// is a bus transaction that every other L1 snoops: a read miss (BusRd)
+// turns remote E and M copies into S, an M copy supplying the line and
+// writing it back; a write miss (BusRdX) or a write to an S line (BusUpgr)
+// invalidates every other copy. The bus carries one transaction at a time,
+// a core that finds it busy waits until it frees.
+//
+// load and store only touch the calling core's own L1, so cores on
+// different host threads may call them at once. Transactions queue up until
+// the owner calls resolve() between cycles, which runs them in (cycle,
+// core) order and charges each core its bus time through takeStall. In lax
+// mode, for quanta longer than a cycle, a transaction instead fills the
+// core's L1 at once at the uncontended latency; resolve then updates the
+// other L1s and charges the bus wait late, after the quantum.
+class SnoopBus {
+public:
+    // Throws std::runtime_error for no cores, a write-through L1D, or a
+    // cache configuration Cache rejects
+    SnoopBus(int cores, const CoherenceConfig& cfg = {});
+
+    // Cycles a load or store issued by core at cycle now takes beyond the
+    // pipeline's own cycle, as far as the core can know without the others
+    uint32_t load(int core, uint32_t addr, uint64_t now);
+    uint32_t store(int core, uint32_t addr, uint64_t now);
+
+    // Run the queued transactions; never while a core ticks
+    void resolve();
+
+    // Cycles resolve() charged to core since the last call
+    uint32_t takeStall(int core);
+
+    void setLax(bool on) { lax = on; }
+    bool isLax() const { return lax; }
+
+    // Cold caches, an idle bus, no queued transactions and zero counters
+    void reset();
+
+    int cores() const { return static_cast<int>(ports.size()); }
+    const CoherenceConfig& config() const { return cfg; }
+    const Cache& l1d(int core) const { return ports[core].l1; }
+    const CoherenceStats& stats(int core) const { return ports[core].counters; }
+
+private:
+    struct Request {
+        uint64_t cycle;
+        uint32_t addr;
+        bool write;
+        bool upgrade;   // lax: the write found the line Shared
+    };
+
+    // Everything one core touches between two resolves, on its own cache lines
+    struct alignas(64) Port {
+        explicit Port(const CacheConfig& l1d) : l1(l1d) {}
+        Cache l1;
+        CoherenceStats counters;
+        std::vector<Request> requests;
+        uint32_t stall = 0;
+    };
+
+    uint32_t access(int core, uint32_t addr, bool write, uint64_t now);
+    void transact(int core, const Request& r);
+    // Snoop addr in every L1 but core's, invalidating or sharing their
+    // copies. Returns whether one held the line, which supplies it on a fill.
+    bool snoop(int core, uint32_t addr, bool exclusive, bool fill);
+    // Bus cycles of a transaction issued at now, waiting included
+    uint32_t transaction(int core, uint64_t now, uint32_t hold);
+
+    CoherenceConfig cfg;
+    std::vector<Port> ports;
+    std::vector<std::pair<int, Request>> queue;   // resolve's merge buffer
+    uint64_t busFreeAt = 0;   // first cycle the bus is idle again
+    bool lax = false;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Undo log of architectural commits, one variable-sized frame per cycle.
+// RegisterFile::commit and Memory::commit add the value they are about to
+// overwrite, the owner adds whatever else it needs to go back a cycle (pc,
+// latch contents, ...) as the frame payload.
+//
+// Frames are packed into fixed-size chunks that are recycled, so recording
+// does not allocate once the journal is warm. When the chunks would exceed
+// maxBytes the oldest one is dropped together with its frames.
+class CommitJournal {
+public:
+    static constexpr size_t kChunkBytes = 64 * 1024;
+
+    explicit CommitJournal(size_t maxBytes = 64u << 20);
+
+    // Frame under construction: begin, payload, the commits of the cycle, end
+    void begin(uint8_t tag);
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "journal payload must be POD");
+        if (len + sizeof(T) > kMaxPayload) throw std::runtime_error("CommitJournal: frame too large");
+        std::memcpy(scratch.data() + len, &value, sizeof(T));
+        len += sizeof(T);
+    }
+    void recordReg(int idx, int oldValue);
+    void recordMem(int addr, int oldValue);
+    void end();
+
+    // Decoded view of a frame, payload points into the journal
+    struct Frame {
+        uint8_t tag = 0;
+        const uint8_t* payload = nullptr;
+        size_t payloadSize = 0;
+
+        // Register writes in commit order, undo the second one first
+        bool hasReg = false;
+        int regIdx = 0;
+        int regOld = 0;
+        bool hasReg2 = false;
+        int reg2Idx = 0;
+        int reg2Old = 0;
+
+        bool hasMem = false;
+        int memAddr = 0;
+        int memOld = 0;
+    };
+
+    // Newest frame, false when the journal is empty
+    bool back(Frame& out) const;
+    void pop();
+    void clear();
+
+    size_t frames() const { return frameCount; }
+    size_t bytes() const { return chunks.size() * kChunkBytes; }
+
+private:
+    static constexpr size_t kMaxPayload = 512;
+
+    // Trailer closing every frame, frames are walked from the back
+    struct Trailer {
+        uint8_t tag;
+        uint8_t undo;      // kRegUndo | kReg2Undo | kMemUndo
+        uint16_t size;     // whole frame including the trailer
+    };
+    static constexpr uint8_t kRegUndo = 1;
+    static constexpr uint8_t kMemUndo = 2;
+    static constexpr uint8_t kReg2Undo = 4;
+
+    struct Chunk {
+        std::unique_ptr<uint8_t[]> data;
+        size_t used = 0;
+        size_t frames = 0;
+    };
+
+    void newChunk();
+
+    size_t maxChunks;
+    std::deque<Chunk> chunks;
+    std::vector<std::unique_ptr<uint8_t[]>> spare;
+    size_t frameCount = 0;
+
+    // Current frame
+    std::array<uint8_t, kMaxPayload> scratch{};
+    size_t len = 0;
+    uint8_t tag = 0;
+    uint8_t undo = 0;
+    int32_t reg[2] = {};
+    int32_t reg2[2] = {};
+    int32_t memw[2] = {};
+};
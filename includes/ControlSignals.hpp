@@ -1,6 +1,7 @@
 #pragma once
+#include <cstdint>
 
-enum class ALUOp {
+enum class ALUOp : uint8_t {
     NONE,
     ADD,
     SUB,
@@ -10,19 +11,27 @@ enum class ALUOp {
     SLT
 };
 
-enum class BranchType {
+enum class BranchType : uint8_t {
     NONE,
     BEQ,
     BNE
 };
 
-enum class JumpType {
+enum class JumpType : uint8_t {
     NONE,
     J,
     JR,
     JAL
 };
 
+// Stage that resolves branches and jumps. EX squashes two wrong-path
+// instructions, ID only the one fetched behind it but has to wait for
+// operands that EX has not produced yet.
+enum class BranchStage : uint8_t {
+    EX,
+    ID
+};
+
 struct ControlSignals {
     bool regWrite = false;
     bool memRead  = false;
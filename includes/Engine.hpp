@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "Program.hpp"
+#include "Simulation.hpp"
+
+// Common face of the engines that run one program on one machine: the
+// in-order pipeline, the functional simulator and the out-of-order core.
+// Front ends drive them through this interface, the engines themselves
+// stay plain classes with non-virtual hot paths.
+class Engine {
+public:
+    virtual ~Engine() = default;
+
+    virtual EngineKind kind() const = 0;
+
+    // Loading writes the program's data segments to memory, and so does a
+    // reset that clears memory
+    virtual void loadProgram(const Program& program) = 0;
+    virtual void reset(bool clearMemory) = 0;
+
+    // Run until halted or the limit: cycles for engines that model time,
+    // instructions for the others
+    virtual void run(uint64_t limit) = 0;
+    virtual bool isHalted() const = 0;
+
+    virtual uint64_t instructions() const = 0;
+    virtual bool hasCycles() const = 0;
+    virtual uint64_t cycles() const = 0;
+
+    virtual int getReg(int idx) const = 0;
+    virtual int getMemWord(int addr) const = 0;
+    virtual void setMemWord(int addr, int value) = 0;
+
+    // Fill res with the counters and timing of the run so far, registers
+    // and memory ranges excluded
+    virtual void report(SimResult& res) const = 0;
+};
+
+// Engine for cfg.engine set up with the rest of cfg. Throws
+// std::runtime_error for the sampled and wide engines, which are not
+// single machines.
+std::unique_ptr<Engine> makeEngine(const SimConfig& cfg);
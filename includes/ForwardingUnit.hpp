@@ -1,22 +1,64 @@
-#pragma once
-#include "PipelineRegisters.hpp"
-
-enum class ForwardSel {
-    NONE,
-    FROM_EX_MEM,
-    FROM_MEM_WB
-};
-
-struct ForwardingDecision {
-    ForwardSel A = ForwardSel::NONE;
-    ForwardSel B = ForwardSel::NONE;
-};
-
-class ForwardingUnit {
-public:
-    ForwardingDecision resolve(
-        const ID_EX& id_ex,
-        const EX_MEM& ex_mem,
-        const MEM_WB& mem_wb
-    );
-};
+#pragma once
+#include <cstdint>
+#include "PipelineRegisters.hpp"
+
+enum class ForwardSel {
+    NONE,
+    FROM_EX_MEM,     // ALU result in EX/MEM
+    FROM_MEM_LOAD,   // load in EX/MEM, its data leaving MEM this cycle
+    FROM_MEM_WB
+};
+
+struct ForwardingDecision {
+    ForwardSel A = ForwardSel::NONE;
+    ForwardSel B = ForwardSel::NONE;
+    uint8_t laneA = 0;   // lane of the producing latch, 1 = the *2 latches
+    uint8_t laneB = 0;
+};
+
+class ForwardingUnit {
+public:
+    // Producers of rs and rt, youngest first: EX/MEM before MEM/WB and, with
+    // dual issue, the second lane of a stage before the first. Two
+    // comparators per source latch and lane. Dual is fixed by the caller's
+    // tick, so single issue does not test the second lane at all. Defined
+    // here, it runs for every operand of every cycle and wants inlining.
+    template <bool Dual>
+    ForwardingDecision resolve(int rs, int rt, const PipelineRegisters& pipe) {
+        ForwardingDecision fwd;
+        pick<Dual>(rs, pipe, fwd.A, fwd.laneA);
+        pick<Dual>(rt, pipe, fwd.B, fwd.laneB);
+        return fwd;
+    }
+
+private:
+    static bool writes(const ControlSignals& c, bool valid, int reg) {
+        return valid && c.regWrite && c.destReg != 0 && c.destReg == reg;
+    }
+
+    template <bool Dual>
+    static void pick(int reg, const PipelineRegisters& pipe, ForwardSel& sel, uint8_t& lane) {
+        if (reg == 0) return;
+
+        // Youngest first, the second lane only exists with dual issue
+        const EX_MEM& e2 = pipe.ex_mem2.cur();
+        if (Dual && writes(e2.ctrl, e2.valid, reg)) {
+            sel = e2.ctrl.memRead ? ForwardSel::FROM_MEM_LOAD : ForwardSel::FROM_EX_MEM;
+            lane = 1;
+            return;
+        }
+        const EX_MEM& e = pipe.ex_mem.cur();
+        if (writes(e.ctrl, e.valid, reg)) {
+            sel = e.ctrl.memRead ? ForwardSel::FROM_MEM_LOAD : ForwardSel::FROM_EX_MEM;
+            return;
+        }
+        const MEM_WB& m2 = pipe.mem_wb2.cur();
+        if (Dual && writes(m2.ctrl, m2.valid, reg)) {
+            sel = ForwardSel::FROM_MEM_WB;
+            lane = 1;
+            return;
+        }
+        const MEM_WB& m = pipe.mem_wb.cur();
+        if (writes(m.ctrl, m.valid, reg)) sel = ForwardSel::FROM_MEM_WB;
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "JitCache.hpp"
+#include "Program.hpp"
+#include "Registerfile.hpp"
+#include "Memory.hpp"
+
+// Instruction-set simulator: one instruction per step, dispatched from a
+// predecoded array. Same architectural results as CPU, no cycle accuracy.
+class FunctionalCPU {
+public:
+    enum class Backend {
+        Interpreter,
+        Jit   // basic-block translation, interprets where no host backend exists
+    };
+
+    FunctionalCPU();
+
+    void setBackend(Backend backend);
+    Backend backend() const { return selected; }
+    // True when run() actually executes translated code
+    bool jitActive() const { return jit && jit->available(); }
+    const JitCache* jitCache() const { return jit.get(); }
+
+    void loadProgram(const Program& program);
+
+    // Reset state while keeping the currently loaded program
+    void reset(bool clearMemory = true);
+
+    // Execute up to maxInstrs instructions, returns how many retired
+    uint64_t run(uint64_t maxInstrs);
+    bool step() { return run(1) == 1; }
+
+    bool isHalted() const;
+
+    // Replace the architectural state, e.g. when handing over from CPU
+    void setArchState(int pc, const RegisterFile& regs, const Memory& mem);
+
+    const Program& program() const { return instrMem; }
+    const RegisterFile& regFile() const { return regs; }
+    const Memory& memory() const { return mem; }
+
+    int getReg(int idx) const;
+    int getMemWord(int addr) const;
+    void setMemWord(int addr, int value);
+
+    int pc = 0;
+    uint64_t retired = 0;
+
+private:
+    // Handler selector, order matches the dispatch table in run()
+    enum Kind : uint8_t {
+        K_NOP, K_ADD, K_SUB, K_AND, K_OR, K_XOR, K_SLT,
+        K_ADDI, K_ANDI, K_ORI, K_LW, K_SW,
+        K_BEQ, K_BNE, K_J, K_JAL, K_JR
+    };
+
+    struct Op {
+        Kind kind = K_NOP;
+        uint8_t rd = 0;   // destination, writes to $0 are redirected to a sink slot
+        uint8_t rs = 0;
+        uint8_t rt = 0;
+        int32_t imm = 0;  // immediate, or absolute target for branches and jumps
+    };
+
+    static Op predecode(const Instruction& ins);
+
+    uint64_t interpret(uint64_t maxInstrs);
+    uint64_t runTranslated(uint64_t maxInstrs);
+
+    Program instrMem;
+    std::vector<Op> ops;
+
+    Backend selected = Backend::Interpreter;
+    std::unique_ptr<JitCache> jit;
+
+    RegisterFile regs;
+    Memory mem;
+};
@@ -1,13 +1,35 @@
-#pragma once
-
-struct IF_ID;
-struct ID_EX;
-
-struct HazardResult {
-    bool stall = false;
-};
-
-class HazardUnit {
-public:
-    HazardResult detect(const IF_ID& if_id, const ID_EX& id_ex);
-};
+#pragma once
+#include "ControlSignals.hpp"
+#include "Instructions.hpp"
+
+struct IF_ID;
+struct ID_EX;
+struct EX_MEM;
+struct PipelineRegisters;
+
+struct HazardResult {
+    bool stall = false;
+    bool branch = false;   // the stall holds a branch or JR resolved in ID
+    bool split = false;    // dual issue: only the older instruction of the pair issues
+};
+
+class HazardUnit {
+public:
+    HazardResult detect(const IF_ID& if_id, const ID_EX& id_ex, const EX_MEM& ex_mem,
+                        BranchStage branchStage = BranchStage::EX);
+
+    // Dual-issue check of the IF/ID pair. The pair stalls when its older
+    // instruction waits on a load; the younger one is held back when it
+    // waits on a load, reads what the older one writes, or would need the
+    // memory port or branch unit the older one already uses.
+    HazardResult detectPair(const PipelineRegisters& pipe);
+
+    // True if `ins` is a branch or JR that, resolved in ID, reads reg
+    static bool branchReads(int reg, const Instruction& ins);
+
+    // True if `ins` in ID must wait for a load into loadReg that is in EX
+    static bool loadUseHazard(int loadReg, const Instruction& ins);
+
+    // Register `ins` writes, -1 for none
+    static int destReg(const Instruction& ins);
+};
@@ -1,7 +1,8 @@
 #pragma once
-#include <string>
+#include <cstdint>
+#include <type_traits>
 
-enum class Opcode {
+enum class Opcode : uint8_t {
     NOP,
 
     // R-type
@@ -27,16 +28,22 @@ enum class Opcode {
     JAL
 };
 
+// Plain encoding that travels through the pipeline latches. The source text
+// lives out of line in the owning Program and is looked up through index.
 struct Instruction {
     Opcode op = Opcode::NOP;
 
-    int rs = 0;
-    int rt = 0;
-    int rd = 0;
+    uint8_t rs = 0;
+    uint8_t rt = 0;
+    uint8_t rd = 0;
 
-    int imm = 0;
+    int32_t imm = 0;
 
-    int addr = 0;
+    int32_t addr = 0;
 
-    std::string raw_text;
+    // Position in the loaded program, -1 if not owned by one
+    int32_t index = -1;
 };
+
+static_assert(std::is_trivially_copyable_v<Instruction>, "Instruction must stay POD");
+static_assert(sizeof(Instruction) == 16, "Instruction should pack into 16 bytes");
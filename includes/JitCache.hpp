@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Program.hpp"
+
+class Memory;
+
+// State shared between FunctionalCPU and translated code. Generated code
+// addresses the fields by offset, keep the layout plain.
+struct JitContext {
+    int32_t regs[33];   // $0..$31 plus a sink slot for writes to $0
+    int32_t pc;         // next pc when control returns to C++
+    int64_t budget;     // instructions still allowed to retire
+    Memory* mem;
+};
+
+// Basic-block translation cache for x86-64 hosts. Each block is translated
+// on first use and keyed by its program index. Direct exits are chained to
+// the target block once it exists, so loops stay in host code.
+class JitCache {
+public:
+    struct Block {
+        const uint8_t* entry = nullptr;
+        int length = 0;  // guest instructions, terminator included
+    };
+
+    JitCache();
+    ~JitCache();
+
+    JitCache(const JitCache&) = delete;
+    JitCache& operator=(const JitCache&) = delete;
+
+    // False on hosts without an x86-64 backend or when code memory is unavailable
+    bool available() const { return buffer != nullptr; }
+
+    // Drop every translation and translate from `program` from now on
+    void invalidate(const Program& program);
+
+    // Translated block starting at pc, nullptr if pc is outside the program
+    const Block* lookup(int pc);
+
+    // Run translated code from `block` until a block would overrun
+    // ctx.budget, an indirect jump or pc leaves the chained blocks
+    void enter(JitContext& ctx, const Block* block) const;
+
+    int translatedBlocks() const { return (int)blocks.size(); }
+    int chainedExits() const { return chained; }
+
+private:
+    const Block* translate(int pc);
+    // Switch the code buffer between RW and RX; flush, translate and patch write
+    void setWritable(bool on);
+    void flush();
+    void patch(uint32_t site, const uint8_t* target);
+
+    std::vector<Instruction> code;
+
+    uint8_t* buffer = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    bool writable = false;
+    size_t sealed = 0;   // bytes from buffer on that are RX
+    const uint8_t* epilogue = nullptr;
+
+    std::vector<Block> blocks;
+    std::vector<int32_t> blockAt;                 // pc -> index into blocks, -1 if none
+    std::vector<std::vector<uint32_t>> waiting;   // pc -> exit sites to patch once pc is translated
+    int chained = 0;
+};
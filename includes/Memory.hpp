@@ -1,10 +1,22 @@
  #pragma once
+ #include <array>
+ #include <cstdint>
+ #include <memory>
  #include <vector>
 // #include <cstdint>
 // #include <string>
 // #include <iostream>
 #include <optional>
 
+class CommitJournal;
+
+// A committed store, as queued between the cores of a multi-core system
+struct MemWrite {
+    uint64_t cycle;
+    int addr;
+    int value;
+};
+
 // class Memory {
 // private:
 //     std::vector<uint8_t> mem; 
@@ -24,21 +36,99 @@
 //     inline uint32_t getBaseAddress() const { return baseAddress; }
 // };
 
+// Word-addressed memory over the full 32-bit address space. An int address
+// is taken as an unsigned word index, so negative addresses land at the top
+// (where a stack would live). Pages of 1024 words (4 KiB) are allocated on
+// the first committed write to them; reads of untouched pages return 0.
+//
+// Copies share pages copy-on-write: copying costs the page table, and a page
+// is duplicated only when one side first writes to it.
+//
+// A memory can also overlay a base memory: pages it never wrote read through
+// to the base, the first write to one copies it. The base is only read, so
+// overlays on different threads may share one while nobody writes the base.
 class Memory {
 public:
-    Memory(size_t words = 1024);
+    static constexpr unsigned kPageBits = 10;
+    static constexpr uint32_t kPageWords = 1u << kPageBits;
+
+    Memory();
+    Memory(const Memory& other);
+    Memory(Memory&& other) noexcept;
+    Memory& operator=(const Memory& other);
+    Memory& operator=(Memory&& other) noexcept;
 
-    // Clear memory to 0 and discard any pending write
+    // Release every page and discard any pending write. An overlay keeps
+    // its base, which shows through again.
     void reset();
 
-    int read(int addr) const;
+    // Overlay base from now on (nullptr for none), dropping every page first.
+    // base has to outlive the overlay.
+    void setBase(const Memory* base);
+
+    int read(int addr) const {
+        // Fast path: same page as the last access
+        const uint32_t a = static_cast<uint32_t>(addr);
+        if ((a >> kPageBits) == tlbTag) return tlbPage[a & (kPageWords - 1)];
+        return readSlow(a);
+    }
     void writeNext(int addr, int value);
     void commit(); 
+    // Same, recording the overwritten word in the journal first
+    void commit(CommitJournal& journal);
+
+    // The write the next commit makes, if any, and a way to drop it
+    const std::optional<std::pair<int,int>>& pending() const { return pendingWrite; }
+    void discardPending() { pendingWrite.reset(); }
+
+    // Resident footprint in words, a multiple of kPageWords; an overlay
+    // counts and visits its own pages only
+    size_t size() const { return pages * kPageWords; }
+    size_t residentPages() const { return pages; }
 
-    size_t size() const { return data.size(); }
+    // Calls f(firstWordAddress, words) for every resident page in address order
+    template <typename F>
+    void forEachPage(F&& f) const {
+        for (uint32_t r = 0; r < root.size(); ++r) {
+            if (!root[r]) continue;
+            for (uint32_t l = 0; l < kLeafEntries; ++l) {
+                if (const Page* p = root[r]->pages[l].get()) {
+                    f(static_cast<uint32_t>((r * kLeafEntries + l) << kPageBits), p->data());
+                }
+            }
+        }
+    }
+
+    // Same contents, an untouched page equals a page of zeros
+    bool operator==(const Memory& other) const;
+    bool operator!=(const Memory& other) const { return !(*this == other); }
 
 private:
-    std::vector<int> data;
+    // Page number = root index (11 bits) : leaf index (11 bits)
+    static constexpr unsigned kLeafBits = 11;
+    static constexpr uint32_t kLeafEntries = 1u << kLeafBits;
+    static constexpr uint32_t kRootEntries = 1u << (32 - kPageBits - kLeafBits);
+
+    using Page = std::array<int, kPageWords>;
+    struct Leaf {
+        std::shared_ptr<Page> pages[kLeafEntries];
+    };
+
+    const Page* findPage(uint32_t pageNo) const;
+    // The page, allocated or unshared first so it can be written
+    Page& ownPage(uint32_t pageNo);
+    int readSlow(uint32_t addr) const;
+
+    std::vector<std::shared_ptr<Leaf>> root;   // empty until the first page exists
+    size_t pages = 0;
+    const Memory* base = nullptr;
+    std::vector<uint32_t> written;   // overlay: page numbers of its own pages
+
+    // One-entry translation cache, the tag can never match a real page number.
+    // tlbOwned says the cached page is exclusive to us and commit may write it.
+    mutable uint32_t tlbTag = UINT32_MAX;
+    mutable int* tlbPage = nullptr;
+    mutable bool tlbOwned = false;
+
     std::optional<std::pair<int,int>> pendingWrite;
 };
-
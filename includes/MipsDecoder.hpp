@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include "Instructions.hpp"
+
+// Decodes MIPS32 machine code (R, I and J formats) into Instruction.
+//
+// MIPS code is byte addressed from the load address `base`, the pipeline
+// counts instructions, so byte address pc is instruction index
+// (pc - base) / 4. Branch offsets already count instructions after the
+// branch and carry over as they are; jump targets are rebuilt from the
+// upper bits of pc + 4 and turned into indices.
+//
+// Only the subset the pipeline implements decodes:
+//   R  add addu sub subu and or xor slt jr, shifts into $0 (nop, ssnop, ehb)
+//   I  addi addiu andi ori lw sw beq bne
+//   J  j jal
+// addu/subu/addiu map to add/sub/addi, which do not trap on overflow
+// either. andi/ori zero extend their immediate as on MIPS. Branch delay
+// slots are not modelled, build with -fno-delayed-branch so slots hold nops.
+// jal leaves the instruction index of the jal + 1 in $31, not pc + 8, so
+// jr $31 returns as it should but code that treats $31 as a byte address
+// (prints it, or adds to it) sees a different value.
+class MipsDecoder {
+public:
+    explicit MipsDecoder(uint32_t base = 0) : base(base) {}
+
+    // Decode the word at byte address pc into out. False for an encoding
+    // outside the subset, or a jump that leaves the code below base.
+    bool decode(uint32_t word, uint32_t pc, Instruction& out) const;
+
+    // Instruction index of byte address pc
+    int64_t index(uint32_t pc) const { return (static_cast<int64_t>(pc) - base) / 4; }
+
+    // MIPS mnemonic of word for messages, "unknown" when not recognised
+    static const char* mnemonic(uint32_t word);
+
+private:
+    uint32_t base;
+};
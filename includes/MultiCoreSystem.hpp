@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CPU.hpp"
+#include "Coherence.hpp"
+#include "Memory.hpp"
+#include "Program.hpp"
+
+struct MultiCoreConfig {
+    int cores = 2;
+    CoherenceConfig coherence;
+    unsigned threads = 1;     // host threads ticking the cores
+    uint32_t quantum = 1;     // cycles the cores run between two synchronisations
+};
+
+// N pipelined cores sharing one Memory through private L1 data caches kept
+// coherent by a SnoopBus. Each core runs its own program, or the same one
+// from its own entry pc.
+//
+// The cores run in quanta: each ticks on its own for up to `quantum`
+// cycles, then all of them meet at a barrier where their queued stores
+// reach the shared memory and their bus transactions are resolved, both in
+// (cycle, core) order. During a quantum a core sees the memory as it was at
+// the barrier plus its own stores. With more than one host thread the cores
+// are spread over the threads and the barrier is a spinning one.
+//
+// With quantum 1 the cores synchronise every cycle: stores and bus
+// transactions of a cycle take effect at its end and every bus wait is
+// charged exactly, so any number of threads reproduces the serial result.
+// Longer quanta put the bus in lax mode and trade that exactness for fewer
+// barriers; for a given quantum the result still does not depend on the
+// number of threads.
+//
+// Per-core coherence traffic, invalidations and bus waits are in
+// bus().stats(core), the stall cycles they cost in core(i).stats().memStallCycles.
+class MultiCoreSystem {
+public:
+    // Throws std::runtime_error for no cores, no threads, a zero quantum, or
+    // a configuration SnoopBus rejects
+    explicit MultiCoreSystem(const MultiCoreConfig& cfg = {});
+
+    // The cores point into the system, so it stays where it was built
+    MultiCoreSystem(const MultiCoreSystem&) = delete;
+    MultiCoreSystem& operator=(const MultiCoreSystem&) = delete;
+
+    // The same program on every core, core i starting at entryPcs[i] or at 0
+    // past the end of entryPcs. Restarts the system like reset(false).
+    // Either way the program's data segments go to the shared memory.
+    void loadProgram(const Program& program, const std::vector<int>& entryPcs = {});
+    // A program for one core only, the others keep theirs. Restarts the
+    // system like reset(false).
+    void loadProgram(int core, const Program& program, int entryPc = 0);
+
+    // Every core back to its entry pc with zeroed registers, cold caches and
+    // an idle bus. Clearing memory writes every core's data segments again.
+    void reset(bool clearMemory = true);
+
+    // One cycle of every core that has not halted, as a quantum of its own
+    void tick();
+
+    // Run quanta until every core halted or clock reaches maxCycles
+    void run(uint64_t maxCycles);
+
+    bool isHalted() const;
+
+    const MultiCoreConfig& config() const { return cfg; }
+    int cores() const { return static_cast<int>(cpus.size()); }
+    CPU& core(int i) { return *cpus[i]; }
+    const CPU& core(int i) const { return *cpus[i]; }
+    const SnoopBus& bus() const { return snoopBus; }
+    const Memory& memory() const { return mem; }
+
+    // Instructions retired by all cores together
+    uint64_t retired() const;
+
+    // Initial data goes through here, a core's own setMemWord may only reach its view
+    int getMemWord(int addr) const;
+    void setMemWord(int addr, int value);
+
+    uint64_t clock = 0;   // cycles the longest-running core ticked
+
+private:
+    // What one core owns between barriers, on its own cache lines
+    struct alignas(64) Lane {
+        Memory view;                    // the core's overlay on mem when views are on
+        std::vector<MemWrite> outbound; // its stores since the last barrier
+        bool stale = false;             // another core stored, drop the overlay's pages
+    };
+
+    // Tick cores first, first + stride, ... until they halt or reach cycle end
+    void runCores(int first, int stride, uint64_t end);
+    // The barrier's serial part: stores, bus transactions, stale views, clock
+    void sync();
+
+    MultiCoreConfig cfg;
+    Memory mem;
+    SnoopBus snoopBus;
+    std::vector<std::unique_ptr<CPU>> cpus;
+    std::vector<int> entries;
+
+    // A core reads the shared memory directly only while one thread ticks
+    // every core a cycle at a time; otherwise it works on an overlay of it
+    bool views;
+    std::vector<Lane> lanes;
+    std::vector<std::pair<int, MemWrite>> merged;   // sync's merge buffer
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "BranchPredictor.hpp"
+#include "Memory.hpp"
+#include "Program.hpp"
+#include "Registerfile.hpp"
+
+struct OoOConfig {
+    uint32_t width = 4;          // instructions fetched, renamed and retired per cycle
+    uint32_t robEntries = 64;
+    uint32_t rsEntries = 32;     // unified reservation stations
+    uint32_t lsqEntries = 16;    // loads and stores between rename and retirement
+    uint32_t aluUnits = 2;       // ALU, branch and jump issues per cycle
+    uint32_t memUnits = 1;       // load and store issues per cycle
+    uint32_t loadLatency = 2;    // cycles from issue to the data of a load not forwarded
+};
+
+struct OoOStats {
+    uint64_t robOccupancy = 0;     // entries in the ROB, summed over cycles
+    uint64_t robFullStalls = 0;    // cycles rename stopped on a full ROB
+    uint64_t rsFullStalls = 0;     // ... on full reservation stations
+    uint64_t lsqFullStalls = 0;    // ... on a full load/store queue
+    uint64_t frontendStalls = 0;   // cycles rename found nothing fetched
+    uint64_t issued = 0;           // instructions sent to a unit, wrong path included
+    uint64_t branches = 0;         // retired branches and jumps
+    uint64_t mispredicts = 0;      // of those, redirected when they executed
+    uint64_t squashed = 0;         // wrong-path instructions removed from the ROB
+    uint64_t loadForwards = 0;     // loads fed by an older store in the queue
+
+    // Calls f(name, value) for every counter, in declaration order
+    template <typename F>
+    void forEach(F&& f) const {
+        f("rob_occupancy", robOccupancy);
+        f("rob_full_stalls", robFullStalls);
+        f("rs_full_stalls", rsFullStalls);
+        f("lsq_full_stalls", lsqFullStalls);
+        f("frontend_stalls", frontendStalls);
+        f("issued", issued);
+        f("branches", branches);
+        f("mispredicts", mispredicts);
+        f("squashed", squashed);
+        f("load_forwards", loadForwards);
+    }
+};
+
+// Out-of-order core over the same ISA: Tomasulo scheduling with register
+// renaming onto a reorder buffer. Every cycle retires, completes, issues,
+// renames and fetches, in that order, so an instruction spends at least a
+// cycle in each step.
+//
+// Fetch follows the branch predictor, up to one taken transfer per cycle.
+// Rename maps source registers onto the ROB entries producing them. An
+// instruction issues from the reservation stations, oldest first, once its
+// operands are complete. A branch or jump that finds its prediction wrong
+// squashes everything younger as it completes and restarts fetch on the
+// right path. Loads wait for the addresses of all older stores; an older
+// store to the same word forwards its data. Results reach RegisterFile and
+// Memory only at in-order retirement, so architectural results match CPU and
+// FunctionalCPU.
+class OoOCPU {
+public:
+    // Throws std::runtime_error for a zero size, or a ROB or width above 4096
+    explicit OoOCPU(const OoOConfig& cfg = {}, const PredictorConfig& predictor = {});
+
+    void loadProgram(const Program& program);
+
+    // Reset state while keeping the currently loaded program
+    void reset(bool clearMemory = true);
+
+    void tick();
+
+    // Tick until halted or clock reaches maxCycles
+    void run(uint64_t maxCycles);
+
+    // Fetch ran off the program and everything in flight retired
+    bool isHalted() const;
+
+    const OoOConfig& config() const { return cfg; }
+    const OoOStats& stats() const { return counters; }
+    const BranchPredictor& branchPredictor() const { return predictor; }
+    double ipc() const { return clock ? double(retired) / double(clock) : 0.0; }
+    double avgRobOccupancy() const { return clock ? double(counters.robOccupancy) / double(clock) : 0.0; }
+
+    const Program& program() const { return instrMem; }
+    const RegisterFile& regFile() const { return regs; }
+    const Memory& memory() const { return mem; }
+
+    int getReg(int idx) const;
+    int getMemWord(int addr) const;
+    void setMemWord(int addr, int value);
+
+    int pc = 0;             // next instruction to fetch
+    uint64_t clock = 0;
+    uint64_t retired = 0;
+
+private:
+    enum class State : uint8_t { Waiting, Executing, Done };
+    enum class Unit : uint8_t { None, Alu, Load, Store };
+
+    struct Entry {
+        Instruction ins;
+        int pc = 0;
+        Prediction pred;
+        State state = State::Waiting;
+        Unit unit = Unit::None;
+        int8_t dest = -1;          // architectural destination, -1 if none
+        int32_t src[2] = {-1, -1}; // producing ROB slot of rs and rt, -1 once known
+        int32_t val[2] = {0, 0};
+        int32_t value = 0;         // result, or store data
+        int32_t addr = 0;          // load or store address once issued
+        int32_t nextPc = 0;        // actual successor of a transfer
+        bool transfer = false;
+        bool mispredicted = false;
+        uint64_t doneAt = 0;       // cycle the result completes
+    };
+
+    struct Fetched {
+        Instruction ins;
+        int pc = 0;
+        Prediction pred;
+    };
+
+    void retire();
+    void complete();
+    void issue();
+    void rename();
+    void fetch();
+
+    bool ready(const Entry& e) const;
+    bool olderStoresKnown(int slot) const;
+    void execute(int slot);
+    // Drop every entry younger than slot and refetch from the right path
+    void squashAfter(int slot);
+
+    int slotAt(int age) const { return static_cast<int>((head + age) % rob.size()); }
+    int ageOf(int slot) const { return static_cast<int>((slot + rob.size() - head) % rob.size()); }
+
+    OoOConfig cfg;
+    BranchPredictor predictor;
+
+    Program instrMem;
+    RegisterFile regs;
+    Memory mem;
+
+    std::vector<Entry> rob;                // circular, oldest at head
+    size_t head = 0;
+    size_t count = 0;
+    uint32_t rsUsed = 0;
+    uint32_t lsqUsed = 0;
+    std::array<int32_t, 32> renameMap{};  // youngest ROB slot writing a register, -1 if none
+
+    std::vector<Fetched> fetchQueue;       // circular, 2 * width entries
+    size_t fetchHead = 0;
+    size_t fetched = 0;
+
+    OoOStats counters;
+};
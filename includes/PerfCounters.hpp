@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+
+// Build switch for the pipeline event counters. With SCS_PERF_COUNTERS=0 every
+// update is discarded at compile time and stats() stays zero.
+#ifndef SCS_PERF_COUNTERS
+#define SCS_PERF_COUNTERS 1
+#endif
+
+inline constexpr bool kPerfCounters = SCS_PERF_COUNTERS != 0;
+
+// Hardware-style event counts of the pipelined CPU. Retired instructions
+// are CPU::retired, which also counts with the counters compiled out.
+struct PerfCounters {
+    // Counters listed by forEach, all uint64_t
+    static constexpr int kCount = 19;
+
+    uint64_t cycles = 0;
+
+    uint64_t loadUseStalls = 0;    // cycles IF/ID was held behind a load
+    uint64_t branchStalls = 0;     // cycles IF/ID held a branch resolved in ID for its operands
+    uint64_t redirects = 0;        // mispredicted branches and jumps redirected by EX or ID
+    uint64_t flushed = 0;          // valid wrong-path instructions squashed by redirects
+    uint64_t memStallCycles = 0;   // whole pipeline frozen on a data cache miss
+    uint64_t fetchStallCycles = 0; // IF waiting on an instruction cache miss
+    uint64_t pairsIssued = 0;      // dual issue: cycles ID issued two instructions
+    uint64_t issueSplits = 0;      // dual issue: cycles the younger one of a pair was held back
+
+    // Operands delivered by each bypass path
+    uint64_t fwdExMem = 0;         // EX/MEM ALU result into EX
+    uint64_t fwdMemWb = 0;         // MEM/WB result into EX
+    uint64_t fwdMemLoad = 0;       // load data leaving MEM this cycle into EX
+    uint64_t fwdWbId = 0;          // write-back value read through in ID
+    uint64_t fwdExId = 0;          // EX/MEM ALU result into the ID branch comparator
+
+    // Cycles each stage had no instruction to work on, first lane only
+    uint64_t bubblesIF = 0;
+    uint64_t bubblesID = 0;
+    uint64_t bubblesEX = 0;
+    uint64_t bubblesMEM = 0;
+    uint64_t bubblesWB = 0;
+
+    // Calls f(name, value) for every counter, in declaration order
+    template <typename F>
+    void forEach(F&& f) const { visit(*this, f); }
+
+    // Same, with the counters passed as writable references
+    template <typename F>
+    void forEach(F&& f) { visit(*this, f); }
+
+private:
+    template <typename Self, typename F>
+    static void visit(Self& s, F& f) {
+        f("cycles", s.cycles);
+        f("load_use_stalls", s.loadUseStalls);
+        f("branch_stalls", s.branchStalls);
+        f("redirects", s.redirects);
+        f("flushed", s.flushed);
+        f("mem_stall_cycles", s.memStallCycles);
+        f("fetch_stall_cycles", s.fetchStallCycles);
+        f("pairs_issued", s.pairsIssued);
+        f("issue_splits", s.issueSplits);
+        f("fwd_ex_mem", s.fwdExMem);
+        f("fwd_mem_wb", s.fwdMemWb);
+        f("fwd_mem_load", s.fwdMemLoad);
+        f("fwd_wb_id", s.fwdWbId);
+        f("fwd_ex_id", s.fwdExId);
+        f("bubbles_if", s.bubblesIF);
+        f("bubbles_id", s.bubblesID);
+        f("bubbles_ex", s.bubblesEX);
+        f("bubbles_mem", s.bubblesMEM);
+        f("bubbles_wb", s.bubblesWB);
+    }
+};
+
+static_assert(sizeof(PerfCounters) == PerfCounters::kCount * sizeof(uint64_t),
+              "PerfCounters::kCount must match the counters forEach visits");
+
+// Counter update that compiles to nothing when the counters are disabled
+#define SCS_COUNT(stats, field, n) \
+    do { if constexpr (kPerfCounters) (stats).field += (n); } while (0)
@@ -1,10 +1,20 @@
 #pragma once
+#include <cstdint>
 #include "Instructions.hpp"
 #include "ControlSignals.hpp"
 
+// What IF predicted would follow an instruction, checked when it reaches EX
+struct Prediction {
+    int32_t nextPc = 0;
+    int32_t counter = -1;   // direction counter consulted, -1 if none
+    int16_t rasPtr = 0;     // return stack checkpoint from before this instruction
+    int16_t rasCount = 0;
+};
+
 struct IF_ID {
     Instruction rawInstr; 
     int pc = 0;
+    Prediction pred;
     bool valid = false;
 };
 
@@ -17,6 +27,8 @@ struct ID_EX {
     int addr = 0;
     int rs = 0;
     int rt = 0;
+    Prediction pred;
+    bool resolved = false;   // branch or jump already verified by ID
 
     ControlSignals ctrl;
 
@@ -25,6 +37,7 @@ struct ID_EX {
 
 struct EX_MEM {
     Instruction rawInstr;
+    int pc = 0;
     int alu_result = 0;
     int val_rt = 0; 
     int branchTarget = 0;
@@ -37,6 +50,7 @@ struct EX_MEM {
 
 struct MEM_WB {
     Instruction rawInstr;
+    int pc = 0;
     int alu_result = 0;
     int mem_data = 0;
 
@@ -45,11 +59,58 @@ struct MEM_WB {
     bool valid = false;
 };
 
+// Double-buffered latch. Stages read cur() and write next(), commit() flips
+// the bank index so advancing a cycle never copies the latch contents.
+template <typename T>
+struct Latch {
+    T bank[2];
+    uint8_t front = 0;
+    bool holdReq = false;
+    bool bubbleReq = false;
+
+    const T& cur() const { return bank[front]; }
+    T& next() { return bank[front ^ 1]; }
+    const T& next() const { return bank[front ^ 1]; }
+
+    // Stall: keep the current contents for one more cycle
+    void hold() { holdReq = true; }
+    // Flush: whatever is latched at the end of this cycle becomes a bubble
+    void bubble() { bubbleReq = true; }
+
+    void commit() {
+        if (!holdReq) front ^= 1;
+        if (bubbleReq) bank[front].valid = false;
+        holdReq = false;
+        bubbleReq = false;
+    }
+
+    void clear() {
+        bank[0] = T{};
+        bank[1] = T{};
+        front = 0;
+        holdReq = false;
+        bubbleReq = false;
+    }
+};
+
 struct PipelineRegisters {
-    IF_ID if_id, if_id_next;
-    ID_EX id_ex, id_ex_next;
-    EX_MEM ex_mem, ex_mem_next;
-    MEM_WB mem_wb, mem_wb_next;
+    Latch<IF_ID> if_id;
+    Latch<ID_EX> id_ex;
+    Latch<EX_MEM> ex_mem;
+    Latch<MEM_WB> mem_wb;
+
+    // Second lane of the dual-issue mode, holding the younger instruction of
+    // each pair. Always empty with single issue. The stages and commit()
+    // take the width as a template argument, so a single-issue cycle does
+    // not even test it.
+    Latch<IF_ID> if_id2;
+    Latch<ID_EX> id_ex2;
+    Latch<EX_MEM> ex_mem2;
+    Latch<MEM_WB> mem_wb2;
+    bool dual = false;
 
-    void clearNext();
+    // End of cycle: every latch that is not held takes its next bank
+    template <bool Dual>
+    void commit();
+    void clear();
 };
@@ -1,44 +1,93 @@
 #pragma once
+#include "BranchPredictor.hpp"
 #include "PipelineRegisters.hpp"
 #include "Registerfile.hpp"
-#include "Instructions.hpp"
+#include "Program.hpp"
 #include "Memory.hpp"
 #include "ForwardingUnit.hpp"
-#include <vector>
+#include "PerfCounters.hpp"
 
 class IFStage {
 public:
     void evaluate(PipelineRegisters& pipe,
-                  const std::vector<Instruction>& instrMem,
+                  const Program& instrMem,
                   int pc_current,
                   int& pc_next,
-                  bool stall);
+                  bool stall,
+                  BranchPredictor& predictor);
+
+    // Dual issue: fills both IF/ID slots. After a split issue the held-back
+    // younger instruction moves into slot 0 and only slot 1 is fetched.
+    // fetch is false while IF waits on the I-cache or the CPU drains,
+    // lineWords the I-cache line in words (0 without caches).
+    void evaluatePair(PipelineRegisters& pipe,
+                      const Program& instrMem,
+                      int pc_current,
+                      int& pc_next,
+                      bool stall,
+                      bool split,
+                      bool fetch,
+                      int lineWords,
+                      BranchPredictor& predictor);
 };
 
 class IDStage {
 public:
-    // When stalled, ID should NOT consume IF/ID, instead it inserts a bubble into ID/EX
-    void evaluate(PipelineRegisters& pipe, const RegisterFile& regs, bool stall);
+    // When stalled, ID should NOT consume IF/ID, instead it inserts a bubble into ID/EX.
+    // With BranchStage::ID it also resolves branches and jumps and redirects pc_next.
+    void evaluate(PipelineRegisters& pipe, const RegisterFile& regs, bool stall,
+                  BranchStage branchStage, int& pc_next, BranchPredictor& predictor,
+                  PerfCounters& stats);
+
+    // Dual issue: decodes both slots, or only slot 0 when split. Branches
+    // are always left to EX.
+    void evaluatePair(PipelineRegisters& pipe, const RegisterFile& regs, bool stall, bool split,
+                      PerfCounters& stats);
+
+private:
+    template <bool Dual>
+    void decode(const IF_ID& in, ID_EX& out, const RegisterFile& regs,
+                const PipelineRegisters& pipe, PerfCounters& stats);
+
+    ForwardingUnit forwarding;
 };
 
+// EX, MEM and WB take the issue width as Dual, fixed per CPU::tick
+// instantiation: a single-issue cycle never tests the second lane.
 class EXStage {
 public:
+    template <bool Dual>
     void evaluate(
         PipelineRegisters& pipe,
-        int& pc_next
+        int& pc_next,
+        BranchPredictor& predictor,
+        PerfCounters& stats
     );
 
 private:
+    // One lane, true when it redirected fetch
+    template <bool Dual>
+    bool execute(PipelineRegisters& pipe, const ID_EX& in, EX_MEM& out, int& pc_next,
+                 BranchPredictor& predictor, PerfCounters& stats);
+
     ForwardingUnit forwarding;
 };
 
 
 class MEMStage {
 public:
+    template <bool Dual>
     void evaluate(PipelineRegisters& pipe, Memory& mem);
+
+private:
+    void access(const EX_MEM& in, MEM_WB& out, Memory& mem);
 };
 
 class WBStage {
 public:
+    template <bool Dual>
     void evaluate(PipelineRegisters& pipe, RegisterFile& regs);
+
+private:
+    void write(const MEM_WB& in, RegisterFile& regs, int port);
 };
\ No newline at end of file
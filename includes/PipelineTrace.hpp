@@ -0,0 +1,204 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MappedFile.hpp"
+
+// One cycle of the in-order pipeline as a trace records it: the instruction
+// index in each latch at the start of the cycle, why the cycle did not
+// advance normally, and the register and memory writes it committed.
+struct TraceCycle {
+    // Latch order: IF/ID, ID/EX, EX/MEM, MEM/WB, then the same for lane 2
+    static constexpr int kLatches = 8;
+
+    // flags
+    static constexpr uint8_t kStall = 1;       // IF/ID held on a hazard
+    static constexpr uint8_t kFlush = 2;       // a mispredict squashed IF/ID
+    static constexpr uint8_t kFetchWait = 4;   // IF waited on the instruction cache
+    static constexpr uint8_t kFrozen = 8;      // a data miss froze the whole pipeline
+
+    uint64_t cycle = 0;
+    int32_t latch[kLatches] = {-1, -1, -1, -1, -1, -1, -1, -1};   // -1 for a bubble
+    uint8_t flags = 0;
+
+    uint8_t regWrites = 0;   // write ports used, in commit order
+    uint8_t regIdx[2] = {0, 0};
+    int32_t regValue[2] = {0, 0};
+
+    bool memWrite = false;
+    int32_t memAddr = 0;
+    int32_t memValue = 0;
+};
+
+bool operator==(const TraceCycle& a, const TraceCycle& b);
+inline bool operator!=(const TraceCycle& a, const TraceCycle& b) { return !(a == b); }
+
+// Registers and non-zero memory words when tracing started, or after they
+// changed outside the recorded commits, so a replay can rebuild the state
+// of any cycle from these and the commits alone
+struct TraceState {
+    std::array<int32_t, 32> regs{};
+    std::vector<std::pair<int32_t, int32_t>> memory;   // (address, value)
+};
+
+struct TraceConfig {
+    uint32_t chunkCycles = 64 * 1024;   // cycles per independently decodable chunk
+    uint32_t ringCycles = 64 * 1024;    // producer/writer queue, rounded up to a power of two
+};
+
+// Streams TraceCycles to a file. push() only copies the cycle into a
+// single-producer single-consumer ring; a background thread encodes and
+// writes, so the simulating thread never waits on I/O. It does wait, and
+// counts producerWaits, when the writer falls a whole ring behind.
+//
+// File layout, little-endian, version 3 (version 1 had no start block,
+// version 2 no state blocks; neither is read):
+//   header   "SCSTRACE", u32 version, u32 chunkCycles
+//   start    u32 "INIT", u32 words, 32 x i32 registers, words x (i32 address, i32 value)
+//   chunks   each optionally preceded by a state block laid out like the
+//            start block but tagged "STAT", then
+//            u32 "CHNK", u32 payload bytes, u64 first cycle, u32 cycles, payload
+//   index    per chunk u64 file offset, u64 first cycle, u32 cycles, u32 bytes,
+//            u64 file offset of its state block or 0
+//   trailer  u64 index offset, u32 chunks, u32 "TIDX"
+//
+// A chunk holds consecutive cycles; a cycle that does not follow the last
+// one (reset, restore, stepBack) starts a new chunk, and so does a state
+// pushed between two cycles. Every chunk starts from an empty delta state,
+// so any chunk decodes on its own. Within a chunk a cycle is one header
+// byte, usually followed only by its commits:
+//   bit 0-3  flags
+//   bit 4    latch mask follows: a byte of the latches that did not move as
+//            predicted, each followed by zigzag varint (actual - predicted)
+//   bit 5    register writes follow: per write a byte of index | 0x20 if
+//            another follows, then zigzag varint (value - last value of
+//            that register in the chunk)
+//   bit 6    memory write follows: zigzag varint address and value, each
+//            relative to the previous memory write in the chunk
+//   bit 7    repeat: bits 0-6 zero, varint n more copies of the previous
+//            cycle, which had no commits
+// The prediction moves every latch down one stage and fetches the next
+// sequential instruction, or keeps IF/ID and bubbles ID/EX after a stall,
+// or keeps everything after a frozen cycle.
+class TraceWriter {
+public:
+    // Throws std::runtime_error when path can not be created or a size is zero
+    TraceWriter(const std::string& path, const TraceConfig& cfg = {}, const TraceState& start = {});
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // Producer side, one thread only
+    void push(const TraceCycle& c);
+    // The registers and memory changed other than by the pushed commits; the
+    // next cycle starts a chunk that replays from s
+    void push(const TraceState& s);
+
+    // Write everything pushed, then the index, and stop the writer. Throws
+    // std::runtime_error if writing failed. The destructor closes silently.
+    void close();
+
+    uint64_t cycles() const { return pushed; }
+    uint64_t producerWaits() const { return waits; }
+    // Encoded so far, file header and index excluded
+    uint64_t bytes() const { return payloadBytes.load(std::memory_order_relaxed); }
+
+private:
+    void writerLoop();
+    void encode(const TraceCycle& c);
+    void flushChunk();
+    void writeState(const TraceState& s);
+
+    TraceConfig cfg;
+    std::ofstream out;
+    std::thread writer;
+
+    std::vector<TraceCycle> ring;
+    uint64_t mask = 0;
+    alignas(64) std::atomic<uint64_t> head{0};   // written by the producer
+    alignas(64) std::atomic<uint64_t> tail{0};   // written by the writer
+    alignas(64) std::atomic<bool> closing{false};
+    uint64_t pushed = 0;
+    uint64_t waits = 0;
+
+    // States in front of the cycle at ring position first, rare enough for a lock
+    std::mutex statesLock;
+    std::deque<std::pair<uint64_t, TraceState>> states;
+    std::atomic<uint64_t> statesPushed{0};
+
+    // Writer thread only
+    struct ChunkIndex {
+        uint64_t offset;
+        uint64_t firstCycle;
+        uint32_t cycles;
+        uint32_t bytes;
+        uint64_t state;
+    };
+    std::vector<ChunkIndex> index;
+    std::vector<uint8_t> chunk;
+    uint64_t chunkFirst = 0;
+    uint32_t chunkCount = 0;
+    uint64_t chunkState = 0;   // state block in front of the current chunk
+    std::deque<std::pair<uint64_t, TraceState>> due;   // taken from states
+    uint64_t fileOffset = 0;
+    uint32_t repeats = 0;     // copies of prev not yet written
+    bool prevRepeatable = false;
+    TraceCycle prev;          // delta state, reset at every chunk
+    int32_t lastFetched = -1;
+    int32_t regs[32] = {};
+    int32_t memAddr = 0;
+    int32_t memValue = 0;
+    std::atomic<uint64_t> payloadBytes{0};
+    std::atomic<bool> failed{false};
+    bool closed = false;
+};
+
+// Random access to a mapped trace file through its chunk index. A file
+// whose writer never closed it has no index; the chunks are then found by
+// walking their headers, and a truncated last chunk is dropped.
+class TraceReader {
+public:
+    struct Chunk {
+        uint64_t offset;        // of the chunk header
+        uint64_t firstCycle;
+        uint32_t cycles;
+        uint32_t bytes;         // payload
+        uint64_t state;         // of the state block in front, 0 if none
+    };
+
+    // Throws std::runtime_error when path is not a trace
+    explicit TraceReader(const std::string& path);
+
+    const TraceState& start() const { return initial; }
+    size_t chunks() const { return index.size(); }
+    const Chunk& chunk(size_t i) const { return index[i]; }
+    uint64_t cycles() const { return total; }
+
+    // Index of the last chunk holding cycle, chunks() if none does
+    size_t find(uint64_t cycle) const;
+
+    // Replace out with the cycles of chunk i
+    void read(size_t i, std::vector<TraceCycle>& out) const;
+    // Replace out with the state chunk i starts from, false when the chunk
+    // continues from the end of the previous one (or the start block)
+    bool readState(size_t i, TraceState& out) const;
+
+    // Decode one chunk payload. Throws std::runtime_error on malformed data.
+    static void decode(const uint8_t* payload, size_t bytes, uint64_t firstCycle, uint32_t cycles,
+                       std::vector<TraceCycle>& out);
+
+private:
+    MappedFile file;
+    TraceState initial;
+    std::vector<Chunk> index;
+    uint64_t total = 0;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Instructions.hpp"
+
+// A loaded program: the instruction stream plus a side table with the text
+// of every instruction, so the hot path only ever copies Instruction, and
+// the data segments that initialise memory.
+//
+// The tables live in storage that copies share, so copying a program is
+// cheap. It is either built by append, which first unshares it, or a
+// mapped program image (ProgramLoader::loadImage) used in place.
+class Program {
+public:
+    // Words placed at consecutive addresses from address when a program loads
+    struct DataSegment {
+        int32_t address;
+        uint32_t offset;   // of the first word in the word pool
+        uint32_t words;
+    };
+
+    Program() = default;
+
+    // Text for every instruction is produced by disassembly
+    explicit Program(const std::vector<Instruction>& code);
+
+    // Append an instruction and set its index handle. Empty text falls back to disassembly.
+    void append(Instruction ins, std::string_view text = {});
+
+    // Replace the instruction at idx, keeping its index handle. For
+    // assemblers resolving labels after the fact.
+    void patch(size_t idx, Instruction ins);
+
+    // Room for that many more instructions and bytes of text
+    void reserve(size_t instructions, size_t textBytes);
+
+    // Append a data segment of words starting at address
+    void appendData(int32_t address, const std::vector<int32_t>& words);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const Instruction& operator[](size_t idx) const { return code[idx]; }
+    const Instruction* begin() const { return code; }
+    const Instruction* end() const { return code + count; }
+
+    // Text of the instruction at idx, "" for handles outside the program
+    const char* text(int idx) const;
+    const char* text(const Instruction& ins) const { return text(ins.index); }
+    // False when text() disassembles because the program carries no text
+    bool hasText() const { return texts == count; }
+
+    size_t dataSegments() const { return segmentCount; }
+    const DataSegment& dataSegment(size_t i) const { return segments[i]; }
+    const int32_t* dataWords(const DataSegment& s) const { return words + s.offset; }
+
+    // Calls f(address, value) for every data word, in segment order
+    template <typename F>
+    void forEachDataWord(F&& f) const {
+        for (size_t s = 0; s < segmentCount; ++s) {
+            const int32_t* w = words + segments[s].offset;
+            for (uint32_t i = 0; i < segments[s].words; ++i) f(segments[s].address + static_cast<int32_t>(i), w[i]);
+        }
+    }
+
+    // A program viewing tables in storage, which its copies keep alive.
+    // Text may be absent (textOffset null), text() then disassembles on demand.
+    struct View {
+        const Instruction* code = nullptr;
+        size_t count = 0;
+        const uint32_t* textOffset = nullptr;   // count entries into textPool
+        const char* textPool = nullptr;
+        size_t textBytes = 0;
+        const DataSegment* segments = nullptr;
+        size_t segmentCount = 0;
+        const int32_t* words = nullptr;
+    };
+    static Program view(const View& tables, std::shared_ptr<const void> storage);
+
+private:
+    struct Tables;
+    struct Disassembly;
+
+    // Make the tables exclusive to this program, copying shared or viewed ones
+    Tables& own();
+    void bind(const Tables& t);
+
+    std::shared_ptr<Tables> owned;         // built by append, shared with copies until one appends
+    std::shared_ptr<const void> storage;   // holds the tables of a view
+    std::shared_ptr<Disassembly> disassembly;   // text of a view without any, made once on demand
+
+    const Instruction* code = nullptr;
+    size_t count = 0;
+
+    // NUL separated strings, textOffset[i] is the start of instruction i
+    const char* textPool = nullptr;
+    const uint32_t* textOffset = nullptr;
+    size_t texts = 0;
+    size_t textBytes = 0;
+
+    const DataSegment* segments = nullptr;
+    size_t segmentCount = 0;
+    const int32_t* words = nullptr;
+};
+
+// Render an instruction in the loader's syntax (branch targets as indices when known)
+std::string disassemble(const Instruction& ins);
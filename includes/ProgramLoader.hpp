@@ -1,9 +1,75 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <vector>
-#include "Instructions.hpp"
+#include <string_view>
+#include "Program.hpp"
+
+// Layout of raw MIPS32 machine code, see ProgramLoader::loadBinary
+struct MipsFormat {
+    uint32_t base = 0;          // byte address of the first word, 4-aligned
+    bool bigEndian = true;      // false for mipsel
+
+    // The --mips and --mips-base values of the tools: "be" or "le", and a
+    // decimal or 0x hex byte address, word aligned. False, changing nothing,
+    // for anything else.
+    bool parseByteOrder(const std::string& s);
+    bool parseBase(const std::string& s);
+};
 
 class ProgramLoader {
 public:
-    static std::vector<Instruction> loadFromFile(const std::string& path);
+    // A text listing, or a program image (detected by its magic) through loadImage
+    static Program loadFromFile(const std::string& path);
+
+    // Assemble a listing. One statement per line, '#' or '//' starts a comment:
+    //   name:                      labels, any number at the start of a line
+    //   add $3, $1, $2             commas optional, registers $0 to $31
+    //   lw $2, 8($1)               the offset may be empty or a label
+    //   beq $1, $2, target         targets are labels or absolute instruction indices
+    //   .text                      instructions follow (the default)
+    //   .data [address]            data words follow, from address or where the last .data stopped
+    //   .word v, ...               data words, numbers or labels
+    //   .space n                   skip n words, left zero
+    // Numbers are decimal or 0x hex. A label names its instruction index in
+    // .text and its word address in .data, and either can stand for a number.
+    // Every error is collected; they are thrown together, one "Line L, col C:
+    // message" per line, as a std::runtime_error.
+    static Program assemble(std::string_view source);
+
+    // Program images, as written by the cpu_asm tool. The file is mapped and
+    // its instructions and text are used in place: loading reads the
+    // instructions once to check them and no copy is made, the text is only
+    // paged in where it is looked up.
+    //
+    // Layout, in host byte order and checked against it:
+    //   header   "SCSIMAGE", u32 version, u32 byte order mark 0x01020304,
+    //            u32 sizeof(Instruction), u32 sections, u64 file bytes
+    //   table    per section u32 kind, u32 reserved, u64 offset, u64 count
+    //   sections each 64-byte aligned, one per kind at most:
+    //            1 instructions, count x Instruction with index set
+    //            2 text offsets, count x u32 into the text pool, optional
+    //            3 text pool, count bytes of NUL terminated strings
+    //            4 data segments, count x Program::DataSegment
+    //            5 data words, count x i32
+    // Unknown kinds are skipped. The loader checks the layout, and that every
+    // instruction has a known opcode and registers $0 to $31.
+    //
+    // Both throw std::runtime_error on I/O errors; loadImage also for a file
+    // that is not a valid image.
+    static Program loadImage(const std::string& path);
+    static void writeImage(const Program& program, const std::string& path, bool withText = true);
+
+    static bool isImage(const std::string& path);
+
+    // Raw MIPS32 machine code, e.g. objcopy -O binary -j .text of a cross
+    // compiled program. Every word is decoded once by MipsDecoder into the
+    // program, which is then the predecode cache: instruction (pc - base) / 4
+    // is what IF fetches for byte address pc. Execution starts at the first
+    // word. Data addresses are used as they are, so word-aligned lw/sw keep
+    // their meaning in the word-addressed memory. Throws std::runtime_error
+    // on I/O errors and, listing every offending word, on words that do not
+    // decode, or jump or branch outside the code.
+    static Program loadBinary(const std::string& path, const MipsFormat& format = {});
+    static Program decodeBinary(const uint8_t* bytes, size_t size, const MipsFormat& format = {});
 };
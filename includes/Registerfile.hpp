@@ -1,21 +1,36 @@
 #pragma once
 #include <array>
 #include <optional>
+#include <utility>
+
+class CommitJournal;
 
 class RegisterFile {
 public:
+    // Write ports, one per write-back lane. commit() applies them in port
+    // order, so the younger instruction of a pair wins on the same register.
+    static constexpr int kWritePorts = 2;
+
     RegisterFile();
 
     // Clear all registers to 0 and discard any pending write
     void reset();
 
     int read(int idx) const; 
-    void writeNext(int idx, int value); 
-    void commit(); 
+    void writeNext(int idx, int value, int port = 0);
+    // Ports is how many write ports are in use, a single-issue pipeline
+    // does not look at the second one
+    template <int Ports = kWritePorts>
+    void commit();
+    // Same, recording the overwritten value in the journal first
+    template <int Ports = kWritePorts>
+    void commit(CommitJournal& journal);
 
     const std::array<int,32>& getRegs() const { return regs; }
+    // (index, value) the next commit writes through port, if any
+    const std::optional<std::pair<int,int>>& pending(int port = 0) const { return pendingWrite[port]; }
 
 private:
     std::array<int,32> regs;
-    std::optional<std::pair<int,int>> pendingWrite;
+    std::array<std::optional<std::pair<int,int>>, kWritePorts> pendingWrite;
 };
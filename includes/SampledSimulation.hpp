@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CPU.hpp"
+#include "FunctionalCPU.hpp"
+#include "Program.hpp"
+
+// SMARTS-style sampling: every period the program fast-forwards on the
+// functional engine, then the architectural state moves into the pipelined
+// CPU for a warm-up window and a measured window, and moves back after a drain.
+struct SamplingConfig {
+    uint64_t period = 100000;      // instructions from one sample start to the next
+    uint64_t warmupInstrs = 2000;  // detailed but not measured
+    uint64_t sampleInstrs = 1000;  // detailed and measured
+    uint64_t maxInstrs = UINT64_MAX;
+    double zScore = 1.96;          // 95% confidence
+};
+
+struct SamplingResult {
+    uint64_t instructions = 0;     // all retired instructions, either engine
+    uint64_t detailedInstrs = 0;   // retired by the pipeline, warm-up and drain included
+    uint64_t detailedCycles = 0;
+    bool halted = false;
+
+    std::vector<double> sampleCpi;
+    double cpiMean = 0.0;
+    double cpiStdDev = 0.0;
+    double ciHalfWidth = 0.0;      // cpiMean +- ciHalfWidth
+    double estimatedCycles = 0.0;  // cpiMean * instructions
+};
+
+class SampledSimulation {
+public:
+    explicit SampledSimulation(const SamplingConfig& cfg = {});
+
+    void loadProgram(const Program& program);
+    void setMemWord(int addr, int value);
+
+    SamplingResult run();
+
+    // Final architectural state lives in the functional engine
+    const FunctionalCPU& functional() const { return fast; }
+
+private:
+    // Tick until `count` more instructions retire or the pipeline halts
+    void detailedRetire(uint64_t count);
+
+    SamplingConfig cfg;
+    FunctionalCPU fast;
+    CPU detailed;
+};
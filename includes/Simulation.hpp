@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "BranchPredictor.hpp"
+#include "Cache.hpp"
+#include "OoOCPU.hpp"
+#include "PerfCounters.hpp"
+#include "Program.hpp"
+#include "SampledSimulation.hpp"
+
+// One-shot runs of a program on any engine, shared by the headless front ends.
+
+enum class EngineKind {
+    Pipeline,   // cycle-accurate 5-stage CPU
+    ISS,        // FunctionalCPU, interpreted
+    JIT,        // FunctionalCPU, translated blocks
+    Sampled,    // SampledSimulation
+    Wide,       // WideCPU, lockstep lanes with modelled pipeline timing
+    OoO         // OoOCPU, out-of-order core
+};
+
+const char* engineName(EngineKind kind);
+std::optional<EngineKind> parseEngine(std::string_view name);
+
+struct SimConfig {
+    EngineKind engine = EngineKind::Pipeline;
+    uint64_t maxCycles = 10000000;   // instruction limit for the functional engines, at most INT_MAX for the pipeline
+    SamplingConfig sampling;
+
+    // Cache timing model of the pipeline engine, none by default
+    std::optional<CacheHierarchyConfig> caches;
+
+    // Branch prediction of the pipeline and out-of-order engines, static
+    // not-taken by default
+    PredictorConfig predictor;
+    BranchStage branchStage = BranchStage::EX;
+    int issueWidth = 1;              // 2 for the dual-issue pipeline
+    std::string tracePath;           // binary pipeline trace of the run, none if empty;
+                                     // the run throws std::runtime_error if writing it failed
+
+    // Window sizes and units of the out-of-order engine
+    OoOConfig ooo;
+
+    // (start, count) word ranges copied into SimResult::memory
+    std::vector<std::pair<int,int>> memRanges;
+};
+
+struct SimResult {
+    bool halted = false;
+    uint64_t instructions = 0;
+
+    // Only engines that model time report cycles
+    bool hasCycles = false;
+    uint64_t cycles = 0;             // estimated for the sampled engine
+    double cpi = 0.0;
+    double cpiCiHalfWidth = 0.0;     // sampled engine only
+    size_t samples = 0;
+
+    // Pipeline engine only, and only in builds with SCS_PERF_COUNTERS
+    bool hasStats = false;
+    PerfCounters stats;
+
+    // Pipeline engine with SimConfig::caches only, L1I, L1D, then L2
+    std::vector<std::pair<const char*, CacheStats>> cacheStats;
+
+    // Pipeline engine only
+    bool hasPredictor = false;
+    PredictorStats predictor;
+
+    // Out-of-order engine only
+    bool hasOoO = false;
+    OoOStats ooo;
+
+    std::array<int,32> regs{};
+    std::vector<int> memory;         // memRanges, concatenated
+
+    // BatchRunner only: what the job threw, everything above is then unset
+    std::string error;
+};
+
+// Split 16 KiB 4-way L1s over a 256 KiB 8-way L2, the default of the front ends
+CacheHierarchyConfig defaultCacheHierarchy();
+
+// initMem holds (address, value) words written before the run starts
+SimResult simulate(const Program& program, const SimConfig& cfg,
+                   const std::vector<std::pair<int,int>>& initMem = {});
+
+// Runs one lane per initial memory image in lockstep on WideCPU, ignores cfg.engine.
+// maxCycles is the instruction limit of each lane.
+std::vector<SimResult> simulateWide(const Program& program, const SimConfig& cfg,
+                                    const std::vector<std::vector<std::pair<int,int>>>& initMems);
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Memory.hpp"
+#include "PipelineTrace.hpp"
+
+// Any recorded cycle of a pipeline trace, found by seeking instead of
+// simulating. Opening walks the trace once and keeps a keyframe per chunk:
+// the registers and memory as the chunk starts, memory sharing its pages
+// copy-on-write with the neighbouring keyframes. A seek then decodes one
+// chunk at most and replays its commits up to the cycle, however long the
+// run was.
+//
+// Positions count recorded cycles in file order. Where the run went back in
+// time or was edited (stepBack, restore, setMemWord, ...) the trace holds a
+// state block, and the chunk behind it starts from that state rather than
+// from the commits before it.
+class TraceReplay {
+public:
+    // Throws std::runtime_error when path is not a readable trace
+    explicit TraceReplay(const std::string& path);
+
+    uint64_t length() const { return reader.cycles(); }
+    uint64_t position() const { return pos; }
+
+    // Move to the recorded cycle at position n, clamped to the trace.
+    // Forward seeks inside the current chunk only replay the difference.
+    void seek(uint64_t n);
+
+    // Latches and flags at the start of the cycle, and the writes it commits
+    const TraceCycle& cycle() const { return cycles[local]; }
+    // Architectural state before those writes
+    const std::array<int32_t, 32>& regs() const { return regFile; }
+    const Memory& memory() const { return mem; }
+
+    const TraceReader& trace() const { return reader; }
+
+private:
+    struct Keyframe {
+        std::array<int32_t, 32> regs;
+        std::shared_ptr<const Memory> mem;
+    };
+
+    static void fill(const TraceState& s, std::array<int32_t, 32>& regs, Memory& mem);
+    static void apply(const TraceCycle& c, std::array<int32_t, 32>& regs, Memory& mem);
+    void load(size_t chunk);
+
+    TraceReader reader;
+    std::vector<uint64_t> starts;   // position of every chunk's first cycle
+    std::vector<Keyframe> keyframes;
+
+    size_t chunk = 0;
+    std::vector<TraceCycle> cycles;   // decoded current chunk
+    size_t local = 0;                 // cycle within it
+    size_t applied = 0;               // its cycles whose commits are in regFile and mem
+    uint64_t pos = 0;
+    std::array<int32_t, 32> regFile{};
+    Memory mem;
+};
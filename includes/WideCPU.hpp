@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Memory.hpp"
+#include "Program.hpp"
+
+// Predecoded instruction shared with the SIMD kernels
+struct WideOp {
+    uint8_t kind = 0;      // WideKind
+    uint8_t rd = 0;        // destination, writes to $0 go to the sink row 32
+    uint8_t rs = 0;
+    uint8_t rt = 0;
+    int32_t imm = 0;       // immediate, or absolute target for branches and jumps
+    int32_t hazA = -1;     // registers that stall behind a load in EX, -1 if none
+    int32_t hazB = -1;
+    int32_t loadDest = 0;  // destination of a load, 0 for everything else
+};
+
+enum WideKind : uint8_t {
+    W_NOP, W_ADD, W_SUB, W_AND, W_OR, W_XOR, W_SLT,
+    W_ADDI, W_ANDI, W_ORI, W_LW, W_SW,
+    W_BEQ, W_BNE, W_J, W_JAL, W_JR
+};
+
+// Lockstep engine for running one program on many independent machines
+// ("lanes") at once, e.g. parameter sweeps over initial memory images.
+// Registers and memory are stored structure-of-arrays, one row per register
+// or word with a column per lane, so an instruction is applied to all lanes
+// with SIMD. Lanes that diverge are masked: every step executes the lowest
+// pc among the running lanes, the others wait until control reconverges.
+//
+// Memory is a dense window of memWords words per lane for the vector loads;
+// addresses outside it fall back to a sparse Memory per lane, taken lane by
+// lane. Architectural results per lane match FunctionalCPU and CPU. Cycle counts
+// come from the timing rules of the 5-stage pipeline (load-use stalls,
+// 2-cycle flush on taken control transfers) and equal CPU::clock once a
+// lane has halted.
+class WideCPU {
+public:
+    enum class Kernel {
+        Auto,     // best one the host supports
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    explicit WideCPU(int lanes, size_t memWords = 1024);
+
+    int lanes() const { return laneCount; }
+
+    // False if the kernel was not compiled in or the host lacks the instructions
+    bool setKernel(Kernel kernel);
+    Kernel kernel() const { return active; }
+    static const char* kernelName(Kernel kernel);
+
+    void loadProgram(const Program& program);
+
+    // Reset every lane while keeping the currently loaded program
+    void reset(bool clearMemory = true);
+
+    // Run every lane for up to maxInstrs instructions or until it halts,
+    // returns the instructions retired over all lanes
+    uint64_t run(uint64_t maxInstrs);
+
+    bool isHalted(int lane) const;
+    bool allHalted() const;
+
+    int pc(int lane) const { return pcs[lane]; }
+    uint64_t retired(int lane) const { return retiredTotal[lane]; }
+    uint64_t cycles(int lane) const;
+
+    int getReg(int lane, int idx) const;
+    void setReg(int lane, int idx, int value);
+    int getMemWord(int lane, int addr) const;
+    void setMemWord(int lane, int addr, int value);
+
+private:
+    // The program's data segments into every lane
+    void loadData();
+
+    int laneCount;
+    int stride;          // lanes rounded up to the widest vector
+    size_t memWords;
+    Kernel active = Kernel::Scalar;
+
+    Program instrMem;
+    std::vector<WideOp> ops;
+
+    // Column-major state: element [row * stride + lane]
+    std::vector<int32_t> regs;     // 33 rows, the last one absorbs writes to $0
+    std::vector<int32_t> mem;
+    std::vector<int32_t> pcs;
+    std::vector<Memory> far;       // per lane, everything outside the dense window
+
+    // Per-lane bookkeeping of the timing model, lastLoad is the destination
+    // of a load retired in the previous step (0 if none)
+    std::vector<int32_t> lastLoad;
+    std::vector<uint64_t> retiredTotal;
+    std::vector<uint64_t> cyclesTotal;
+
+    // Kernel-side int32 counters for one chunk of run(), folded into the totals
+    std::vector<int32_t> chunkBudget;
+    std::vector<int32_t> chunkCycles;
+};
@@ -4,16 +4,20 @@
 #include <imgui-SFML.h>
 
 #include "CPU.hpp"
+#include "TraceReplay.hpp"
 
 class App {
 public:
-    explicit App(CPU& cpu);
+    // With a replay the windows show the recorded cycles instead of running
+    // cpu, which then only supplies the program text
+    explicit App(CPU& cpu, TraceReplay* replay = nullptr);
     void run();
 
 private:
     sf::RenderWindow window;
     sf::Texture pipelineTexture;
     CPU& cpu;
+    TraceReplay* replay;
 
     // UI run control
     bool running = false;
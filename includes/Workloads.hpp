@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include "Program.hpp"
+
+// Synthetic programs for throughput measurements, sized by the number of
+// instructions they retire before halting.
+
+enum class WorkloadKind {
+    Loop,          // counted loop of ALU ops with a store/load pair
+    LoadHeavy,     // pointer walk over an array, dependent loads
+    BranchHeavy,   // data-dependent forward branches, mixed outcomes
+    CallHeavy      // nested JAL/JR calls
+};
+
+const char* workloadName(WorkloadKind kind);
+std::optional<WorkloadKind> parseWorkload(std::string_view name);
+
+// Program retiring roughly dynamicInstrs instructions (within one loop iteration)
+Program makeWorkload(WorkloadKind kind, uint64_t dynamicInstrs);
@@ -0,0 +1,237 @@
+#include "Cache.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCS_CACHE_SSE2 1
+#else
+#define SCS_CACHE_SSE2 0
+#endif
+
+namespace {
+
+bool isPow2(uint32_t x) { return x && !(x & (x - 1)); }
+
+uint32_t log2u(uint32_t x) {
+    uint32_t n = 0;
+    while (x >>= 1) ++n;
+    return n;
+}
+
+} // namespace
+
+Cache::Cache(const CacheConfig& config)
+: cfg(config)
+{
+    // Lines of at least two words keep every real tag below kInvalid
+    if (!isPow2(cfg.lineBytes) || cfg.lineBytes < 8 || !isPow2(cfg.ways) || cfg.ways > 64 ||
+        !isPow2(cfg.sizeBytes) || cfg.sizeBytes < cfg.lineBytes * cfg.ways || cfg.hitLatency == 0) {
+        throw std::runtime_error("Cache: size, line size and ways must be powers of two that fit");
+    }
+
+    lineShift = log2u(cfg.lineBytes / 4);
+    sets = cfg.sizeBytes / (cfg.lineBytes * cfg.ways);
+    setBits = log2u(sets);
+
+    tags.assign((size_t)sets * cfg.ways, kInvalid);
+    states.assign(tags.size(), LineState::Invalid);
+    if (cfg.replacement == Replacement::LRU) stamps.assign(tags.size(), 0);
+    else plru.assign(sets, 0);
+}
+
+void Cache::invalidate() {
+    std::fill(tags.begin(), tags.end(), kInvalid);
+    std::fill(states.begin(), states.end(), LineState::Invalid);
+    std::fill(stamps.begin(), stamps.end(), 0);
+    std::fill(plru.begin(), plru.end(), 0);
+    clock = 0;
+    lastLine = kInvalid;
+}
+
+int Cache::find(uint32_t set, uint32_t tag) const {
+    const uint32_t* t = tags.data() + (size_t)set * cfg.ways;
+    uint32_t w = 0;
+#if SCS_CACHE_SSE2
+    const __m128i key = _mm_set1_epi32(static_cast<int>(tag));
+    for (; w + 4 <= cfg.ways; w += 4) {
+        const __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t + w)), key);
+        const int m = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (m) {
+            for (int j = 0; j < 4; ++j) {
+                if (m & (1 << j)) return static_cast<int>(w) + j;
+            }
+        }
+    }
+#endif
+    for (; w < cfg.ways; ++w) {
+        if (t[w] == tag) return static_cast<int>(w);
+    }
+    return -1;
+}
+
+uint32_t Cache::victim(uint32_t set) const {
+    const size_t base = (size_t)set * cfg.ways;
+    for (uint32_t w = 0; w < cfg.ways; ++w) {
+        if (tags[base + w] == kInvalid) return w;
+    }
+
+    if (cfg.replacement == Replacement::LRU) {
+        uint32_t best = 0;
+        for (uint32_t w = 1; w < cfg.ways; ++w) {
+            if (stamps[base + w] < stamps[base + best]) best = w;
+        }
+        return best;
+    }
+
+    // Follow the tree bits, each one points at the less recently used half
+    const uint64_t bits = plru[set];
+    uint32_t node = 1, way = 0;
+    for (uint32_t level = 0; level < log2u(cfg.ways); ++level) {
+        const uint32_t b = (bits >> node) & 1;
+        way = way * 2 + b;
+        node = node * 2 + b;
+    }
+    return way;
+}
+
+void Cache::touch(uint32_t set, uint32_t way) {
+    if (cfg.replacement == Replacement::LRU) {
+        stamps[(size_t)set * cfg.ways + way] = ++clock;
+        return;
+    }
+
+    // Point every node on the path away from the way just used
+    uint64_t& bits = plru[set];
+    const uint32_t levels = log2u(cfg.ways);
+    uint32_t node = 1;
+    for (uint32_t level = 0; level < levels; ++level) {
+        const uint32_t b = (way >> (levels - 1 - level)) & 1;
+        if (b) bits &= ~(uint64_t(1) << node);
+        else bits |= uint64_t(1) << node;
+        node = node * 2 + b;
+    }
+}
+
+Cache::Outcome Cache::access(uint32_t addr, bool write) {
+    Outcome out;
+    if (write) counters.writes++;
+    else counters.reads++;
+
+    const uint32_t line = addr >> lineShift;
+    const uint32_t set = line & (sets - 1);
+    const uint32_t tag = line >> setBits;
+
+    int way;
+    if (line == lastLine) way = static_cast<int>(lastSlot - set * cfg.ways);
+    else way = find(set, tag);
+
+    if (way >= 0) {
+        out.hit = true;
+        const size_t slot = (size_t)set * cfg.ways + way;
+        touch(set, way);
+        if (write) {
+            if (cfg.writePolicy == WritePolicy::WriteBack) states[slot] = LineState::Modified;
+            else out.forward = true;
+        }
+        lastLine = line;
+        lastSlot = static_cast<uint32_t>(slot);
+        return out;
+    }
+
+    if (write) counters.writeMisses++;
+    else counters.readMisses++;
+
+    if (write && cfg.writePolicy == WritePolicy::WriteThrough) {
+        out.forward = true;
+        return out;
+    }
+
+    const uint32_t w = victim(set);
+    const size_t slot = (size_t)set * cfg.ways + w;
+    if (tags[slot] != kInvalid && states[slot] == LineState::Modified) {
+        out.writeback = true;
+        out.victimAddr = ((tags[slot] << setBits) | set) << lineShift;
+        counters.writebacks++;
+    }
+
+    tags[slot] = tag;
+    states[slot] = write ? LineState::Modified : LineState::Exclusive;
+    touch(set, w);
+    lastLine = line;
+    lastSlot = static_cast<uint32_t>(slot);
+    return out;
+}
+
+int Cache::slotOf(uint32_t addr) const {
+    const uint32_t line = addr >> lineShift;
+    const uint32_t set = line & (sets - 1);
+    const int way = find(set, line >> setBits);
+    return way < 0 ? -1 : static_cast<int>(set * cfg.ways) + way;
+}
+
+LineState Cache::state(uint32_t addr) const {
+    const int slot = slotOf(addr);
+    return slot < 0 ? LineState::Invalid : states[slot];
+}
+
+void Cache::setState(uint32_t addr, LineState s) {
+    const int slot = slotOf(addr);
+    if (slot < 0) return;
+    states[slot] = s;
+    if (s != LineState::Invalid) return;
+
+    tags[slot] = kInvalid;
+    if (lastSlot == static_cast<uint32_t>(slot)) lastLine = kInvalid;
+}
+
+CacheHierarchy::CacheHierarchy(const CacheHierarchyConfig& cfg)
+: icache(cfg.l1i)
+, dcache(cfg.l1d)
+, memoryLatency(cfg.memoryLatency)
+{
+    if (cfg.l2) level2.emplace(*cfg.l2);
+}
+
+void CacheHierarchy::reset() {
+    for (Cache* c : {&icache, &dcache}) {
+        c->invalidate();
+        c->clearStats();
+    }
+    if (level2) {
+        level2->invalidate();
+        level2->clearStats();
+    }
+}
+
+uint32_t CacheHierarchy::nextLevel(uint32_t addr, bool write) {
+    if (!level2) return memoryLatency;
+
+    const Cache::Outcome o = level2->access(addr, write);
+    // Writebacks and write-through traffic drain through a write buffer
+    if (o.hit || write) return level2->config().hitLatency;
+    return level2->config().hitLatency + memoryLatency;
+}
+
+uint32_t CacheHierarchy::l1Access(Cache& l1, uint32_t addr, bool write) {
+    const Cache::Outcome o = l1.access(addr, write);
+    uint32_t extra = l1.config().hitLatency - 1;
+
+    if (o.writeback) nextLevel(o.victimAddr, true);
+    if (o.forward) nextLevel(addr, true);
+    // Only a line fill makes the pipeline wait for the next level
+    if (!o.hit && !o.forward) extra += nextLevel(addr, false);
+    return extra;
+}
+
+uint32_t CacheHierarchy::fetch(uint32_t pc) {
+    return l1Access(icache, kTextBase + pc, false);
+}
+
+uint32_t CacheHierarchy::load(uint32_t addr) {
+    return l1Access(dcache, addr, false);
+}
+
+uint32_t CacheHierarchy::store(uint32_t addr) {
+    return l1Access(dcache, addr, true);
+}
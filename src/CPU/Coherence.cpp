@@ -0,0 +1,151 @@
+#include "Coherence.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+SnoopBus::SnoopBus(int cores, const CoherenceConfig& config)
+: cfg(config)
+{
+    if (cores < 1) throw std::runtime_error("SnoopBus: needs at least one core");
+    if (cfg.l1d.writePolicy != WritePolicy::WriteBack) {
+        throw std::runtime_error("SnoopBus: MESI needs write-back L1 caches");
+    }
+    ports.reserve(static_cast<size_t>(cores));
+    for (int i = 0; i < cores; ++i) ports.emplace_back(cfg.l1d);
+}
+
+void SnoopBus::reset() {
+    for (Port& p : ports) {
+        p.l1.invalidate();
+        p.l1.clearStats();
+        p.counters = {};
+        p.requests.clear();
+        p.stall = 0;
+    }
+    busFreeAt = 0;
+}
+
+uint32_t SnoopBus::load(int core, uint32_t addr, uint64_t now) {
+    return access(core, addr, false, now);
+}
+
+uint32_t SnoopBus::store(int core, uint32_t addr, uint64_t now) {
+    return access(core, addr, true, now);
+}
+
+uint32_t SnoopBus::access(int core, uint32_t addr, bool write, uint64_t now) {
+    Port& p = ports[core];
+    const uint32_t hit = cfg.l1d.hitLatency - 1;
+    const LineState s = p.l1.state(addr);
+    if (s == LineState::Modified || s == LineState::Exclusive || (s == LineState::Shared && !write)) {
+        p.l1.access(addr, write);
+        return hit;
+    }
+
+    const bool upgrade = s == LineState::Shared;
+    p.requests.push_back({now, addr, write, upgrade});
+    if (!lax) return hit;
+
+    p.l1.access(addr, write);
+    return hit + cfg.busLatency + (upgrade ? 0 : cfg.memoryLatency);
+}
+
+uint32_t SnoopBus::takeStall(int core) {
+    const uint32_t s = ports[core].stall;
+    ports[core].stall = 0;
+    return s;
+}
+
+void SnoopBus::resolve() {
+    queue.clear();
+    for (int c = 0; c < cores(); ++c) {
+        for (const Request& r : ports[c].requests) queue.emplace_back(c, r);
+        ports[c].requests.clear();
+    }
+    // A core has at most one memory access per cycle, so (cycle, core) is unique
+    std::sort(queue.begin(), queue.end(), [](const auto& a, const auto& b) {
+        return a.second.cycle != b.second.cycle ? a.second.cycle < b.second.cycle : a.first < b.first;
+    });
+    for (const auto& q : queue) transact(q.first, q.second);
+}
+
+void SnoopBus::transact(int core, const Request& r) {
+    Port& p = ports[core];
+    CoherenceStats& st = p.counters;
+    uint32_t hold = cfg.busLatency;
+
+    if (lax) {
+        // The line is already in the core's L1, only the other copies move
+        if (!r.write) {
+            st.busReads++;
+            const bool held = snoop(core, r.addr, false, true);
+            const LineState own = p.l1.state(r.addr);
+            if (held && own == LineState::Exclusive) p.l1.setState(r.addr, LineState::Shared);
+            // Written since without a transaction, the copies just shared have to go
+            if (held && own == LineState::Modified) {
+                st.busUpgrades++;
+                snoop(core, r.addr, true, false);
+            }
+            if (!held) hold += cfg.memoryLatency;
+        } else if (r.upgrade) {
+            st.busUpgrades++;
+            snoop(core, r.addr, true, false);
+        } else {
+            st.busReadExclusive++;
+            if (!snoop(core, r.addr, true, true)) hold += cfg.memoryLatency;
+        }
+        // The uncontended part was charged up front, the wait lands on the next quantum
+        p.stall += transaction(core, r.cycle, hold) - hold;
+        return;
+    }
+
+    // Earlier transactions of the cycle may have invalidated the line meanwhile
+    const LineState s = p.l1.state(r.addr);
+    if (!r.write) {
+        st.busReads++;
+        const bool shared = snoop(core, r.addr, false, true);
+        p.l1.access(r.addr, false);
+        if (shared) p.l1.setState(r.addr, LineState::Shared);
+        else hold += cfg.memoryLatency;
+    } else if (s == LineState::Shared) {
+        st.busUpgrades++;
+        snoop(core, r.addr, true, false);
+        p.l1.access(r.addr, true);
+    } else {
+        st.busReadExclusive++;
+        if (!snoop(core, r.addr, true, true)) hold += cfg.memoryLatency;
+        p.l1.access(r.addr, true);
+    }
+    p.stall += transaction(core, r.cycle, hold);
+}
+
+bool SnoopBus::snoop(int core, uint32_t addr, bool exclusive, bool fill) {
+    bool held = false;
+    for (int o = 0; o < cores(); ++o) {
+        if (o == core) continue;
+        Port& other = ports[o];
+        const LineState s = other.l1.state(addr);
+        if (s == LineState::Invalid) continue;
+
+        // The first copy found supplies the data, a Modified one writes back on the way
+        if (fill && !held) other.counters.interventions++;
+        if (s == LineState::Modified) other.counters.snoopWritebacks++;
+        held = true;
+
+        if (exclusive) {
+            other.l1.setState(addr, LineState::Invalid);
+            ports[core].counters.invalidationsSent++;
+            other.counters.invalidationsReceived++;
+        } else {
+            other.l1.setState(addr, LineState::Shared);
+        }
+    }
+    return held;
+}
+
+uint32_t SnoopBus::transaction(int core, uint64_t now, uint32_t hold) {
+    const uint64_t start = std::max(now, busFreeAt);
+    busFreeAt = start + hold;
+    ports[core].counters.busWaitCycles += start - now;
+    ports[core].counters.busBusyCycles += hold;
+    return static_cast<uint32_t>(start - now) + hold;
+}
@@ -0,0 +1,134 @@
+#include "CommitJournal.hpp"
+#include <algorithm>
+
+CommitJournal::CommitJournal(size_t maxBytes)
+: maxChunks(std::max<size_t>(1, maxBytes / kChunkBytes))
+{
+}
+
+void CommitJournal::begin(uint8_t frameTag) {
+    tag = frameTag;
+    undo = 0;
+    len = 0;
+}
+
+void CommitJournal::recordReg(int idx, int oldValue) {
+    // Second write port of a dual-issue cycle
+    if (undo & kRegUndo) {
+        undo |= kReg2Undo;
+        reg2[0] = idx;
+        reg2[1] = oldValue;
+        return;
+    }
+    undo |= kRegUndo;
+    reg[0] = idx;
+    reg[1] = oldValue;
+}
+
+void CommitJournal::recordMem(int addr, int oldValue) {
+    undo |= kMemUndo;
+    memw[0] = addr;
+    memw[1] = oldValue;
+}
+
+void CommitJournal::newChunk() {
+    Chunk c;
+    if (!spare.empty()) {
+        c.data = std::move(spare.back());
+        spare.pop_back();
+    } else {
+        c.data = std::make_unique<uint8_t[]>(kChunkBytes);
+    }
+    chunks.push_back(std::move(c));
+
+    // Over budget: forget the oldest cycles
+    if (chunks.size() > maxChunks) {
+        frameCount -= chunks.front().frames;
+        spare.push_back(std::move(chunks.front().data));
+        chunks.pop_front();
+    }
+}
+
+void CommitJournal::end() {
+    const size_t size = len + ((undo & kRegUndo) ? sizeof(reg) : 0) +
+                        ((undo & kReg2Undo) ? sizeof(reg2) : 0) +
+                        ((undo & kMemUndo) ? sizeof(memw) : 0) + sizeof(Trailer);
+    if (chunks.empty() || chunks.back().used + size > kChunkBytes) newChunk();
+
+    Chunk& c = chunks.back();
+    uint8_t* p = c.data.get() + c.used;
+    std::memcpy(p, scratch.data(), len);
+    p += len;
+    if (undo & kRegUndo) { std::memcpy(p, reg, sizeof(reg)); p += sizeof(reg); }
+    if (undo & kReg2Undo) { std::memcpy(p, reg2, sizeof(reg2)); p += sizeof(reg2); }
+    if (undo & kMemUndo) { std::memcpy(p, memw, sizeof(memw)); p += sizeof(memw); }
+
+    const Trailer t{tag, undo, static_cast<uint16_t>(size)};
+    std::memcpy(p, &t, sizeof(t));
+
+    c.used += size;
+    ++c.frames;
+    ++frameCount;
+}
+
+bool CommitJournal::back(Frame& out) const {
+    if (frameCount == 0) return false;
+
+    const Chunk& c = chunks.back();
+    const uint8_t* endp = c.data.get() + c.used;
+    Trailer t;
+    std::memcpy(&t, endp - sizeof(t), sizeof(t));
+
+    const uint8_t* p = endp - sizeof(t);
+    out = Frame{};
+    out.tag = t.tag;
+    if (t.undo & kMemUndo) {
+        p -= sizeof(memw);
+        int32_t m[2];
+        std::memcpy(m, p, sizeof(m));
+        out.hasMem = true;
+        out.memAddr = m[0];
+        out.memOld = m[1];
+    }
+    if (t.undo & kReg2Undo) {
+        p -= sizeof(reg2);
+        int32_t r[2];
+        std::memcpy(r, p, sizeof(r));
+        out.hasReg2 = true;
+        out.reg2Idx = r[0];
+        out.reg2Old = r[1];
+    }
+    if (t.undo & kRegUndo) {
+        p -= sizeof(reg);
+        int32_t r[2];
+        std::memcpy(r, p, sizeof(r));
+        out.hasReg = true;
+        out.regIdx = r[0];
+        out.regOld = r[1];
+    }
+    out.payload = endp - t.size;
+    out.payloadSize = static_cast<size_t>(p - out.payload);
+    return true;
+}
+
+void CommitJournal::pop() {
+    if (frameCount == 0) return;
+
+    Chunk& c = chunks.back();
+    Trailer t;
+    std::memcpy(&t, c.data.get() + c.used - sizeof(t), sizeof(t));
+    c.used -= t.size;
+    --c.frames;
+    --frameCount;
+
+    if (c.frames == 0) {
+        spare.push_back(std::move(c.data));
+        chunks.pop_back();
+    }
+}
+
+void CommitJournal::clear() {
+    for (Chunk& c : chunks) spare.push_back(std::move(c.data));
+    chunks.clear();
+    frameCount = 0;
+}
@@ -0,0 +1,74 @@
+#include "MappedFile.hpp"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SCS_HAVE_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef SCS_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("MappedFile: can not open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: can not stat " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("MappedFile: can not map " + path);
+        }
+        bytes = static_cast<const uint8_t*>(p);
+        mapped = true;
+    }
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("MappedFile: can not open " + path);
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    bytes = buffer.data();
+    length = buffer.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    buffer = std::move(other.buffer);
+    mapped = other.mapped;
+    length = other.length;
+    bytes = mapped ? other.bytes : buffer.data();
+    other.bytes = nullptr;
+    other.length = 0;
+    other.mapped = false;
+    return *this;
+}
+
+void MappedFile::release() {
+#ifdef SCS_HAVE_MMAP
+    if (mapped) ::munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+}
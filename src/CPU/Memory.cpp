@@ -1,29 +1,159 @@
 #include "Memory.hpp"
-#include <algorithm>
+#include "CommitJournal.hpp"
 
-Memory::Memory(size_t words) {
-    data.assign(words, 0);
+Memory::Memory() = default;
+
+Memory::Memory(const Memory& other) {
+    *this = other;
+}
+
+Memory::Memory(Memory&& other) noexcept
+: root(std::move(other.root))
+, pages(other.pages)
+, base(other.base)
+, written(std::move(other.written))
+, tlbTag(other.tlbTag)
+, tlbPage(other.tlbPage)
+, tlbOwned(other.tlbOwned)
+, pendingWrite(other.pendingWrite)
+{
+    // The pages moved with the table, so the cached pointer stays valid here
+    other.reset();
+}
+
+Memory& Memory::operator=(const Memory& other) {
+    if (this == &other) return *this;
+
+    root = other.root;
+    pages = other.pages;
+    base = other.base;
+    written = other.written;
+    pendingWrite = other.pendingWrite;
+
+    // Every page is shared now, neither side may write through its cache
+    tlbTag = UINT32_MAX;
+    tlbPage = nullptr;
+    tlbOwned = false;
+    other.tlbOwned = false;
+    return *this;
+}
+
+Memory& Memory::operator=(Memory&& other) noexcept {
+    if (this == &other) return *this;
+
+    root = std::move(other.root);
+    pages = other.pages;
+    base = other.base;
+    written = std::move(other.written);
+    tlbTag = other.tlbTag;
+    tlbPage = other.tlbPage;
+    tlbOwned = other.tlbOwned;
+    pendingWrite = other.pendingWrite;
+
+    other.reset();
+    return *this;
 }
 
 void Memory::reset() {
-    std::fill(data.begin(), data.end(), 0);
+    if (base) {
+        // Drop the pages written, keep the tables: overlays are reset often
+        for (uint32_t pageNo : written) {
+            std::shared_ptr<Leaf>& leaf = root[pageNo >> kLeafBits];
+            if (leaf.use_count() > 1) leaf.reset();
+            else if (leaf) leaf->pages[pageNo & (kLeafEntries - 1)].reset();
+        }
+        written.clear();
+    } else {
+        root.clear();
+    }
+    pages = 0;
+    tlbTag = UINT32_MAX;
+    tlbPage = nullptr;
+    tlbOwned = false;
     pendingWrite.reset();
 }
 
-int Memory::read(int addr) const {
-    if (addr < 0 || (size_t)addr >= data.size()) return 0;
-    return data[addr];
+void Memory::setBase(const Memory* memory) {
+    base = nullptr;
+    written.clear();
+    reset();
+    base = memory;
+}
+
+const Memory::Page* Memory::findPage(uint32_t pageNo) const {
+    const Leaf* leaf = root.empty() ? nullptr : root[pageNo >> kLeafBits].get();
+    const Page* page = leaf ? leaf->pages[pageNo & (kLeafEntries - 1)].get() : nullptr;
+    if (!page && base) return base->findPage(pageNo);
+    return page;
+}
+
+Memory::Page& Memory::ownPage(uint32_t pageNo) {
+    // The root table itself only exists once something was written
+    if (root.empty()) root.resize(kRootEntries);
+
+    // Unshare top-down: a private leaf may still point at shared pages
+    std::shared_ptr<Leaf>& leaf = root[pageNo >> kLeafBits];
+    if (!leaf) leaf = std::make_shared<Leaf>();
+    else if (leaf.use_count() > 1) leaf = std::make_shared<Leaf>(*leaf);
+
+    std::shared_ptr<Page>& page = leaf->pages[pageNo & (kLeafEntries - 1)];
+    if (!page) {
+        const Page* under = base ? base->findPage(pageNo) : nullptr;
+        if (under) page = std::make_shared<Page>(*under);
+        else page = std::make_shared<Page>();   // value-initialised, all zero
+        if (base) written.push_back(pageNo);
+        ++pages;
+    } else if (page.use_count() > 1) {
+        page = std::make_shared<Page>(*page);
+    }
+    return *page;
+}
+
+int Memory::readSlow(uint32_t addr) const {
+    const uint32_t pageNo = addr >> kPageBits;
+    const Page* page = findPage(pageNo);
+    if (!page) return 0;
+
+    tlbTag = pageNo;
+    tlbPage = const_cast<int*>(page->data());
+    tlbOwned = false;
+    return (*page)[addr & (kPageWords - 1)];
 }
 
 void Memory::writeNext(int addr, int value) {
-    if (addr < 0 || (size_t)addr >= data.size()) return;
     pendingWrite = std::make_pair(addr, value);
 }
 
 void Memory::commit() {
     if (pendingWrite.has_value()) {
         auto [addr, val] = pendingWrite.value();
-        if (addr >= 0 && (size_t)addr < data.size()) data[addr] = val;
+        const uint32_t a = static_cast<uint32_t>(addr);
+        const uint32_t pageNo = a >> kPageBits;
+        if (pageNo != tlbTag || !tlbOwned) {
+            tlbPage = ownPage(pageNo).data();
+            tlbTag = pageNo;
+            tlbOwned = true;
+        }
+        tlbPage[a & (kPageWords - 1)] = val;
     }
     pendingWrite.reset();
 }
+
+void Memory::commit(CommitJournal& journal) {
+    if (pendingWrite.has_value()) journal.recordMem(pendingWrite->first, read(pendingWrite->first));
+    commit();
+}
+
+bool Memory::operator==(const Memory& other) const {
+    // Every resident page of either side must match the other side word by word
+    auto covers = [](const Memory& a, const Memory& b) {
+        bool same = true;
+        a.forEachPage([&](uint32_t base, const int* words) {
+            for (uint32_t i = 0; same && i < kPageWords; ++i) {
+                same = words[i] == b.read(static_cast<int>(base + i));
+            }
+        });
+        return same;
+    };
+    return covers(*this, other) && covers(other, *this);
+}
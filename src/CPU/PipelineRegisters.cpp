@@ -1,8 +1,29 @@
-#include "PipelineRegisters.hpp"
-
-void PipelineRegisters::clearNext() {
-    if_id_next = IF_ID{};
-    id_ex_next = ID_EX{};
-    ex_mem_next = EX_MEM{};
-    mem_wb_next = MEM_WB{};
-}
+#include "PipelineRegisters.hpp"
+
+template <bool Dual>
+void PipelineRegisters::commit() {
+    if_id.commit();
+    id_ex.commit();
+    ex_mem.commit();
+    mem_wb.commit();
+    if constexpr (Dual) {
+        if_id2.commit();
+        id_ex2.commit();
+        ex_mem2.commit();
+        mem_wb2.commit();
+    }
+}
+
+template void PipelineRegisters::commit<false>();
+template void PipelineRegisters::commit<true>();
+
+void PipelineRegisters::clear() {
+    if_id.clear();
+    id_ex.clear();
+    ex_mem.clear();
+    mem_wb.clear();
+    if_id2.clear();
+    id_ex2.clear();
+    ex_mem2.clear();
+    mem_wb2.clear();
+}
@@ -1,64 +1,190 @@
 #include "PipelineStages.hpp"
+#include <utility>
+
+namespace {
+
+bool isTransfer(const ControlSignals& c) {
+    return c.branch != BranchType::NONE || c.jump != JumpType::NONE;
+}
+
+// Successor of the branch or jump at pc, with a and b the values of rs and rt
+int successor(const ControlSignals& c, int pc, int imm, int addr, int rs, int a, int b,
+              BranchPredictor::Kind& kind) {
+    kind = BranchPredictor::Kind::Branch;
+    if (c.branch == BranchType::BEQ) return a == b ? pc + 1 + imm : pc + 1;
+    if (c.branch == BranchType::BNE) return a != b ? pc + 1 + imm : pc + 1;
+
+    // J / JAL use absolute target (instruction index in this simulator)
+    if (c.jump == JumpType::J || c.jump == JumpType::JAL) {
+        kind = c.jump == JumpType::JAL ? BranchPredictor::Kind::Call : BranchPredictor::Kind::Jump;
+        return addr;
+    }
+
+    // JR, through $ra it is a return
+    kind = rs == 31 ? BranchPredictor::Kind::Return : BranchPredictor::Kind::Jump;
+    return a;
+}
+
+// Fetches the instruction at pc into out, false past the end of the program
+bool fetchOne(IF_ID& out, const Program& instrMem, int pc, BranchPredictor& predictor) {
+    if (pc < 0 || pc >= (int)instrMem.size()) {
+        out.valid = false;
+        return false;
+    }
+
+    out.rawInstr = instrMem[pc];
+    out.pc = pc;
+    out.valid = true;
+
+    // pc + 1 unless the predictor knows this one as a taken branch or jump
+    out.pred = predictor.predict(pc);
+    return true;
+}
+
+} // namespace
 
 void IFStage::evaluate(
     PipelineRegisters& pipe,
-    const std::vector<Instruction>& instrMem,
+    const Program& instrMem,
     int pc_current,
     int& pc_next,
-    bool stall
+    bool stall,
+    BranchPredictor& predictor
 ) {
     if (stall) {
-        pipe.if_id_next = pipe.if_id;
+        pipe.if_id.hold();
         pc_next = pc_current;
         return;
     }
 
-    if (pc_current < 0 || pc_current >= (int)instrMem.size()) {
-        pipe.if_id_next.valid = false;
-        pc_next = pc_current;
+    IF_ID& out = pipe.if_id.next();
+    pc_next = fetchOne(out, instrMem, pc_current, predictor) ? out.pred.nextPc : pc_current;
+}
+
+void IFStage::evaluatePair(
+    PipelineRegisters& pipe,
+    const Program& instrMem,
+    int pc_current,
+    int& pc_next,
+    bool stall,
+    bool split,
+    bool fetch,
+    int lineWords,
+    BranchPredictor& predictor
+) {
+    pc_next = pc_current;
+    if (stall) {
+        pipe.if_id.hold();
+        pipe.if_id2.hold();
         return;
     }
 
-    pipe.if_id_next.rawInstr = instrMem[pc_current];
-    pipe.if_id_next.pc = pc_current;
-    pipe.if_id_next.valid = true;
+    IF_ID& slot0 = pipe.if_id.next();
+    IF_ID& slot1 = pipe.if_id2.next();
+    slot1.valid = false;
+
+    // The younger instruction ID held back moves up, one slot is left to fill
+    if (split) slot0 = pipe.if_id2.cur();
+    else slot0.valid = false;
+
+    IF_ID& first = split ? slot1 : slot0;
+    if (!fetch || !fetchOne(first, instrMem, pc_current, predictor)) return;
+    pc_next = first.pred.nextPc;
 
-    pc_next = pc_current + 1;
+    // A pair is two sequential instructions from one I-cache line, so the
+    // first must be predicted to fall through
+    if (split || pc_next != pc_current + 1 || (lineWords > 0 && pc_next % lineWords == 0)) return;
+    if (fetchOne(slot1, instrMem, pc_next, predictor)) pc_next = slot1.pred.nextPc;
 }
 
 
-void IDStage::evaluate(PipelineRegisters& pipe, const RegisterFile& regs, bool stall) {
+void IDStage::evaluate(PipelineRegisters& pipe, const RegisterFile& regs, bool stall,
+                       BranchStage branchStage, int& pc_next, BranchPredictor& predictor,
+                       PerfCounters& stats) {
     if (stall) {
         // Insert NOPinto ID/EX, IF/ID is held by IF stage.
-        pipe.id_ex_next = ID_EX{};
-        pipe.id_ex_next.valid = false;
+        pipe.id_ex.bubble();
         return;
     }
-    const IF_ID& in = pipe.if_id;
+    const IF_ID& in = pipe.if_id.cur();
+    ID_EX& out = pipe.id_ex.next();
+    decode<false>(in, out, regs, pipe, stats);
+
+    if (branchStage != BranchStage::ID || !out.valid || !isTransfer(out.ctrl)) return;
+
+    // Early resolution. The hazard unit stalled anything the comparator can
+    // not get yet, what is left comes from EX/MEM or the write-back bypass.
+    const Instruction& di = in.rawInstr;
+    const ControlSignals& c = out.ctrl;
+    const EX_MEM& exMem = pipe.ex_mem.cur();
+    const ForwardingDecision fwd = forwarding.resolve<false>(di.rs, di.rt, pipe);
+    int valA = out.val_rs;
+    int valB = out.val_rt;
+    if (fwd.A == ForwardSel::FROM_EX_MEM) {
+        valA = exMem.alu_result;
+        SCS_COUNT(stats, fwdExId, 1);
+    }
+    if (fwd.B == ForwardSel::FROM_EX_MEM && c.branch != BranchType::NONE) {
+        valB = exMem.alu_result;
+        SCS_COUNT(stats, fwdExId, 1);
+    }
+
+    BranchPredictor::Kind kind;
+    const int actualNext = successor(c, in.pc, di.imm, di.addr, di.rs, valA, valB, kind);
+    predictor.resolve(in.pc, kind, actualNext, in.pred);
+    out.resolved = true;
+
+    // Mispredicted: only the instruction IF fetched this cycle is on the wrong path
+    if (actualNext != in.pred.nextPc) {
+        pc_next = actualNext;
+        SCS_COUNT(stats, redirects, 1);
+        SCS_COUNT(stats, flushed, int(pipe.if_id.next().valid));
+        pipe.if_id.bubble();
+    }
+}
 
+void IDStage::evaluatePair(PipelineRegisters& pipe, const RegisterFile& regs, bool stall, bool split,
+                           PerfCounters& stats) {
+    if (stall) {
+        pipe.id_ex.bubble();
+        pipe.id_ex2.bubble();
+        return;
+    }
+    decode<true>(pipe.if_id.cur(), pipe.id_ex.next(), regs, pipe, stats);
+    if (split) pipe.id_ex2.next().valid = false;
+    else decode<true>(pipe.if_id2.cur(), pipe.id_ex2.next(), regs, pipe, stats);
+}
+
+template <bool Dual>
+void IDStage::decode(const IF_ID& in, ID_EX& out, const RegisterFile& regs,
+                     const PipelineRegisters& pipe, PerfCounters& stats) {
     if (!in.valid) {
-        pipe.id_ex_next.valid = false;
+        out.valid = false;
         return;
     }
 
     const Instruction& di = in.rawInstr;
-    ID_EX& out = pipe.id_ex_next;
 
     // Keep the decoded instruction for debugg
     out.rawInstr = di;
 
     out.pc = in.pc;
+    out.pred = in.pred;
     out.rs = di.rs;
     out.rt = di.rt;
     out.imm = di.imm;
     out.addr = di.addr;
 
+	// The younger write-back lane wins when both write the register
+	auto bypasses = [](const MEM_WB& wb, int idx) {
+	    return wb.valid && wb.ctrl.regWrite && wb.ctrl.destReg == idx && idx != 0;
+	};
 	auto readWithWbBypass = [&](int idx) -> int {
-	    int v = regs.read(idx);
-	    if (pipe.mem_wb.valid && pipe.mem_wb.ctrl.regWrite && pipe.mem_wb.ctrl.destReg == idx && idx != 0) {
-	        v = pipe.mem_wb.ctrl.memToReg ? pipe.mem_wb.mem_data : pipe.mem_wb.alu_result;
-	    }
-	    return v;
+	    const MEM_WB* wb = &pipe.mem_wb.cur();
+	    if (Dual && bypasses(pipe.mem_wb2.cur(), idx)) wb = &pipe.mem_wb2.cur();
+	    else if (!bypasses(*wb, idx)) return regs.read(idx);
+	    SCS_COUNT(stats, fwdWbId, 1);
+	    return wb->ctrl.memToReg ? wb->mem_data : wb->alu_result;
 	};
 	out.val_rs = readWithWbBypass(di.rs);
 	out.val_rt = readWithWbBypass(di.rt);
@@ -159,59 +285,63 @@ void IDStage::evaluate(PipelineRegisters& pipe, const RegisterFile& regs, bool s
     }
 
     out.ctrl = c;
+    out.resolved = false;
     out.valid = true;
-
 }
-void EXStage::evaluate(PipelineRegisters& pipe, int& pc_next) {
-    const ID_EX& in = pipe.id_ex;
 
-    if (!in.valid) {
-        pipe.ex_mem_next.valid = false;
+template <bool Dual>
+void EXStage::evaluate(PipelineRegisters& pipe, int& pc_next, BranchPredictor& predictor, PerfCounters& stats) {
+    if constexpr (!Dual) {
+        execute<false>(pipe, pipe.id_ex.cur(), pipe.ex_mem.next(), pc_next, predictor, stats);
         return;
     }
-
-    //Forwarding
-    ForwardingDecision fwd =
-        forwarding.resolve(in, pipe.ex_mem, pipe.mem_wb);
-
-    int valA = in.val_rs;
-    int valB = in.val_rt;
-
-    // MEM->EX forwarding for loads
-    const bool memStageLoadAvail =
-        pipe.ex_mem.valid && pipe.ex_mem.ctrl.memRead &&
-        pipe.ex_mem.ctrl.regWrite &&
-        pipe.ex_mem.ctrl.destReg != 0 &&
-        pipe.mem_wb_next.valid && pipe.mem_wb_next.ctrl.memToReg;
-    const int memStageLoadVal = pipe.mem_wb_next.mem_data;
-
-    if (fwd.A == ForwardSel::FROM_EX_MEM)
-        valA = pipe.ex_mem.alu_result;
-    else if (fwd.A == ForwardSel::FROM_MEM_WB)
-        valA = pipe.mem_wb.ctrl.memToReg
-                 ? pipe.mem_wb.mem_data
-                 : pipe.mem_wb.alu_result;
-
-    // Override with MEM-stage load forwarding if applicable
-    if (memStageLoadAvail && pipe.ex_mem.ctrl.destReg == in.rs) {
-        valA = memStageLoadVal;
+    // Older instruction of a pair first, its redirect squashes the younger one
+    if (execute<true>(pipe, pipe.id_ex.cur(), pipe.ex_mem.next(), pc_next, predictor, stats)) {
+        SCS_COUNT(stats, flushed, int(pipe.id_ex2.cur().valid));
+        pipe.ex_mem2.next().valid = false;
+        return;
     }
+    execute<true>(pipe, pipe.id_ex2.cur(), pipe.ex_mem2.next(), pc_next, predictor, stats);
+}
 
-    if (fwd.B == ForwardSel::FROM_EX_MEM)
-        valB = pipe.ex_mem.alu_result;
-    else if (fwd.B == ForwardSel::FROM_MEM_WB)
-        valB = pipe.mem_wb.ctrl.memToReg
-                 ? pipe.mem_wb.mem_data
-                 : pipe.mem_wb.alu_result;
+template void EXStage::evaluate<false>(PipelineRegisters&, int&, BranchPredictor&, PerfCounters&);
+template void EXStage::evaluate<true>(PipelineRegisters&, int&, BranchPredictor&, PerfCounters&);
 
-    // Override with MEM-stage load forwarding if applicable
-    if (memStageLoadAvail && pipe.ex_mem.ctrl.destReg == in.rt) {
-        valB = memStageLoadVal;
+template <bool Dual>
+bool EXStage::execute(PipelineRegisters& pipe, const ID_EX& in, EX_MEM& out, int& pc_next,
+                      BranchPredictor& predictor, PerfCounters& stats) {
+    if (!in.valid) {
+        out.valid = false;
+        return false;
     }
 
-    EX_MEM& out = pipe.ex_mem_next;
+    //Forwarding
+    const ForwardingDecision fwd = forwarding.resolve<Dual>(in.rs, in.rt, pipe);
+
+    auto forwarded = [&](ForwardSel sel, uint8_t lane, int value) -> int {
+        switch (sel) {
+            case ForwardSel::FROM_EX_MEM:
+                SCS_COUNT(stats, fwdExMem, 1);
+                return (Dual && lane ? pipe.ex_mem2 : pipe.ex_mem).cur().alu_result;
+            case ForwardSel::FROM_MEM_LOAD:
+                // Written by MEM earlier in this cycle
+                SCS_COUNT(stats, fwdMemLoad, 1);
+                return (Dual && lane ? pipe.mem_wb2 : pipe.mem_wb).next().mem_data;
+            case ForwardSel::FROM_MEM_WB: {
+                SCS_COUNT(stats, fwdMemWb, 1);
+                const MEM_WB& memWb = (Dual && lane ? pipe.mem_wb2 : pipe.mem_wb).cur();
+                return memWb.ctrl.memToReg ? memWb.mem_data : memWb.alu_result;
+            }
+            default:
+                return value;
+        }
+    };
+    const int valA = forwarded(fwd.A, fwd.laneA, in.val_rs);
+    const int valB = forwarded(fwd.B, fwd.laneB, in.val_rt);
+
     // Keep instruction for debugg
     out.rawInstr = in.rawInstr;
+    out.pc = in.pc;
     out.ctrl = in.ctrl;
 
     // ALU 
@@ -248,58 +378,60 @@ void EXStage::evaluate(PipelineRegisters& pipe, int& pc_next) {
     out.branchTarget = in.pc + 1 + in.imm;
     out.valid = true;
 
-    // Control flow handling (basic)
-// We resolve branches/jumps in EX.
-bool takeBranch = false;
-if (in.ctrl.branch == BranchType::BEQ) {
-    takeBranch = out.zero;
-} else if (in.ctrl.branch == BranchType::BNE) {
-    takeBranch = !out.zero;
-}
-
-if (takeBranch) {
-    pc_next = out.branchTarget;
-    pipe.if_id_next.valid = false;
-    pipe.id_ex_next.valid = false;
-}
-
-// J / JAL use absolute target (instruction index in this simulator)
-if (in.ctrl.jump == JumpType::J || in.ctrl.jump == JumpType::JAL) {
-    pc_next = in.addr;
-    pipe.if_id_next.valid = false;
-    pipe.id_ex_next.valid = false;
-
+    // JAL links the return address through the ALU result
     if (in.ctrl.jump == JumpType::JAL) {
         out.alu_result = in.pc + 1;
     }
-}
 
-// JR
-if (in.ctrl.jump == JumpType::JR) {
-    pc_next = valA;
-    pipe.if_id_next.valid = false;
-    pipe.id_ex_next.valid = false;
-}
+    // We resolve branches/jumps in EX against the successor IF predicted,
+    // unless ID already did
+    if (!isTransfer(in.ctrl) || in.resolved) return false;
+
+    BranchPredictor::Kind kind;
+    const int actualNext = successor(in.ctrl, in.pc, in.imm, in.addr, in.rs, valA, valB, kind);
+    predictor.resolve(in.pc, kind, actualNext, in.pred);
+    if (actualNext == in.pred.nextPc) return false;
+
+    // Mispredicted: squash what ID decoded and what IF fetched this cycle, every lane
+    pc_next = actualNext;
+    SCS_COUNT(stats, redirects, 1);
+    SCS_COUNT(stats, flushed, int(pipe.if_id.cur().valid) + int(pipe.if_id.next().valid));
+    pipe.if_id.bubble();
+    pipe.id_ex.bubble();
+    if constexpr (Dual) {
+        SCS_COUNT(stats, flushed, int(pipe.if_id2.cur().valid) + int(pipe.if_id2.next().valid));
+        pipe.if_id2.bubble();
+        pipe.id_ex2.bubble();
+    }
+    return true;
 }
 
 
+template <bool Dual>
 void MEMStage::evaluate(PipelineRegisters& pipe, Memory& mem) {
-    const EX_MEM& in = pipe.ex_mem;
+    // The issue check never pairs two memory operations, one port is enough
+    access(pipe.ex_mem.cur(), pipe.mem_wb.next(), mem);
+    if constexpr (Dual) access(pipe.ex_mem2.cur(), pipe.mem_wb2.next(), mem);
+}
+
+template void MEMStage::evaluate<false>(PipelineRegisters&, Memory&);
+template void MEMStage::evaluate<true>(PipelineRegisters&, Memory&);
 
+void MEMStage::access(const EX_MEM& in, MEM_WB& out, Memory& mem) {
     if (!in.valid) {
-        pipe.mem_wb_next.valid = false;
+        out.valid = false;
         return;
     }
 
-    MEM_WB& out = pipe.mem_wb_next;
     // keep instruction for debug
     out.rawInstr = in.rawInstr;
+    out.pc = in.pc;
     out.ctrl = in.ctrl;
     out.alu_result = in.alu_result;
 
-    if (in.ctrl.memRead) {
-        out.mem_data = mem.read(in.alu_result);
-    }
+    // The bank still holds data from two cycles ago, overwrite every field
+    out.mem_data = in.ctrl.memRead ? mem.read(in.alu_result) : 0;
+
     if (in.ctrl.memWrite) {
         mem.writeNext(in.alu_result, in.val_rt);
     }
@@ -307,13 +439,21 @@ void MEMStage::evaluate(PipelineRegisters& pipe, Memory& mem) {
     out.valid = true;
 }
 
+template <bool Dual>
 void WBStage::evaluate(PipelineRegisters& pipe, RegisterFile& regs) {
-    const MEM_WB& in = pipe.mem_wb;
+    // One write port per lane
+    write(pipe.mem_wb.cur(), regs, 0);
+    if constexpr (Dual) write(pipe.mem_wb2.cur(), regs, 1);
+}
+
+template void WBStage::evaluate<false>(PipelineRegisters&, RegisterFile&);
+template void WBStage::evaluate<true>(PipelineRegisters&, RegisterFile&);
 
+void WBStage::write(const MEM_WB& in, RegisterFile& regs, int port) {
     if (!in.valid) return;
     if (!in.ctrl.regWrite) return;
 
     int value = in.ctrl.memToReg ? in.mem_data : in.alu_result;
     int dest = in.ctrl.destReg;
-    if (dest >= 0) regs.writeNext(dest, value);
+    if (dest >= 0) regs.writeNext(dest, value, port);
 }
@@ -0,0 +1,508 @@
+#include "PipelineTrace.hpp"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'C', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t kVersion = 3;   // 2 added the start block, 3 state blocks
+constexpr uint32_t kChunkMagic = 0x4b4e4843;   // "CHNK"
+constexpr uint32_t kIndexMagic = 0x58444954;   // "TIDX"
+constexpr uint32_t kStartMagic = 0x54494e49;   // "INIT"
+constexpr uint32_t kStateMagic = 0x54415453;   // "STAT"
+constexpr size_t kFileHeaderBytes = 16;
+constexpr size_t kStateBytes = 8 + 32 * 4;   // start or state block without the memory words
+constexpr size_t kChunkHeaderBytes = 20;
+constexpr size_t kIndexEntryBytes = 32;
+constexpr size_t kTrailerBytes = 16;
+
+// Header byte of a cycle
+constexpr uint8_t kFlagBits = 0x0f;
+constexpr uint8_t kLatchMask = 0x10;
+constexpr uint8_t kRegs = 0x20;
+constexpr uint8_t kMem = 0x40;
+constexpr uint8_t kRepeat = 0x80;
+constexpr uint8_t kMoreRegs = 0x20;   // in the index byte of a register write
+
+template <typename T>
+void put(std::vector<uint8_t>& buf, T value) {
+    const size_t at = buf.size();
+    buf.resize(at + sizeof(T));
+    std::memcpy(buf.data() + at, &value, sizeof(T));
+}
+
+template <typename T>
+T get(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+void putVarint(std::vector<uint8_t>& buf, uint64_t v) {
+    while (v >= 0x80) {
+        buf.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<uint8_t>(v));
+}
+
+void putSigned(std::vector<uint8_t>& buf, int64_t v) {
+    putVarint(buf, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+// Wrapping 32-bit difference, so every value round-trips
+int32_t diff(int32_t value, int32_t base) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(base));
+}
+
+int32_t undiff(int32_t delta, int32_t base) {
+    return static_cast<int32_t>(static_cast<uint32_t>(base) + static_cast<uint32_t>(delta));
+}
+
+void putState(std::vector<uint8_t>& buf, uint32_t magic, const TraceState& s) {
+    put(buf, magic);
+    put(buf, static_cast<uint32_t>(s.memory.size()));
+    for (int32_t r : s.regs) put(buf, r);
+    for (const auto& [addr, value] : s.memory) {
+        put(buf, addr);
+        put(buf, value);
+    }
+}
+
+// Size of the start or state block at p, 0 if it is not one or does not fit in end
+uint64_t stateSize(const uint8_t* p, const uint8_t* end, uint32_t magic) {
+    if (uint64_t(end - p) < kStateBytes || get<uint32_t>(p) != magic) return 0;
+    const uint64_t bytes = kStateBytes + uint64_t(get<uint32_t>(p + 4)) * 8;
+    return bytes <= uint64_t(end - p) ? bytes : 0;
+}
+
+void getState(const uint8_t* p, TraceState& out) {
+    const uint32_t words = get<uint32_t>(p + 4);
+    p += 8;
+    for (int32_t& r : out.regs) {
+        r = get<int32_t>(p);
+        p += 4;
+    }
+    out.memory.clear();
+    out.memory.reserve(words);
+    for (uint32_t i = 0; i < words; ++i, p += 8) out.memory.emplace_back(get<int32_t>(p), get<int32_t>(p + 4));
+}
+
+class Cursor {
+public:
+    Cursor(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    bool done() const { return p == end; }
+
+    uint8_t byte() {
+        if (p == end) throw std::runtime_error("TraceReader: chunk payload ends early");
+        return *p++;
+    }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        throw std::runtime_error("TraceReader: varint too long");
+    }
+
+    int64_t signedVarint() {
+        const uint64_t v = varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+// Where the latches of the cycle after p should be, see the format in the header
+void predict(const TraceCycle& p, int32_t lastFetched, int32_t* q) {
+    if (p.flags & TraceCycle::kFrozen) {
+        std::memcpy(q, p.latch, sizeof(p.latch));
+        return;
+    }
+    const bool stall = p.flags & TraceCycle::kStall;
+    for (int lane : {0, 4}) {
+        q[lane + 3] = p.latch[lane + 2];
+        q[lane + 2] = p.latch[lane + 1];
+        q[lane + 1] = stall ? -1 : p.latch[lane];
+    }
+    if (stall) {
+        q[0] = p.latch[0];
+        q[4] = p.latch[4];
+    } else if (p.flags & (TraceCycle::kFlush | TraceCycle::kFetchWait)) {
+        q[0] = q[4] = -1;
+    } else {
+        q[0] = lastFetched + 1;
+        q[4] = p.latch[4] >= 0 ? lastFetched + 2 : -1;
+    }
+}
+
+// Youngest instruction seen in IF/ID so far
+int32_t fetchedAfter(const TraceCycle& c, int32_t lastFetched) {
+    if (c.latch[4] >= 0) return c.latch[4];
+    if (c.latch[0] >= 0) return c.latch[0];
+    return lastFetched;
+}
+
+bool sameState(const TraceCycle& a, const TraceCycle& b) {
+    return a.flags == b.flags && std::memcmp(a.latch, b.latch, sizeof(a.latch)) == 0;
+}
+
+} // namespace
+
+bool operator==(const TraceCycle& a, const TraceCycle& b) {
+    if (a.cycle != b.cycle || !sameState(a, b) || a.regWrites != b.regWrites || a.memWrite != b.memWrite) return false;
+    for (int i = 0; i < a.regWrites; ++i) {
+        if (a.regIdx[i] != b.regIdx[i] || a.regValue[i] != b.regValue[i]) return false;
+    }
+    return !a.memWrite || (a.memAddr == b.memAddr && a.memValue == b.memValue);
+}
+
+TraceWriter::TraceWriter(const std::string& path, const TraceConfig& config, const TraceState& start)
+: cfg(config)
+, out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!cfg.chunkCycles || !cfg.ringCycles) throw std::runtime_error("TraceWriter: sizes must be non-zero");
+    if (!out) throw std::runtime_error("TraceWriter: can not create " + path);
+
+    uint64_t size = 1;
+    while (size < cfg.ringCycles) size <<= 1;
+    ring.resize(size);
+    mask = size - 1;
+
+    std::vector<uint8_t> header;
+    header.insert(header.end(), kMagic, kMagic + sizeof(kMagic));
+    put(header, kVersion);
+    put(header, cfg.chunkCycles);
+    putState(header, kStartMagic, start);
+    out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    if (!out) throw std::runtime_error("TraceWriter: can not write " + path);
+    fileOffset = header.size();
+
+    writer = std::thread([this] { writerLoop(); });
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        close();
+    } catch (const std::runtime_error&) {
+    }
+}
+
+void TraceWriter::push(const TraceCycle& c) {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask) {
+        ++waits;
+        while (h - tail.load(std::memory_order_acquire) > mask) std::this_thread::yield();
+    }
+    ring[h & mask] = c;
+    head.store(h + 1, std::memory_order_release);
+    ++pushed;
+}
+
+void TraceWriter::push(const TraceState& s) {
+    std::lock_guard<std::mutex> g(statesLock);
+    states.emplace_back(head.load(std::memory_order_relaxed), s);
+    // Published before the cycle it goes in front of
+    statesPushed.fetch_add(1, std::memory_order_release);
+}
+
+void TraceWriter::close() {
+    if (closed) return;
+    closed = true;
+    closing.store(true, std::memory_order_release);
+    writer.join();
+    if (failed.load()) throw std::runtime_error("TraceWriter: writing the trace failed");
+}
+
+void TraceWriter::writerLoop() {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t statesTaken = 0;
+    for (;;) {
+        // closing first: once it is set, head is final
+        const bool last = closing.load(std::memory_order_acquire);
+        const uint64_t h = head.load(std::memory_order_acquire);
+        if (t == h) {
+            if (last) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        // After head: every state in front of a cycle below h is visible
+        if (statesPushed.load(std::memory_order_acquire) != statesTaken) {
+            std::lock_guard<std::mutex> g(statesLock);
+            statesTaken += states.size();
+            for (auto& s : states) due.push_back(std::move(s));
+            states.clear();
+        }
+        for (; t != h; ++t) {
+            // Only the latest of several states in front of a cycle matters
+            if (!due.empty() && due.front().first == t) {
+                while (due.size() > 1 && due[1].first == t) due.pop_front();
+                writeState(due.front().second);
+                due.pop_front();
+            }
+            encode(ring[t & mask]);
+            tail.store(t + 1, std::memory_order_release);
+        }
+    }
+
+    if (chunkCount) flushChunk();
+    std::vector<uint8_t> buf;
+    for (const ChunkIndex& e : index) {
+        put(buf, e.offset);
+        put(buf, e.firstCycle);
+        put(buf, e.cycles);
+        put(buf, e.bytes);
+        put(buf, e.state);
+    }
+    put(buf, fileOffset);
+    put(buf, static_cast<uint32_t>(index.size()));
+    put(buf, kIndexMagic);
+    out.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+    out.flush();
+    if (!out) failed = true;
+}
+
+void TraceWriter::encode(const TraceCycle& c) {
+    if (chunkCount && (c.cycle != prev.cycle + 1 || chunkCount == cfg.chunkCycles)) flushChunk();
+    if (!chunkCount) chunkFirst = c.cycle;
+    ++chunkCount;
+
+    const bool repeatable = !c.regWrites && !c.memWrite;
+    if (chunkCount > 1 && prevRepeatable && repeatable && sameState(prev, c)) {
+        ++repeats;
+        prev.cycle = c.cycle;
+        return;
+    }
+    if (repeats) {
+        chunk.push_back(kRepeat);
+        putVarint(chunk, repeats);
+        repeats = 0;
+    }
+
+    int32_t q[TraceCycle::kLatches];
+    predict(prev, lastFetched, q);
+    uint8_t moved = 0;
+    for (int i = 0; i < TraceCycle::kLatches; ++i) {
+        if (c.latch[i] != q[i]) moved |= static_cast<uint8_t>(1u << i);
+    }
+
+    chunk.push_back(static_cast<uint8_t>((c.flags & kFlagBits) | (moved ? kLatchMask : 0) |
+                                         (c.regWrites ? kRegs : 0) | (c.memWrite ? kMem : 0)));
+    if (moved) {
+        chunk.push_back(moved);
+        for (int i = 0; i < TraceCycle::kLatches; ++i) {
+            if (moved & (1u << i)) putSigned(chunk, int64_t(c.latch[i]) - int64_t(q[i]));
+        }
+    }
+    for (int i = 0; i < c.regWrites; ++i) {
+        const int r = c.regIdx[i] & 31;
+        chunk.push_back(static_cast<uint8_t>(r | (i + 1 < c.regWrites ? kMoreRegs : 0)));
+        putSigned(chunk, diff(c.regValue[i], regs[r]));
+        regs[r] = c.regValue[i];
+    }
+    if (c.memWrite) {
+        putSigned(chunk, diff(c.memAddr, memAddr));
+        putSigned(chunk, diff(c.memValue, memValue));
+        memAddr = c.memAddr;
+        memValue = c.memValue;
+    }
+
+    prev = c;
+    prevRepeatable = repeatable;
+    lastFetched = fetchedAfter(c, lastFetched);
+}
+
+void TraceWriter::flushChunk() {
+    if (repeats) {
+        chunk.push_back(kRepeat);
+        putVarint(chunk, repeats);
+        repeats = 0;
+    }
+
+    std::vector<uint8_t> header;
+    put(header, kChunkMagic);
+    put(header, static_cast<uint32_t>(chunk.size()));
+    put(header, chunkFirst);
+    put(header, chunkCount);
+    out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    if (!out) failed = true;
+
+    index.push_back({fileOffset, chunkFirst, chunkCount, static_cast<uint32_t>(chunk.size()), chunkState});
+    fileOffset += header.size() + chunk.size();
+    payloadBytes.fetch_add(header.size() + chunk.size(), std::memory_order_relaxed);
+
+    // Fresh delta state, the next chunk decodes without this one
+    chunk.clear();
+    chunkCount = 0;
+    chunkState = 0;
+    prev = TraceCycle{};
+    prevRepeatable = false;
+    lastFetched = -1;
+    std::memset(regs, 0, sizeof(regs));
+    memAddr = 0;
+    memValue = 0;
+}
+
+// A state block goes in front of the chunk starting with the next cycle
+void TraceWriter::writeState(const TraceState& s) {
+    if (chunkCount) flushChunk();
+    std::vector<uint8_t> buf;
+    putState(buf, kStateMagic, s);
+    out.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+    if (!out) failed = true;
+    chunkState = fileOffset;
+    fileOffset += buf.size();
+    payloadBytes.fetch_add(buf.size(), std::memory_order_relaxed);
+}
+
+TraceReader::TraceReader(const std::string& path)
+: file(path)
+{
+    const uint8_t* data = file.data();
+    const uint64_t size = file.size();
+    if (size < kFileHeaderBytes || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("TraceReader: " + path + " is not a trace");
+    }
+    const uint32_t version = get<uint32_t>(data + 8);
+    if (version != kVersion) {
+        throw std::runtime_error("TraceReader: unsupported trace version " + std::to_string(version));
+    }
+    if (size < kFileHeaderBytes + kStateBytes || get<uint32_t>(data + kFileHeaderBytes) != kStartMagic) {
+        throw std::runtime_error("TraceReader: " + path + " is not a trace");
+    }
+
+    const uint64_t startBytes = stateSize(data + kFileHeaderBytes, data + size, kStartMagic);
+    if (!startBytes) throw std::runtime_error("TraceReader: " + path + " is truncated");
+    const uint64_t chunksAt = kFileHeaderBytes + startBytes;
+    getState(data + kFileHeaderBytes, initial);
+
+    // The index, if the writer got to close the file
+    if (size >= chunksAt + kTrailerBytes) {
+        const uint8_t* trailer = data + size - kTrailerBytes;
+        const uint64_t at = get<uint64_t>(trailer);
+        const uint32_t n = get<uint32_t>(trailer + 8);
+        if (get<uint32_t>(trailer + 12) == kIndexMagic && at >= chunksAt &&
+            at + uint64_t(n) * kIndexEntryBytes + kTrailerBytes == size) {
+            bool ok = true;
+            for (uint32_t i = 0; i < n && ok; ++i) {
+                const uint8_t* e = data + at + uint64_t(i) * kIndexEntryBytes;
+                const Chunk c{get<uint64_t>(e), get<uint64_t>(e + 8), get<uint32_t>(e + 16), get<uint32_t>(e + 20),
+                              get<uint64_t>(e + 24)};
+                ok = c.offset >= chunksAt && c.offset + kChunkHeaderBytes + c.bytes <= at &&
+                     (!c.state || (c.state >= chunksAt && c.state < c.offset &&
+                                   stateSize(data + c.state, data + c.offset, kStateMagic)));
+                index.push_back(c);
+                total += c.cycles;
+            }
+            if (ok) return;
+            index.clear();
+            total = 0;
+        }
+    }
+
+    // No index: walk the chunk headers and the state blocks between them
+    uint64_t at = chunksAt;
+    uint64_t state = 0;
+    for (;;) {
+        if (const uint64_t bytes = stateSize(data + at, data + size, kStateMagic)) {
+            state = at;
+            at += bytes;
+            continue;
+        }
+        if (at + kChunkHeaderBytes > size || get<uint32_t>(data + at) != kChunkMagic) break;
+        const uint32_t bytes = get<uint32_t>(data + at + 4);
+        if (at + kChunkHeaderBytes + bytes > size) break;
+        index.push_back({at, get<uint64_t>(data + at + 8), get<uint32_t>(data + at + 16), bytes, state});
+        total += index.back().cycles;
+        at += kChunkHeaderBytes + bytes;
+        state = 0;
+    }
+}
+
+size_t TraceReader::find(uint64_t cycle) const {
+    for (size_t i = index.size(); i-- > 0;) {
+        if (cycle >= index[i].firstCycle && cycle - index[i].firstCycle < index[i].cycles) return i;
+    }
+    return index.size();
+}
+
+void TraceReader::read(size_t i, std::vector<TraceCycle>& out) const {
+    const Chunk& c = index.at(i);
+    decode(file.data() + c.offset + kChunkHeaderBytes, c.bytes, c.firstCycle, c.cycles, out);
+}
+
+bool TraceReader::readState(size_t i, TraceState& out) const {
+    const Chunk& c = index.at(i);
+    if (!c.state) return false;
+    getState(file.data() + c.state, out);
+    return true;
+}
+
+void TraceReader::decode(const uint8_t* payload, size_t bytes, uint64_t firstCycle, uint32_t cycles,
+                         std::vector<TraceCycle>& out) {
+    out.clear();
+    out.reserve(cycles);
+
+    Cursor in(payload, bytes);
+    TraceCycle prev;
+    int32_t lastFetched = -1;
+    int32_t regs[32] = {};
+    int32_t memAddr = 0;
+    int32_t memValue = 0;
+
+    while (!in.done()) {
+        const uint8_t head = in.byte();
+        if (head & kRepeat) {
+            if (head != kRepeat || out.empty()) throw std::runtime_error("TraceReader: bad repeat");
+            for (uint64_t n = in.varint(); n > 0; --n) {
+                if (out.size() == cycles) throw std::runtime_error("TraceReader: chunk holds too many cycles");
+                TraceCycle c = out.back();
+                c.cycle++;
+                out.push_back(c);
+            }
+            continue;
+        }
+        if (out.size() == cycles) throw std::runtime_error("TraceReader: chunk holds too many cycles");
+
+        TraceCycle c;
+        c.cycle = firstCycle + out.size();
+        c.flags = head & kFlagBits;
+        predict(prev, lastFetched, c.latch);
+        if (head & kLatchMask) {
+            const uint8_t moved = in.byte();
+            for (int i = 0; i < TraceCycle::kLatches; ++i) {
+                if (moved & (1u << i)) c.latch[i] = static_cast<int32_t>(c.latch[i] + in.signedVarint());
+            }
+        }
+        if (head & kRegs) {
+            for (bool more = true; more;) {
+                if (c.regWrites == 2) throw std::runtime_error("TraceReader: more than two register writes");
+                const uint8_t b = in.byte();
+                const int r = b & 31;
+                more = b & kMoreRegs;
+                regs[r] = undiff(static_cast<int32_t>(in.signedVarint()), regs[r]);
+                c.regIdx[c.regWrites] = static_cast<uint8_t>(r);
+                c.regValue[c.regWrites] = regs[r];
+                c.regWrites++;
+            }
+        }
+        if (head & kMem) {
+            c.memWrite = true;
+            memAddr = c.memAddr = undiff(static_cast<int32_t>(in.signedVarint()), memAddr);
+            memValue = c.memValue = undiff(static_cast<int32_t>(in.signedVarint()), memValue);
+        }
+
+        out.push_back(c);
+        prev = c;
+        lastFetched = fetchedAfter(c, lastFetched);
+    }
+    if (out.size() != cycles) throw std::runtime_error("TraceReader: chunk holds too few cycles");
+}
@@ -1,4 +1,5 @@
 #include "Registerfile.hpp"
+#include "CommitJournal.hpp"
 
 RegisterFile::RegisterFile() {
     regs.fill(0);
@@ -7,7 +8,7 @@ RegisterFile::RegisterFile() {
 
 void RegisterFile::reset() {
     regs.fill(0);
-    pendingWrite.reset();
+    for (auto& w : pendingWrite) w.reset();
     regs[0] = 0;
 }
 
@@ -16,16 +17,39 @@ int RegisterFile::read(int idx) const {
     return regs[idx];
 }
 
-void RegisterFile::writeNext(int idx, int value) {
-    if (idx <= 0 || idx >= 32) return; 
-    pendingWrite = std::make_pair(idx, value);
+void RegisterFile::writeNext(int idx, int value, int port) {
+    if (idx <= 0 || idx >= 32 || port < 0 || port >= kWritePorts) return;
+    pendingWrite[port] = std::make_pair(idx, value);
 }
 
+template <int Ports>
 void RegisterFile::commit() {
-    if (pendingWrite.has_value()) {
-        auto [idx, val] = pendingWrite.value();
-        if (idx > 0 && idx < 32) regs[idx] = val;
+    for (int p = 0; p < Ports; ++p) {
+        auto& w = pendingWrite[p];
+        if (w.has_value()) {
+            auto [idx, val] = w.value();
+            if (idx > 0 && idx < 32) regs[idx] = val;
+        }
+        w.reset();
     }
-    pendingWrite.reset();
     regs[0] = 0;
 }
+
+template <int Ports>
+void RegisterFile::commit(CommitJournal& journal) {
+    // Port by port, a second write to the same register records the first one's value
+    for (int p = 0; p < Ports; ++p) {
+        auto& w = pendingWrite[p];
+        if (w.has_value() && w->first > 0 && w->first < 32) {
+            journal.recordReg(w->first, regs[w->first]);
+            regs[w->first] = w->second;
+        }
+        w.reset();
+    }
+    regs[0] = 0;
+}
+
+template void RegisterFile::commit<1>();
+template void RegisterFile::commit<2>();
+template void RegisterFile::commit<1>(CommitJournal&);
+template void RegisterFile::commit<2>(CommitJournal&);
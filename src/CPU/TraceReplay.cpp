@@ -0,0 +1,84 @@
+#include "TraceReplay.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+TraceReplay::TraceReplay(const std::string& path)
+: reader(path)
+{
+    if (reader.chunks() == 0) throw std::runtime_error("TraceReplay: " + path + " holds no cycles");
+
+    std::array<int32_t, 32> regs;
+    Memory m;
+    fill(reader.start(), regs, m);
+
+    // One pass over every commit, a keyframe in front of each chunk. A chunk
+    // with a state block starts from it instead, the run was rewound or
+    // edited there. A chunk without either shares the previous keyframe's
+    // memory.
+    std::shared_ptr<const Memory> snap;
+    bool stored = true;
+    uint64_t at = 0;
+    std::vector<TraceCycle> buf;
+    TraceState state;
+    starts.reserve(reader.chunks());
+    keyframes.reserve(reader.chunks());
+    for (size_t i = 0; i < reader.chunks(); ++i) {
+        if (reader.readState(i, state)) {
+            fill(state, regs, m);
+            stored = true;
+        }
+        if (stored) snap = std::make_shared<const Memory>(m);
+        starts.push_back(at);
+        keyframes.push_back({regs, snap});
+        at += reader.chunk(i).cycles;
+
+        reader.read(i, buf);
+        stored = false;
+        for (const TraceCycle& c : buf) {
+            apply(c, regs, m);
+            stored |= c.memWrite;
+        }
+    }
+
+    load(0);
+}
+
+void TraceReplay::fill(const TraceState& s, std::array<int32_t, 32>& regs, Memory& mem) {
+    regs = s.regs;
+    mem = Memory();
+    for (const auto& [addr, value] : s.memory) {
+        mem.writeNext(addr, value);
+        mem.commit();
+    }
+}
+
+void TraceReplay::apply(const TraceCycle& c, std::array<int32_t, 32>& regs, Memory& mem) {
+    for (int i = 0; i < c.regWrites; ++i) regs[c.regIdx[i] & 31] = c.regValue[i];
+    regs[0] = 0;
+    if (c.memWrite) {
+        mem.writeNext(c.memAddr, c.memValue);
+        mem.commit();
+    }
+}
+
+// Decode chunk i and stand at its first cycle
+void TraceReplay::load(size_t i) {
+    if (i != chunk || cycles.empty()) reader.read(i, cycles);
+    chunk = i;
+    regFile = keyframes[i].regs;
+    mem = *keyframes[i].mem;
+    local = 0;
+    applied = 0;
+    pos = starts[i];
+}
+
+void TraceReplay::seek(uint64_t n) {
+    n = std::min(n, length() - 1);
+    const size_t i = static_cast<size_t>(std::upper_bound(starts.begin(), starts.end(), n) - starts.begin()) - 1;
+    const size_t target = static_cast<size_t>(n - starts[i]);
+    if (i != chunk || target < applied) load(i);
+
+    for (; applied < target; ++applied) apply(cycles[applied], regFile, mem);
+    local = target;
+    pos = n;
+}
@@ -1,47 +1,339 @@
 #include "CPU.hpp"
 #include <iostream>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+// Tag bits of a journal frame: which latches were valid, fetchEnabled, and
+// whether the cycle was frozen on a data miss or carries cache stall state
+constexpr uint8_t kIfIdValid = 1;
+constexpr uint8_t kIdExValid = 2;
+constexpr uint8_t kExMemValid = 4;
+constexpr uint8_t kMemWbValid = 8;
+constexpr uint8_t kFetchEnabled = 16;
+constexpr uint8_t kFrozen = 32;
+constexpr uint8_t kCacheState = 64;
+constexpr uint8_t kSecondLane = 128;   // dual issue, a byte of lane 2 valid bits follows pc
+
+template <typename T>
+const uint8_t* take(const uint8_t* p, T& out) {
+    std::memcpy(&out, p, sizeof(T));
+    return p + sizeof(T);
+}
+
+} // namespace
 
 CPU::CPU()
 : instrMem()
-, mem(1024)
 {
     pc = 0;
     clock = 0;
 }
 
-void CPU::loadProgram(const std::vector<Instruction>& program) {
+void CPU::loadProgram(const Program& program) {
     instrMem = program;
     // Load a program and reset the control flow/pipeline
     pc = 0;
     clock = 0;
+    retired = 0;
+    perf = {};
+    if (journal) journal->clear();
+    resetTimingState();
 
-    pipe.if_id = IF_ID{};
-    pipe.id_ex = ID_EX{};
-    pipe.ex_mem = EX_MEM{};
-    pipe.mem_wb = MEM_WB{};
-    pipe.clearNext();
+    pipe.clear();
+    instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    traceStale = true;
 }
 
 void CPU::reset(bool clearMemory) {
     pc = 0;
     clock = 0;
+    retired = 0;
+    perf = {};
+    if (journal) journal->clear();
+    resetTimingState();
 
     // Clear pipeline
-    pipe.if_id = IF_ID{};
-    pipe.id_ex = ID_EX{};
-    pipe.ex_mem = EX_MEM{};
-    pipe.mem_wb = MEM_WB{};
-    pipe.clearNext();
+    pipe.clear();
 
     // Clear architectural state
     regs.reset();
-    if (clearMemory) mem.reset();
+    if (clearMemory) {
+        dataMem().reset();
+        instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    }
+    traceStale = true;
+}
+
+// Cold caches, no stalls in flight, untrained predictor
+void CPU::resetTimingState() {
+    if (cacheModel) cacheModel->reset();
+    predictor.reset();
+    memWait = 0;
+    fetchWait = 0;
+    fetchPc = 0;
+    fetchPending = false;
+}
+
+bool CPU::pipelineEmpty() const {
+    const bool empty = !pipe.if_id.cur().valid && !pipe.id_ex.cur().valid && !pipe.ex_mem.cur().valid && !pipe.mem_wb.cur().valid;
+    if (!empty || !pipe.dual) return empty;
+    return !pipe.if_id2.cur().valid && !pipe.id_ex2.cur().valid && !pipe.ex_mem2.cur().valid && !pipe.mem_wb2.cur().valid;
 }
 
 bool CPU::isHalted() const {
-    const bool pipelineEmpty = !pipe.if_id.valid && !pipe.id_ex.valid && !pipe.ex_mem.valid && !pipe.mem_wb.valid;
     const bool noMoreFetch = pc < 0 || pc >= static_cast<int>(instrMem.size());
-    return noMoreFetch && pipelineEmpty;
+    return noMoreFetch && pipelineEmpty();
+}
+
+void CPU::setArchState(int pc, const RegisterFile& regs, const Memory& mem) {
+    this->pc = pc;
+    this->regs = regs;
+    dataMem() = mem;
+    pipe.clear();
+    if (journal) journal->clear();
+    traceStale = true;
+
+    // The caches stay warm, only the stalls in flight belonged to the old pipeline
+    memWait = 0;
+    fetchWait = 0;
+    fetchPending = false;
+}
+
+CPU::Snapshot CPU::snapshot() const {
+    Snapshot snap;
+    snap.pc = pc;
+    snap.clock = clock;
+    snap.retired = retired;
+    snap.fetchEnabled = fetchEnabled;
+    snap.issueWidth = width;
+    snap.pipe = pipe;
+    snap.regs = regs;
+    snap.mem = dataMem();
+    snap.perf = perf;
+    snap.caches = cacheModel;
+    snap.predictor = predictor;
+    snap.memWait = memWait;
+    snap.fetchWait = fetchWait;
+    snap.fetchPc = fetchPc;
+    snap.fetchPending = fetchPending;
+    return snap;
+}
+
+void CPU::restore(const Snapshot& snap) {
+    if (outbound) throw std::runtime_error("CPU: a core whose stores its owner commits can not be restored");
+    if (snap.issueWidth == 2 && branchAt == BranchStage::ID) {
+        throw std::runtime_error("CPU: a dual-issue snapshot can not be restored while branches resolve in ID");
+    }
+    pc = snap.pc;
+    clock = snap.clock;
+    retired = snap.retired;
+    fetchEnabled = snap.fetchEnabled;
+    width = snap.issueWidth;
+    pipe = snap.pipe;
+    regs = snap.regs;
+    dataMem() = snap.mem;
+    perf = snap.perf;
+    cacheModel = snap.caches;
+    predictor = snap.predictor;
+    memWait = snap.memWait;
+    fetchWait = snap.fetchWait;
+    fetchPc = snap.fetchPc;
+    fetchPending = snap.fetchPending;
+    if (journal) journal->clear();
+    traceStale = true;
+}
+
+void CPU::setCaches(const CacheHierarchyConfig& cfg) {
+    cacheModel.emplace(cfg);
+    resetTimingState();
+    if (journal) journal->clear();
+}
+
+void CPU::disableCaches() {
+    cacheModel.reset();
+    resetTimingState();
+    if (journal) journal->clear();
+}
+
+void CPU::attachShared(Memory& memory, SnoopBus& snoopBus, int core,
+                       std::vector<MemWrite>* queue, bool defer) {
+    sharedMem = &memory;
+    bus = &snoopBus;
+    busPort = core;
+    outbound = queue;
+    deferStores = defer && queue;
+    resetTimingState();
+    if (outbound) journal.reset();
+    else if (journal) journal->clear();
+    traceStale = true;
+}
+
+void CPU::detachShared() {
+    sharedMem = nullptr;
+    bus = nullptr;
+    outbound = nullptr;
+    deferStores = false;
+    resetTimingState();
+    if (journal) journal->clear();
+    traceStale = true;
+}
+
+void CPU::setPredictor(const PredictorConfig& cfg) {
+    predictor = BranchPredictor(cfg);
+}
+
+void CPU::setBranchStage(BranchStage stage) {
+    if (stage == BranchStage::ID && width == 2) throw std::runtime_error("CPU: dual issue resolves branches in EX");
+    branchAt = stage;
+}
+
+void CPU::setIssueWidth(int lanes) {
+    if (lanes != 1 && lanes != 2) throw std::runtime_error("CPU: issue width must be 1 or 2");
+    if (lanes == 2 && branchAt == BranchStage::ID) throw std::runtime_error("CPU: dual issue resolves branches in EX");
+    if (lanes == width) return;
+
+    drain();
+    width = lanes;
+    pipe.dual = lanes == 2;
+    if (journal) journal->clear();
+}
+
+void CPU::enableJournal(size_t maxBytes) {
+    if (outbound) throw std::runtime_error("CPU: a core whose stores its owner commits can not be rewound");
+    journal = std::make_unique<CommitJournal>(maxBytes);
+}
+
+void CPU::disableJournal() {
+    journal.reset();
+}
+
+void CPU::journalBegin(bool frozen) {
+    // Everything the tick overwrites apart from the commits, which record themselves
+    auto validBits = [](const Latch<IF_ID>& a, const Latch<ID_EX>& b, const Latch<EX_MEM>& c,
+                        const Latch<MEM_WB>& d) -> uint8_t {
+        return (a.cur().valid ? kIfIdValid : 0) | (b.cur().valid ? kIdExValid : 0) |
+               (c.cur().valid ? kExMemValid : 0) | (d.cur().valid ? kMemWbValid : 0);
+    };
+
+    uint8_t tag = (fetchEnabled ? kFetchEnabled : 0) | (cacheModel || bus ? kCacheState : 0);
+    uint8_t lane2 = 0;
+    if (frozen) {
+        tag |= kFrozen;
+    } else {
+        tag |= validBits(pipe.if_id, pipe.id_ex, pipe.ex_mem, pipe.mem_wb);
+        if (width == 2) {
+            tag |= kSecondLane;
+            lane2 = validBits(pipe.if_id2, pipe.id_ex2, pipe.ex_mem2, pipe.mem_wb2);
+        }
+    }
+    journal->begin(tag);
+
+    if (!frozen) {
+        journal->put(pc);
+        if (tag & kSecondLane) journal->put(lane2);
+        if (tag & kIfIdValid) journal->put(pipe.if_id.cur());
+        if (tag & kIdExValid) journal->put(pipe.id_ex.cur());
+        if (tag & kExMemValid) journal->put(pipe.ex_mem.cur());
+        if (tag & kMemWbValid) journal->put(pipe.mem_wb.cur());
+        if (lane2 & kIfIdValid) journal->put(pipe.if_id2.cur());
+        if (lane2 & kIdExValid) journal->put(pipe.id_ex2.cur());
+        if (lane2 & kExMemValid) journal->put(pipe.ex_mem2.cur());
+        if (lane2 & kMemWbValid) journal->put(pipe.mem_wb2.cur());
+    }
+    if (tag & kCacheState) {
+        journal->put(memWait);
+        journal->put(fetchWait);
+        journal->put(fetchPc);
+        journal->put(fetchPending);
+    }
+    if constexpr (kPerfCounters) perfBefore = perf;
+}
+
+void CPU::journalEnd() {
+    if constexpr (kPerfCounters) {
+        // Every counter moves by a few events per cycle at most
+        uint64_t before[PerfCounters::kCount];
+        int i = 0;
+        perfBefore.forEach([&](const char*, uint64_t value) { before[i++] = value; });
+        i = 0;
+        perf.forEach([&](const char*, uint64_t value) {
+            journal->put(static_cast<uint8_t>(value - before[i++]));
+        });
+    }
+    journal->end();
+}
+
+uint64_t CPU::stepBack(uint64_t n) {
+    if (!journal) return 0;
+
+    uint64_t undone = 0;
+    CommitJournal::Frame f;
+    while (undone < n && journal->back(f)) {
+        // Payload order matches journalBegin/End
+        const uint8_t* p = f.payload;
+        uint8_t lane2 = 0;
+        if (!(f.tag & kFrozen)) {
+            p = take(p, pc);
+            if (f.tag & kSecondLane) p = take(p, lane2);
+            auto latch = [&](auto& l, uint8_t bits, uint8_t bit) {
+                if (bits & bit) p = take(p, l.bank[l.front]);
+                else l.bank[l.front].valid = false;
+            };
+            latch(pipe.if_id, f.tag, kIfIdValid);
+            latch(pipe.id_ex, f.tag, kIdExValid);
+            latch(pipe.ex_mem, f.tag, kExMemValid);
+            latch(pipe.mem_wb, f.tag, kMemWbValid);
+            latch(pipe.if_id2, lane2, kIfIdValid);
+            latch(pipe.id_ex2, lane2, kIdExValid);
+            latch(pipe.ex_mem2, lane2, kExMemValid);
+            latch(pipe.mem_wb2, lane2, kMemWbValid);
+        }
+        if (f.tag & kCacheState) {
+            p = take(p, memWait);
+            p = take(p, fetchWait);
+            p = take(p, fetchPc);
+            p = take(p, fetchPending);
+        }
+
+        if constexpr (kPerfCounters) {
+            perf.forEach([&](const char*, uint64_t& value) {
+                uint8_t delta;
+                p = take(p, delta);
+                value -= delta;
+            });
+        }
+
+        if (f.hasReg2) {
+            regs.writeNext(f.reg2Idx, f.reg2Old);
+            regs.commit();
+        }
+        if (f.hasReg) {
+            regs.writeNext(f.regIdx, f.regOld);
+            regs.commit();
+        }
+        if (f.hasMem) {
+            dataMem().writeNext(f.memAddr, f.memOld);
+            dataMem().commit();
+        }
+
+        fetchEnabled = (f.tag & kFetchEnabled) != 0;
+        if (f.tag & kMemWbValid) retired--;
+        if (lane2 & kMemWbValid) retired--;
+        clock--;
+
+        journal->pop();
+        ++undone;
+    }
+    if (undone) traceStale = true;
+    return undone;
+}
+
+void CPU::drain() {
+    fetchEnabled = false;
+    while (!pipelineEmpty()) tick();
+    fetchEnabled = true;
 }
 
 void CPU::tick() {
@@ -49,34 +341,195 @@ void CPU::tick() {
         // Nothing left to do.
         return;
     }
+
+    // Bus time charged after the last cycle, when the other cores' transactions were known
+    if (bus) memWait += static_cast<int>(bus->takeStall(busPort));
+
+    if (memWait > 0) {
+        // Data miss in progress: nothing moves, an instruction miss keeps counting down
+        if (tracer) traceCycle(TraceCycle::kFrozen);
+        if (journal) journalBegin(true);
+        memWait--;
+        if (fetchWait > 0) fetchWait--;
+        SCS_COUNT(perf, cycles, 1);
+        SCS_COUNT(perf, memStallCycles, 1);
+        SCS_COUNT(perf, bubblesWB, 1);
+        if (journal) journalEnd();
+        clock++;
+        return;
+    }
+
+    if (width == 2) advance<true>();
+    else advance<false>();
+}
+
+template <bool Dual>
+void CPU::advance() {
     int pc_next = pc;
+    if (journal) journalBegin(false);
 
     // Detect hazards based on th pipeline state.
-    const HazardResult hz = hazardUnit.detect(pipe.if_id, pipe.id_ex);
+    HazardResult hz;
+    if constexpr (Dual) hz = hazardUnit.detectPair(pipe);
+    else hz = hazardUnit.detect(pipe.if_id.cur(), pipe.id_ex.cur(), pipe.ex_mem.cur(), branchAt);
     const bool stall = hz.stall;
 
-    pipe.clearNext();
+    // IF waits while the instruction cache fills the line of pc
+    bool fetching = fetchEnabled && !stall && pc >= 0 && pc < static_cast<int>(instrMem.size());
+    bool fetchBlocked = false;
+    if (cacheModel && fetching) {
+        if (!fetchPending || fetchPc != pc) {
+            fetchPc = pc;
+            fetchWait = static_cast<int>(cacheModel->fetch(static_cast<uint32_t>(pc)));
+            fetchPending = true;
+        }
+        fetchBlocked = fetchWait > 0;
+        if (!fetchBlocked) fetchPending = false;
+    }
+
+    if constexpr (kPerfCounters) {
+        perf.cycles++;
+        perf.loadUseStalls += stall && !hz.branch;
+        perf.branchStalls += hz.branch;
+        perf.fetchStallCycles += fetchBlocked;
+        perf.bubblesIF += !fetching || fetchBlocked;
+        perf.bubblesID += stall || !pipe.if_id.cur().valid;
+        perf.bubblesEX += !pipe.id_ex.cur().valid;
+        perf.bubblesMEM += !pipe.ex_mem.cur().valid;
+        perf.bubblesWB += !pipe.mem_wb.cur().valid;
+        if constexpr (Dual) {
+            perf.pairsIssued += !stall && !hz.split && pipe.if_id2.cur().valid;
+            perf.issueSplits += hz.split;
+        }
+    }
+
+    // IF/ID are the only stages that stall, on a load-use or ID branch hazard
+    if constexpr (Dual) {
+        const int lineWords = cacheModel ? static_cast<int>(cacheModel->l1i().config().lineBytes / 4) : 0;
+        ifStage.evaluatePair(pipe, instrMem, pc, pc_next, stall, hz.split, fetching && !fetchBlocked,
+                             lineWords, predictor);
+        idStage.evaluatePair(pipe, regs, stall, hz.split, perf);
+    } else {
+        if ((fetchEnabled || stall) && !fetchBlocked) ifStage.evaluate(pipe, instrMem, pc, pc_next, stall, predictor);
+        else pipe.if_id.next().valid = false;
+        idStage.evaluate(pipe, regs, stall, branchAt, pc_next, predictor, perf);
+    }
 
-    // IF/ID are the only stages that stall on a load-use hazard
-    ifStage.evaluate(pipe, instrMem, pc, pc_next, stall);
-    idStage.evaluate(pipe, regs, stall);
+    Memory& data = dataMem();
+    memStage.evaluate<Dual>(pipe, data);
+    if (cacheModel || bus) {
+        // A data miss freezes the pipeline for the cycles after this one.
+        // A pair holds at most one memory operation.
+        auto access = [&](const EX_MEM& m) {
+            if (!m.valid || !(m.ctrl.memRead || m.ctrl.memWrite)) return;
+            const uint32_t addr = static_cast<uint32_t>(m.alu_result);
+            if (bus) {
+                const uint64_t now = static_cast<uint64_t>(clock);
+                memWait = static_cast<int>(m.ctrl.memRead ? bus->load(busPort, addr, now)
+                                                          : bus->store(busPort, addr, now));
+            } else {
+                memWait = static_cast<int>(m.ctrl.memRead ? cacheModel->load(addr) : cacheModel->store(addr));
+            }
+        };
+        access(pipe.ex_mem.cur());
+        if constexpr (Dual) access(pipe.ex_mem2.cur());
+    }
+    exStage.evaluate<Dual>(pipe, pc_next, predictor, perf);
+    retired += pipe.mem_wb.cur().valid;
+    if constexpr (Dual) retired += pipe.mem_wb2.cur().valid;
+    wbStage.evaluate<Dual>(pipe, regs);
 
-    memStage.evaluate(pipe, mem);
-    exStage.evaluate(pipe, pc_next);
-    wbStage.evaluate(pipe, regs);
+    if (tracer) {
+        bool flushed = pipe.if_id.bubbleReq;
+        if constexpr (Dual) flushed = flushed || pipe.if_id2.bubbleReq;
+        traceCycle((stall ? TraceCycle::kStall : 0) | (flushed ? TraceCycle::kFlush : 0) |
+                   (fetchBlocked ? TraceCycle::kFetchWait : 0));
+    }
 
-    pipe.if_id = pipe.if_id_next;
-    pipe.id_ex = pipe.id_ex_next;
-    pipe.ex_mem = pipe.ex_mem_next;
-    pipe.mem_wb = pipe.mem_wb_next;
+    // Flip the latch banks, held latches keep their contents
+    pipe.commit<Dual>();
 
-    regs.commit();
-    mem.commit();
+    if (outbound) queueStore(data);
+    if (journal) {
+        regs.commit<Dual ? 2 : 1>(*journal);
+        data.commit(*journal);
+        journalEnd();
+    } else {
+        regs.commit<Dual ? 2 : 1>();
+        data.commit();
+    }
 
+    if (fetchWait > 0) fetchWait--;
     pc = pc_next;
     clock++;
 }
 
+void CPU::queueStore(Memory& data) {
+    const auto& w = data.pending();
+    if (!w) return;
+    outbound->push_back({static_cast<uint64_t>(clock), w->first, w->second});
+    if (deferStores) data.discardPending();
+}
+
+void CPU::enableTrace(const std::string& path, const TraceConfig& cfg) {
+    disableTrace();
+    tracer = std::make_unique<TraceWriter>(path, cfg, traceState());
+    traceStale = false;
+}
+
+void CPU::disableTrace() {
+    if (!tracer) return;
+    std::unique_ptr<TraceWriter> t = std::move(tracer);
+    t->close();
+}
+
+TraceState CPU::traceState() const {
+    TraceState s;
+    for (int r = 0; r < 32; ++r) s.regs[r] = regs.read(r);
+    dataMem().forEachPage([&](uint32_t first, const int* words) {
+        for (uint32_t i = 0; i < Memory::kPageWords; ++i) {
+            if (words[i]) s.memory.emplace_back(static_cast<int32_t>(first + i), words[i]);
+        }
+    });
+    return s;
+}
+
+// The latches as the cycle found them and the writes it is about to commit
+void CPU::traceCycle(uint8_t flags) {
+    if (traceStale) {
+        // Registers or memory changed outside the commits since the last cycle
+        tracer->push(traceState());
+        traceStale = false;
+    }
+    auto at = [](const auto& l) { return l.cur().valid ? l.cur().pc : -1; };
+    TraceCycle c;
+    c.cycle = static_cast<uint64_t>(clock);
+    c.flags = flags;
+    c.latch[0] = at(pipe.if_id);
+    c.latch[1] = at(pipe.id_ex);
+    c.latch[2] = at(pipe.ex_mem);
+    c.latch[3] = at(pipe.mem_wb);
+    if (width == 2) {
+        c.latch[4] = at(pipe.if_id2);
+        c.latch[5] = at(pipe.id_ex2);
+        c.latch[6] = at(pipe.ex_mem2);
+        c.latch[7] = at(pipe.mem_wb2);
+    }
+    for (int port = 0; port < RegisterFile::kWritePorts; ++port) {
+        if (const auto& w = regs.pending(port)) {
+            c.regIdx[c.regWrites] = static_cast<uint8_t>(w->first);
+            c.regValue[c.regWrites] = w->second;
+            c.regWrites++;
+        }
+    }
+    if (const auto& w = dataMem().pending()) {
+        c.memWrite = true;
+        c.memAddr = w->first;
+        c.memValue = w->second;
+    }
+    tracer->push(c);
+}
+
 void CPU::dumpRegisters() const {
     const auto& r = regs.getRegs();
     std::cout << "Registers:\n";
@@ -89,21 +542,26 @@ void CPU::dumpRegisters() const {
 }
 
 void CPU::dumpPipeline() const {
+    const IF_ID& ifid = pipe.if_id.cur();
+    const ID_EX& idex = pipe.id_ex.cur();
+    const EX_MEM& exmem = pipe.ex_mem.cur();
+    const MEM_WB& memwb = pipe.mem_wb.cur();
+
     auto dumpIF = [&]() {
-        if (!pipe.if_id.valid) { std::cout << "IF: <empty>\n"; return; }
-        std::cout << "IF: pc=" << pipe.if_id.pc << " op=" << (int)pipe.if_id.rawInstr.op << " txt=" << pipe.if_id.rawInstr.raw_text << "\n";
+        if (!ifid.valid) { std::cout << "IF: <empty>\n"; return; }
+        std::cout << "IF: pc=" << ifid.pc << " op=" << (int)ifid.rawInstr.op << " txt=" << instrMem.text(ifid.rawInstr) << "\n";
     };
     auto dumpID = [&]() {
-        if (!pipe.id_ex.valid) { std::cout << "ID/EX: <empty>\n"; return; }
-        std::cout << "ID/EX: pc=" << pipe.id_ex.pc << " rs=" << pipe.id_ex.rs << " rt=" << pipe.id_ex.rt << " imm=" << pipe.id_ex.imm << "\n";
+        if (!idex.valid) { std::cout << "ID/EX: <empty>\n"; return; }
+        std::cout << "ID/EX: pc=" << idex.pc << " rs=" << idex.rs << " rt=" << idex.rt << " imm=" << idex.imm << "\n";
     };
     auto dumpEX = [&]() {
-        if (!pipe.ex_mem.valid) { std::cout << "EX/MEM: <empty>\n"; return; }
-        std::cout << "EX/MEM: alu=" << pipe.ex_mem.alu_result << " zero=" << pipe.ex_mem.zero << "\n";
+        if (!exmem.valid) { std::cout << "EX/MEM: <empty>\n"; return; }
+        std::cout << "EX/MEM: alu=" << exmem.alu_result << " zero=" << exmem.zero << "\n";
     };
     auto dumpMEM = [&]() {
-        if (!pipe.mem_wb.valid) { std::cout << "MEM/WB: <empty>\n"; return; }
-        std::cout << "MEM/WB: alu=" << pipe.mem_wb.alu_result << " mem=" << pipe.mem_wb.mem_data << "\n";
+        if (!memwb.valid) { std::cout << "MEM/WB: <empty>\n"; return; }
+        std::cout << "MEM/WB: alu=" << memwb.alu_result << " mem=" << memwb.mem_data << "\n";
     };
 
     std::cout << "Clock: " << clock << " PC: " << pc << "\n";
@@ -111,6 +569,41 @@ void CPU::dumpPipeline() const {
     dumpID();
     dumpEX();
     dumpMEM();
+    if (width == 2) {
+        const IF_ID& ifid2 = pipe.if_id2.cur();
+        std::cout << "Lane 2:\n";
+        if (!ifid2.valid) std::cout << "IF: <empty>\n";
+        else std::cout << "IF: pc=" << ifid2.pc << " txt=" << instrMem.text(ifid2.rawInstr) << "\n";
+        for (auto [name, instr, valid] : {std::tuple{"ID/EX", &pipe.id_ex2.cur().rawInstr, pipe.id_ex2.cur().valid},
+                                          std::tuple{"EX/MEM", &pipe.ex_mem2.cur().rawInstr, pipe.ex_mem2.cur().valid},
+                                          std::tuple{"MEM/WB", &pipe.mem_wb2.cur().rawInstr, pipe.mem_wb2.cur().valid}}) {
+            std::cout << name << ": " << (valid ? instrMem.text(*instr) : std::string("<empty>")) << "\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+void CPU::dumpStats() const {
+    if (cacheModel) {
+        std::cout << "Caches:\n";
+        cacheModel->forEachLevel([](const char* name, const CacheStats& st) {
+            std::cout << "  " << name << ": " << st.hits() << " hits, " << st.misses() << " misses, "
+                      << st.writebacks << " writebacks\n";
+        });
+    }
+    if (const PredictorStats& ps = predictor.stats(); ps.total() > 0) {
+        std::cout << "Predictor (" << predictorName(predictor.config().kind) << "): "
+                  << ps.mispredicts() << " of " << ps.total() << " mispredicted, accuracy "
+                  << ps.accuracy() * 100.0 << "%\n";
+    }
+    if (!kPerfCounters) {
+        std::cout << "Counters: disabled (SCS_PERF_COUNTERS=0)\n" << std::flush;
+        return;
+    }
+    std::cout << "Counters:\n";
+    perf.forEach([](const char* name, uint64_t value) {
+        std::cout << "  " << name << ": " << value << "\n";
+    });
     std::cout << std::flush;
 }
 
@@ -119,11 +612,12 @@ int CPU::getReg(int idx) const {
 }
 
 int CPU::getMemWord(int addr) const {
-    return mem.read(addr);
+    return dataMem().read(addr);
 }
 
 void CPU::setMemWord(int addr, int value) {
     // For tests/initialization we want an immediate result
-    mem.writeNext(addr, value);
-    mem.commit();
+    dataMem().writeNext(addr, value);
+    dataMem().commit();
+    traceStale = true;
 }
@@ -0,0 +1,221 @@
+#include "FunctionalCPU.hpp"
+#include <algorithm>
+#include <array>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCS_THREADED_DISPATCH 1
+#else
+#define SCS_THREADED_DISPATCH 0
+#endif
+
+namespace {
+// Register slot that absorbs writes to $0
+constexpr int kSink = 32;
+}
+
+FunctionalCPU::FunctionalCPU()
+: instrMem()
+{
+}
+
+void FunctionalCPU::loadProgram(const Program& program) {
+    instrMem = program;
+
+    ops.clear();
+    ops.reserve(program.size());
+    for (size_t i = 0; i < program.size(); ++i) ops.push_back(predecode(program[i]));
+
+    // Translations of the previous program are stale
+    if (jit) jit->invalidate(instrMem);
+
+    pc = 0;
+    retired = 0;
+    instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+}
+
+void FunctionalCPU::reset(bool clearMemory) {
+    pc = 0;
+    retired = 0;
+
+    regs.reset();
+    if (clearMemory) {
+        mem.reset();
+        instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    }
+}
+
+void FunctionalCPU::setBackend(Backend backend) {
+    selected = backend;
+    if (backend == Backend::Jit && !jit) {
+        jit = std::make_unique<JitCache>();
+        jit->invalidate(instrMem);
+    }
+}
+
+bool FunctionalCPU::isHalted() const {
+    return pc < 0 || pc >= static_cast<int>(ops.size());
+}
+
+void FunctionalCPU::setArchState(int pc, const RegisterFile& regs, const Memory& mem) {
+    this->pc = pc;
+    this->regs = regs;
+    this->mem = mem;
+}
+
+FunctionalCPU::Op FunctionalCPU::predecode(const Instruction& ins) {
+    Op op;
+    op.rs = ins.rs;
+    op.rt = ins.rt;
+    op.imm = ins.imm;
+
+    auto dest = [](int r) { return static_cast<uint8_t>(r == 0 ? kSink : r); };
+
+    switch (ins.op) {
+        case Opcode::NOP:  op.kind = K_NOP; break;
+        case Opcode::ADD:  op.kind = K_ADD; op.rd = dest(ins.rd); break;
+        case Opcode::SUB:  op.kind = K_SUB; op.rd = dest(ins.rd); break;
+        case Opcode::AND:  op.kind = K_AND; op.rd = dest(ins.rd); break;
+        case Opcode::OR:   op.kind = K_OR;  op.rd = dest(ins.rd); break;
+        case Opcode::XOR:  op.kind = K_XOR; op.rd = dest(ins.rd); break;
+        case Opcode::SLT:  op.kind = K_SLT; op.rd = dest(ins.rd); break;
+        case Opcode::ADDI: op.kind = K_ADDI; op.rd = dest(ins.rt); break;
+        case Opcode::ANDI: op.kind = K_ANDI; op.rd = dest(ins.rt); break;
+        case Opcode::ORI:  op.kind = K_ORI;  op.rd = dest(ins.rt); break;
+        case Opcode::LW:   op.kind = K_LW;   op.rd = dest(ins.rt); break;
+        case Opcode::SW:   op.kind = K_SW; break;
+        // Branch targets are resolved here so the handler is a plain compare
+        case Opcode::BEQ:  op.kind = K_BEQ; op.imm = ins.index + 1 + ins.imm; break;
+        case Opcode::BNE:  op.kind = K_BNE; op.imm = ins.index + 1 + ins.imm; break;
+        case Opcode::J:    op.kind = K_J;   op.imm = ins.addr; break;
+        case Opcode::JAL:  op.kind = K_JAL; op.imm = ins.addr; break;
+        case Opcode::JR:   op.kind = K_JR; break;
+    }
+    return op;
+}
+
+uint64_t FunctionalCPU::run(uint64_t maxInstrs) {
+    if (selected == Backend::Jit && jitActive()) return runTranslated(maxInstrs);
+    return interpret(maxInstrs);
+}
+
+uint64_t FunctionalCPU::runTranslated(uint64_t maxInstrs) {
+    JitContext ctx;
+    for (int i = 0; i < 32; ++i) ctx.regs[i] = regs.read(i);
+    ctx.regs[kSink] = 0;
+    ctx.pc = pc;
+    const uint64_t granted = std::min<uint64_t>(maxInstrs, INT64_MAX);
+    ctx.budget = static_cast<int64_t>(granted);
+    ctx.mem = &mem;
+
+    // Blocks chain among themselves, control only comes back here for
+    // indirect jumps, untranslated targets and a nearly spent budget
+    while (const JitCache::Block* block = jit->lookup(ctx.pc)) {
+        if (ctx.budget < block->length) break;
+        jit->enter(ctx, block);
+    }
+
+    for (int i = 1; i < 32; ++i) {
+        regs.writeNext(i, ctx.regs[i]);
+        regs.commit();
+    }
+
+    const uint64_t executed = granted - static_cast<uint64_t>(ctx.budget);
+    retired += executed;
+    pc = ctx.pc;
+
+    // Finish a budget smaller than the next block one instruction at a time
+    const uint64_t left = maxInstrs - executed;
+    if (left > 0 && !isHalted()) return executed + interpret(left);
+    return executed;
+}
+
+uint64_t FunctionalCPU::interpret(uint64_t maxInstrs) {
+    // Work on a local copy of the register file, written back on exit
+    std::array<int, 33> r{};
+    for (int i = 0; i < 32; ++i) r[i] = regs.read(i);
+
+    const Op* const code = ops.data();
+    const unsigned count = static_cast<unsigned>(ops.size());
+    const Op* op = nullptr;
+    int p = pc;
+    uint64_t left = maxInstrs;
+
+#if SCS_THREADED_DISPATCH
+    static const void* const dispatch[] = {
+        &&h_K_NOP, &&h_K_ADD, &&h_K_SUB, &&h_K_AND, &&h_K_OR, &&h_K_XOR, &&h_K_SLT,
+        &&h_K_ADDI, &&h_K_ANDI, &&h_K_ORI, &&h_K_LW, &&h_K_SW,
+        &&h_K_BEQ, &&h_K_BNE, &&h_K_J, &&h_K_JAL, &&h_K_JR
+    };
+#define NEXT() \
+    do { \
+        if (left == 0 || static_cast<unsigned>(p) >= count) goto done; \
+        --left; \
+        op = &code[p]; \
+        goto *dispatch[op->kind]; \
+    } while (0)
+#define HANDLER(k) h_##k
+
+    NEXT();
+#else
+#define NEXT() goto top
+#define HANDLER(k) case k
+
+top:
+    if (left == 0 || static_cast<unsigned>(p) >= count) goto done;
+    --left;
+    op = &code[p];
+    switch (op->kind) {
+#endif
+
+    HANDLER(K_NOP):  p++; NEXT();
+    HANDLER(K_ADD):  r[op->rd] = r[op->rs] + r[op->rt]; p++; NEXT();
+    HANDLER(K_SUB):  r[op->rd] = r[op->rs] - r[op->rt]; p++; NEXT();
+    HANDLER(K_AND):  r[op->rd] = r[op->rs] & r[op->rt]; p++; NEXT();
+    HANDLER(K_OR):   r[op->rd] = r[op->rs] | r[op->rt]; p++; NEXT();
+    HANDLER(K_XOR):  r[op->rd] = r[op->rs] ^ r[op->rt]; p++; NEXT();
+    HANDLER(K_SLT):  r[op->rd] = (r[op->rs] < r[op->rt]) ? 1 : 0; p++; NEXT();
+    HANDLER(K_ADDI): r[op->rd] = r[op->rs] + op->imm; p++; NEXT();
+    HANDLER(K_ANDI): r[op->rd] = r[op->rs] & op->imm; p++; NEXT();
+    HANDLER(K_ORI):  r[op->rd] = r[op->rs] | op->imm; p++; NEXT();
+    HANDLER(K_LW):   r[op->rd] = mem.read(r[op->rs] + op->imm); p++; NEXT();
+    HANDLER(K_SW):
+        mem.writeNext(r[op->rs] + op->imm, r[op->rt]);
+        mem.commit();
+        p++;
+        NEXT();
+    HANDLER(K_BEQ):  p = (r[op->rs] == r[op->rt]) ? op->imm : p + 1; NEXT();
+    HANDLER(K_BNE):  p = (r[op->rs] != r[op->rt]) ? op->imm : p + 1; NEXT();
+    HANDLER(K_J):    p = op->imm; NEXT();
+    HANDLER(K_JAL):  r[31] = p + 1; p = op->imm; NEXT();
+    HANDLER(K_JR):   p = r[op->rs]; NEXT();
+
+#if !SCS_THREADED_DISPATCH
+    }
+#endif
+#undef NEXT
+#undef HANDLER
+
+done:
+    for (int i = 1; i < 32; ++i) {
+        regs.writeNext(i, r[i]);
+        regs.commit();
+    }
+
+    const uint64_t executed = maxInstrs - left;
+    retired += executed;
+    pc = p;
+    return executed;
+}
+
+int FunctionalCPU::getReg(int idx) const {
+    return regs.read(idx);
+}
+
+int FunctionalCPU::getMemWord(int addr) const {
+    return mem.read(addr);
+}
+
+void FunctionalCPU::setMemWord(int addr, int value) {
+    mem.writeNext(addr, value);
+    mem.commit();
+}
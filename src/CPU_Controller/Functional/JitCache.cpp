@@ -0,0 +1,338 @@
+#include "JitCache.hpp"
+#include "Memory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define SCS_JIT_X86_64 1
+#include <sys/mman.h>
+#else
+#define SCS_JIT_X86_64 0
+#endif
+
+#if SCS_JIT_X86_64
+
+namespace {
+
+constexpr size_t kCodeBytes = size_t(8) << 20;
+constexpr int kMaxBlockLen = 64;
+// Worst case for one block: prologue, the largest instruction template per
+// instruction, two chained exits and the bail-out stub
+constexpr size_t kMaxBlockBytes = 32 + kMaxBlockLen * 40 + 3 * 32;
+constexpr int kSink = 32;
+
+int32_t jitLoad(Memory* mem, int32_t addr) {
+    return mem->read(addr);
+}
+
+void jitStore(Memory* mem, int32_t addr, int32_t value) {
+    mem->writeNext(addr, value);
+    mem->commit();
+}
+
+constexpr int32_t regOff(int r) { return static_cast<int32_t>(offsetof(JitContext, regs) + 4 * r); }
+constexpr int32_t kPcOff = static_cast<int32_t>(offsetof(JitContext, pc));
+constexpr int32_t kBudgetOff = static_cast<int32_t>(offsetof(JitContext, budget));
+constexpr int32_t kMemOff = static_cast<int32_t>(offsetof(JitContext, mem));
+
+// x86-64 register numbers used by the templates. rbx holds the JitContext.
+enum Reg : uint8_t { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESI = 6, EDI = 7 };
+
+class Emitter {
+public:
+    explicit Emitter(uint8_t* at) : start(at), p(at) {}
+
+    size_t size() const { return static_cast<size_t>(p - start); }
+    uint8_t* here() const { return p; }
+
+    void byte(uint8_t b) { *p++ = b; }
+    void u32(uint32_t v) { std::memcpy(p, &v, 4); p += 4; }
+    void u64(uint64_t v) { std::memcpy(p, &v, 8); p += 8; }
+
+    // <op> reg, [rbx + disp32]
+    void rbxMem(uint8_t op, uint8_t reg, int32_t disp) {
+        byte(op);
+        byte(static_cast<uint8_t>(0x80 | (reg << 3) | EBX));
+        u32(static_cast<uint32_t>(disp));
+    }
+    void load(uint8_t reg, int32_t disp) { rbxMem(0x8B, reg, disp); }
+    void store(uint8_t reg, int32_t disp) { rbxMem(0x89, reg, disp); }
+
+    // mov dword [rbx + disp32], imm32
+    void storeImm(int32_t disp, int32_t imm) {
+        rbxMem(0xC7, 0, disp);
+        u32(static_cast<uint32_t>(imm));
+    }
+
+    // <op> qword [rbx + disp32], imm32 with op extension ext (/5 sub, /7 cmp)
+    void qwordImm(uint8_t ext, int32_t disp, int32_t imm) {
+        byte(0x48);
+        rbxMem(0x81, ext, disp);
+        u32(static_cast<uint32_t>(imm));
+    }
+
+    void callAbs(const void* fn) {
+        byte(0x48); byte(0xB8); u64(reinterpret_cast<uint64_t>(fn));  // mov rax, imm64
+        byte(0xFF); byte(0xD0);                                       // call rax
+    }
+
+    // Jumps return the address of their rel32 field for bind()
+    uint8_t* jmp32() { byte(0xE9); uint8_t* site = p; u32(0); return site; }
+    uint8_t* jcc32(uint8_t cc) { byte(0x0F); byte(cc); uint8_t* site = p; u32(0); return site; }
+
+    static void bind(uint8_t* site, const uint8_t* target) {
+        const int32_t rel = static_cast<int32_t>(target - (site + 4));
+        std::memcpy(site, &rel, 4);
+    }
+
+private:
+    uint8_t* start;
+    uint8_t* p;
+};
+
+constexpr uint8_t kJE = 0x84;
+constexpr uint8_t kJNE = 0x85;
+constexpr uint8_t kJL = 0x8C;
+
+bool endsBlock(Opcode op) {
+    switch (op) {
+        case Opcode::BEQ:
+        case Opcode::BNE:
+        case Opcode::J:
+        case Opcode::JAL:
+        case Opcode::JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+JitCache::JitCache() {
+    // Never writable and executable at once (W^X): code pages are RW while a
+    // block is emitted or chained and RX while it runs
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_JIT
+    flags |= MAP_JIT;
+#endif
+    void* mem = mmap(nullptr, kCodeBytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mem == MAP_FAILED) return;
+
+    buffer = static_cast<uint8_t*>(mem);
+    capacity = kCodeBytes;
+    writable = true;
+    try {
+        flush();
+        setWritable(false);
+    } catch (const std::runtime_error&) {
+        // The host refuses executable pages, callers interpret
+        munmap(buffer, capacity);
+        buffer = nullptr;
+        capacity = 0;
+    }
+}
+
+JitCache::~JitCache() {
+    if (buffer) munmap(buffer, capacity);
+}
+
+void JitCache::setWritable(bool on) {
+    if (on == writable) return;
+    // Only the pages up to used hold code, the rest of the buffer stays RW
+    // and empty, so small programs toggle a few pages rather than all of it
+    const size_t page = 4096;
+    const size_t bytes = on ? sealed : std::min(capacity, (used + page - 1) / page * page);
+    if (bytes && mprotect(buffer, bytes, on ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) {
+        throw std::runtime_error("JIT code buffer: mprotect failed");
+    }
+    sealed = on ? 0 : bytes;
+    writable = on;
+}
+
+void JitCache::flush() {
+    setWritable(true);
+    blocks.clear();
+    std::fill(blockAt.begin(), blockAt.end(), -1);
+    for (auto& w : waiting) w.clear();
+    chained = 0;
+
+    // Shared entry/exit: enter(ctx, entry) keeps ctx in rbx and jumps to the block
+    Emitter e(buffer);
+    e.byte(0x53);                             // push rbx
+    e.byte(0x48); e.byte(0x89); e.byte(0xFB); // mov rbx, rdi
+    e.byte(0xFF); e.byte(0xE6);               // jmp rsi
+    epilogue = e.here();
+    e.byte(0x5B);                             // pop rbx
+    e.byte(0xC3);                             // ret
+    used = e.size();
+}
+
+void JitCache::patch(uint32_t site, const uint8_t* target) {
+    Emitter::bind(buffer + site, target);
+    chained++;
+}
+
+const JitCache::Block* JitCache::translate(int pc) {
+    setWritable(true);
+    if (capacity - used < kMaxBlockBytes) flush();
+
+    const int n = static_cast<int>(code.size());
+    int len = 0;
+    while (pc + len < n && len < kMaxBlockLen) {
+        if (endsBlock(code[pc + len].op)) { len++; break; }
+        len++;
+    }
+
+    uint8_t* const entry = buffer + used;
+    Emitter e(entry);
+
+    // Leave without executing anything if the whole block does not fit the budget
+    e.qwordImm(7, kBudgetOff, len);           // cmp qword [budget], len
+    uint8_t* const bail = e.jcc32(kJL);
+    e.qwordImm(5, kBudgetOff, len);           // sub qword [budget], len
+
+    std::vector<std::pair<uint8_t*, int>> exits;
+    auto exitTo = [&](int target) {
+        if (target >= 0 && target < n) {
+            // Falls through to the stub below until the target gets chained
+            uint8_t* site = e.jmp32();
+            Emitter::bind(site, site + 4);
+            exits.push_back({site, target});
+        }
+        e.storeImm(kPcOff, target);
+        Emitter::bind(e.jmp32(), epilogue);
+    };
+    auto dst = [](int r) { return regOff(r == 0 ? kSink : r); };
+
+    for (int i = pc; i < pc + len; ++i) {
+        const Instruction& ins = code[i];
+        switch (ins.op) {
+            case Opcode::NOP:
+                break;
+            case Opcode::ADD:
+            case Opcode::SUB:
+            case Opcode::AND:
+            case Opcode::OR:
+            case Opcode::XOR: {
+                const uint8_t op = ins.op == Opcode::ADD ? 0x03
+                                 : ins.op == Opcode::SUB ? 0x2B
+                                 : ins.op == Opcode::AND ? 0x23
+                                 : ins.op == Opcode::OR  ? 0x0B
+                                 : 0x33;
+                e.load(EAX, regOff(ins.rs));
+                e.rbxMem(op, EAX, regOff(ins.rt));
+                e.store(EAX, dst(ins.rd));
+                break;
+            }
+            case Opcode::SLT:
+                e.load(EAX, regOff(ins.rs));
+                e.byte(0x31); e.byte(0xC9);           // xor ecx, ecx
+                e.rbxMem(0x3B, EAX, regOff(ins.rt));  // cmp eax, [rt]
+                e.byte(0x0F); e.byte(0x9C); e.byte(0xC1); // setl cl
+                e.store(ECX, dst(ins.rd));
+                break;
+            case Opcode::ADDI:
+            case Opcode::ANDI:
+            case Opcode::ORI:
+                e.load(EAX, regOff(ins.rs));
+                e.byte(ins.op == Opcode::ADDI ? 0x05 : ins.op == Opcode::ANDI ? 0x25 : 0x0D);
+                e.u32(static_cast<uint32_t>(ins.imm));
+                e.store(EAX, dst(ins.rt));
+                break;
+            case Opcode::LW:
+            case Opcode::SW:
+                e.byte(0x48); e.load(EDI, kMemOff);   // mov rdi, [mem]
+                e.load(ESI, regOff(ins.rs));
+                e.byte(0x81); e.byte(0xC6);           // add esi, imm32
+                e.u32(static_cast<uint32_t>(ins.imm));
+                if (ins.op == Opcode::LW) {
+                    e.callAbs(reinterpret_cast<const void*>(&jitLoad));
+                    e.store(EAX, dst(ins.rt));
+                } else {
+                    e.load(EDX, regOff(ins.rt));
+                    e.callAbs(reinterpret_cast<const void*>(&jitStore));
+                }
+                break;
+            case Opcode::BEQ:
+            case Opcode::BNE: {
+                e.load(EAX, regOff(ins.rs));
+                e.rbxMem(0x3B, EAX, regOff(ins.rt));
+                uint8_t* notTaken = e.jcc32(ins.op == Opcode::BEQ ? kJNE : kJE);
+                exitTo(i + 1 + ins.imm);
+                Emitter::bind(notTaken, e.here());
+                exitTo(i + 1);
+                break;
+            }
+            case Opcode::J:
+                exitTo(ins.addr);
+                break;
+            case Opcode::JAL:
+                e.storeImm(regOff(31), i + 1);
+                exitTo(ins.addr);
+                break;
+            case Opcode::JR:
+                // Indirect, the dispatcher looks the target up
+                e.load(EAX, regOff(ins.rs));
+                e.store(EAX, kPcOff);
+                Emitter::bind(e.jmp32(), epilogue);
+                break;
+        }
+    }
+    if (!endsBlock(code[pc + len - 1].op)) exitTo(pc + len);
+
+    Emitter::bind(bail, e.here());
+    e.storeImm(kPcOff, pc);
+    Emitter::bind(e.jmp32(), epilogue);
+
+    used += e.size();
+
+    blockAt[pc] = static_cast<int32_t>(blocks.size());
+    blocks.push_back({entry, len});
+
+    for (const auto& [site, target] : exits) {
+        const uint32_t off = static_cast<uint32_t>(site - buffer);
+        if (blockAt[target] >= 0) patch(off, blocks[blockAt[target]].entry);
+        else waiting[target].push_back(off);
+    }
+    for (uint32_t off : waiting[pc]) patch(off, entry);
+    waiting[pc].clear();
+
+    setWritable(false);
+    return &blocks[blockAt[pc]];
+}
+
+void JitCache::enter(JitContext& ctx, const Block* block) const {
+    using EntryFn = void (*)(JitContext*, const uint8_t*);
+    reinterpret_cast<EntryFn>(buffer)(&ctx, block->entry);
+}
+
+#else // !SCS_JIT_X86_64
+
+// No backend for this host, available() stays false and callers interpret
+JitCache::JitCache() {}
+JitCache::~JitCache() {}
+void JitCache::setWritable(bool) {}
+void JitCache::flush() {}
+void JitCache::patch(uint32_t, const uint8_t*) {}
+const JitCache::Block* JitCache::translate(int) { return nullptr; }
+void JitCache::enter(JitContext&, const Block*) const {}
+
+#endif
+
+void JitCache::invalidate(const Program& program) {
+    code.assign(program.begin(), program.end());
+    blockAt.assign(code.size(), -1);
+    waiting.assign(code.size(), {});
+    if (buffer) {
+        flush();
+        setWritable(false);
+    }
+}
+
+const JitCache::Block* JitCache::lookup(int pc) {
+    if (!buffer || pc < 0 || pc >= static_cast<int>(code.size())) return nullptr;
+    if (blockAt[pc] >= 0) return &blocks[blockAt[pc]];
+    return translate(pc);
+}
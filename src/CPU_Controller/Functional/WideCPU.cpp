@@ -0,0 +1,318 @@
+#include "WideCPU.hpp"
+#include "HazardUnit.hpp"
+#include "Memory.hpp"
+#include "WideKernel.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCS_WIDE_SSE2 1
+#else
+#define SCS_WIDE_SSE2 0
+#endif
+
+namespace {
+
+constexpr int kSink = 32;
+constexpr int kMaxVector = 8;   // widest kernel, lanes are padded to this
+
+// Bounded so the per-lane int32 counters cannot overflow within one kernel call
+constexpr uint64_t kChunk = 1u << 28;
+
+struct ScalarVec {
+    using T = int32_t;
+    static constexpr int W = 1;
+
+    static T load(const int32_t* p) { return *p; }
+    static void store(int32_t* p, T v) { *p = v; }
+    static T set1(int32_t x) { return x; }
+
+    static T add(T a, T b) { return (int32_t)((uint32_t)a + (uint32_t)b); }
+    static T sub(T a, T b) { return (int32_t)((uint32_t)a - (uint32_t)b); }
+    static T and_(T a, T b) { return a & b; }
+    static T or_(T a, T b) { return a | b; }
+    static T xor_(T a, T b) { return a ^ b; }
+    static T andnot(T a, T b) { return ~a & b; }
+
+    static T eq(T a, T b) { return a == b ? -1 : 0; }
+    static T gt(T a, T b) { return a > b ? -1 : 0; }
+    static T select(T m, T a, T b) { return m ? a : b; }
+    static bool none(T m) { return m == 0; }
+
+    static T min(T a, T b) { return a < b ? a : b; }
+    static int32_t hmin(T v) { return v; }
+
+    static T gather(const int32_t* base, T addr, T mask, int32_t stride) {
+        return mask ? base[addr * stride] : 0;
+    }
+};
+
+#if SCS_WIDE_SSE2
+struct Sse2Vec {
+    using T = __m128i;
+    static constexpr int W = 4;
+
+    static T load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(int32_t* p, T v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static T set1(int32_t x) { return _mm_set1_epi32(x); }
+
+    static T add(T a, T b) { return _mm_add_epi32(a, b); }
+    static T sub(T a, T b) { return _mm_sub_epi32(a, b); }
+    static T and_(T a, T b) { return _mm_and_si128(a, b); }
+    static T or_(T a, T b) { return _mm_or_si128(a, b); }
+    static T xor_(T a, T b) { return _mm_xor_si128(a, b); }
+    static T andnot(T a, T b) { return _mm_andnot_si128(a, b); }
+
+    static T eq(T a, T b) { return _mm_cmpeq_epi32(a, b); }
+    static T gt(T a, T b) { return _mm_cmpgt_epi32(a, b); }
+    // No blendv or pminsd before SSE4.1
+    static T select(T m, T a, T b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+    static bool none(T m) { return _mm_movemask_epi8(m) == 0; }
+
+    static T min(T a, T b) { return select(gt(a, b), b, a); }
+    static int32_t hmin(T v) {
+        v = min(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = min(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+
+    static T gather(const int32_t* base, T addr, T mask, int32_t stride) {
+        return gatherByLane<Sse2Vec>(base, addr, mask, stride);
+    }
+};
+#endif
+
+bool hostHasAvx2() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+WideKernelFn kernelFor(WideCPU::Kernel k) {
+    switch (k) {
+        case WideCPU::Kernel::Scalar: return &wideKernelScalar;
+        case WideCPU::Kernel::SSE2:   return wideKernelSse2();
+        case WideCPU::Kernel::AVX2:   return hostHasAvx2() ? wideKernelAvx2() : nullptr;
+        case WideCPU::Kernel::Auto:   break;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+uint64_t wideKernelScalar(const WideView& s) {
+    return lockstep<ScalarVec>(s);
+}
+
+int32_t wideFarLoad(const WideView& s, int lane, int32_t addr) {
+    return s.far[lane].read(addr);
+}
+
+void wideFarStore(const WideView& s, int lane, int32_t addr, int32_t value) {
+    s.far[lane].writeNext(addr, value);
+    s.far[lane].commit();
+}
+
+WideKernelFn wideKernelSse2() {
+#if SCS_WIDE_SSE2
+    return &lockstep<Sse2Vec>;
+#else
+    return nullptr;
+#endif
+}
+
+WideCPU::WideCPU(int lanes, size_t memWords)
+: laneCount(lanes)
+, stride((lanes + kMaxVector - 1) / kMaxVector * kMaxVector)
+, memWords(memWords)
+{
+    // Word offsets into the memory array are int32 in the kernels
+    if (lanes <= 0 || memWords == 0 || (uint64_t)memWords * (uint64_t)stride > INT32_MAX) {
+        throw std::runtime_error("WideCPU: unsupported lane count or memory size");
+    }
+
+    regs.assign((size_t)(kSink + 1) * stride, 0);
+    mem.assign(memWords * stride, 0);
+    pcs.assign(stride, 0);
+    lastLoad.assign(stride, 0);
+    retiredTotal.assign(stride, 0);
+    cyclesTotal.assign(stride, 0);
+    chunkBudget.assign(stride, 0);
+    chunkCycles.assign(stride, 0);
+    far.resize(stride);
+
+    setKernel(Kernel::Auto);
+}
+
+bool WideCPU::setKernel(Kernel kernel) {
+    if (kernel == Kernel::Auto) {
+        for (Kernel k : {Kernel::AVX2, Kernel::SSE2}) {
+            if (kernelFor(k)) { active = k; return true; }
+        }
+        active = Kernel::Scalar;
+        return true;
+    }
+    if (!kernelFor(kernel)) return false;
+    active = kernel;
+    return true;
+}
+
+const char* WideCPU::kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Auto:   return "auto";
+        case Kernel::Scalar: return "scalar";
+        case Kernel::SSE2:   return "sse2";
+        case Kernel::AVX2:   return "avx2";
+    }
+    return "?";
+}
+
+void WideCPU::loadProgram(const Program& program) {
+    instrMem = program;
+
+    ops.clear();
+    ops.reserve(program.size());
+    for (size_t i = 0; i < program.size(); ++i) {
+        const Instruction& ins = program[i];
+        WideOp op;
+        op.rs = ins.rs;
+        op.rt = ins.rt;
+        op.imm = ins.imm;
+
+        auto dest = [](int r) { return static_cast<uint8_t>(r == 0 ? kSink : r); };
+
+        switch (ins.op) {
+            case Opcode::NOP:  op.kind = W_NOP; break;
+            case Opcode::ADD:  op.kind = W_ADD; op.rd = dest(ins.rd); break;
+            case Opcode::SUB:  op.kind = W_SUB; op.rd = dest(ins.rd); break;
+            case Opcode::AND:  op.kind = W_AND; op.rd = dest(ins.rd); break;
+            case Opcode::OR:   op.kind = W_OR;  op.rd = dest(ins.rd); break;
+            case Opcode::XOR:  op.kind = W_XOR; op.rd = dest(ins.rd); break;
+            case Opcode::SLT:  op.kind = W_SLT; op.rd = dest(ins.rd); break;
+            case Opcode::ADDI: op.kind = W_ADDI; op.rd = dest(ins.rt); break;
+            case Opcode::ANDI: op.kind = W_ANDI; op.rd = dest(ins.rt); break;
+            case Opcode::ORI:  op.kind = W_ORI;  op.rd = dest(ins.rt); break;
+            case Opcode::LW:   op.kind = W_LW;   op.rd = dest(ins.rt); op.loadDest = ins.rt; break;
+            case Opcode::SW:   op.kind = W_SW; break;
+            case Opcode::BEQ:  op.kind = W_BEQ; op.imm = ins.index + 1 + ins.imm; break;
+            case Opcode::BNE:  op.kind = W_BNE; op.imm = ins.index + 1 + ins.imm; break;
+            case Opcode::J:    op.kind = W_J;   op.imm = ins.addr; break;
+            case Opcode::JAL:  op.kind = W_JAL; op.imm = ins.addr; break;
+            case Opcode::JR:   op.kind = W_JR; break;
+        }
+
+        // Same rule as the hazard unit, reduced to the registers that trigger it
+        if (ins.rs != 0 && HazardUnit::loadUseHazard(ins.rs, ins)) op.hazA = ins.rs;
+        if (ins.rt != 0 && HazardUnit::loadUseHazard(ins.rt, ins)) op.hazB = ins.rt;
+
+        ops.push_back(op);
+    }
+
+    std::fill(pcs.begin(), pcs.end(), 0);
+    std::fill(lastLoad.begin(), lastLoad.end(), 0);
+    std::fill(retiredTotal.begin(), retiredTotal.end(), 0);
+    std::fill(cyclesTotal.begin(), cyclesTotal.end(), 0);
+    loadData();
+}
+
+void WideCPU::reset(bool clearMemory) {
+    std::fill(regs.begin(), regs.end(), 0);
+    if (clearMemory) {
+        std::fill(mem.begin(), mem.end(), 0);
+        for (Memory& m : far) m.reset();
+        loadData();
+    }
+
+    std::fill(pcs.begin(), pcs.end(), 0);
+    std::fill(lastLoad.begin(), lastLoad.end(), 0);
+    std::fill(retiredTotal.begin(), retiredTotal.end(), 0);
+    std::fill(cyclesTotal.begin(), cyclesTotal.end(), 0);
+}
+
+uint64_t WideCPU::run(uint64_t maxInstrs) {
+    const WideKernelFn kernel = kernelFor(active);
+
+    WideView v;
+    v.ops = ops.data();
+    v.count = static_cast<int32_t>(ops.size());
+    v.stride = stride;
+    v.memWords = static_cast<int32_t>(memWords);
+    v.regs = regs.data();
+    v.mem = mem.data();
+    v.pc = pcs.data();
+    v.budget = chunkBudget.data();
+    v.cycles = chunkCycles.data();
+    v.lastLoad = lastLoad.data();
+    v.far = far.data();
+
+    uint64_t executed = 0;
+    while (maxInstrs > 0) {
+        const uint64_t chunk = std::min(maxInstrs, kChunk);
+        for (int l = 0; l < laneCount; ++l) chunkBudget[l] = static_cast<int32_t>(chunk);
+        std::fill(chunkCycles.begin(), chunkCycles.end(), 0);
+
+        kernel(v);
+
+        bool more = false;
+        for (int l = 0; l < laneCount; ++l) {
+            const uint64_t done = chunk - static_cast<uint64_t>(chunkBudget[l]);
+            retiredTotal[l] += done;
+            cyclesTotal[l] += static_cast<uint64_t>(chunkCycles[l]);
+            executed += done;
+            more |= (chunkBudget[l] == 0 && !isHalted(l));
+        }
+        if (!more) break;
+        maxInstrs -= chunk;
+    }
+    return executed;
+}
+
+bool WideCPU::isHalted(int lane) const {
+    return pcs[lane] < 0 || pcs[lane] >= static_cast<int>(ops.size());
+}
+
+bool WideCPU::allHalted() const {
+    for (int l = 0; l < laneCount; ++l) {
+        if (!isHalted(l)) return false;
+    }
+    return true;
+}
+
+uint64_t WideCPU::cycles(int lane) const {
+    // The first instruction takes the full depth of the pipeline to retire
+    return retiredTotal[lane] ? cyclesTotal[lane] + 4 : 0;
+}
+
+int WideCPU::getReg(int lane, int idx) const {
+    if (idx < 0 || idx > 31) return 0;
+    return regs[(size_t)idx * stride + lane];
+}
+
+void WideCPU::setReg(int lane, int idx, int value) {
+    if (idx <= 0 || idx > 31) return;
+    regs[(size_t)idx * stride + lane] = value;
+}
+
+int WideCPU::getMemWord(int lane, int addr) const {
+    if (addr < 0 || (size_t)addr >= memWords) return far[lane].read(addr);
+    return mem[(size_t)addr * stride + lane];
+}
+
+void WideCPU::loadData() {
+    instrMem.forEachDataWord([&](int addr, int value) {
+        for (int lane = 0; lane < laneCount; ++lane) setMemWord(lane, addr, value);
+    });
+}
+
+void WideCPU::setMemWord(int lane, int addr, int value) {
+    if (addr < 0 || (size_t)addr >= memWords) {
+        far[lane].writeNext(addr, value);
+        far[lane].commit();
+        return;
+    }
+    mem[(size_t)addr * stride + lane] = value;
+}
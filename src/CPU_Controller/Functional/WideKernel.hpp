@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdint>
+#include "WideCPU.hpp"
+
+class Memory;
+
+// Lockstep kernel shared by the scalar, SSE2 and AVX2 builds of WideCPU.
+// Only included by the kernel translation units: everything with code lives
+// in an anonymous namespace so a TU built with extra ISA flags cannot leak
+// its instantiations into the rest of the program.
+
+// Raw view of the WideCPU state handed to a kernel. Arrays are [row * stride + lane].
+struct WideView {
+    const WideOp* ops;
+    int32_t count;      // program length
+    int32_t stride;     // lanes including padding, a multiple of every vector width
+    int32_t memWords;
+
+    int32_t* regs;
+    int32_t* mem;
+    int32_t* pc;
+    int32_t* budget;    // instructions each lane may still retire, 0 for padding lanes
+    int32_t* cycles;    // timing model, accumulated
+    int32_t* lastLoad;
+    Memory* far;        // per-lane sparse memory behind the dense window of memWords
+};
+
+// Runs until no lane has budget left inside the program, returns the lockstep steps taken
+using WideKernelFn = uint64_t (*)(const WideView&);
+
+uint64_t wideKernelScalar(const WideView& s);
+WideKernelFn wideKernelSse2();   // nullptr where not compiled in
+WideKernelFn wideKernelAvx2();
+
+// Accesses outside the dense window. Defined out of line in WideCPU.cpp so the
+// ISA-flagged kernels never instantiate Memory's inline code themselves.
+int32_t wideFarLoad(const WideView& s, int lane, int32_t addr);
+void wideFarStore(const WideView& s, int lane, int32_t addr, int32_t value);
+
+namespace {
+
+// Lane-by-lane gather for ISAs without one. Masked-off lanes read 0.
+template <typename V>
+typename V::T gatherByLane(const int32_t* base, typename V::T addr, typename V::T mask, int32_t stride) {
+    alignas(32) int32_t a[V::W], m[V::W], out[V::W];
+    V::store(a, addr);
+    V::store(m, mask);
+    for (int j = 0; j < V::W; ++j) out[j] = m[j] ? base[a[j] * stride + j] : 0;
+    return V::load(out);
+}
+
+template <typename V>
+uint64_t lockstep(const WideView& s) {
+    using T = typename V::T;
+    constexpr int W = V::W;
+
+    const T zero = V::set1(0);
+    const T one = V::set1(1);
+    const T two = V::set1(2);
+    const T minusOne = V::set1(-1);
+    const T count = V::set1(s.count);
+    const T words = V::set1(s.memWords);
+    const T idle = V::set1(INT32_MAX);
+
+    // Lanes that can still run are keyed by pc, the rest sort last
+    auto key = [&](T pc, T budget) {
+        const T live = V::and_(V::and_(V::gt(pc, minusOne), V::gt(count, pc)), V::gt(budget, zero));
+        return V::select(live, pc, idle);
+    };
+
+    T lowest = idle;
+    for (int l = 0; l < s.stride; l += W) {
+        lowest = V::min(lowest, key(V::load(s.pc + l), V::load(s.budget + l)));
+    }
+    int32_t cur = V::hmin(lowest);
+
+    uint64_t steps = 0;
+    while (cur != INT32_MAX) {
+        const WideOp op = s.ops[cur];
+        const T at = V::set1(cur);
+        const T seq = V::set1(cur + 1);
+        const T imm = V::set1(op.imm);
+        const T hazA = V::set1(op.hazA);
+        const T hazB = V::set1(op.hazB);
+        const T loadDest = V::set1(op.loadDest);
+
+        int32_t* rd = s.regs + op.rd * s.stride;
+        int32_t* ra = s.regs + 31 * s.stride;
+        const int32_t* rs = s.regs + op.rs * s.stride;
+        const int32_t* rt = s.regs + op.rt * s.stride;
+
+        // Fold the next step's pc scan into this pass
+        lowest = idle;
+
+        for (int l = 0; l < s.stride; l += W) {
+            T pc = V::load(s.pc + l);
+            T budget = V::load(s.budget + l);
+            const T mask = V::and_(V::eq(pc, at), V::gt(budget, zero));
+            if (V::none(mask)) {
+                lowest = V::min(lowest, key(pc, budget));
+                continue;
+            }
+
+            auto write = [&](int32_t* row, T value) {
+                V::store(row + l, V::select(mask, value, V::load(row + l)));
+            };
+
+            T next = seq;
+            switch (op.kind) {
+                case W_NOP:  break;
+                case W_ADD:  write(rd, V::add(V::load(rs + l), V::load(rt + l))); break;
+                case W_SUB:  write(rd, V::sub(V::load(rs + l), V::load(rt + l))); break;
+                case W_AND:  write(rd, V::and_(V::load(rs + l), V::load(rt + l))); break;
+                case W_OR:   write(rd, V::or_(V::load(rs + l), V::load(rt + l))); break;
+                case W_XOR:  write(rd, V::xor_(V::load(rs + l), V::load(rt + l))); break;
+                case W_SLT:  write(rd, V::and_(V::gt(V::load(rt + l), V::load(rs + l)), one)); break;
+                case W_ADDI: write(rd, V::add(V::load(rs + l), imm)); break;
+                case W_ANDI: write(rd, V::and_(V::load(rs + l), imm)); break;
+                case W_ORI:  write(rd, V::or_(V::load(rs + l), imm)); break;
+                case W_LW: {
+                    const T addr = V::add(V::load(rs + l), imm);
+                    const T inRange = V::and_(V::gt(addr, minusOne), V::gt(words, addr));
+                    write(rd, V::gather(s.mem + l, addr, V::and_(mask, inRange), s.stride));
+
+                    const T outside = V::andnot(inRange, mask);
+                    if (!V::none(outside)) {
+                        alignas(32) int32_t a[W], m[W];
+                        V::store(a, addr);
+                        V::store(m, outside);
+                        for (int j = 0; j < W; ++j) {
+                            if (m[j]) rd[l + j] = wideFarLoad(s, l + j, a[j]);
+                        }
+                    }
+                    break;
+                }
+                case W_SW: {
+                    // No scatter below AVX-512, stores go lane by lane
+                    alignas(32) int32_t m[W];
+                    V::store(m, mask);
+                    for (int j = 0; j < W; ++j) {
+                        if (!m[j]) continue;
+                        const int32_t addr = (int32_t)((uint32_t)rs[l + j] + (uint32_t)op.imm);
+                        if (addr >= 0 && addr < s.memWords) s.mem[addr * s.stride + l + j] = rt[l + j];
+                        else wideFarStore(s, l + j, addr, rt[l + j]);
+                    }
+                    break;
+                }
+                case W_BEQ:  next = V::select(V::eq(V::load(rs + l), V::load(rt + l)), imm, seq); break;
+                case W_BNE:  next = V::select(V::eq(V::load(rs + l), V::load(rt + l)), seq, imm); break;
+                case W_J:    next = imm; break;
+                case W_JAL:  write(ra, seq); next = imm; break;
+                case W_JR:   next = V::load(rs + l); break;
+            }
+
+            // Pipeline timing: a cycle per instruction, one more behind a load
+            // it depends on and two for a taken transfer that stays in the program
+            const T last = V::load(s.lastLoad + l);
+            const T stall = V::and_(V::gt(last, zero), V::or_(V::eq(last, hazA), V::eq(last, hazB)));
+            const T inProgram = V::and_(V::gt(next, minusOne), V::gt(count, next));
+            const T taken = V::andnot(V::eq(next, seq), inProgram);
+            const T cost = V::add(one, V::add(V::and_(stall, one), V::and_(taken, two)));
+            V::store(s.cycles + l, V::add(V::load(s.cycles + l), V::and_(mask, cost)));
+            V::store(s.lastLoad + l, V::select(mask, loadDest, last));
+
+            pc = V::select(mask, next, pc);
+            budget = V::sub(budget, V::and_(mask, one));
+            V::store(s.pc + l, pc);
+            V::store(s.budget + l, budget);
+
+            lowest = V::min(lowest, key(pc, budget));
+        }
+
+        cur = V::hmin(lowest);
+        ++steps;
+    }
+    return steps;
+}
+
+} // namespace
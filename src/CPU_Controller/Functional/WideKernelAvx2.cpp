@@ -0,0 +1,58 @@
+// AVX2 build of the lockstep kernel. CMake compiles this file alone with
+// -mavx2; WideCPU only calls into it after checking the host at runtime.
+#include "WideKernel.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Vec {
+    using T = __m256i;
+    static constexpr int W = 8;
+
+    static T load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(int32_t* p, T v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static T set1(int32_t x) { return _mm256_set1_epi32(x); }
+
+    static T add(T a, T b) { return _mm256_add_epi32(a, b); }
+    static T sub(T a, T b) { return _mm256_sub_epi32(a, b); }
+    static T and_(T a, T b) { return _mm256_and_si256(a, b); }
+    static T or_(T a, T b) { return _mm256_or_si256(a, b); }
+    static T xor_(T a, T b) { return _mm256_xor_si256(a, b); }
+    static T andnot(T a, T b) { return _mm256_andnot_si256(a, b); }
+
+    static T eq(T a, T b) { return _mm256_cmpeq_epi32(a, b); }
+    static T gt(T a, T b) { return _mm256_cmpgt_epi32(a, b); }
+    static T select(T m, T a, T b) { return _mm256_blendv_epi8(b, a, m); }
+    static bool none(T m) { return _mm256_testz_si256(m, m) != 0; }
+
+    static T min(T a, T b) { return _mm256_min_epi32(a, b); }
+    static int32_t hmin(T v) {
+        __m128i x = _mm_min_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+        x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(x);
+    }
+
+    // Element j reads base[addr_j * stride + j], masked-off lanes read 0
+    static T gather(const int32_t* base, T addr, T mask, int32_t stride) {
+        const T lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const T idx = _mm256_add_epi32(_mm256_mullo_epi32(addr, _mm256_set1_epi32(stride)), lane);
+        return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, idx, mask, 4);
+    }
+};
+
+} // namespace
+
+WideKernelFn wideKernelAvx2() {
+    return &lockstep<Avx2Vec>;
+}
+
+#else
+
+WideKernelFn wideKernelAvx2() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "BranchPredictor.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+const char* predictorName(PredictorKind kind) {
+    switch (kind) {
+        case PredictorKind::NotTaken:      return "not-taken";
+        case PredictorKind::BackwardTaken: return "backward-taken";
+        case PredictorKind::Bimodal:       return "bimodal";
+        case PredictorKind::GShare:        return "gshare";
+    }
+    return "?";
+}
+
+std::optional<PredictorKind> parsePredictor(std::string_view name) {
+    for (PredictorKind k : {PredictorKind::NotTaken, PredictorKind::BackwardTaken,
+                            PredictorKind::Bimodal, PredictorKind::GShare}) {
+        if (name == predictorName(k)) return k;
+    }
+    return std::nullopt;
+}
+
+BranchPredictor::BranchPredictor()
+: BranchPredictor(PredictorConfig{})
+{
+}
+
+BranchPredictor::BranchPredictor(const PredictorConfig& config)
+: cfg(config)
+{
+    if (cfg.btbEntries & (cfg.btbEntries - 1)) {
+        throw std::runtime_error("BranchPredictor: BTB entries must be a power of two");
+    }
+    cfg.tableBits = std::min<uint32_t>(cfg.tableBits, 24);
+    cfg.historyBits = std::min<uint32_t>(cfg.historyBits, cfg.tableBits);
+    cfg.rasDepth = std::min<uint32_t>(cfg.rasDepth, 4096);
+
+    if (cfg.kind == PredictorKind::Bimodal || cfg.kind == PredictorKind::GShare) {
+        counters2.resize(size_t(1) << cfg.tableBits);
+    }
+    btb.resize(cfg.btbEntries);
+    ras.resize(cfg.rasDepth);
+    reset();
+}
+
+void BranchPredictor::reset() {
+    // Weakly not-taken, one taken outcome flips a fresh counter
+    std::fill(counters2.begin(), counters2.end(), 1);
+    std::fill(btb.begin(), btb.end(), BtbEntry{});
+    std::fill(ras.begin(), ras.end(), 0);
+    history = 0;
+    rasPtr = 0;
+    rasCount = 0;
+    counters = {};
+}
+
+uint32_t BranchPredictor::counterIndex(int pc) const {
+    const uint32_t mask = (1u << cfg.tableBits) - 1;
+    if (cfg.kind == PredictorKind::GShare) return (static_cast<uint32_t>(pc) ^ history) & mask;
+    return static_cast<uint32_t>(pc) & mask;
+}
+
+void BranchPredictor::push(int returnPc) {
+    if (ras.empty()) return;
+    ras[rasPtr] = returnPc;
+    rasPtr = static_cast<int16_t>((rasPtr + 1) % ras.size());
+    rasCount = static_cast<int16_t>(std::min<size_t>(rasCount + 1, ras.size()));
+}
+
+int BranchPredictor::pop() {
+    rasPtr = static_cast<int16_t>((rasPtr + ras.size() - 1) % ras.size());
+    rasCount--;
+    return ras[rasPtr];
+}
+
+Prediction BranchPredictor::predict(int pc) {
+    Prediction p;
+    p.nextPc = pc + 1;
+    p.rasPtr = rasPtr;
+    p.rasCount = rasCount;
+    if (btb.empty()) return p;
+
+    const BtbEntry& e = btb[static_cast<uint32_t>(pc) & (btb.size() - 1)];
+    if (e.pc != pc) return p;
+
+    switch (e.kind) {
+        case Kind::Branch: {
+            bool taken = false;
+            switch (cfg.kind) {
+                case PredictorKind::NotTaken:      break;
+                case PredictorKind::BackwardTaken: taken = e.target <= pc; break;
+                case PredictorKind::Bimodal:
+                case PredictorKind::GShare:
+                    p.counter = static_cast<int32_t>(counterIndex(pc));
+                    taken = counters2[p.counter] >= 2;
+                    break;
+            }
+            if (taken) p.nextPc = e.target;
+            break;
+        }
+        case Kind::Jump:
+            p.nextPc = e.target;
+            break;
+        case Kind::Call:
+            p.nextPc = e.target;
+            push(pc + 1);
+            break;
+        case Kind::Return:
+            // Without a return address the last target is the best guess
+            p.nextPc = rasCount > 0 ? pop() : e.target;
+            break;
+    }
+    return p;
+}
+
+void BranchPredictor::resolve(int pc, Kind kind, int actualNext, const Prediction& pred) {
+    const bool miss = actualNext != pred.nextPc;
+    switch (kind) {
+        case Kind::Branch: counters.branches++; counters.branchMispredicts += miss; break;
+        case Kind::Jump:
+        case Kind::Call:   counters.jumps++; counters.jumpMispredicts += miss; break;
+        case Kind::Return: counters.returns++; counters.returnMispredicts += miss; break;
+    }
+
+    // Wrong path: rewind the RAS to before this instruction and redo its own effect
+    if (miss && !ras.empty()) {
+        rasPtr = pred.rasPtr;
+        rasCount = pred.rasCount;
+        if (kind == Kind::Call) push(pc + 1);
+        else if (kind == Kind::Return && rasCount > 0) pop();
+    }
+
+    const bool taken = actualNext != pc + 1;
+    if (kind == Kind::Branch) {
+        if (!counters2.empty()) {
+            const uint32_t idx = pred.counter >= 0 ? static_cast<uint32_t>(pred.counter) : counterIndex(pc);
+            uint8_t& c = counters2[idx];
+            if (taken && c < 3) c++;
+            else if (!taken && c > 0) c--;
+        }
+        if (cfg.kind == PredictorKind::GShare) {
+            history = ((history << 1) | (taken ? 1u : 0u)) & ((1u << cfg.historyBits) - 1);
+        }
+    }
+
+    // Learn the target of anything that left the straight line
+    if (!btb.empty() && (taken || kind != Kind::Branch)) {
+        BtbEntry& e = btb[static_cast<uint32_t>(pc) & (btb.size() - 1)];
+        e.pc = pc;
+        e.target = actualNext;
+        e.kind = kind;
+    }
+}
@@ -1,19 +1,119 @@
 #include "HazardUnit.hpp"
 #include "PipelineRegisters.hpp"
+#include <initializer_list>
 
-HazardResult HazardUnit::detect(const IF_ID& if_id, const ID_EX& id_ex) {
+HazardResult HazardUnit::detect(const IF_ID& if_id, const ID_EX& id_ex, const EX_MEM& ex_mem,
+                                BranchStage branchStage) {
     HazardResult res;
 
-    if (!if_id.valid || !id_ex.valid)
+    if (!if_id.valid)
         return res;
 
-    auto readsRt = [&](const Instruction& ins) -> bool {
-        switch (ins.op) {
+    // The ID comparator only gets the EX/MEM ALU result and the write-back
+    // value: it waits one cycle behind an ALU result still in EX and two
+    // behind a load, whose data is not there before WB
+    if (branchStage == BranchStage::ID) {
+        const Instruction& ins = if_id.rawInstr;
+        const bool onEx = id_ex.valid && id_ex.ctrl.regWrite && branchReads(id_ex.ctrl.destReg, ins);
+        const bool onLoad = ex_mem.valid && ex_mem.ctrl.memRead && branchReads(ex_mem.ctrl.destReg, ins);
+        if (onEx || onLoad) {
+            res.stall = true;
+            res.branch = true;
+            return res;
+        }
+    }
+
+    if (!id_ex.valid)
+        return res;
+
+    // Classic load-use hazard
+    if (id_ex.ctrl.memRead && loadUseHazard(id_ex.ctrl.destReg, if_id.rawInstr)) {
+        res.stall = true;
+    }
+
+    return res;
+}
+
+HazardResult HazardUnit::detectPair(const PipelineRegisters& pipe) {
+    HazardResult res;
+
+    const IF_ID& older = pipe.if_id.cur();
+    const IF_ID& younger = pipe.if_id2.cur();
+    if (!older.valid)
+        return res;
+
+    // The issue check never pairs two memory operations, at most one lane holds a load
+    auto behindLoad = [&](const Instruction& ins) {
+        for (const ID_EX* ex : {&pipe.id_ex.cur(), &pipe.id_ex2.cur()}) {
+            if (ex->valid && ex->ctrl.memRead && loadUseHazard(ex->ctrl.destReg, ins)) return true;
+        }
+        return false;
+    };
+
+    if (behindLoad(older.rawInstr)) {
+        res.stall = true;
+        return res;
+    }
+    if (!younger.valid)
+        return res;
+
+    auto isMem = [](Opcode op) { return op == Opcode::LW || op == Opcode::SW; };
+    auto isTransfer = [](Opcode op) {
+        return op == Opcode::BEQ || op == Opcode::BNE || op == Opcode::J ||
+               op == Opcode::JAL || op == Opcode::JR;
+    };
+    const Instruction& a = older.rawInstr;
+    const Instruction& b = younger.rawInstr;
+    res.split = behindLoad(b) ||
+                loadUseHazard(destReg(a), b) ||
+                (isMem(a.op) && isMem(b.op)) ||
+                (isTransfer(a.op) && isTransfer(b.op));
+    return res;
+}
+
+int HazardUnit::destReg(const Instruction& ins) {
+    switch (ins.op) {
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::AND:
+        case Opcode::OR:
+        case Opcode::XOR:
+        case Opcode::SLT:
+            return ins.rd;
+        case Opcode::ADDI:
+        case Opcode::ANDI:
+        case Opcode::ORI:
+        case Opcode::LW:
+            return ins.rt;
+        case Opcode::JAL:
+            return 31;
+        default:
+            return -1;
+    }
+}
+
+bool HazardUnit::branchReads(int reg, const Instruction& ins) {
+    if (reg <= 0) return false;
+    switch (ins.op) {
+        case Opcode::BEQ:
+        case Opcode::BNE:
+            return reg == ins.rs || reg == ins.rt;
+        case Opcode::JR:
+            return reg == ins.rs;
+        default:
+            return false;
+    }
+}
+
+bool HazardUnit::loadUseHazard(int loadReg, const Instruction& ins) {
+    auto readsRt = [](const Instruction& in) -> bool {
+        switch (in.op) {
             // R-type ALU ops read rs and rt
             case Opcode::ADD:
             case Opcode::SUB:
             case Opcode::AND:
             case Opcode::OR:
+            case Opcode::XOR:
             case Opcode::SLT:
                 return true;
 
@@ -33,19 +133,8 @@ HazardResult HazardUnit::detect(const IF_ID& if_id, const ID_EX& id_ex) {
         }
     };
 
-    // Classic load-use hazard
-    if (id_ex.ctrl.memRead) {
-        const int loadReg = id_ex.ctrl.destReg;  // destination of LW
-        const int rs = if_id.rawInstr.rs;
-        const int rt = if_id.rawInstr.rt;
-
-        const bool usesRs = (rs != 0); // rs==0 is still a read but never hazzards
-        const bool usesRt = readsRt(if_id.rawInstr);
+    const bool usesRs = (ins.rs != 0); // rs==0 is still a read but never hazzards
+    const bool usesRt = readsRt(ins);
 
-        if (loadReg != 0 && ((usesRs && loadReg == rs) || (usesRt && loadReg == rt))) {
-            res.stall = true;
-        }
-    }
-
-    return res;
+    return loadReg != 0 && ((usesRs && loadReg == ins.rs) || (usesRt && loadReg == ins.rt));
 }
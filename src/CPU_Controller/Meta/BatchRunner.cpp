@@ -0,0 +1,132 @@
+#include "BatchRunner.hpp"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Per-worker job queue. The owner takes from the back, thieves from the front,
+// so they only meet on the last item.
+struct alignas(64) WorkQueue {
+    std::mutex lock;
+    std::deque<size_t> items;
+
+    bool popBack(size_t& out) {
+        std::lock_guard<std::mutex> g(lock);
+        if (items.empty()) return false;
+        out = items.back();
+        items.pop_back();
+        return true;
+    }
+
+    bool stealFront(size_t& out) {
+        std::lock_guard<std::mutex> g(lock);
+        if (items.empty()) return false;
+        out = items.front();
+        items.pop_front();
+        return true;
+    }
+};
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double secondsSince(int64_t ns) {
+    return double(now() - ns) * 1e-9;
+}
+
+} // namespace
+
+BatchRunner::BatchRunner(unsigned threads)
+: threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+, counters(new WorkerCounters[this->threads])
+{
+}
+
+void BatchRunner::onProgress(std::function<void(const BatchProgress&)> cb,
+                             std::chrono::milliseconds interval) {
+    progressCb = std::move(cb);
+    progressInterval = interval;
+}
+
+BatchProgress BatchRunner::progress() const {
+    BatchProgress p;
+    for (unsigned w = 0; w < threads; ++w) {
+        p.completedJobs += counters[w].jobs.load(std::memory_order_relaxed);
+        p.instructions += counters[w].instructions.load(std::memory_order_relaxed);
+    }
+    p.totalJobs = total.load(std::memory_order_relaxed);
+    const double frozen = elapsed.load(std::memory_order_acquire);
+    p.seconds = frozen >= 0.0 ? frozen : secondsSince(startedNs.load(std::memory_order_relaxed));
+    return p;
+}
+
+std::vector<SimResult> BatchRunner::run(const std::vector<SimJob>& jobs) {
+    std::vector<SimResult> results(jobs.size());
+    std::vector<WorkQueue> queues(threads);
+
+    // Contiguous slices keep neighbouring jobs (often the same program) on one worker
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        queues[i * threads / jobs.size()].items.push_back(i);
+    }
+    for (unsigned w = 0; w < threads; ++w) {
+        counters[w].jobs = 0;
+        counters[w].instructions = 0;
+    }
+    total = jobs.size();
+    active = threads;
+    const int64_t started = now();
+    startedNs.store(started, std::memory_order_relaxed);
+    elapsed.store(-1.0, std::memory_order_release);
+
+    auto worker = [&](unsigned self) {
+        size_t job;
+        for (;;) {
+            bool found = queues[self].popBack(job);
+            for (unsigned k = 1; !found && k < threads; ++k) {
+                found = queues[(self + k) % threads].stealFront(job);
+            }
+            // Queues only shrink, once every one is empty this worker is done
+            if (!found) break;
+
+            const SimJob& j = jobs[job];
+            // An exception must not leave the worker thread
+            try {
+                results[job] = simulate(*j.program, j.config, j.initMem);
+            } catch (const std::exception& e) {
+                results[job].error = e.what();
+            } catch (...) {
+                results[job].error = "unknown exception";
+            }
+
+            counters[self].instructions.fetch_add(results[job].instructions, std::memory_order_relaxed);
+            counters[self].jobs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::lock_guard<std::mutex> g(doneLock);
+        if (--active == 0) {
+            elapsed.store(secondsSince(started), std::memory_order_release);
+            doneCv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (unsigned w = 0; w < threads; ++w) pool.emplace_back(worker, w);
+
+    if (progressCb) {
+        std::unique_lock<std::mutex> g(doneLock);
+        while (!doneCv.wait_for(g, progressInterval, [&] { return active == 0; })) {
+            g.unlock();
+            progressCb(progress());
+            g.lock();
+        }
+    }
+    for (auto& t : pool) t.join();
+
+    return results;
+}
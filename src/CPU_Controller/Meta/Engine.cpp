@@ -0,0 +1,122 @@
+#include "Engine.hpp"
+#include "CPU.hpp"
+#include "FunctionalCPU.hpp"
+#include "OoOCPU.hpp"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+class PipelineEngine : public Engine {
+public:
+    explicit PipelineEngine(const SimConfig& cfg) {
+        if (cfg.caches) cpu.setCaches(*cfg.caches);
+        cpu.setPredictor(cfg.predictor);
+        cpu.setBranchStage(cfg.branchStage);
+        cpu.setIssueWidth(cfg.issueWidth);
+        if (!cfg.tracePath.empty()) cpu.enableTrace(cfg.tracePath);
+    }
+
+    EngineKind kind() const override { return EngineKind::Pipeline; }
+    void loadProgram(const Program& program) override { cpu.loadProgram(program); }
+    void reset(bool clearMemory) override { cpu.reset(clearMemory); }
+    void run(uint64_t limit) override {
+        // CPU::clock is an int, the limit must not pass where it would overflow
+        limit = std::min<uint64_t>(limit, INT_MAX);
+        while (!cpu.isHalted() && (uint64_t)cpu.clock < limit) cpu.tick();
+        // The trace covers one run, closing it is where a write error shows
+        cpu.disableTrace();
+    }
+    bool isHalted() const override { return cpu.isHalted(); }
+    uint64_t instructions() const override { return cpu.retired; }
+    bool hasCycles() const override { return true; }
+    uint64_t cycles() const override { return (uint64_t)cpu.clock; }
+    int getReg(int idx) const override { return cpu.getReg(idx); }
+    int getMemWord(int addr) const override { return cpu.getMemWord(addr); }
+    void setMemWord(int addr, int value) override { cpu.setMemWord(addr, value); }
+
+    void report(SimResult& res) const override {
+        res.hasStats = kPerfCounters;
+        res.stats = cpu.stats();
+        res.hasPredictor = true;
+        res.predictor = cpu.branchPredictor().stats();
+        if (const CacheHierarchy* c = cpu.caches()) {
+            c->forEachLevel([&](const char* name, const CacheStats& st) { res.cacheStats.push_back({name, st}); });
+        }
+    }
+
+private:
+    CPU cpu;
+};
+
+class FunctionalEngine : public Engine {
+public:
+    explicit FunctionalEngine(bool jit) {
+        if (jit) iss.setBackend(FunctionalCPU::Backend::Jit);
+    }
+
+    EngineKind kind() const override {
+        return iss.backend() == FunctionalCPU::Backend::Jit ? EngineKind::JIT : EngineKind::ISS;
+    }
+    void loadProgram(const Program& program) override { iss.loadProgram(program); }
+    void reset(bool clearMemory) override { iss.reset(clearMemory); }
+    void run(uint64_t limit) override {
+        if (iss.retired < limit) iss.run(limit - iss.retired);
+    }
+    bool isHalted() const override { return iss.isHalted(); }
+    uint64_t instructions() const override { return iss.retired; }
+    bool hasCycles() const override { return false; }
+    uint64_t cycles() const override { return 0; }
+    int getReg(int idx) const override { return iss.getReg(idx); }
+    int getMemWord(int addr) const override { return iss.getMemWord(addr); }
+    void setMemWord(int addr, int value) override { iss.setMemWord(addr, value); }
+    void report(SimResult&) const override {}
+
+private:
+    FunctionalCPU iss;
+};
+
+class OoOEngine : public Engine {
+public:
+    explicit OoOEngine(const SimConfig& cfg)
+    : core(cfg.ooo, cfg.predictor)
+    {
+    }
+
+    EngineKind kind() const override { return EngineKind::OoO; }
+    void loadProgram(const Program& program) override { core.loadProgram(program); }
+    void reset(bool clearMemory) override { core.reset(clearMemory); }
+    void run(uint64_t limit) override { core.run(limit); }
+    bool isHalted() const override { return core.isHalted(); }
+    uint64_t instructions() const override { return core.retired; }
+    bool hasCycles() const override { return true; }
+    uint64_t cycles() const override { return core.clock; }
+    int getReg(int idx) const override { return core.getReg(idx); }
+    int getMemWord(int addr) const override { return core.getMemWord(addr); }
+    void setMemWord(int addr, int value) override { core.setMemWord(addr, value); }
+
+    void report(SimResult& res) const override {
+        res.hasOoO = true;
+        res.ooo = core.stats();
+    }
+
+private:
+    OoOCPU core;
+};
+
+} // namespace
+
+std::unique_ptr<Engine> makeEngine(const SimConfig& cfg) {
+    switch (cfg.engine) {
+        case EngineKind::Pipeline: return std::make_unique<PipelineEngine>(cfg);
+        case EngineKind::ISS:      return std::make_unique<FunctionalEngine>(false);
+        case EngineKind::JIT:      return std::make_unique<FunctionalEngine>(true);
+        case EngineKind::OoO:      return std::make_unique<OoOEngine>(cfg);
+        case EngineKind::Sampled:
+        case EngineKind::Wide:
+            break;
+    }
+    throw std::runtime_error(std::string("makeEngine: no single-machine engine for ") + engineName(cfg.engine));
+}
@@ -0,0 +1,208 @@
+#include "MipsDecoder.hpp"
+#include "MappedFile.hpp"
+#include "ProgramLoader.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Fields of a MIPS32 word
+uint32_t opField(uint32_t w)    { return w >> 26; }
+uint8_t  rsField(uint32_t w)    { return (w >> 21) & 31; }
+uint8_t  rtField(uint32_t w)    { return (w >> 16) & 31; }
+uint8_t  rdField(uint32_t w)    { return (w >> 11) & 31; }
+uint32_t shamtField(uint32_t w) { return (w >> 6) & 31; }
+uint32_t functField(uint32_t w) { return w & 63; }
+int32_t  simm(uint32_t w)       { return static_cast<int16_t>(w & 0xffff); }
+int32_t  zimm(uint32_t w)       { return static_cast<int32_t>(w & 0xffff); }
+
+struct Name {
+    uint32_t code;
+    const char* name;
+};
+
+// Names for messages about words that do not decode, supported ones included
+constexpr Name kSpecial[] = {
+    {0x00, "sll"}, {0x02, "srl"}, {0x03, "sra"}, {0x04, "sllv"}, {0x06, "srlv"}, {0x07, "srav"},
+    {0x08, "jr"}, {0x09, "jalr"}, {0x0c, "syscall"}, {0x0d, "break"},
+    {0x10, "mfhi"}, {0x11, "mthi"}, {0x12, "mflo"}, {0x13, "mtlo"},
+    {0x18, "mult"}, {0x19, "multu"}, {0x1a, "div"}, {0x1b, "divu"},
+    {0x20, "add"}, {0x21, "addu"}, {0x22, "sub"}, {0x23, "subu"},
+    {0x24, "and"}, {0x25, "or"}, {0x26, "xor"}, {0x27, "nor"}, {0x2a, "slt"}, {0x2b, "sltu"},
+};
+constexpr Name kPrimary[] = {
+    {0x01, "regimm"}, {0x02, "j"}, {0x03, "jal"}, {0x04, "beq"}, {0x05, "bne"}, {0x06, "blez"}, {0x07, "bgtz"},
+    {0x08, "addi"}, {0x09, "addiu"}, {0x0a, "slti"}, {0x0b, "sltiu"},
+    {0x0c, "andi"}, {0x0d, "ori"}, {0x0e, "xori"}, {0x0f, "lui"},
+    {0x10, "cop0"}, {0x11, "cop1"}, {0x1c, "special2"}, {0x1f, "special3"},
+    {0x20, "lb"}, {0x21, "lh"}, {0x23, "lw"}, {0x24, "lbu"}, {0x25, "lhu"},
+    {0x28, "sb"}, {0x29, "sh"}, {0x2b, "sw"},
+};
+
+template <size_t N>
+const char* lookup(const Name (&table)[N], uint32_t code) {
+    for (const Name& n : table) {
+        if (n.code == code) return n.name;
+    }
+    return "unknown";
+}
+
+std::string hex(uint32_t v) {
+    char buf[11];
+    std::snprintf(buf, sizeof(buf), "0x%08x", v);
+    return buf;
+}
+
+} // namespace
+
+bool MipsDecoder::decode(uint32_t word, uint32_t pc, Instruction& out) const {
+    Instruction ins;
+    const uint32_t op = opField(word);
+
+    if (op == 0) {
+        // R-type. Shifts into $0 are the nop family (nop, ssnop, ehb), any
+        // other shift amount is a shift the pipeline does not have
+        const uint32_t funct = functField(word);
+        if (funct <= 0x03 && funct != 0x01 && rdField(word) == 0) {
+            out = ins;
+            return true;
+        }
+        if (shamtField(word) != 0) return false;
+        switch (funct) {
+            case 0x20: case 0x21: ins.op = Opcode::ADD; break;
+            case 0x22: case 0x23: ins.op = Opcode::SUB; break;
+            case 0x24: ins.op = Opcode::AND; break;
+            case 0x25: ins.op = Opcode::OR;  break;
+            case 0x26: ins.op = Opcode::XOR; break;
+            case 0x2a: ins.op = Opcode::SLT; break;
+            case 0x08:
+                // jr rs, the hint and the other fields are zero
+                if (word & 0x001fffc0) return false;
+                ins.op = Opcode::JR;
+                ins.rs = rsField(word);
+                out = ins;
+                return true;
+            default: return false;
+        }
+        ins.rs = rsField(word);
+        ins.rt = rtField(word);
+        ins.rd = rdField(word);
+        out = ins;
+        return true;
+    }
+
+    if (op == 0x02 || op == 0x03) {
+        // J-type, the target keeps the 256 MB region of the delay slot
+        const uint32_t target = ((pc + 4) & 0xf0000000u) | ((word & 0x03ffffffu) << 2);
+        if (target < base) return false;
+        ins.op = op == 0x02 ? Opcode::J : Opcode::JAL;
+        ins.addr = static_cast<int32_t>(index(target));
+        out = ins;
+        return true;
+    }
+
+    // I-type
+    ins.rs = rsField(word);
+    ins.rt = rtField(word);
+    switch (op) {
+        case 0x08: case 0x09: ins.op = Opcode::ADDI; ins.imm = simm(word); break;
+        case 0x0c: ins.op = Opcode::ANDI; ins.imm = zimm(word); break;
+        case 0x0d: ins.op = Opcode::ORI;  ins.imm = zimm(word); break;
+        case 0x23: ins.op = Opcode::LW;   ins.imm = simm(word); break;
+        case 0x2b: ins.op = Opcode::SW;   ins.imm = simm(word); break;
+        // Offsets count instructions after the branch, as the pipeline does
+        case 0x04: ins.op = Opcode::BEQ;  ins.imm = simm(word); break;
+        case 0x05: ins.op = Opcode::BNE;  ins.imm = simm(word); break;
+        default: return false;
+    }
+    out = ins;
+    return true;
+}
+
+const char* MipsDecoder::mnemonic(uint32_t word) {
+    return opField(word) == 0 ? lookup(kSpecial, functField(word)) : lookup(kPrimary, opField(word));
+}
+
+bool MipsFormat::parseByteOrder(const std::string& s) {
+    if (s != "be" && s != "le") return false;
+    bigEndian = s == "be";
+    return true;
+}
+
+bool MipsFormat::parseBase(const std::string& s) {
+    if (s.empty() || s[0] == '-') return false;
+    char* end = nullptr;
+    const unsigned long long v = std::strtoull(s.c_str(), &end, 0);
+    if (!end || *end != '\0' || v > UINT32_MAX || v % 4) return false;
+    base = static_cast<uint32_t>(v);
+    return true;
+}
+
+Program ProgramLoader::decodeBinary(const uint8_t* bytes, size_t size, const MipsFormat& format) {
+    if (format.base % 4) throw std::runtime_error("MIPS load address " + hex(format.base) + " is not word aligned");
+    if (size % 4) throw std::runtime_error("MIPS binary size " + std::to_string(size) + " is not a whole number of words");
+    if (size / 4 > (0x100000000ull - format.base) / 4) throw std::runtime_error("MIPS binary does not fit the address space");
+
+    // Decoded once, in pc order, so instruction (pc - base) / 4 is the word at pc
+    const MipsDecoder decoder(format.base);
+    const size_t words = size / 4;
+    Program program;
+    program.reserve(words, 0);
+
+    constexpr size_t kMaxReported = 50;
+    std::string errors;
+    size_t errorCount = 0;
+    for (size_t i = 0; i < words; ++i) {
+        const uint8_t* b = bytes + i * 4;
+        const uint32_t word = format.bigEndian
+            ? uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 | b[3]
+            : uint32_t(b[3]) << 24 | uint32_t(b[2]) << 16 | uint32_t(b[1]) << 8 | b[0];
+        const uint32_t pc = format.base + static_cast<uint32_t>(i * 4);
+
+        // Jumps and branches must stay in the code, a wrong base moves every
+        // jump out of it
+        Instruction ins;
+        const char* problem = nullptr;
+        if (!decoder.decode(word, pc, ins)) {
+            problem = (word >> 26) == 0x02 || (word >> 26) == 0x03 ? ": jump outside the code " : ": unsupported instruction ";
+        } else if ((ins.op == Opcode::J || ins.op == Opcode::JAL) && static_cast<size_t>(ins.addr) >= words) {
+            problem = ": jump outside the code ";
+        } else if ((ins.op == Opcode::BEQ || ins.op == Opcode::BNE) &&
+                   static_cast<uint64_t>(static_cast<int64_t>(i) + 1 + ins.imm) >= words) {
+            problem = ": branch outside the code ";
+        }
+        if (problem) {
+            if (errorCount++ < kMaxReported) {
+                if (!errors.empty()) errors += '\n';
+                errors += hex(pc) + problem + hex(word) + " (" + MipsDecoder::mnemonic(word) + ")";
+            }
+            continue;
+        }
+        program.append(ins);
+    }
+
+    if (errorCount) {
+        if (errorCount > kMaxReported) errors += "\n... " + std::to_string(errorCount - kMaxReported) + " more errors";
+        throw std::runtime_error(errors);
+    }
+    return program;
+}
+
+Program ProgramLoader::loadBinary(const std::string& path, const MipsFormat& format) {
+    MappedFile file = [&] {
+        try {
+            return MappedFile(path);
+        } catch (const std::runtime_error&) {
+            throw std::runtime_error("Could not open program file: " + path);
+        }
+    }();
+    try {
+        return decodeBinary(file.data(), file.size(), format);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("MIPS binary " + path + ":\n" + e.what());
+    }
+}
@@ -0,0 +1,197 @@
+#include "MultiCoreSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Sense-reversing barrier: the last thread in resets the count and starts
+// the next generation, the others spin on the generation number
+class SpinBarrier {
+public:
+    explicit SpinBarrier(unsigned n) : count(n), total(n) {}
+
+    void wait() {
+        const unsigned gen = generation.load(std::memory_order_acquire);
+        if (count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            count.store(total, std::memory_order_relaxed);
+            generation.store(gen + 1, std::memory_order_release);
+            return;
+        }
+        // Yield once the wait gets long, the host may have fewer cores than threads
+        for (unsigned spins = 0; generation.load(std::memory_order_acquire) == gen; ++spins) {
+            if (spins >= 1024) std::this_thread::yield();
+        }
+    }
+
+private:
+    alignas(64) std::atomic<unsigned> count;
+    alignas(64) std::atomic<unsigned> generation{0};
+    unsigned total;
+};
+
+} // namespace
+
+MultiCoreSystem::MultiCoreSystem(const MultiCoreConfig& config)
+: cfg(config)
+, snoopBus(config.cores, config.coherence)
+, views(config.threads > 1 || config.quantum > 1)
+, lanes(static_cast<size_t>(std::max(config.cores, 0)))
+{
+    if (cfg.threads == 0 || cfg.quantum == 0) {
+        throw std::runtime_error("MultiCoreSystem: threads and quantum must be non-zero");
+    }
+    snoopBus.setLax(cfg.quantum > 1);
+    for (int i = 0; i < cfg.cores; ++i) {
+        if (views) lanes[i].view.setBase(&mem);
+        cpus.push_back(std::make_unique<CPU>());
+        cpus.back()->attachShared(views ? lanes[i].view : mem, snoopBus, i, &lanes[i].outbound, !views);
+    }
+    entries.assign(cpus.size(), 0);
+}
+
+void MultiCoreSystem::loadProgram(const Program& program, const std::vector<int>& entryPcs) {
+    for (int i = 0; i < cores(); ++i) {
+        cpus[i]->loadProgram(program);
+        entries[i] = i < static_cast<int>(entryPcs.size()) ? entryPcs[i] : 0;
+    }
+    // A core loading its data may only reach its view, which reset drops
+    program.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    reset(false);
+}
+
+void MultiCoreSystem::loadProgram(int core, const Program& program, int entryPc) {
+    cpus[core]->loadProgram(program);
+    entries[core] = entryPc;
+    program.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    reset(false);
+}
+
+void MultiCoreSystem::reset(bool clearMemory) {
+    // The bus times every core against one clock, so all of them restart together
+    for (int i = 0; i < cores(); ++i) {
+        cpus[i]->reset(false);
+        cpus[i]->pc = entries[i];
+        lanes[i].outbound.clear();
+        lanes[i].view.reset();
+    }
+    if (clearMemory) {
+        mem.reset();
+        for (auto& cpu : cpus) cpu->program().forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    }
+    snoopBus.reset();
+    clock = 0;
+}
+
+void MultiCoreSystem::runCores(int first, int stride, uint64_t end) {
+    for (int c = first; c < cores(); c += stride) {
+        CPU& cpu = *cpus[c];
+        if (lanes[c].stale) {
+            lanes[c].view.reset();
+            lanes[c].stale = false;
+        }
+        while (!cpu.isHalted() && static_cast<uint64_t>(cpu.clock) < end) cpu.tick();
+    }
+}
+
+void MultiCoreSystem::sync() {
+    // Stores in (cycle, core) order, so the latest one to a word wins
+    merged.clear();
+    int writers = 0;
+    int writer = -1;
+    for (int c = 0; c < cores(); ++c) {
+        std::vector<MemWrite>& out = lanes[c].outbound;
+        if (out.empty()) continue;
+        writers++;
+        writer = c;
+        for (const MemWrite& w : out) merged.emplace_back(c, w);
+        out.clear();
+    }
+    if (writers > 1) {
+        std::stable_sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) {
+            return a.second.cycle < b.second.cycle;
+        });
+    }
+    for (const auto& m : merged) {
+        mem.writeNext(m.second.addr, m.second.value);
+        mem.commit();
+    }
+
+    snoopBus.resolve();
+
+    // A view is stale once another core stored; its own stores are in it already
+    if (views && writers > 0) {
+        for (int c = 0; c < cores(); ++c) lanes[c].stale = writers > 1 || c != writer;
+    }
+
+    for (const auto& cpu : cpus) clock = std::max(clock, static_cast<uint64_t>(cpu->clock));
+}
+
+void MultiCoreSystem::tick() {
+    runCores(0, 1, clock + 1);
+    sync();
+}
+
+void MultiCoreSystem::run(uint64_t maxCycles) {
+    // The cores count cycles in CPU::clock, an int
+    maxCycles = std::min<uint64_t>(maxCycles, INT_MAX);
+    const unsigned workers = std::min<unsigned>(cfg.threads, static_cast<unsigned>(cores()));
+    if (workers <= 1) {
+        while (!isHalted() && clock < maxCycles) {
+            runCores(0, 1, std::min<uint64_t>(clock + cfg.quantum, maxCycles));
+            sync();
+        }
+        return;
+    }
+
+    // The calling thread is worker 0 and runs the serial part between barriers
+    SpinBarrier barrier(workers);
+    uint64_t end = 0;
+    bool stop = false;
+    auto worker = [&](unsigned self) {
+        for (;;) {
+            barrier.wait();
+            if (stop) return;
+            runCores(static_cast<int>(self), static_cast<int>(workers), end);
+            barrier.wait();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < workers; ++w) pool.emplace_back(worker, w);
+    for (;;) {
+        stop = isHalted() || clock >= maxCycles;
+        end = std::min<uint64_t>(clock + cfg.quantum, maxCycles);
+        barrier.wait();
+        if (stop) break;
+        runCores(0, static_cast<int>(workers), end);
+        barrier.wait();
+        sync();
+    }
+    for (auto& t : pool) t.join();
+}
+
+bool MultiCoreSystem::isHalted() const {
+    for (const auto& cpu : cpus) {
+        if (!cpu->isHalted()) return false;
+    }
+    return true;
+}
+
+uint64_t MultiCoreSystem::retired() const {
+    uint64_t n = 0;
+    for (const auto& cpu : cpus) n += cpu->retired;
+    return n;
+}
+
+int MultiCoreSystem::getMemWord(int addr) const {
+    return mem.read(addr);
+}
+
+void MultiCoreSystem::setMemWord(int addr, int value) {
+    mem.writeNext(addr, value);
+    mem.commit();
+    for (Lane& l : lanes) l.stale = true;
+}
@@ -0,0 +1,168 @@
+#include "Program.hpp"
+#include <mutex>
+
+struct Program::Tables {
+    std::vector<Instruction> code;
+    std::string textPool;
+    std::vector<uint32_t> textOffset;
+    std::vector<DataSegment> segments;
+    std::vector<int32_t> words;
+};
+
+struct Program::Disassembly {
+    std::once_flag once;
+    std::string pool;
+    std::vector<uint32_t> offset;
+};
+
+Program::Program(const std::vector<Instruction>& code) {
+    Tables& t = own();
+    t.code.reserve(code.size());
+    t.textOffset.reserve(code.size());
+    for (const Instruction& ins : code) append(ins);
+}
+
+Program Program::view(const View& tables, std::shared_ptr<const void> storage) {
+    Program p;
+    p.storage = std::move(storage);
+    p.code = tables.code;
+    p.count = tables.count;
+    if (tables.textOffset) {
+        p.textPool = tables.textPool;
+        p.textOffset = tables.textOffset;
+        p.texts = tables.count;
+        p.textBytes = tables.textBytes;
+    } else {
+        p.disassembly = std::make_shared<Disassembly>();
+    }
+    p.segments = tables.segments;
+    p.segmentCount = tables.segmentCount;
+    p.words = tables.words;
+    return p;
+}
+
+Program::Tables& Program::own() {
+    if (owned && owned.use_count() == 1) return *owned;
+
+    auto t = std::make_shared<Tables>();
+    t->code.assign(code, code + count);
+    t->textOffset.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        t->textOffset.push_back(static_cast<uint32_t>(t->textPool.size()));
+        t->textPool += text(static_cast<int>(i));
+        t->textPool.push_back('\0');
+    }
+    t->segments.assign(segments, segments + segmentCount);
+    for (size_t s = 0; s < segmentCount; ++s) {
+        t->segments[s].offset = static_cast<uint32_t>(t->words.size());
+        t->words.insert(t->words.end(), words + segments[s].offset, words + segments[s].offset + segments[s].words);
+    }
+
+    owned = std::move(t);
+    storage.reset();
+    disassembly.reset();
+    bind(*owned);
+    return *owned;
+}
+
+void Program::bind(const Tables& t) {
+    code = t.code.data();
+    count = t.code.size();
+    textPool = t.textPool.data();
+    textOffset = t.textOffset.data();
+    texts = t.textOffset.size();
+    textBytes = t.textPool.size();
+    segments = t.segments.data();
+    segmentCount = t.segments.size();
+    words = t.words.data();
+}
+
+void Program::append(Instruction ins, std::string_view text) {
+    Tables& t = own();
+    ins.index = static_cast<int32_t>(t.code.size());
+    t.code.push_back(ins);
+
+    t.textOffset.push_back(static_cast<uint32_t>(t.textPool.size()));
+    if (text.empty()) t.textPool += disassemble(ins);
+    else t.textPool.append(text.data(), text.size());
+    t.textPool.push_back('\0');
+    bind(t);
+}
+
+void Program::patch(size_t idx, Instruction ins) {
+    Tables& t = own();
+    ins.index = static_cast<int32_t>(idx);
+    t.code[idx] = ins;
+}
+
+void Program::reserve(size_t instructions, size_t textBytes) {
+    Tables& t = own();
+    t.code.reserve(t.code.size() + instructions);
+    t.textOffset.reserve(t.textOffset.size() + instructions);
+    t.textPool.reserve(t.textPool.size() + textBytes);
+    bind(t);
+}
+
+void Program::appendData(int32_t address, const std::vector<int32_t>& data) {
+    Tables& t = own();
+    t.segments.push_back({address, static_cast<uint32_t>(t.words.size()), static_cast<uint32_t>(data.size())});
+    t.words.insert(t.words.end(), data.begin(), data.end());
+    bind(t);
+}
+
+const char* Program::text(int idx) const {
+    if (idx < 0 || (size_t)idx >= count) return "";
+    if (texts == count) return textOffset[idx] < textBytes ? textPool + textOffset[idx] : "";
+
+    // A view without text: disassemble the whole program the first time
+    Disassembly& d = *disassembly;
+    std::call_once(d.once, [&] {
+        d.offset.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            d.offset.push_back(static_cast<uint32_t>(d.pool.size()));
+            d.pool += disassemble(code[i]);
+            d.pool.push_back('\0');
+        }
+    });
+    return d.pool.c_str() + d.offset[idx];
+}
+
+std::string disassemble(const Instruction& ins) {
+    auto reg = [](int r) { return "$" + std::to_string(r); };
+
+    auto rtype = [&](const char* m) {
+        return std::string(m) + " " + reg(ins.rd) + ", " + reg(ins.rs) + ", " + reg(ins.rt);
+    };
+    auto itype = [&](const char* m) {
+        return std::string(m) + " " + reg(ins.rt) + ", " + reg(ins.rs) + ", " + std::to_string(ins.imm);
+    };
+    auto memop = [&](const char* m) {
+        return std::string(m) + " " + reg(ins.rt) + ", " + std::to_string(ins.imm) + "(" + reg(ins.rs) + ")";
+    };
+    auto branch = [&](const char* m) {
+        // The loader takes absolute indices, print one when the position is known
+        const int target = ins.index >= 0 ? ins.index + 1 + ins.imm : ins.imm;
+        return std::string(m) + " " + reg(ins.rs) + ", " + reg(ins.rt) + ", " + std::to_string(target);
+    };
+
+    switch (ins.op) {
+        case Opcode::NOP:  return "nop";
+        case Opcode::ADD:  return rtype("add");
+        case Opcode::SUB:  return rtype("sub");
+        case Opcode::AND:  return rtype("and");
+        case Opcode::OR:   return rtype("or");
+        case Opcode::XOR:  return rtype("xor");
+        case Opcode::SLT:  return rtype("slt");
+        case Opcode::JR:   return "jr " + reg(ins.rs);
+        case Opcode::ADDI: return itype("addi");
+        case Opcode::ANDI: return itype("andi");
+        case Opcode::ORI:  return itype("ori");
+        case Opcode::LW:   return memop("lw");
+        case Opcode::SW:   return memop("sw");
+        case Opcode::BEQ:  return branch("beq");
+        case Opcode::BNE:  return branch("bne");
+        case Opcode::J:    return "j " + std::to_string(ins.addr);
+        case Opcode::JAL:  return "jal " + std::to_string(ins.addr);
+    }
+    return "???";
+}
@@ -0,0 +1,221 @@
+#include "ProgramLoader.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+static_assert(std::is_trivially_copyable<Instruction>::value, "images store Instruction as raw bytes");
+static_assert(std::is_trivially_copyable<Program::DataSegment>::value, "images store DataSegment as raw bytes");
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'C', 'S', 'I', 'M', 'A', 'G', 'E'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kByteOrder = 0x01020304;
+constexpr uint64_t kAlign = 64;
+
+enum Kind : uint32_t {
+    kInstructions = 1,
+    kTextOffsets = 2,
+    kTextPool = 3,
+    kDataSegments = 4,
+    kDataWords = 5,
+    kKinds
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t instructionBytes;
+    uint32_t sections;
+    uint64_t fileBytes;
+};
+
+struct Section {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+};
+
+uint64_t elementBytes(uint32_t kind) {
+    switch (kind) {
+        case kInstructions: return sizeof(Instruction);
+        case kTextOffsets:  return sizeof(uint32_t);
+        case kTextPool:     return 1;
+        case kDataSegments: return sizeof(Program::DataSegment);
+        case kDataWords:    return sizeof(int32_t);
+    }
+    return 1;
+}
+
+// The file is held by every copy of the loaded program
+struct Image {
+    explicit Image(const std::string& path) : file(path) {}
+    MappedFile file;
+};
+
+} // namespace
+
+bool ProgramLoader::isImage(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+Program ProgramLoader::loadImage(const std::string& path) {
+    auto image = std::make_shared<const Image>(path);
+    const uint8_t* base = image->file.data();
+    const uint64_t size = image->file.size();
+    auto bad = [&](const std::string& why) { return std::runtime_error("Program image " + path + ": " + why); };
+
+    Header h;
+    if (size < sizeof(h)) throw bad("truncated header");
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0) throw bad("not a program image");
+    if (h.version != kVersion) throw bad("unsupported version " + std::to_string(h.version));
+    if (h.byteOrder != kByteOrder || h.instructionBytes != sizeof(Instruction)) throw bad("written for another host layout");
+    if (h.fileBytes != size) throw bad("truncated");
+    if (h.sections > (size - sizeof(h)) / sizeof(Section)) throw bad("section table out of range");
+
+    const uint8_t* found[kKinds] = {};
+    uint64_t counts[kKinds] = {};
+    for (uint32_t i = 0; i < h.sections; ++i) {
+        Section s;
+        std::memcpy(&s, base + sizeof(h) + i * sizeof(Section), sizeof(s));
+        if (s.kind == 0 || s.kind >= kKinds) continue;
+        const uint64_t bytes = s.count * elementBytes(s.kind);
+        if (s.offset % kAlign || s.offset > size || s.count > size || bytes > size - s.offset) {
+            throw bad("section " + std::to_string(s.kind) + " out of range");
+        }
+        if (found[s.kind]) throw bad("duplicate section " + std::to_string(s.kind));
+        found[s.kind] = base + s.offset;
+        counts[s.kind] = s.count;
+    }
+
+    Program::View v;
+    if (!found[kInstructions]) throw bad("no instructions");
+    v.code = reinterpret_cast<const Instruction*>(found[kInstructions]);
+    v.count = counts[kInstructions];
+
+    // The engines index register files and rename maps with these fields unchecked
+    for (size_t i = 0; i < v.count; ++i) {
+        const Instruction& ins = v.code[i];
+        if (static_cast<uint8_t>(ins.op) > static_cast<uint8_t>(Opcode::JAL)) {
+            throw bad("instruction " + std::to_string(i) + " has opcode " + std::to_string(unsigned(ins.op)) + " out of range");
+        }
+        if (ins.rs > 31 || ins.rt > 31 || ins.rd > 31) throw bad("instruction " + std::to_string(i) + " has a register out of range");
+    }
+
+    if (found[kTextOffsets]) {
+        if (counts[kTextOffsets] != v.count) throw bad("text table does not match the instructions");
+        if (v.count && (!counts[kTextPool] || found[kTextPool][counts[kTextPool] - 1] != '\0')) throw bad("text pool not terminated");
+        v.textOffset = reinterpret_cast<const uint32_t*>(found[kTextOffsets]);
+        v.textPool = reinterpret_cast<const char*>(found[kTextPool]);
+        v.textBytes = counts[kTextPool];
+    }
+
+    if (counts[kDataSegments]) {
+        v.segments = reinterpret_cast<const Program::DataSegment*>(found[kDataSegments]);
+        v.segmentCount = counts[kDataSegments];
+        v.words = reinterpret_cast<const int32_t*>(found[kDataWords]);
+        for (size_t i = 0; i < v.segmentCount; ++i) {
+            const Program::DataSegment& s = v.segments[i];
+            if (uint64_t(s.offset) + s.words > counts[kDataWords]) throw bad("data segment out of range");
+        }
+    }
+
+    return Program::view(v, std::move(image));
+}
+
+void ProgramLoader::writeImage(const Program& program, const std::string& path, bool withText) {
+    std::vector<Section> table;
+    std::vector<std::pair<const void*, uint64_t>> payload;   // (bytes, size) per section
+    auto add = [&](uint32_t kind, const void* data, uint64_t count) {
+        table.push_back({kind, 0, 0, count});
+        payload.push_back({data, count * elementBytes(kind)});
+    };
+
+    // The text pool is rebuilt, a program without text disassembles here
+    std::vector<uint32_t> textOffset;
+    std::string textPool;
+    if (withText) {
+        textOffset.reserve(program.size());
+        for (size_t i = 0; i < program.size(); ++i) {
+            textOffset.push_back(static_cast<uint32_t>(textPool.size()));
+            textPool += program.text(static_cast<int>(i));
+            textPool.push_back('\0');
+        }
+        if (textPool.size() > UINT32_MAX) throw std::runtime_error("Program text too large for an image: " + path);
+    }
+
+    // Data words are packed in segment order
+    std::vector<Program::DataSegment> segments;
+    std::vector<int32_t> words;
+    for (size_t i = 0; i < program.dataSegments(); ++i) {
+        Program::DataSegment s = program.dataSegment(i);
+        const int32_t* w = program.dataWords(s);
+        s.offset = static_cast<uint32_t>(words.size());
+        words.insert(words.end(), w, w + s.words);
+        segments.push_back(s);
+    }
+
+    add(kInstructions, program.begin(), program.size());
+    if (withText) {
+        add(kTextOffsets, textOffset.data(), textOffset.size());
+        add(kTextPool, textPool.data(), textPool.size());
+    }
+    if (!segments.empty()) {
+        add(kDataSegments, segments.data(), segments.size());
+        add(kDataWords, words.data(), words.size());
+    }
+
+    auto align = [](uint64_t n) { return (n + kAlign - 1) / kAlign * kAlign; };
+    uint64_t offset = align(sizeof(Header) + table.size() * sizeof(Section));
+    for (size_t i = 0; i < table.size(); ++i) {
+        table[i].offset = offset;
+        offset = align(offset + payload[i].second);
+    }
+
+    Header h;
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.byteOrder = kByteOrder;
+    h.instructionBytes = sizeof(Instruction);
+    h.sections = static_cast<uint32_t>(table.size());
+    h.fileBytes = offset;
+
+    // Written aside and renamed over path, so a program still mapping the
+    // old file (or the source of this one) keeps its pages
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Could not create program image: " + path);
+        const char zeros[kAlign] = {};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(Section));
+        uint64_t written = sizeof(h) + table.size() * sizeof(Section);
+        for (size_t i = 0; i < table.size(); ++i) {
+            out.write(zeros, table[i].offset - written);
+            out.write(static_cast<const char*>(payload[i].first), payload[i].second);
+            written = table[i].offset + payload[i].second;
+        }
+        out.write(zeros, offset - written);
+        if (!out.flush()) {
+            out.close();
+            std::remove(temp.c_str());
+            throw std::runtime_error("Could not write program image: " + path);
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("Could not replace program image: " + path);
+    }
+}
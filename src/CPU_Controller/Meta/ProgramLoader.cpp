@@ -1,154 +1,493 @@
 #include "ProgramLoader.hpp"
+#include "MappedFile.hpp"
 
-#include <fstream>
-#include <sstream>
-#include <stdexcept>
-#include <cctype>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Operand layout of a mnemonic
+enum class Form : uint8_t { None, R, Jr, I, Mem, Branch, Jump };
+
+struct Mnemonic {
+    std::string_view name;
+    Opcode op;
+    Form form;
+};
+
+constexpr Mnemonic kMnemonics[] = {
+    {"nop",  Opcode::NOP,  Form::None},
+    {"add",  Opcode::ADD,  Form::R},
+    {"sub",  Opcode::SUB,  Form::R},
+    {"and",  Opcode::AND,  Form::R},
+    {"or",   Opcode::OR,   Form::R},
+    {"xor",  Opcode::XOR,  Form::R},
+    {"slt",  Opcode::SLT,  Form::R},
+    {"jr",   Opcode::JR,   Form::Jr},
+    {"addi", Opcode::ADDI, Form::I},
+    {"andi", Opcode::ANDI, Form::I},
+    {"ori",  Opcode::ORI,  Form::I},
+    {"lw",   Opcode::LW,   Form::Mem},
+    {"sw",   Opcode::SW,   Form::Mem},
+    {"beq",  Opcode::BEQ,  Form::Branch},
+    {"bne",  Opcode::BNE,  Form::Branch},
+    {"j",    Opcode::J,    Form::Jump},
+    {"jal",  Opcode::JAL,  Form::Jump},
+};
 
-static inline std::string trim(std::string s) {
-    auto notSpace = [](unsigned char c){ return !std::isspace(c); };
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
-    s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
-    return s;
+// Character classes, one table lookup per byte
+enum : uint8_t { kSpace = 1, kSeparator = 2, kTokenEnd = 4, kDigit = 8, kIdentStart = 16, kIdent = 32 };
+
+constexpr std::array<uint8_t, 256> makeClasses() {
+    std::array<uint8_t, 256> t{};
+    for (unsigned char c : {' ', '\t', '\r', '\v', '\f'}) t[c] = kSpace | kSeparator | kTokenEnd;
+    t[','] = kSeparator | kTokenEnd;
+    // Line end, comments ('/' only when doubled) and the label colon
+    for (unsigned char c : {'\n', '#', '/', ':'}) t[c] = kTokenEnd;
+    for (int c = '0'; c <= '9'; ++c) t[c] = kDigit | kIdent;
+    for (int c = 'a'; c <= 'z'; ++c) t[c] = kIdentStart | kIdent;
+    for (int c = 'A'; c <= 'Z'; ++c) t[c] = kIdentStart | kIdent;
+    t['_'] = kIdentStart | kIdent;
+    t['.'] = kIdent;
+    return t;
 }
 
-static inline std::string toLower(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return (char)std::tolower(c); });
-    return s;
+constexpr std::array<uint8_t, 256> kClass = makeClasses();
+
+bool is(char c, uint8_t cls) { return kClass[static_cast<unsigned char>(c)] & cls; }
+bool isDigit(char c) { return is(c, kDigit); }
+bool isIdentStart(char c) { return is(c, kIdentStart); }
+constexpr char lower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+bool isIdentifier(std::string_view s) {
+    if (s.empty() || !isIdentStart(s[0])) return false;
+    for (char c : s) {
+        if (!is(c, kIdent)) return false;
+    }
+    return true;
 }
 
-static inline std::string stripPunct(std::string s) {
-    // remove trailing commas etc.
-    while (!s.empty() && (s.back() == ',')) s.pop_back();
-    return s;
+// Up to four lower-case characters packed into a word, so a mnemonic is
+// found with integer compares
+constexpr uint32_t packName(std::string_view s) {
+    uint32_t key = 0;
+    for (size_t i = 0; i < s.size(); ++i) key |= static_cast<uint32_t>(static_cast<unsigned char>(lower(s[i]))) << (8 * i);
+    return key;
 }
 
-static int parseReg(const std::string& tok, int lineNo) {
-    std::string s = stripPunct(tok);
-    if (!s.empty() && s[0] == '$') s.erase(0,1);
-    if (s.empty()) throw std::runtime_error("Line " + std::to_string(lineNo) + ": missing register");
-    // Allow names like 
-    for(char c: s) {
-        if (!std::isdigit((unsigned char)c) && c!='-' ) {
-            throw std::runtime_error("Line " + std::to_string(lineNo) + ": invalid register token: " + tok);
-        }
-    }
-    int r = std::stoi(s);
-    if (r < 0 || r > 31) throw std::runtime_error("Line " + std::to_string(lineNo) + ": register out of range: " + tok);
-    return r;
+template <size_t... I>
+constexpr std::array<uint32_t, sizeof...(I)> mnemonicKeys(std::index_sequence<I...>) {
+    return {packName(kMnemonics[I].name)...};
 }
 
-static int parseImm(const std::string& tok, int lineNo) {
-    std::string s = stripPunct(tok);
-    if (s.empty()) throw std::runtime_error("Line " + std::to_string(lineNo) + ": missing immediate");
-    try { return std::stoi(s); }
-    catch(...) { throw std::runtime_error("Line " + std::to_string(lineNo) + ": invalid immediate: " + tok); }
+constexpr auto kMnemonicKeys = mnemonicKeys(std::make_index_sequence<std::size(kMnemonics)>());
+
+const Mnemonic* findMnemonic(std::string_view word) {
+    if (word.size() > 4) return nullptr;
+    const uint32_t key = packName(word);
+    for (size_t i = 0; i < kMnemonicKeys.size(); ++i) {
+        if (kMnemonicKeys[i] == key && kMnemonics[i].name.size() == word.size()) return &kMnemonics[i];
+    }
+    return nullptr;
 }
 
-static void parseMemOperand(const std::string& tok, int& imm, int& base, int lineNo) {
-    // format: imm(base) e.g. 8($2)
-    std::string s = stripPunct(tok);
-    auto lp = s.find('(');
-    auto rp = s.find(')');
-    if (lp == std::string::npos || rp == std::string::npos || rp < lp) {
-        throw std::runtime_error("Line " + std::to_string(lineNo) + ": invalid memory operand (expected imm(base)): " + tok);
+// Decimal or 0x hex with an optional sign. Anything from INT32_MIN to
+// UINT32_MAX is taken, the upper half wrapping to negative.
+bool parseNumber(std::string_view s, int32_t& out) {
+    bool negative = false;
+    if (!s.empty() && (s[0] == '-' || s[0] == '+')) {
+        negative = s[0] == '-';
+        s.remove_prefix(1);
+    }
+    unsigned base = 10;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s.remove_prefix(2);
     }
-    std::string immStr = s.substr(0, lp);
-    std::string baseStr = s.substr(lp+1, rp-lp-1);
-    imm = immStr.empty() ? 0 : parseImm(immStr, lineNo);
-    base = parseReg(baseStr, lineNo);
+    if (s.empty()) return false;
+    uint64_t v = 0;
+    for (char c : s) {
+        unsigned d;
+        if (isDigit(c)) d = static_cast<unsigned>(c - '0');
+        else if (base == 16 && lower(c) >= 'a' && lower(c) <= 'f') d = static_cast<unsigned>(lower(c) - 'a' + 10);
+        else return false;
+        v = v * base + d;
+        if (v > UINT32_MAX) return false;
+    }
+    if (negative && v > uint64_t(INT32_MAX) + 1) return false;
+    out = static_cast<int32_t>(negative ? 0u - static_cast<uint32_t>(v) : static_cast<uint32_t>(v));
+    return true;
 }
 
-std::vector<Instruction> ProgramLoader::loadFromFile(const std::string& path) {
-    std::ifstream in(path);
-    if (!in) {
-        throw std::runtime_error("Could not open program file: " + path);
+// One pass over the source: a cursor lexes every statement straight out of
+// the buffer into string_views, and label references are left as fixups
+// resolved once every label is known. Errors are collected; a bad
+// statement still takes its slot, so later ones keep their positions.
+class Assembler {
+public:
+    explicit Assembler(std::string_view source)
+    : cur(source.data())
+    , end(source.data() + source.size())
+    {}
+
+    Program run();
+
+private:
+    // How a resolved label value lands in its operand
+    enum class Use : uint8_t { Branch, Jump, Imm, Word };
+
+    struct Fixup {
+        Use use;
+        uint32_t line;
+        uint32_t col;
+        size_t slot;             // instruction, or word in the data pool
+        std::string_view name;
+    };
+
+    struct Label {
+        int32_t value;           // instruction index or word address
+        bool text;
+    };
+
+    void statement();
+    void directive(std::string_view name);
+    void instruction(const Mnemonic& m, Instruction& ins);
+
+    // Next token of the statement, separated by whitespace or commas; empty
+    // at the end of the statement. Leaves cur on the following separator.
+    std::string_view token();
+    // The statement ends here: a line end, a comment or the end of the source
+    bool atStatementEnd() const {
+        return cur == end || *cur == '\n' || *cur == '#' || (*cur == '/' && cur + 1 < end && cur[1] == '/');
     }
+    bool reg(uint8_t& out);
+    bool reg(std::string_view tok, uint8_t& out);
+    // A number, or a label resolved later into slot
+    bool value(std::string_view tok, Use use, size_t slot, int32_t& out);
+    // No operands left
+    bool done();
+
+    void error(std::string_view at, const std::string& msg) { error(lineNo, column(at), msg); }
+    void error(uint32_t line, uint32_t col, const std::string& msg);
+    uint32_t column(std::string_view at) const { return static_cast<uint32_t>(at.data() - lineBegin) + 1; }
+    // Zero width view of the cursor, for errors about what is missing
+    std::string_view here() const { return {cur, 0}; }
 
-    std::vector<Instruction> program;
-    std::string line;
-    int lineNo = 0;
+    void placeWord(int32_t word);
 
-    while (std::getline(in, line)) {
+    const char* cur;
+    const char* const end;
+    const char* lineBegin = nullptr;
+    uint32_t lineNo = 0;
+    bool inData = false;
+
+    Program program;
+    std::vector<Program::DataSegment> segments;
+    std::vector<int32_t> words;
+    uint32_t dataAddr = 0;   // next data word
+
+    std::unordered_map<std::string_view, Label> labels;
+    std::vector<Fixup> fixups;
+    struct Error {
+        uint32_t line;
+        uint32_t col;
+        std::string msg;
+    };
+    std::vector<Error> errors;   // the first kMaxReported by position
+    size_t errorCount = 0;
+};
+
+constexpr size_t kMaxReported = 50;
+
+void Assembler::error(uint32_t line, uint32_t col, const std::string& msg) {
+    // Labels resolve after the pass, so their errors can come out of order
+    errorCount++;
+    auto before = [](const Error& a, const Error& b) { return a.line != b.line ? a.line < b.line : a.col < b.col; };
+    Error e{line, col, msg};
+    if (errors.size() == kMaxReported && !before(e, errors.back())) return;
+    errors.insert(std::upper_bound(errors.begin(), errors.end(), e, before), std::move(e));
+    if (errors.size() > kMaxReported) errors.pop_back();
+}
+
+Program Assembler::run() {
+    size_t lines = 1;
+    for (const char* p = cur; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); ++p) lines++;
+    program.reserve(lines, static_cast<size_t>(end - cur));
+
+    while (cur < end) {
+        lineBegin = cur;
         lineNo++;
-        // strip comments (# or //)
-        auto hash = line.find('#');
-        if (hash != std::string::npos) line = line.substr(0, hash);
-        auto sl = line.find("//");
-        if (sl != std::string::npos) line = line.substr(0, sl);
-
-        line = trim(line);
-        if (line.empty()) continue;
-
-        std::istringstream iss(line);
-        std::string mnem;
-        iss >> mnem;
-        mnem = toLower(mnem);
-
-        Instruction ins;
-        ins.raw_text = line;
-
-        if (mnem == "nop") {
-            ins.op = Opcode::NOP;
-        } else if (mnem == "add" || mnem == "sub" || mnem == "and" || mnem == "or" || mnem == "xor" || mnem == "slt") {
-            std::string rd, rs, rt;
-            if (!(iss >> rd >> rs >> rt)) {
-                throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected rd rs rt");
-            }
-            ins.rd = parseReg(rd, lineNo);
-            ins.rs = parseReg(rs, lineNo);
-            ins.rt = parseReg(rt, lineNo);
-            if (mnem == "add") ins.op = Opcode::ADD;
-            else if (mnem == "sub") ins.op = Opcode::SUB;
-            else if (mnem == "and") ins.op = Opcode::AND;
-            else if (mnem == "or") ins.op = Opcode::OR;
-            else if (mnem == "xor") ins.op = Opcode::XOR;
-            else ins.op = Opcode::SLT;
-        } else if (mnem == "jr") {
-            std::string rs;
-            if (!(iss >> rs)) throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected rs");
-            ins.op = Opcode::JR;
-            ins.rs = parseReg(rs, lineNo);
-        } else if (mnem == "addi" || mnem == "andi" || mnem == "ori") {
-            std::string rt, rs, imm;
-            if (!(iss >> rt >> rs >> imm)) throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected rt rs imm");
-            ins.rt = parseReg(rt, lineNo);
-            ins.rs = parseReg(rs, lineNo);
-            ins.imm = parseImm(imm, lineNo);
-            if (mnem == "addi") ins.op = Opcode::ADDI;
-            else if (mnem == "andi") ins.op = Opcode::ANDI;
-            else ins.op = Opcode::ORI;
-        } else if (mnem == "lw" || mnem == "sw") {
-            std::string rt, mem;
-            if (!(iss >> rt >> mem)) throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected rt imm(base)");
-            int imm=0, base=0;
-            parseMemOperand(mem, imm, base, lineNo);
-            ins.rt = parseReg(rt, lineNo);
-            ins.rs = base;
-            ins.imm = imm;
-            ins.op = (mnem == "lw") ? Opcode::LW : Opcode::SW;
-        } else if (mnem == "beq" || mnem == "bne") {
-            std::string rs, rt, target;
-            if (!(iss >> rs >> rt >> target)) throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected rs rt targetIndex");
-            ins.rs = parseReg(rs, lineNo);
-            ins.rt = parseReg(rt, lineNo);
-            ins.imm = parseImm(target, lineNo);
-            int pc = (int)program.size();
-            int targetPc = ins.imm;
-            ins.imm = targetPc - (pc + 1);
-            ins.op = (mnem == "beq") ? Opcode::BEQ : Opcode::BNE;
-        } else if (mnem == "j" || mnem == "jal") {
-            std::string target;
-            if (!(iss >> target)) throw std::runtime_error("Line " + std::to_string(lineNo) + ": expected targetIndex");
-            ins.addr = parseImm(target, lineNo);
-            ins.op = (mnem == "j") ? Opcode::J : Opcode::JAL;
+        statement();
+
+        // Skip what is left, a comment or the rest of a bad statement
+        if (cur < end && *cur != '\n') {
+            const void* nl = std::memchr(cur, '\n', end - cur);
+            cur = nl ? static_cast<const char*>(nl) : end;
+        }
+        if (cur < end) cur++;
+    }
+
+    for (const Fixup& f : fixups) {
+        const auto it = labels.find(f.name);
+        if (it == labels.end()) {
+            error(f.line, f.col, "undefined label: " + std::string(f.name));
+            continue;
+        }
+        const Label& l = it->second;
+        if (f.use == Use::Word) {
+            words[f.slot] = l.value;
+            continue;
+        }
+        if (f.use != Use::Imm && !l.text) {
+            error(f.line, f.col, "not an instruction label: " + std::string(f.name));
+            continue;
+        }
+        Instruction ins = program[f.slot];
+        if (f.use == Use::Branch) ins.imm = l.value - (static_cast<int32_t>(f.slot) + 1);
+        else if (f.use == Use::Jump) ins.addr = l.value;
+        else ins.imm = l.value;
+        program.patch(f.slot, ins);
+    }
+
+    if (errorCount) {
+        std::string msg;
+        for (const Error& e : errors) {
+            if (!msg.empty()) msg += "\n";
+            msg += "Line " + std::to_string(e.line) + ", col " + std::to_string(e.col) + ": " + e.msg;
+        }
+        if (errorCount > errors.size()) msg += "\n... " + std::to_string(errorCount - errors.size()) + " more errors";
+        throw std::runtime_error(msg);
+    }
+
+    for (const Program::DataSegment& s : segments) {
+        program.appendData(s.address, std::vector<int32_t>(words.begin() + s.offset, words.begin() + s.offset + s.words));
+    }
+    return std::move(program);
+}
+
+void Assembler::statement() {
+    std::string_view word = token();
+
+    // Leading labels
+    while (!word.empty() && cur < end && *cur == ':') {
+        cur++;
+        if (!isIdentifier(word)) {
+            error(word, "invalid label: " + std::string(word));
         } else {
-            throw std::runtime_error("Line " + std::to_string(lineNo) + ": unknown mnemonic: " + mnem);
+            const Label l{inData ? static_cast<int32_t>(dataAddr) : static_cast<int32_t>(program.size()), !inData};
+            if (!labels.emplace(word, l).second) error(word, "duplicate label: " + std::string(word));
+        }
+        word = token();
+    }
+    if (word.empty()) {
+        if (!atStatementEnd()) error(here(), std::string("unexpected '") + *cur + "'");
+        return;
+    }
+
+    if (word[0] == '.') {
+        directive(word);
+        return;
+    }
+
+    const Mnemonic* m = findMnemonic(word);
+    if (!m) error(word, "unknown mnemonic: " + std::string(word));
+    if (inData) {
+        if (m) error(word, "instruction in .data: " + std::string(word));
+        return;
+    }
+
+    // A bad instruction still takes its slot, so later labels stay right
+    Instruction ins;
+    if (m) instruction(*m, ins);
+
+    // The text is the statement as written, comment and outer spaces cut
+    const char* stop = cur;
+    if (!atStatementEnd()) {
+        const void* nl = std::memchr(cur, '\n', end - cur);
+        stop = nl ? static_cast<const char*>(nl) : end;
+    }
+    while (stop > word.data() && is(stop[-1], kSpace)) stop--;
+    program.append(ins, std::string_view(word.data(), stop - word.data()));
+}
+
+void Assembler::instruction(const Mnemonic& m, Instruction& ins) {
+    const size_t slot = program.size();
+    ins.op = m.op;
+
+    switch (m.form) {
+        case Form::None:
+            break;
+        case Form::R:
+            if (!reg(ins.rd) || !reg(ins.rs) || !reg(ins.rt)) return;
+            break;
+        case Form::Jr:
+            if (!reg(ins.rs)) return;
+            break;
+        case Form::I: {
+            if (!reg(ins.rt) || !reg(ins.rs)) return;
+            const std::string_view tok = token();
+            if (tok.empty()) { error(here(), "missing immediate"); return; }
+            if (!value(tok, Use::Imm, slot, ins.imm)) return;
+            break;
+        }
+        case Form::Mem: {
+            // rt, imm(base) with imm a number, a label or empty for 0
+            if (!reg(ins.rt)) return;
+            const std::string_view tok = token();
+            const size_t lp = tok.find('(');
+            if (tok.empty() || lp == std::string_view::npos || tok.back() != ')') {
+                error(tok.empty() ? here() : tok, "expected imm(base)");
+                return;
+            }
+            const std::string_view imm = tok.substr(0, lp);
+            if (!imm.empty() && !value(imm, Use::Imm, slot, ins.imm)) return;
+            if (!reg(tok.substr(lp + 1, tok.size() - lp - 2), ins.rs)) return;
+            break;
+        }
+        case Form::Branch: {
+            if (!reg(ins.rs) || !reg(ins.rt)) return;
+            const std::string_view tok = token();
+            if (tok.empty()) { error(here(), "missing branch target"); return; }
+            int32_t target = 0;
+            if (!value(tok, Use::Branch, slot, target)) return;
+            ins.imm = target - (static_cast<int32_t>(slot) + 1);
+            break;
+        }
+        case Form::Jump: {
+            const std::string_view tok = token();
+            if (tok.empty()) { error(here(), "missing jump target"); return; }
+            if (!value(tok, Use::Jump, slot, ins.addr)) return;
+            break;
+        }
+    }
+    done();
+}
+
+void Assembler::directive(std::string_view name) {
+    if (name == ".text") {
+        inData = false;
+    } else if (name == ".data") {
+        inData = true;
+        const std::string_view tok = token();
+        int32_t addr;
+        if (!tok.empty()) {
+            if (!parseNumber(tok, addr)) { error(tok, "invalid address: " + std::string(tok)); return; }
+            dataAddr = static_cast<uint32_t>(addr);
+        }
+    } else if (name == ".word") {
+        if (!inData) { error(name, ".word outside .data"); return; }
+        std::string_view tok = token();
+        if (tok.empty()) error(here(), "expected words");
+        for (; !tok.empty(); tok = token()) {
+            int32_t v = 0;
+            value(tok, Use::Word, words.size(), v);
+            placeWord(v);
         }
+    } else if (name == ".space") {
+        if (!inData) { error(name, ".space outside .data"); return; }
+        const std::string_view tok = token();
+        int32_t n;
+        if (tok.empty() || !parseNumber(tok, n) || n < 0) { error(tok.empty() ? here() : tok, "expected a word count"); return; }
+        dataAddr += static_cast<uint32_t>(n);
+    } else {
+        error(name, "unknown directive: " + std::string(name));
+        return;
+    }
+    done();
+}
+
+void Assembler::placeWord(int32_t word) {
+    // Extend the last segment while the words are consecutive
+    const bool extend = !segments.empty() &&
+        static_cast<uint32_t>(segments.back().address) + segments.back().words == dataAddr;
+    if (!extend) segments.push_back({static_cast<int32_t>(dataAddr), static_cast<uint32_t>(words.size()), 0});
+    segments.back().words++;
+    words.push_back(word);
+    dataAddr++;
+}
+
+std::string_view Assembler::token() {
+    while (cur < end && is(*cur, kSeparator)) cur++;
+    const char* b = cur;
+    while (cur < end && (!is(*cur, kTokenEnd) || (*cur == '/' && !(cur + 1 < end && cur[1] == '/')))) cur++;
+    return std::string_view(b, cur - b);
+}
 
-        program.push_back(ins);
+bool Assembler::reg(uint8_t& out) {
+    const std::string_view tok = token();
+    if (tok.empty()) {
+        error(here(), "missing register");
+        return false;
     }
+    return reg(tok, out);
+}
+
+bool Assembler::reg(std::string_view tok, uint8_t& out) {
+    std::string_view digits = tok;
+    if (!digits.empty() && digits[0] == '$') digits.remove_prefix(1);
+    unsigned r = 0;
+    bool ok = !digits.empty() && digits.size() <= 3;
+    for (size_t i = 0; ok && i < digits.size(); ++i) {
+        ok = isDigit(digits[i]);
+        r = r * 10 + static_cast<unsigned>(digits[i] - '0');
+    }
+    if (!ok || r > 31) {
+        error(tok, (ok ? "register out of range: " : "invalid register: ") + std::string(tok));
+        return false;
+    }
+    out = static_cast<uint8_t>(r);
+    return true;
+}
 
-    return program;
+bool Assembler::value(std::string_view tok, Use use, size_t slot, int32_t& out) {
+    out = 0;
+    if (isIdentStart(tok[0])) {
+        if (!isIdentifier(tok)) {
+            error(tok, "invalid label: " + std::string(tok));
+            return false;
+        }
+        fixups.push_back({use, lineNo, column(tok), slot, tok});
+        return true;
+    }
+    if (!parseNumber(tok, out)) {
+        error(tok, (use == Use::Branch || use == Use::Jump ? "invalid target: " : "invalid number: ") + std::string(tok));
+        return false;
+    }
+    return true;
+}
+
+bool Assembler::done() {
+    const std::string_view tok = token();
+    if (tok.empty() && atStatementEnd()) return true;
+    if (tok.empty()) error(here(), std::string("unexpected '") + *cur + "'");
+    else error(tok, "unexpected operand: " + std::string(tok));
+    return false;
+}
+
+} // namespace
+
+Program ProgramLoader::assemble(std::string_view source) {
+    return Assembler(source).run();
+}
+
+Program ProgramLoader::loadFromFile(const std::string& path) {
+    if (isImage(path)) return loadImage(path);
+
+    MappedFile file = [&] {
+        try {
+            return MappedFile(path);
+        } catch (const std::runtime_error&) {
+            throw std::runtime_error("Could not open program file: " + path);
+        }
+    }();
+    return assemble(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()));
 }
@@ -0,0 +1,75 @@
+#include "SampledSimulation.hpp"
+#include <algorithm>
+#include <cmath>
+
+SampledSimulation::SampledSimulation(const SamplingConfig& cfg)
+: cfg(cfg)
+{
+}
+
+void SampledSimulation::loadProgram(const Program& program) {
+    fast.loadProgram(program);
+    fast.reset(true);
+    detailed.loadProgram(program);
+}
+
+void SampledSimulation::setMemWord(int addr, int value) {
+    fast.setMemWord(addr, value);
+}
+
+void SampledSimulation::detailedRetire(uint64_t count) {
+    const uint64_t target = detailed.retired + count;
+    while (detailed.retired < target && !detailed.isHalted()) detailed.tick();
+}
+
+SamplingResult SampledSimulation::run() {
+    SamplingResult res;
+    const uint64_t detailedPerSample = cfg.warmupInstrs + cfg.sampleInstrs;
+    const uint64_t skip = cfg.period > detailedPerSample ? cfg.period - detailedPerSample : 0;
+
+    while (!fast.isHalted() && res.instructions < cfg.maxInstrs) {
+        res.instructions += fast.run(std::min(skip, cfg.maxInstrs - res.instructions));
+        if (fast.isHalted() || res.instructions >= cfg.maxInstrs) break;
+
+        // Hand over to the pipeline, it starts cold and fills during warm-up
+        detailed.setArchState(fast.pc, fast.regFile(), fast.memory());
+        const uint64_t retired0 = detailed.retired;
+        const int clock0 = detailed.clock;
+
+        detailedRetire(cfg.warmupInstrs);
+
+        const uint64_t sampleRetired0 = detailed.retired;
+        const int sampleClock0 = detailed.clock;
+        detailedRetire(cfg.sampleInstrs);
+
+        // Windows cut short by the end of the program would bias the estimate
+        const uint64_t measured = detailed.retired - sampleRetired0;
+        if (measured == cfg.sampleInstrs && measured > 0) {
+            res.sampleCpi.push_back(double(detailed.clock - sampleClock0) / double(measured));
+        }
+
+        detailed.drain();
+        res.instructions += detailed.retired - retired0;
+        res.detailedInstrs += detailed.retired - retired0;
+        res.detailedCycles += detailed.clock - clock0;
+
+        fast.setArchState(detailed.pc, detailed.regFile(), detailed.memory());
+    }
+    res.halted = fast.isHalted();
+
+    const size_t n = res.sampleCpi.size();
+    if (n > 0) {
+        double sum = 0.0;
+        for (double c : res.sampleCpi) sum += c;
+        res.cpiMean = sum / n;
+
+        if (n > 1) {
+            double sq = 0.0;
+            for (double c : res.sampleCpi) sq += (c - res.cpiMean) * (c - res.cpiMean);
+            res.cpiStdDev = std::sqrt(sq / (n - 1));
+            res.ciHalfWidth = cfg.zScore * res.cpiStdDev / std::sqrt(double(n));
+        }
+        res.estimatedCycles = res.cpiMean * res.instructions;
+    }
+    return res;
+}
@@ -0,0 +1,129 @@
+#include "Simulation.hpp"
+#include "Engine.hpp"
+#include "WideCPU.hpp"
+
+const char* engineName(EngineKind kind) {
+    switch (kind) {
+        case EngineKind::Pipeline: return "pipeline";
+        case EngineKind::ISS:      return "iss";
+        case EngineKind::JIT:      return "jit";
+        case EngineKind::Sampled:  return "sampled";
+        case EngineKind::Wide:     return "wide";
+        case EngineKind::OoO:      return "ooo";
+    }
+    return "?";
+}
+
+std::optional<EngineKind> parseEngine(std::string_view name) {
+    for (EngineKind k : {EngineKind::Pipeline, EngineKind::ISS, EngineKind::JIT, EngineKind::Sampled, EngineKind::Wide,
+                         EngineKind::OoO}) {
+        if (name == engineName(k)) return k;
+    }
+    return std::nullopt;
+}
+
+CacheHierarchyConfig defaultCacheHierarchy() {
+    CacheHierarchyConfig cfg;
+    CacheConfig l2;
+    l2.sizeBytes = 256 * 1024;
+    l2.ways = 8;
+    l2.lineBytes = 64;
+    l2.hitLatency = 10;
+    cfg.l2 = l2;
+    return cfg;
+}
+
+namespace {
+
+template <typename Engine>
+void capture(const Engine& eng, const SimConfig& cfg, SimResult& res) {
+    for (int r = 0; r < 32; ++r) res.regs[r] = eng.getReg(r);
+    for (const auto& [start, count] : cfg.memRanges) {
+        for (int i = 0; i < count; ++i) res.memory.push_back(eng.getMemWord(start + i));
+    }
+}
+
+} // namespace
+
+SimResult simulate(const Program& program, const SimConfig& cfg,
+                   const std::vector<std::pair<int,int>>& initMem) {
+    SimResult res;
+
+    switch (cfg.engine) {
+        case EngineKind::Pipeline:
+        case EngineKind::ISS:
+        case EngineKind::JIT:
+        case EngineKind::OoO: {
+            const std::unique_ptr<Engine> eng = makeEngine(cfg);
+            eng->loadProgram(program);
+            for (const auto& [addr, value] : initMem) eng->setMemWord(addr, value);
+
+            eng->run(cfg.maxCycles);
+
+            res.halted = eng->isHalted();
+            res.instructions = eng->instructions();
+            if (eng->hasCycles()) {
+                res.hasCycles = true;
+                res.cycles = eng->cycles();
+                res.cpi = res.instructions ? double(res.cycles) / double(res.instructions) : 0.0;
+            }
+            eng->report(res);
+            capture(*eng, cfg, res);
+            break;
+        }
+        case EngineKind::Sampled: {
+            SamplingConfig sc = cfg.sampling;
+            sc.maxInstrs = cfg.maxCycles;
+            SampledSimulation sim(sc);
+            sim.loadProgram(program);
+            for (const auto& [addr, value] : initMem) sim.setMemWord(addr, value);
+
+            const SamplingResult sr = sim.run();
+
+            res.halted = sr.halted;
+            res.instructions = sr.instructions;
+            res.samples = sr.sampleCpi.size();
+            if (res.samples > 0) {
+                res.hasCycles = true;
+                res.cycles = (uint64_t)(sr.estimatedCycles + 0.5);
+                res.cpi = sr.cpiMean;
+                res.cpiCiHalfWidth = sr.ciHalfWidth;
+            }
+            capture(sim.functional(), cfg, res);
+            break;
+        }
+        case EngineKind::Wide:
+            res = std::move(simulateWide(program, cfg, {initMem}).front());
+            break;
+    }
+    return res;
+}
+
+std::vector<SimResult> simulateWide(const Program& program, const SimConfig& cfg,
+                                    const std::vector<std::vector<std::pair<int,int>>>& initMems) {
+    std::vector<SimResult> results(initMems.size());
+    if (initMems.empty()) return results;
+
+    WideCPU wide(static_cast<int>(initMems.size()));
+    wide.loadProgram(program);
+    for (size_t lane = 0; lane < initMems.size(); ++lane) {
+        for (const auto& [addr, value] : initMems[lane]) wide.setMemWord((int)lane, addr, value);
+    }
+
+    wide.run(cfg.maxCycles);
+
+    for (size_t lane = 0; lane < initMems.size(); ++lane) {
+        const int l = static_cast<int>(lane);
+        SimResult& res = results[lane];
+        res.halted = wide.isHalted(l);
+        res.instructions = wide.retired(l);
+        res.hasCycles = true;
+        res.cycles = wide.cycles(l);
+        res.cpi = res.instructions ? double(res.cycles) / double(res.instructions) : 0.0;
+        for (int r = 0; r < 32; ++r) res.regs[r] = wide.getReg(l, r);
+        for (const auto& [start, count] : cfg.memRanges) {
+            for (int i = 0; i < count; ++i) res.memory.push_back(wide.getMemWord(l, start + i));
+        }
+    }
+    return results;
+}
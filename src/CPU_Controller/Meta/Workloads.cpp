@@ -0,0 +1,123 @@
+#include "Workloads.hpp"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// Appends instructions in assembler operand order, branch and jump targets are absolute
+struct Builder {
+    Program p;
+
+    int here() const { return static_cast<int>(p.size()); }
+
+    void rtype(Opcode op, int rd, int rs, int rt) { p.append({op, (uint8_t)rs, (uint8_t)rt, (uint8_t)rd, 0, 0}); }
+    void itype(Opcode op, int rt, int rs, int imm) { p.append({op, (uint8_t)rs, (uint8_t)rt, 0, imm, 0}); }
+    void memop(Opcode op, int rt, int imm, int rs) { p.append({op, (uint8_t)rs, (uint8_t)rt, 0, imm, 0}); }
+    void branch(Opcode op, int rs, int rt, int target) {
+        p.append({op, (uint8_t)rs, (uint8_t)rt, 0, target - (here() + 1), 0});
+    }
+    void jump(Opcode op, int target) { p.append({op, 0, 0, 0, 0, target}); }
+    void jr(int rs) { p.append({Opcode::JR, (uint8_t)rs, 0, 0, 0, 0}); }
+};
+
+// Loop count so that prologue + iterations * perIter is close to the target
+int iterationsFor(uint64_t dynamicInstrs, int prologue, int perIter) {
+    const uint64_t body = dynamicInstrs > (uint64_t)prologue ? dynamicInstrs - prologue : 0;
+    return (int)std::clamp<uint64_t>(body / perIter, 1, INT_MAX);
+}
+
+} // namespace
+
+const char* workloadName(WorkloadKind kind) {
+    switch (kind) {
+        case WorkloadKind::Loop:        return "loop";
+        case WorkloadKind::LoadHeavy:   return "load";
+        case WorkloadKind::BranchHeavy: return "branch";
+        case WorkloadKind::CallHeavy:   return "call";
+    }
+    return "?";
+}
+
+std::optional<WorkloadKind> parseWorkload(std::string_view name) {
+    for (WorkloadKind k : {WorkloadKind::Loop, WorkloadKind::LoadHeavy,
+                           WorkloadKind::BranchHeavy, WorkloadKind::CallHeavy}) {
+        if (name == workloadName(k)) return k;
+    }
+    return std::nullopt;
+}
+
+Program makeWorkload(WorkloadKind kind, uint64_t dynamicInstrs) {
+    Builder b;
+
+    switch (kind) {
+        case WorkloadKind::Loop: {
+            b.itype(Opcode::ADDI, 1, 0, iterationsFor(dynamicInstrs, 1, 6));
+            const int loop = b.here();
+            b.itype(Opcode::ADDI, 2, 2, 1);
+            b.rtype(Opcode::ADD, 3, 2, 3);
+            b.memop(Opcode::SW, 3, 5, 0);
+            b.memop(Opcode::LW, 4, 5, 0);
+            b.itype(Opcode::ADDI, 1, 1, -1);
+            b.branch(Opcode::BNE, 1, 0, loop);
+            break;
+        }
+        case WorkloadKind::LoadHeavy: {
+            // Three loads and a store per iteration, two of the loads feed the next instruction
+            b.itype(Opcode::ADDI, 1, 0, iterationsFor(dynamicInstrs, 1, 10));
+            const int loop = b.here();
+            b.memop(Opcode::LW, 2, 0, 10);
+            b.memop(Opcode::LW, 3, 1, 10);
+            b.rtype(Opcode::ADD, 4, 2, 3);
+            b.memop(Opcode::LW, 5, 2, 10);
+            b.rtype(Opcode::ADD, 6, 5, 4);
+            b.memop(Opcode::SW, 6, 3, 10);
+            b.itype(Opcode::ADDI, 10, 10, 1);
+            b.itype(Opcode::ANDI, 10, 10, 255);
+            b.itype(Opcode::ADDI, 1, 1, -1);
+            b.branch(Opcode::BNE, 1, 0, loop);
+            break;
+        }
+        case WorkloadKind::BranchHeavy: {
+            // Each guarded add is skipped on a different bit pattern of the
+            // counter, 11 to 14 instructions per iteration
+            b.itype(Opcode::ADDI, 1, 0, iterationsFor(dynamicInstrs, 1, 12));
+            const int loop = b.here();
+            b.itype(Opcode::ANDI, 3, 1, 1);
+            b.branch(Opcode::BEQ, 3, 0, b.here() + 2);
+            b.itype(Opcode::ADDI, 6, 6, 1);
+            b.itype(Opcode::ANDI, 4, 1, 2);
+            b.branch(Opcode::BNE, 4, 0, b.here() + 2);
+            b.itype(Opcode::ADDI, 7, 7, 1);
+            b.itype(Opcode::ANDI, 5, 1, 4);
+            b.branch(Opcode::BEQ, 5, 0, b.here() + 2);
+            b.rtype(Opcode::XOR, 8, 8, 1);
+            b.rtype(Opcode::SLT, 9, 6, 7);
+            b.branch(Opcode::BNE, 9, 0, b.here() + 2);
+            b.itype(Opcode::ADDI, 6, 6, 2);
+            b.itype(Opcode::ADDI, 1, 1, -1);
+            b.branch(Opcode::BNE, 1, 0, loop);
+            break;
+        }
+        case WorkloadKind::CallHeavy: {
+            // main calls f, f saves $31 and calls g: 10 instructions per iteration
+            const int f = 5, g = 10, end = 12;
+            b.itype(Opcode::ADDI, 1, 0, iterationsFor(dynamicInstrs, 2, 10));
+            const int loop = b.here();
+            b.jump(Opcode::JAL, f);
+            b.itype(Opcode::ADDI, 1, 1, -1);
+            b.branch(Opcode::BNE, 1, 0, loop);
+            b.jump(Opcode::J, end);
+            // f
+            b.itype(Opcode::ADDI, 2, 2, 1);
+            b.rtype(Opcode::OR, 20, 31, 0);
+            b.jump(Opcode::JAL, g);
+            b.rtype(Opcode::OR, 31, 20, 0);
+            b.jr(31);
+            // g
+            b.rtype(Opcode::ADD, 3, 3, 2);
+            b.jr(31);
+            break;
+        }
+    }
+    return b.p;
+}
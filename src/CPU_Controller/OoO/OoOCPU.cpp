@@ -0,0 +1,370 @@
+#include "OoOCPU.hpp"
+#include "HazardUnit.hpp"
+#include <stdexcept>
+
+namespace {
+
+bool isMemOp(Opcode op) { return op == Opcode::LW || op == Opcode::SW; }
+
+bool isTransfer(Opcode op) {
+    return op == Opcode::BEQ || op == Opcode::BNE || op == Opcode::J ||
+           op == Opcode::JAL || op == Opcode::JR;
+}
+
+// Which of rs and rt an instruction reads
+void sources(const Instruction& ins, bool& rs, bool& rt) {
+    switch (ins.op) {
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::AND:
+        case Opcode::OR:
+        case Opcode::XOR:
+        case Opcode::SLT:
+        case Opcode::SW:
+        case Opcode::BEQ:
+        case Opcode::BNE:
+            rs = rt = true;
+            break;
+        case Opcode::ADDI:
+        case Opcode::ANDI:
+        case Opcode::ORI:
+        case Opcode::LW:
+        case Opcode::JR:
+            rs = true;
+            rt = false;
+            break;
+        default:
+            rs = rt = false;
+    }
+}
+
+BranchPredictor::Kind transferKind(const Instruction& ins) {
+    switch (ins.op) {
+        case Opcode::J:   return BranchPredictor::Kind::Jump;
+        case Opcode::JAL: return BranchPredictor::Kind::Call;
+        case Opcode::JR:  return ins.rs == 31 ? BranchPredictor::Kind::Return : BranchPredictor::Kind::Jump;
+        default:          return BranchPredictor::Kind::Branch;
+    }
+}
+
+} // namespace
+
+OoOCPU::OoOCPU(const OoOConfig& config, const PredictorConfig& predictorCfg)
+: cfg(config)
+, predictor(predictorCfg)
+{
+    if (!cfg.width || !cfg.robEntries || !cfg.rsEntries || !cfg.lsqEntries || !cfg.aluUnits ||
+        !cfg.memUnits || !cfg.loadLatency || cfg.robEntries > 4096 || cfg.width > 4096) {
+        throw std::runtime_error("OoOCPU: sizes must be non-zero, ROB and width at most 4096");
+    }
+    rob.resize(cfg.robEntries);
+    fetchQueue.resize(2 * static_cast<size_t>(cfg.width));
+    renameMap.fill(-1);
+}
+
+void OoOCPU::loadProgram(const Program& program) {
+    instrMem = program;
+    // Load a program and reset the control flow and everything in flight
+    pc = 0;
+    clock = 0;
+    retired = 0;
+    head = 0;
+    count = 0;
+    rsUsed = 0;
+    lsqUsed = 0;
+    renameMap.fill(-1);
+    fetchHead = 0;
+    fetched = 0;
+    predictor.reset();
+    counters = {};
+    instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+}
+
+void OoOCPU::reset(bool clearMemory) {
+    loadProgram(instrMem);
+    regs.reset();
+    if (clearMemory) {
+        mem.reset();
+        instrMem.forEachDataWord([&](int addr, int value) { setMemWord(addr, value); });
+    }
+}
+
+bool OoOCPU::isHalted() const {
+    const bool noMoreFetch = pc < 0 || pc >= static_cast<int>(instrMem.size());
+    return noMoreFetch && fetched == 0 && count == 0;
+}
+
+void OoOCPU::run(uint64_t maxCycles) {
+    while (!isHalted() && clock < maxCycles) tick();
+}
+
+void OoOCPU::tick() {
+    if (isHalted()) return;
+
+    counters.robOccupancy += count;
+
+    // Back to front, so an instruction moves at most one step per cycle
+    retire();
+    complete();
+    issue();
+    rename();
+    fetch();
+
+    clock++;
+}
+
+void OoOCPU::retire() {
+    for (uint32_t n = 0; n < cfg.width && count > 0; ++n) {
+        Entry& e = rob[head];
+        if (e.state != State::Done) break;
+
+        if (e.unit == Unit::Store) {
+            mem.writeNext(e.addr, e.value);
+            mem.commit();
+        }
+        if (e.dest > 0) {
+            regs.writeNext(e.dest, e.value);
+            regs.commit();
+            if (renameMap[e.dest] == static_cast<int32_t>(head)) renameMap[e.dest] = -1;
+        }
+        if (e.unit == Unit::Load || e.unit == Unit::Store) lsqUsed--;
+        if (e.transfer) {
+            counters.branches++;
+            counters.mispredicts += e.mispredicted;
+        }
+
+        retired++;
+        head = (head + 1) % rob.size();
+        count--;
+    }
+}
+
+void OoOCPU::complete() {
+    for (int age = 0; age < static_cast<int>(count); ++age) {
+        const int slot = slotAt(age);
+        Entry& e = rob[slot];
+        if (e.state != State::Executing || e.doneAt > clock) continue;
+        e.state = State::Done;
+
+        // Broadcast on the common data bus
+        for (int a = age + 1; a < static_cast<int>(count); ++a) {
+            Entry& w = rob[slotAt(a)];
+            if (w.state != State::Waiting) continue;
+            for (int i = 0; i < 2; ++i) {
+                if (w.src[i] == slot) {
+                    w.src[i] = -1;
+                    w.val[i] = e.value;
+                }
+            }
+        }
+
+        if (!e.transfer) continue;
+        predictor.resolve(e.pc, transferKind(e.ins), e.nextPc, e.pred);
+        if (e.mispredicted) squashAfter(slot);
+    }
+}
+
+bool OoOCPU::ready(const Entry& e) const {
+    return e.src[0] < 0 && e.src[1] < 0;
+}
+
+bool OoOCPU::olderStoresKnown(int slot) const {
+    for (int age = 0; age < ageOf(slot); ++age) {
+        const Entry& e = rob[slotAt(age)];
+        if (e.unit == Unit::Store && e.state == State::Waiting) return false;
+    }
+    return true;
+}
+
+void OoOCPU::issue() {
+    uint32_t alu = cfg.aluUnits;
+    uint32_t memPorts = cfg.memUnits;
+
+    // Oldest first
+    for (int age = 0; age < static_cast<int>(count) && (alu > 0 || memPorts > 0); ++age) {
+        const int slot = slotAt(age);
+        Entry& e = rob[slot];
+        if (e.state != State::Waiting || !ready(e)) continue;
+
+        if (e.unit == Unit::Alu) {
+            if (alu == 0) continue;
+            alu--;
+        } else {
+            if (memPorts == 0) continue;
+            if (e.unit == Unit::Load && !olderStoresKnown(slot)) continue;
+            memPorts--;
+        }
+
+        rsUsed--;
+        counters.issued++;
+        execute(slot);
+    }
+}
+
+void OoOCPU::execute(int slot) {
+    Entry& e = rob[slot];
+    const Instruction& ins = e.ins;
+    const int a = e.val[0];
+    const int b = e.val[1];
+    uint64_t latency = 1;
+
+    switch (ins.op) {
+        case Opcode::ADD:  e.value = a + b; break;
+        case Opcode::SUB:  e.value = a - b; break;
+        case Opcode::AND:  e.value = a & b; break;
+        case Opcode::OR:   e.value = a | b; break;
+        case Opcode::XOR:  e.value = a ^ b; break;
+        case Opcode::SLT:  e.value = a < b ? 1 : 0; break;
+        case Opcode::ADDI: e.value = a + ins.imm; break;
+        case Opcode::ANDI: e.value = a & ins.imm; break;
+        case Opcode::ORI:  e.value = a | ins.imm; break;
+        case Opcode::SW:
+            e.addr = a + ins.imm;
+            e.value = b;
+            break;
+        case Opcode::LW: {
+            e.addr = a + ins.imm;
+            // The youngest older store to the word has the data, else memory does
+            bool forwarded = false;
+            for (int age = ageOf(slot); age-- > 0 && !forwarded;) {
+                const Entry& s = rob[slotAt(age)];
+                if (s.unit == Unit::Store && s.addr == e.addr) {
+                    e.value = s.value;
+                    forwarded = true;
+                }
+            }
+            if (forwarded) {
+                counters.loadForwards++;
+            } else {
+                e.value = mem.read(e.addr);
+                latency = cfg.loadLatency;
+            }
+            break;
+        }
+        case Opcode::BEQ:  e.nextPc = a == b ? e.pc + 1 + ins.imm : e.pc + 1; break;
+        case Opcode::BNE:  e.nextPc = a != b ? e.pc + 1 + ins.imm : e.pc + 1; break;
+        case Opcode::J:    e.nextPc = ins.addr; break;
+        case Opcode::JAL:
+            e.nextPc = ins.addr;
+            e.value = e.pc + 1;
+            break;
+        case Opcode::JR:   e.nextPc = a; break;
+        default: break;
+    }
+
+    e.mispredicted = e.transfer && e.nextPc != e.pred.nextPc;
+    e.doneAt = clock + latency;
+    e.state = State::Executing;
+}
+
+void OoOCPU::squashAfter(int slot) {
+    const int keep = ageOf(slot) + 1;
+    for (int age = keep; age < static_cast<int>(count); ++age) {
+        const Entry& e = rob[slotAt(age)];
+        if (e.state == State::Waiting && e.unit != Unit::None) rsUsed--;
+        if (e.unit == Unit::Load || e.unit == Unit::Store) lsqUsed--;
+        counters.squashed++;
+    }
+    count = static_cast<size_t>(keep);
+
+    // The map as it was when the branch was renamed
+    renameMap.fill(-1);
+    for (int age = 0; age < keep; ++age) {
+        const int s = slotAt(age);
+        if (rob[s].dest > 0) renameMap[rob[s].dest] = s;
+    }
+
+    fetched = 0;
+    pc = rob[slot].nextPc;
+}
+
+void OoOCPU::rename() {
+    for (uint32_t n = 0; n < cfg.width; ++n) {
+        if (fetched == 0) {
+            if (n == 0) counters.frontendStalls++;
+            return;
+        }
+        const Fetched& f = fetchQueue[fetchHead];
+        const bool memOp = isMemOp(f.ins.op);
+        const bool needsRs = f.ins.op != Opcode::NOP;
+
+        if (count == rob.size()) {
+            counters.robFullStalls++;
+            return;
+        }
+        if (needsRs && rsUsed == cfg.rsEntries) {
+            counters.rsFullStalls++;
+            return;
+        }
+        if (memOp && lsqUsed == cfg.lsqEntries) {
+            counters.lsqFullStalls++;
+            return;
+        }
+
+        const int slot = slotAt(static_cast<int>(count));
+        Entry& e = rob[slot];
+        e = Entry{};
+        e.ins = f.ins;
+        e.pc = f.pc;
+        e.pred = f.pred;
+        e.transfer = isTransfer(f.ins.op);
+        e.unit = f.ins.op == Opcode::LW ? Unit::Load
+               : f.ins.op == Opcode::SW ? Unit::Store
+               : needsRs ? Unit::Alu : Unit::None;
+
+        // Operands: the register file, a completed result, or a tag to wait on
+        bool readsRs, readsRt;
+        sources(f.ins, readsRs, readsRt);
+        const int regIdx[2] = {readsRs ? f.ins.rs : 0, readsRt ? f.ins.rt : 0};
+        for (int i = 0; i < 2; ++i) {
+            const int r = regIdx[i];
+            const int32_t tag = r ? renameMap[r] : -1;
+            if (tag < 0) e.val[i] = regs.read(r);
+            else if (rob[tag].state == State::Done) e.val[i] = rob[tag].value;
+            else e.src[i] = tag;
+        }
+
+        const int dest = HazardUnit::destReg(f.ins);
+        if (dest > 0) {
+            e.dest = static_cast<int8_t>(dest);
+            renameMap[dest] = slot;
+        }
+
+        if (needsRs) rsUsed++;
+        else e.state = State::Done;
+        if (memOp) lsqUsed++;
+
+        count++;
+        fetchHead = (fetchHead + 1) % fetchQueue.size();
+        fetched--;
+    }
+}
+
+void OoOCPU::fetch() {
+    for (uint32_t n = 0; n < cfg.width && fetched < fetchQueue.size(); ++n) {
+        if (pc < 0 || pc >= static_cast<int>(instrMem.size())) return;
+
+        Fetched& f = fetchQueue[(fetchHead + fetched) % fetchQueue.size()];
+        f.ins = instrMem[pc];
+        f.pc = pc;
+        f.pred = predictor.predict(pc);
+        fetched++;
+        pc = f.pred.nextPc;
+
+        // One taken transfer per cycle
+        if (pc != f.pc + 1) return;
+    }
+}
+
+int OoOCPU::getReg(int idx) const {
+    return regs.read(idx);
+}
+
+int OoOCPU::getMemWord(int addr) const {
+    return mem.read(addr);
+}
+
+void OoOCPU::setMemWord(int addr, int value) {
+    mem.writeNext(addr, value);
+    mem.commit();
+}
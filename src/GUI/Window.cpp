@@ -67,11 +67,12 @@ static std::string TruncateToWidth(const std::string& s, float maxW) {
     return std::string();
 }
 
-App::App(CPU& cpu)
+App::App(CPU& cpu, TraceReplay* replay)
     : window(sf::VideoMode({900u, 600u}),
              "MIPS Pipeline Simulator (ImGui + SFML 3)",
              sf::Style::Default)
     , cpu(cpu)
+    , replay(replay)
 {
     window.setFramerateLimit(60);
 
@@ -85,6 +86,9 @@ App::App(CPU& cpu)
     gPipelineTexture.setSmooth(true);
 
     ResetColorCache();
+
+    // Backspace steps back through the recent cycles
+    cpu.enableJournal();
 }
 
 void App::run()
@@ -93,6 +97,10 @@ void App::run()
     sf::Clock runClock;
     std::vector<std::string> executedHistory;
 
+    // S saves the current state, L goes back to the latest save. Each entry
+    // remembers how much of the history existed at that point.
+    std::vector<std::pair<CPU::Snapshot, size_t>> snapshots;
+
     while (window.isOpen())
     {
         while (const auto event = window.pollEvent())
@@ -109,7 +117,31 @@ void App::run()
                 window.setView(sf::View(sf::FloatRect({0, 0}, {w, h})));
             }
 
-            if (const auto* key = event->getIf<sf::Event::KeyPressed>()) {
+            const auto* key = event->getIf<sf::Event::KeyPressed>();
+            if (key && replay) {
+                // Replay: the keys move through the recorded cycles, shift by 100
+                const uint64_t pos = replay->position();
+                const uint64_t stride = key->shift ? 100 : 1;
+                if (key->scancode == sf::Keyboard::Scancode::Escape) {
+                    window.close();
+                } else if (key->scancode == sf::Keyboard::Scancode::Space ||
+                           key->scancode == sf::Keyboard::Scancode::Right) {
+                    replay->seek(pos + stride);
+                } else if (key->scancode == sf::Keyboard::Scancode::Left ||
+                           key->scancode == sf::Keyboard::Scancode::Backspace) {
+                    replay->seek(pos - std::min(pos, stride));
+                    running = false;
+                } else if (key->scancode == sf::Keyboard::Scancode::Home ||
+                           key->scancode == sf::Keyboard::Scancode::R) {
+                    replay->seek(0);
+                    running = false;
+                } else if (key->scancode == sf::Keyboard::Scancode::End) {
+                    replay->seek(replay->length() - 1);
+                } else if (key->scancode == sf::Keyboard::Scancode::Enter) {
+                    running = !running;
+                    runClock.restart();
+                }
+            } else if (key) {
                 if (key->scancode == sf::Keyboard::Scancode::Escape) {
                     window.close();
                 } else if (key->scancode == sf::Keyboard::Scancode::Space) {
@@ -117,7 +149,7 @@ void App::run()
                     if (!cpu.isHalted()) {
                         cpu.tick();
                         const auto& p = cpu.pipeline();
-                        if (p.if_id.valid) executedHistory.push_back(p.if_id.rawInstr.raw_text);
+                        if (p.if_id.cur().valid) executedHistory.push_back(cpu.program().text(p.if_id.cur().rawInstr));
                         else executedHistory.push_back("<empty>");
                     }
                 } else if (key->scancode == sf::Keyboard::Scancode::Enter) {
@@ -128,22 +160,45 @@ void App::run()
                     cpu.reset(true);
                     executedHistory.clear();
                     ResetColorCache(); // reset palette assignments
+                } else if (key->scancode == sf::Keyboard::Scancode::Backspace) {
+                    // Shift goes back 100 cycles at once
+                    const uint64_t n = cpu.stepBack(key->shift ? 100 : 1);
+                    executedHistory.resize(executedHistory.size() - std::min<size_t>(n, executedHistory.size()));
+                    running = false;
+                } else if (key->scancode == sf::Keyboard::Scancode::D) {
+                    // Toggle dual issue, whatever is in flight drains first
+                    cpu.setIssueWidth(cpu.issueWidth() == 2 ? 1 : 2);
+                } else if (key->scancode == sf::Keyboard::Scancode::S) {
+                    snapshots.emplace_back(cpu.snapshot(), executedHistory.size());
+                } else if (key->scancode == sf::Keyboard::Scancode::L) {
+                    if (!snapshots.empty()) {
+                        cpu.restore(snapshots.back().first);
+                        executedHistory.resize(std::min(executedHistory.size(), snapshots.back().second));
+                        running = false;
+                    }
                 }
             }
         }
 
         // Auto-run mode
-        if (running && !cpu.isHalted()) {
+        const bool atEnd = replay ? replay->position() + 1 >= replay->length() : cpu.isHalted();
+        if (running && replay && !atEnd) {
+            const float step = (ticksPerSecond <= 0.01f) ? 1.0f : (1.0f / ticksPerSecond);
+            if (runClock.getElapsedTime().asSeconds() >= step) {
+                replay->seek(replay->position() + 1);
+                runClock.restart();
+            }
+        } else if (running && !atEnd) {
             const float dt = runClock.getElapsedTime().asSeconds();
             const float step = (ticksPerSecond <= 0.01f) ? 1.0f : (1.0f / ticksPerSecond);
             if (dt >= step) {
                 cpu.tick();
                 runClock.restart();
                 const auto& p = cpu.pipeline();
-                if (p.if_id.valid) executedHistory.push_back(p.if_id.rawInstr.raw_text);
+                if (p.if_id.cur().valid) executedHistory.push_back(cpu.program().text(p.if_id.cur().rawInstr));
                 else executedHistory.push_back("<empty>");
             }
-        } else if (cpu.isHalted()) {
+        } else if (atEnd) {
             running = false;
         }
 
@@ -164,20 +219,52 @@ void App::run()
             ImGuiWindowFlags_NoResize |
             ImGuiWindowFlags_NoCollapse);
 
-        ImGui::Text("Clock: %d  PC: %d  State: %s", cpu.clock, cpu.pc,
-            cpu.isHalted() ? "HALTED" : (running ? "RUN" : "PAUSE"));
-
-        const auto& pipe = cpu.pipeline();
+        // What sits in each latch, IF/ID to MEM/WB then lane 2, live or recorded
+        struct LatchView { const Instruction* instr; bool valid; };
+        LatchView latches[TraceCycle::kLatches];
+        bool dual = false;
+        static const Instruction kBubble{};
+        if (replay) {
+            const TraceCycle& tc = replay->cycle();
+            ImGui::Text("Replay cycle: %llu  Position: %llu / %llu  State: %s  Chunks: %zu",
+                (unsigned long long)tc.cycle, (unsigned long long)replay->position() + 1,
+                (unsigned long long)replay->length(), running ? "PLAY" : "PAUSE", replay->trace().chunks());
+
+            uint64_t pos = replay->position();
+            const uint64_t first = 0;
+            const uint64_t last = replay->length() - 1;
+            ImGui::SetNextItemWidth(-1.0f);
+            if (ImGui::SliderScalar("##timeline", ImGuiDataType_U64, &pos, &first, &last, "%llu")) replay->seek(pos);
+
+            for (int i = 0; i < TraceCycle::kLatches; ++i) {
+                const int32_t idx = tc.latch[i];
+                const bool valid = idx >= 0 && idx < (int32_t)cpu.program().size();
+                latches[i] = {valid ? &cpu.program()[idx] : &kBubble, valid};
+                dual |= i >= 4 && valid;
+            }
+        } else {
+            ImGui::Text("Clock: %d  PC: %d  State: %s  Issue: %d  Snapshots: %zu  Undo: %llu", cpu.clock, cpu.pc,
+                cpu.isHalted() ? "HALTED" : (running ? "RUN" : "PAUSE"), cpu.issueWidth(), snapshots.size(),
+                (unsigned long long)cpu.journalDepth());
+
+            const auto& pipe = cpu.pipeline();
+            latches[0] = {&pipe.if_id.cur().rawInstr,   pipe.if_id.cur().valid};
+            latches[1] = {&pipe.id_ex.cur().rawInstr,   pipe.id_ex.cur().valid};
+            latches[2] = {&pipe.ex_mem.cur().rawInstr,  pipe.ex_mem.cur().valid};
+            latches[3] = {&pipe.mem_wb.cur().rawInstr,  pipe.mem_wb.cur().valid};
+            latches[4] = {&pipe.if_id2.cur().rawInstr,  pipe.if_id2.cur().valid};
+            latches[5] = {&pipe.id_ex2.cur().rawInstr,  pipe.id_ex2.cur().valid};
+            latches[6] = {&pipe.ex_mem2.cur().rawInstr, pipe.ex_mem2.cur().valid};
+            latches[7] = {&pipe.mem_wb2.cur().rawInstr, pipe.mem_wb2.cur().valid};
+            dual = cpu.issueWidth() == 2;
+        }
 
         std::unordered_map<std::string, ImU32> liveInstrColors;
-        auto addLive = [&](const Instruction& instr, bool valid) {
-            if (!valid || instr.op == Opcode::NOP) return;
-            liveInstrColors[instr.raw_text] = GetStableColorForKey(instr.raw_text);
-        };
-        addLive(pipe.if_id.rawInstr,  pipe.if_id.valid);
-        addLive(pipe.id_ex.rawInstr,  pipe.id_ex.valid);
-        addLive(pipe.ex_mem.rawInstr, pipe.ex_mem.valid);
-        addLive(pipe.mem_wb.rawInstr, pipe.mem_wb.valid);
+        for (const LatchView& l : latches) {
+            if (!l.valid || l.instr->op == Opcode::NOP) continue;
+            const std::string key = cpu.program().text(*l.instr);
+            liveInstrColors[key] = GetStableColorForKey(key);
+        }
 
         ImGui::Separator();
 
@@ -190,7 +277,7 @@ void App::run()
             const ImVec2 imgMax = ImGui::GetItemRectMax();
             const ImVec2 imgSize(imgMax.x - imgMin.x, imgMax.y - imgMin.y);
 
-            struct Slot { const char* name; float x0, y0, x1, y1; const Instruction* instr; bool valid; };
+            struct Slot { const char* name; float x0, y0, x1, y1; const Instruction* instr; bool valid; bool labelBelow; };
 
             const float baseY0 = 70.0f / 367.0f;
             const float baseY1 = 305.0f / 367.0f;
@@ -199,12 +286,21 @@ void App::run()
             const float y0 = yCenter - yHalf;
             const float y1 = yCenter + yHalf;
 
-            const Slot slots[] = {
-                {"IF/ID",  (115.0f/599.0f), y0, (141.0f/599.0f), y1, &pipe.if_id.rawInstr,  pipe.if_id.valid},
-                {"ID/EX",  (252.0f/599.0f), y0, (277.0f/599.0f), y1, &pipe.id_ex.rawInstr,  pipe.id_ex.valid},
-                {"EX/MEM", (374.0f/599.0f), y0, (399.0f/599.0f), y1, &pipe.ex_mem.rawInstr, pipe.ex_mem.valid},
-                {"MEM/WB", (499.0f/599.0f), y0, (524.0f/599.0f), y1, &pipe.mem_wb.rawInstr, pipe.mem_wb.valid},
+            // Dual issue splits every latch: first lane on top, second lane below
+            const float yMid = dual ? yCenter - 0.01f : y1;
+            std::vector<Slot> slots = {
+                {"IF/ID",  (115.0f/599.0f), y0, (141.0f/599.0f), yMid, latches[0].instr, latches[0].valid, false},
+                {"ID/EX",  (252.0f/599.0f), y0, (277.0f/599.0f), yMid, latches[1].instr, latches[1].valid, false},
+                {"EX/MEM", (374.0f/599.0f), y0, (399.0f/599.0f), yMid, latches[2].instr, latches[2].valid, false},
+                {"MEM/WB", (499.0f/599.0f), y0, (524.0f/599.0f), yMid, latches[3].instr, latches[3].valid, false},
             };
+            if (dual) {
+                const float yLow = yCenter + 0.01f;
+                slots.push_back({"IF/ID",  (115.0f/599.0f), yLow, (141.0f/599.0f), y1, latches[4].instr, latches[4].valid, true});
+                slots.push_back({"ID/EX",  (252.0f/599.0f), yLow, (277.0f/599.0f), y1, latches[5].instr, latches[5].valid, true});
+                slots.push_back({"EX/MEM", (374.0f/599.0f), yLow, (399.0f/599.0f), y1, latches[6].instr, latches[6].valid, true});
+                slots.push_back({"MEM/WB", (499.0f/599.0f), yLow, (524.0f/599.0f), y1, latches[7].instr, latches[7].valid, true});
+            }
 
             ImDrawList* dl = ImGui::GetWindowDrawList();
             const float pad = 4.0f;
@@ -218,7 +314,7 @@ void App::run()
 
                 ImU32 base = EmptyColor(1.0f);
                 if (isLive) {
-                    auto it = liveInstrColors.find(s.instr->raw_text);
+                    auto it = liveInstrColors.find(cpu.program().text(*s.instr));
                     if (it != liveInstrColors.end()) base = it->second;
                 }
 
@@ -228,7 +324,7 @@ void App::run()
                 dl->AddRectFilled(p0, p1, fill, rounding);
                 dl->AddRect(p0, p1, border, rounding, 0, 2.0f);
 
-                const std::string fullText = isLive ? s.instr->raw_text : std::string("<empty>");
+                const std::string fullText = isLive ? cpu.program().text(*s.instr) : "<empty>";
 
                 const float maxLabelW = imgSize.x - pad * 2.0f;
                 const std::string clipped = TruncateToWidth(fullText, maxLabelW);
@@ -240,8 +336,9 @@ void App::run()
                 float labelX = (p0.x + p1.x) * 0.5f - tsz.x * 0.5f;
                 labelX = std::max(imgMin.x + pad, std::min(labelX, imgMax.x - pad - tsz.x));
 
-                float labelY = p0.y - tsz.y - 3.0f;
+                float labelY = s.labelBelow ? p1.y + 3.0f : p0.y - tsz.y - 3.0f;
                 if (labelY < imgMin.y + pad) labelY = imgMin.y + pad;
+                if (labelY > imgMax.y - pad - tsz.y) labelY = imgMax.y - pad - tsz.y;
 
                 const ImU32 bg = ImGui::ColorConvertFloat4ToU32({0.0f, 0.0f, 0.0f, 0.35f});
                 dl->AddRectFilled({labelX - 2.0f, labelY - 1.0f},
@@ -263,7 +360,8 @@ void App::run()
             ImGuiWindowFlags_NoResize |
             ImGuiWindowFlags_NoCollapse);
 
-        ImGui::Text("Controls: SPACE=Step | ENTER=Run/Pause | R=Reset | ESC=Quit");
+        if (replay) ImGui::Text("Controls: SPACE/RIGHT=Next | LEFT=Back | SHIFT=x100 | HOME/END | ENTER=Play/Pause | ESC=Quit");
+        else ImGui::Text("Controls: SPACE=Step | ENTER=Run/Pause | R=Reset | ESC=Quit");
         ImGui::SliderFloat("Ticks/sec", &ticksPerSecond, 1.0f, 60.0f, "%.0f");
 
         ImGui::Separator();
@@ -274,33 +372,43 @@ void App::run()
         if (ImGui::BeginChild("##program", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 10.5f),
                               true, ImGuiWindowFlags_HorizontalScrollbar))
         {
+            // Replay knows no pc, it marks the instruction in IF/ID
             const auto& prog = cpu.program();
+            const int mark = replay ? replay->cycle().latch[0] : cpu.pc;
             for (int i = 0; i < (int)prog.size(); ++i) {
-                const bool isPC = (i == cpu.pc);
-                if (isPC) ImGui::Text("-> %02d: %s", i, prog[i].raw_text.c_str());
-                else      ImGui::Text("   %02d: %s", i, prog[i].raw_text.c_str());
+                const bool isPC = (i == mark);
+                if (isPC) ImGui::Text("-> %02d: %s", i, prog.text(i));
+                else      ImGui::Text("   %02d: %s", i, prog.text(i));
             }
         }
         ImGui::EndChild();
 
         ImGui::Separator();
-        ImGui::Text("Executed (most recent last):");
-        if (ImGui::BeginChild("##history", ImVec2(0, 0),
-                              true, ImGuiWindowFlags_HorizontalScrollbar))
-        {
-            int n = (int)executedHistory.size();
-            const int showLast = 40;
-            int start = (n > showLast) ? (n - showLast) : 0;
-            for (int i = start; i < n; ++i) {
-                const auto it = liveInstrColors.find(executedHistory[i]);
-                if (it != liveInstrColors.end()) {
-                    ImGui::TextColored(U32ToVec4(it->second), "%s", executedHistory[i].c_str());
-                } else {
-                    ImGui::Text("%s", executedHistory[i].c_str());
+        if (replay) {
+            const TraceCycle& tc = replay->cycle();
+            ImGui::Text("Commits this cycle:");
+            for (int i = 0; i < tc.regWrites; ++i) ImGui::Text("  $%d = %d", tc.regIdx[i], tc.regValue[i]);
+            if (tc.memWrite) ImGui::Text("  [%d] = %d", tc.memAddr, tc.memValue);
+            if (!tc.regWrites && !tc.memWrite) ImGui::TextDisabled("  none");
+        } else {
+            ImGui::Text("Executed (most recent last):");
+            if (ImGui::BeginChild("##history", ImVec2(0, 0),
+                                  true, ImGuiWindowFlags_HorizontalScrollbar))
+            {
+                int n = (int)executedHistory.size();
+                const int showLast = 40;
+                int start = (n > showLast) ? (n - showLast) : 0;
+                for (int i = start; i < n; ++i) {
+                    const auto it = liveInstrColors.find(executedHistory[i]);
+                    if (it != liveInstrColors.end()) {
+                        ImGui::TextColored(U32ToVec4(it->second), "%s", executedHistory[i].c_str());
+                    } else {
+                        ImGui::Text("%s", executedHistory[i].c_str());
+                    }
                 }
             }
+            ImGui::EndChild();
         }
-        ImGui::EndChild();
 
         ImGui::PopTextWrapPos();
         ImGui::End();
@@ -314,14 +422,34 @@ void App::run()
             ImGuiWindowFlags_NoResize |
             ImGuiWindowFlags_NoCollapse);
 
-        if (ImGui::BeginChild("##regs", ImVec2(0, 0), true))
+        const float regsW = ImGui::GetContentRegionAvail().x * 0.5f;
+        if (ImGui::BeginChild("##regs", ImVec2(regsW, 0), true))
         {
-            const auto& regs = cpu.regFile().getRegs();
+            const auto& regs = replay ? replay->regs() : cpu.regFile().getRegs();
             for (int i = 0; i < 32; ++i) {
                 ImGui::Text("$%02d: %d", i, regs[i]);
             }
         }
         ImGui::EndChild();
+
+        ImGui::SameLine();
+        if (ImGui::BeginChild("##stats", ImVec2(0, 0), true))
+        {
+            if (replay) {
+                const uint8_t flags = replay->cycle().flags;
+                ImGui::Text("%-16s %s", "stall", (flags & TraceCycle::kStall) ? "yes" : "no");
+                ImGui::Text("%-16s %s", "flush", (flags & TraceCycle::kFlush) ? "yes" : "no");
+                ImGui::Text("%-16s %s", "fetch_wait", (flags & TraceCycle::kFetchWait) ? "yes" : "no");
+                ImGui::Text("%-16s %s", "frozen", (flags & TraceCycle::kFrozen) ? "yes" : "no");
+            } else if (kPerfCounters) {
+                cpu.stats().forEach([](const char* name, uint64_t value) {
+                    ImGui::Text("%-16s %llu", name, (unsigned long long)value);
+                });
+            } else {
+                ImGui::TextDisabled("Counters disabled (SCS_PERF_COUNTERS=0)");
+            }
+        }
+        ImGui::EndChild();
         ImGui::End();
 
         //MEMORY 
@@ -335,8 +463,10 @@ void App::run()
 
         int memWordsToShow = 64;
         ImGui::Text("Memory [0..%d] (word addressed)", memWordsToShow - 1);
-        for (int i = 0; i < memWordsToShow && i < (int)cpu.memory().size(); ++i) {
-            ImGui::Text("[%02d] = %d", i, cpu.getMemWord(i));
+        const Memory& shown = replay ? replay->memory() : cpu.memory();
+        ImGui::TextDisabled("%zu resident pages", shown.residentPages());
+        for (int i = 0; i < memWordsToShow; ++i) {
+            ImGui::Text("[%02d] = %d", i, shown.read(i));
         }
 
         ImGui::End();
@@ -0,0 +1,123 @@
+#include "ProgramLoader.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Assembles a program listing into a program image that every front end
+// maps and runs in place (see ProgramLoader::loadImage). With --mips the
+// input is raw MIPS32 machine code instead, decoded once into the image.
+
+namespace {
+
+struct Options {
+    std::string input;
+    std::string output;
+    bool text = true;
+    bool mips = false;
+    MipsFormat mipsFormat;
+    std::vector<std::pair<int32_t, std::vector<int32_t>>> data;   // (address, words)
+};
+
+void usage(std::ostream& os) {
+    os << "usage: cpu_asm [options] program.txt|program.bin\n"
+          "  -o FILE                 image to write (default: the input with its extension replaced by .img)\n"
+          "  --data ADDR:V[,V...]    data segment: words V from address ADDR on, repeatable\n"
+          "  --no-text               leave out the instruction text, front ends then show disassembly\n"
+          "  --mips be|le            the input is raw MIPS32 machine code of that byte order\n"
+          "  --mips-base ADDR        byte address the machine code is loaded at (default 0)\n";
+}
+
+bool parseData(const std::string& s, std::pair<int32_t, std::vector<int32_t>>& out) {
+    const auto colon = s.find(':');
+    if (colon == std::string::npos) return false;
+    try {
+        out.first = std::stoi(s.substr(0, colon));
+        std::istringstream values(s.substr(colon + 1));
+        std::string v;
+        while (std::getline(values, v, ',')) {
+            size_t used = 0;
+            out.second.push_back(std::stoi(v, &used, 0));
+            if (used != v.size()) return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    return !out.second.empty();
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            usage(std::cout);
+            std::exit(0);
+        } else if (a == "--mips" || a == "--mips-base") {
+            if (i + 1 >= argc) { std::cerr << "missing value for " << a << "\n"; return false; }
+            const std::string v = argv[++i];
+            if (a == "--mips-base") {
+                if (!opt.mipsFormat.parseBase(v)) { std::cerr << "invalid --mips-base\n"; return false; }
+                continue;
+            }
+            if (!opt.mipsFormat.parseByteOrder(v)) { std::cerr << "invalid --mips, expected be or le\n"; return false; }
+            opt.mips = true;
+        } else if (a == "-o" || a == "--data") {
+            if (i + 1 >= argc) { std::cerr << "missing value for " << a << "\n"; return false; }
+            const std::string v = argv[++i];
+            if (a == "-o") {
+                opt.output = v;
+                continue;
+            }
+            std::pair<int32_t, std::vector<int32_t>> seg;
+            if (!parseData(v, seg)) { std::cerr << "invalid --data, expected ADDR:V[,V...]\n"; return false; }
+            opt.data.push_back(std::move(seg));
+        } else if (a == "--no-text") {
+            opt.text = false;
+        } else if (!a.empty() && a[0] == '-') {
+            std::cerr << "unknown option: " << a << "\n";
+            return false;
+        } else if (opt.input.empty()) {
+            opt.input = a;
+        } else {
+            std::cerr << "only one program file\n";
+            return false;
+        }
+    }
+    if (opt.input.empty()) {
+        std::cerr << "no program file given\n";
+        return false;
+    }
+    if (opt.output.empty()) {
+        const auto slash = opt.input.find_last_of("/\\");
+        const auto dot = opt.input.rfind('.');
+        const bool ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        opt.output = (ext ? opt.input.substr(0, dot) : opt.input) + ".img";
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(std::cerr);
+        return 2;
+    }
+
+    try {
+        Program program = opt.mips ? ProgramLoader::loadBinary(opt.input, opt.mipsFormat)
+                                   : ProgramLoader::loadFromFile(opt.input);
+        for (const auto& [addr, words] : opt.data) program.appendData(addr, words);
+        ProgramLoader::writeImage(program, opt.output, opt.text);
+        std::cout << opt.output << ": " << program.size() << " instructions, "
+                  << program.dataSegments() << " data segments\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include "BatchRunner.hpp"
+#include "ProgramLoader.hpp"
+#include "Simulation.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Headless batch runner: simulates program files and prints the final
+// architectural state as JSON or CSV. Links against cpu_core only.
+
+namespace {
+
+struct Options {
+    SimConfig sim;
+    bool csv = false;
+    unsigned jobs = 0;       // worker threads, 0 = hardware concurrency
+    uint64_t repeat = 1;     // runs of every file, for throughput measurements
+    bool progress = false;
+    bool mips = false;       // files are raw MIPS32 machine code
+    MipsFormat mipsFormat;
+    std::vector<std::string> files;
+};
+
+void usage(std::ostream& os) {
+    os << "usage: cpu_run [options] program.txt [program.txt ...]\n"
+          "  --engine NAME                       pipeline, iss, jit, sampled, wide or ooo (default pipeline)\n"
+          "  --max-cycles N                      cycle limit, instruction limit for iss/jit/wide (default 10000000)\n"
+          "  --caches                            pipeline engine: model L1I/L1D and L2 caches\n"
+          "  --predictor NAME                    pipeline and ooo: not-taken, backward-taken, bimodal or gshare\n"
+          "  --btb N                             BTB entries, a power of two (default 512 with --predictor)\n"
+          "  --ras N                             return-address stack depth (default 16 with --predictor)\n"
+          "  --issue-width 1|2                   pipeline engine: in-order issue width (default 1)\n"
+          "  --branch-stage ex|id                pipeline engine: stage that resolves branches (default ex, id needs issue width 1)\n"
+          "  --ooo-width N                       ooo engine: fetch, rename and retire width (default 4)\n"
+          "  --rob N                             ooo engine: reorder buffer entries (default 64)\n"
+          "  --rs N                              ooo engine: reservation stations (default 32)\n"
+          "  --lsq N                             ooo engine: load/store queue entries (default 16)\n"
+          "  --mips be|le                        program files are raw MIPS32 machine code of that byte order\n"
+          "  --mips-base ADDR                    byte address the machine code is loaded at (default 0)\n"
+          "  --trace FILE                        pipeline engine: binary trace of every cycle, one run only\n"
+          "  --mem START:COUNT                   report COUNT memory words from START, repeatable\n"
+          "  --format json|csv                   output format (default json)\n"
+          "  --sample-period N                   sampled engine: instructions per sample period\n"
+          "  --sample-warmup N                   sampled engine: warm-up instructions per sample\n"
+          "  --sample-size N                     sampled engine: measured instructions per sample\n"
+          "  --jobs N                            worker threads (default: all cores)\n"
+          "  --repeat N                          run every program N times, as N lanes for wide\n"
+          "  --progress                          report progress and throughput on stderr\n";
+}
+
+// strtoull would take "-1" as 2^64 - 1, only plain digits are accepted
+bool parseU64(const std::string& s, uint64_t& out) {
+    if (s.empty() || s[0] < '0' || s[0] > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtoull(s.c_str(), &end, 10);
+    return errno == 0 && end && *end == '\0';
+}
+
+bool parseRange(const std::string& s, std::pair<int,int>& out) {
+    const auto colon = s.find(':');
+    if (colon == std::string::npos) return false;
+    try {
+        out.first = std::stoi(s.substr(0, colon));
+        out.second = std::stoi(s.substr(colon + 1));
+    } catch (...) {
+        return false;
+    }
+    return out.second >= 0;
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    bool btbSet = false, rasSet = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) { std::cerr << "missing value for " << a << "\n"; return false; }
+            out = argv[++i];
+            return true;
+        };
+        std::string v;
+
+        if (a == "-h" || a == "--help") {
+            usage(std::cout);
+            std::exit(0);
+        } else if (a == "--engine") {
+            if (!value(v)) return false;
+            const auto e = parseEngine(v);
+            if (!e) { std::cerr << "unknown engine: " << v << "\n"; return false; }
+            opt.sim.engine = *e;
+        } else if (a == "--max-cycles") {
+            if (!value(v) || !parseU64(v, opt.sim.maxCycles)) { std::cerr << "invalid --max-cycles\n"; return false; }
+        } else if (a == "--caches") {
+            opt.sim.caches = defaultCacheHierarchy();
+        } else if (a == "--predictor") {
+            if (!value(v)) return false;
+            const auto k = parsePredictor(v);
+            if (!k) { std::cerr << "unknown predictor: " << v << "\n"; return false; }
+            opt.sim.predictor.kind = *k;
+            if (!btbSet) opt.sim.predictor.btbEntries = 512;
+            if (!rasSet) opt.sim.predictor.rasDepth = 16;
+        } else if (a == "--issue-width") {
+            if (!value(v) || (v != "1" && v != "2")) {
+                std::cerr << "invalid --issue-width\n";
+                return false;
+            }
+            opt.sim.issueWidth = v == "2" ? 2 : 1;
+        } else if (a == "--branch-stage") {
+            if (!value(v)) return false;
+            if (v == "ex") opt.sim.branchStage = BranchStage::EX;
+            else if (v == "id") opt.sim.branchStage = BranchStage::ID;
+            else { std::cerr << "unknown branch stage: " << v << "\n"; return false; }
+        } else if (a == "--ooo-width" || a == "--rob" || a == "--rs" || a == "--lsq") {
+            uint64_t n;
+            if (!value(v) || !parseU64(v, n) || n == 0 || n > 4096) {
+                std::cerr << "invalid " << a << "\n";
+                return false;
+            }
+            OoOConfig& o = opt.sim.ooo;
+            (a == "--ooo-width" ? o.width : a == "--rob" ? o.robEntries : a == "--rs" ? o.rsEntries : o.lsqEntries) = (uint32_t)n;
+        } else if (a == "--btb" || a == "--ras") {
+            uint64_t n;
+            if (!value(v) || !parseU64(v, n) || n > 65536 || (a == "--btb" && (n & (n - 1)))) {
+                std::cerr << "invalid " << a << "\n";
+                return false;
+            }
+            if (a == "--btb") { opt.sim.predictor.btbEntries = (uint32_t)n; btbSet = true; }
+            else { opt.sim.predictor.rasDepth = (uint32_t)n; rasSet = true; }
+        } else if (a == "--mips") {
+            if (!value(v) || !opt.mipsFormat.parseByteOrder(v)) { std::cerr << "invalid --mips, expected be or le\n"; return false; }
+            opt.mips = true;
+        } else if (a == "--mips-base") {
+            if (!value(v) || !opt.mipsFormat.parseBase(v)) { std::cerr << "invalid --mips-base\n"; return false; }
+        } else if (a == "--trace") {
+            if (!value(opt.sim.tracePath) || opt.sim.tracePath.empty()) { std::cerr << "invalid --trace\n"; return false; }
+        } else if (a == "--mem") {
+            std::pair<int,int> r;
+            if (!value(v) || !parseRange(v, r)) { std::cerr << "invalid --mem, expected START:COUNT\n"; return false; }
+            opt.sim.memRanges.push_back(r);
+        } else if (a == "--format") {
+            if (!value(v)) return false;
+            if (v == "csv") opt.csv = true;
+            else if (v == "json") opt.csv = false;
+            else { std::cerr << "unknown format: " << v << "\n"; return false; }
+        } else if (a == "--sample-period") {
+            if (!value(v) || !parseU64(v, opt.sim.sampling.period)) { std::cerr << "invalid --sample-period\n"; return false; }
+        } else if (a == "--sample-warmup") {
+            if (!value(v) || !parseU64(v, opt.sim.sampling.warmupInstrs)) { std::cerr << "invalid --sample-warmup\n"; return false; }
+        } else if (a == "--sample-size") {
+            if (!value(v) || !parseU64(v, opt.sim.sampling.sampleInstrs)) { std::cerr << "invalid --sample-size\n"; return false; }
+        } else if (a == "--jobs") {
+            uint64_t n;
+            if (!value(v) || !parseU64(v, n) || n == 0 || n > 1024) { std::cerr << "invalid --jobs\n"; return false; }
+            opt.jobs = (unsigned)n;
+        } else if (a == "--repeat") {
+            if (!value(v) || !parseU64(v, opt.repeat) || opt.repeat == 0) { std::cerr << "invalid --repeat\n"; return false; }
+        } else if (a == "--progress") {
+            opt.progress = true;
+        } else if (!a.empty() && a[0] == '-') {
+            std::cerr << "unknown option: " << a << "\n";
+            return false;
+        } else {
+            opt.files.push_back(a);
+        }
+    }
+    if (opt.files.empty()) {
+        std::cerr << "no program files given\n";
+        return false;
+    }
+    if (opt.sim.issueWidth == 2 && opt.sim.branchStage == BranchStage::ID) {
+        std::cerr << "--branch-stage id needs --issue-width 1, dual issue resolves branches in EX\n";
+        return false;
+    }
+    if (!opt.sim.tracePath.empty()) {
+        // Every run would write the same file
+        if (opt.sim.engine != EngineKind::Pipeline || opt.files.size() != 1 || opt.repeat != 1) {
+            std::cerr << "--trace needs the pipeline engine and a single run\n";
+            return false;
+        }
+        // The file is only created when the run starts, a run that fails
+        // earlier leaves an existing trace alone
+    }
+    return true;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:   out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string csvField(const std::string& s) {
+    if (s.find_first_of(",\"\n") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+struct Entry {
+    std::string file;
+    std::string error;   // load failure, the result is meaningless if set
+    SimResult res;
+};
+
+void writeJson(std::ostream& os, const Options& opt, const std::vector<Entry>& entries) {
+    os << "{\n  \"engine\": \"" << engineName(opt.sim.engine) << "\",\n  \"results\": [";
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const Entry& en = entries[e];
+        const SimResult& r = en.res;
+        os << (e ? ",\n" : "\n") << "    {\n      \"program\": " << jsonString(en.file);
+        if (!en.error.empty()) {
+            os << ",\n      \"error\": " << jsonString(en.error) << "\n    }";
+            continue;
+        }
+        os << ",\n      \"halted\": " << (r.halted ? "true" : "false")
+           << ",\n      \"instructions\": " << r.instructions;
+        if (r.hasCycles) {
+            os << ",\n      \"cycles\": " << r.cycles
+               << ",\n      \"cpi\": " << r.cpi;
+        } else {
+            os << ",\n      \"cycles\": null,\n      \"cpi\": null";
+        }
+        if (opt.sim.engine == EngineKind::Sampled) {
+            os << ",\n      \"samples\": " << r.samples
+               << ",\n      \"cpi_ci95\": " << r.cpiCiHalfWidth;
+        }
+        if (r.hasStats) {
+            os << ",\n      \"stats\": {";
+            const char* sep = "";
+            r.stats.forEach([&](const char* name, uint64_t value) {
+                os << sep << "\"" << name << "\": " << value;
+                sep = ", ";
+            });
+            os << "}";
+        }
+        if (r.hasPredictor && r.predictor.total() > 0) {
+            os << ",\n      \"predictor\": {";
+            r.predictor.forEach([&](const char* name, uint64_t value) { os << "\"" << name << "\": " << value << ", "; });
+            os << "\"accuracy\": " << r.predictor.accuracy() << "}";
+        }
+        if (r.hasOoO) {
+            os << ",\n      \"ooo\": {";
+            r.ooo.forEach([&](const char* name, uint64_t value) { os << "\"" << name << "\": " << value << ", "; });
+            os << "\"ipc\": " << (r.cycles ? double(r.instructions) / double(r.cycles) : 0.0)
+               << ", \"avg_rob_occupancy\": " << (r.cycles ? double(r.ooo.robOccupancy) / double(r.cycles) : 0.0) << "}";
+        }
+        if (!r.cacheStats.empty()) {
+            os << ",\n      \"caches\": {";
+            const char* sep = "";
+            for (const auto& [level, st] : r.cacheStats) {
+                os << sep << "\"" << level << "\": {\"hits\": " << st.hits() << ", \"misses\": " << st.misses()
+                   << ", \"writebacks\": " << st.writebacks << "}";
+                sep = ", ";
+            }
+            os << "}";
+        }
+        os << ",\n      \"registers\": [";
+        for (int i = 0; i < 32; ++i) os << (i ? ", " : "") << r.regs[i];
+        os << "],\n      \"memory\": [";
+        size_t k = 0;
+        for (size_t m = 0; m < opt.sim.memRanges.size(); ++m) {
+            const auto& [start, count] = opt.sim.memRanges[m];
+            os << (m ? ", " : "") << "{\"start\": " << start << ", \"values\": [";
+            for (int i = 0; i < count; ++i) os << (i ? ", " : "") << r.memory[k++];
+            os << "]}";
+        }
+        os << "]\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+void writeCsv(std::ostream& os, const Options& opt, const std::vector<Entry>& entries) {
+    // Counter columns follow the memory words when the engine has them,
+    // perf_ keeps perf_cycles apart from the cycles column. The error
+    // column comes last and is only filled for a file that failed to load
+    // or run, whose other columns after engine stay empty
+    const bool stats = kPerfCounters && opt.sim.engine == EngineKind::Pipeline;
+    const bool caches = opt.sim.caches && opt.sim.engine == EngineKind::Pipeline;
+    const bool ooo = opt.sim.engine == EngineKind::OoO;
+
+    size_t columns = 6;
+    os << "program,engine,halted,instructions,cycles,cpi";
+    auto column = [&](const std::string& name) {
+        os << "," << name;
+        ++columns;
+    };
+    for (int i = 0; i < 32; ++i) column("r" + std::to_string(i));
+    for (const auto& [start, count] : opt.sim.memRanges) {
+        for (int i = 0; i < count; ++i) column("m" + std::to_string(start + i));
+    }
+    if (stats) PerfCounters{}.forEach([&](const char* name, uint64_t) { column(std::string("perf_") + name); });
+    if (ooo) OoOStats{}.forEach([&](const char* name, uint64_t) { column(name); });
+    if (caches) {
+        CacheHierarchy(*opt.sim.caches).forEachLevel([&](const char* level, const CacheStats&) {
+            for (const char* what : {"_hits", "_misses", "_writebacks"}) column(level + std::string(what));
+        });
+    }
+    os << ",error\n";
+
+    for (const Entry& en : entries) {
+        os << csvField(en.file) << "," << engineName(opt.sim.engine);
+        if (!en.error.empty()) {
+            os << std::string(columns - 1, ',') << csvField(en.error) << "\n";
+            continue;
+        }
+        const SimResult& r = en.res;
+        os << "," << (r.halted ? 1 : 0) << "," << r.instructions << ",";
+        if (r.hasCycles) os << r.cycles << "," << r.cpi;
+        else os << ",";
+        for (int v : r.regs) os << "," << v;
+        for (int v : r.memory) os << "," << v;
+        if (stats) r.stats.forEach([&](const char*, uint64_t value) { os << "," << value; });
+        if (ooo) r.ooo.forEach([&](const char*, uint64_t value) { os << "," << value; });
+        if (caches) {
+            for (const auto& [level, st] : r.cacheStats) os << "," << st.hits() << "," << st.misses() << "," << st.writebacks;
+        }
+        os << ",\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(std::cerr);
+        return 2;
+    }
+
+    // Load every file once, the jobs share the parsed program
+    std::vector<Entry> entries;
+    std::vector<SimJob> jobs;
+    bool failed = false;
+    for (const auto& file : opt.files) {
+        std::shared_ptr<const Program> program;
+        try {
+            program = std::make_shared<const Program>(opt.mips ? ProgramLoader::loadBinary(file, opt.mipsFormat)
+                                                               : ProgramLoader::loadFromFile(file));
+        } catch (const std::exception& e) {
+            Entry en;
+            en.file = file;
+            en.error = e.what();
+            entries.push_back(std::move(en));
+            std::cerr << "Failed to load '" << file << "': " << e.what() << "\n";
+            failed = true;
+            continue;
+        }
+        for (uint64_t r = 0; r < opt.repeat; ++r) {
+            Entry en;
+            en.file = file;
+            entries.push_back(std::move(en));
+            jobs.push_back(SimJob{program, opt.sim, {}});
+        }
+    }
+
+    auto report = [](const BatchProgress& p) {
+        std::cerr << p.completedJobs << "/" << p.totalJobs << " jobs, "
+                  << p.instructions << " instructions in " << p.seconds << " s ("
+                  << (p.seconds > 0 ? p.instructions / p.seconds / 1e6 : 0.0) << " MIPS)\n";
+    };
+
+    std::vector<SimResult> results;
+    if (opt.sim.engine == EngineKind::Wide) {
+        // The repeats of a file are lanes of one lockstep engine
+        const auto t0 = std::chrono::steady_clock::now();
+        BatchProgress p;
+        p.totalJobs = jobs.size();
+        for (size_t i = 0; i < jobs.size(); i += opt.repeat) {
+            const std::vector<std::vector<std::pair<int,int>>> lanes(opt.repeat);
+            for (SimResult& r : simulateWide(*jobs[i].program, opt.sim, lanes)) {
+                p.instructions += r.instructions;
+                results.push_back(std::move(r));
+            }
+        }
+        p.completedJobs = jobs.size();
+        p.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (opt.progress) {
+            std::cerr << "lockstep: ";
+            report(p);
+        }
+    } else if (!opt.sim.tracePath.empty()) {
+        // The one job runs here rather than on a worker, so a trace that
+        // could not be written is reported
+        for (const SimJob& j : jobs) {
+            try {
+                results.push_back(simulate(*j.program, j.config, j.initMem));
+            } catch (const std::exception& e) {
+                entries.front().error = e.what();
+                std::cerr << "Failed to run '" << entries.front().file << "': " << e.what() << "\n";
+                failed = true;
+            }
+        }
+    } else {
+        BatchRunner runner(opt.jobs);
+        if (opt.progress) runner.onProgress(report);
+
+        results = runner.run(jobs);
+        if (opt.progress) {
+            std::cerr << runner.threadCount() << " threads: ";
+            report(runner.progress());
+        }
+    }
+
+    size_t next = 0;
+    for (Entry& en : entries) {
+        if (!en.error.empty()) continue;
+        en.res = std::move(results[next++]);
+        if (!en.res.error.empty()) {
+            en.error = en.res.error;
+            std::cerr << "Failed to run '" << en.file << "': " << en.error << "\n";
+            failed = true;
+        }
+    }
+
+    std::ostringstream out;
+    out.precision(6);
+    if (opt.csv) writeCsv(out, opt, entries);
+    else writeJson(out, opt, entries);
+    std::cout << out.str();
+
+    return failed ? 1 : 0;
+}
@@ -1,27 +1,58 @@
 #include "CPU.hpp"
 #include "ProgramLoader.hpp"
+#include "TraceReplay.hpp"
 #include "Window.hpp"
 
 #include <iostream>
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
-static std::vector<Instruction> defaultDemoProgram() {
-    return {
-        {Opcode::ADDI, 0, 2, 0, 20, 0, "addi $2, $0, 20"},
-        {Opcode::ADDI, 0, 3, 0, 5,  0, "addi $3, $0, 5"},
-        {Opcode::ADD,  2, 3, 1, 0,  0, "add $1, $2, $3"},
-        {Opcode::ADDI, 1, 4, 0, 10, 0, "addi $4, $1, 10"},
-        {Opcode::SW,   0, 4, 0, 0,  0, "sw $4, 0($0)"},
-        {Opcode::LW,   0, 5, 0, 0,  0, "lw $5, 0($0)"},
-        {Opcode::SUB,  5, 4, 6, 0,  0, "sub $6, $5, $4"},
-    };
+static Program defaultDemoProgram() {
+    Program p;
+    p.append({Opcode::ADDI, 0, 2, 0, 20, 0}, "addi $2, $0, 20");
+    p.append({Opcode::ADDI, 0, 3, 0, 5,  0}, "addi $3, $0, 5");
+    p.append({Opcode::ADD,  2, 3, 1, 0,  0}, "add $1, $2, $3");
+    p.append({Opcode::ADDI, 1, 4, 0, 10, 0}, "addi $4, $1, 10");
+    p.append({Opcode::SW,   0, 4, 0, 0,  0}, "sw $4, 0($0)");
+    p.append({Opcode::LW,   0, 5, 0, 0,  0}, "lw $5, 0($0)");
+    p.append({Opcode::SUB,  5, 4, 6, 0,  0}, "sub $6, $5, $4");
+    return p;
 }
 
 int main(int argc, char** argv) {
     CPU cpu;
 
-    std::vector<Instruction> program;
+    Program program;
+
+    // --replay FILE opens a trace recorded by cpu_run --trace, the program
+    // argument then only supplies the instruction text. --mips be|le loads
+    // the program as raw MIPS32 machine code, at --mips-base ADDR if given.
+    std::optional<std::string> replayPath;
+    bool mips = false;
+    MipsFormat mipsFormat;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (a == "--mips" && i + 1 < argc) {
+            if (!mipsFormat.parseByteOrder(argv[++i])) {
+                std::cerr << "invalid --mips, expected be or le\n";
+                return 2;
+            }
+            mips = true;
+        } else if (a == "--mips-base" && i + 1 < argc) {
+            if (!mipsFormat.parseBase(argv[++i])) {
+                std::cerr << "invalid --mips-base\n";
+                return 2;
+            }
+        } else {
+            args.push_back(a);
+        }
+    }
 
     auto firstExisting = [](const std::vector<std::filesystem::path>& candidates)
             -> std::optional<std::filesystem::path> {
@@ -35,8 +66,8 @@ int main(int argc, char** argv) {
     };
 
     std::optional<std::filesystem::path> resolved;
-    if (argc >= 2) {
-        resolved = std::filesystem::path(argv[1]);
+    if (!args.empty()) {
+        resolved = std::filesystem::path(args[0]);
     } else {
         const std::filesystem::path exePath = (argc >= 1) ? std::filesystem::path(argv[0]) : std::filesystem::path();
         const std::filesystem::path exeDir  = exePath.has_parent_path() ? exePath.parent_path() : std::filesystem::current_path();
@@ -52,7 +83,8 @@ int main(int argc, char** argv) {
 
     if (resolved && std::filesystem::exists(*resolved)) {
         try {
-            program = ProgramLoader::loadFromFile(resolved->string());
+            program = mips ? ProgramLoader::loadBinary(resolved->string(), mipsFormat)
+                           : ProgramLoader::loadFromFile(resolved->string());
             std::cout << "Loaded program from: " << resolved->string() << " (" << program.size() << " instructions)\n";
         } catch (const std::exception& e) {
             std::cerr << "Failed to load '" << resolved->string() << "': " << e.what() << "\n";
@@ -70,7 +102,18 @@ int main(int argc, char** argv) {
     // Start from a clean architectural
     cpu.reset(true);
 
-    App ui(cpu);
+    std::unique_ptr<TraceReplay> replay;
+    if (replayPath) {
+        try {
+            replay = std::make_unique<TraceReplay>(*replayPath);
+            std::cout << "Replaying " << replay->length() << " cycles from: " << *replayPath << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to open trace '" << *replayPath << "': " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    App ui(cpu, replay.get());
     ui.run();
 
     return 0;
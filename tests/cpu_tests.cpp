@@ -1,9 +1,29 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <cstring>
+#include <cstddef>
 
+#include "BatchRunner.hpp"
 #include "CPU.hpp"
+#include "Engine.hpp"
+#include "FunctionalCPU.hpp"
+#include "MultiCoreSystem.hpp"
+#include "OoOCPU.hpp"
+#include "SampledSimulation.hpp"
+#include "TraceReplay.hpp"
+#include "Simulation.hpp"
+#include "WideCPU.hpp"
+#include "Workloads.hpp"
 #include "Instructions.hpp"
+#include "ProgramLoader.hpp"
 
 namespace {
 
@@ -19,7 +39,13 @@ int g_failures = 0;
     } \
 } while(0)
 
-static Instruction I(Opcode op, int rs=0, int rt=0, int rd=0, int imm=0, int addr=0, const std::string& txt="") {
+// An instruction plus its listing text, the text goes to the Program side table
+struct Line {
+    Instruction ins;
+    std::string txt;
+};
+
+static Line I(Opcode op, int rs=0, int rt=0, int rd=0, int imm=0, int addr=0, const std::string& txt="") {
     Instruction ins;
     ins.op = op;
     ins.rs = rs;
@@ -27,8 +53,13 @@ static Instruction I(Opcode op, int rs=0, int rt=0, int rd=0, int imm=0, int add
     ins.rd = rd;
     ins.imm = imm;
     ins.addr = addr;
-    ins.raw_text = txt;
-    return ins;
+    return {ins, txt};
+}
+
+static Program toProgram(const std::vector<Line>& lines) {
+    Program prog;
+    for (const auto& l : lines) prog.append(l.ins, l.txt);
+    return prog;
 }
 
 static void runCPU(CPU& cpu, int max_cycles) {
@@ -37,8 +68,25 @@ static void runCPU(CPU& cpu, int max_cycles) {
     }
 }
 
-static void runProgramAndDrain(CPU& cpu, const std::vector<Instruction>& prog) {
-    cpu.loadProgram(prog);
+static void runToHalt(CPU& cpu, int max_cycles = 100000) {
+    for (int i = 0; i < max_cycles && !cpu.isHalted(); ++i) {
+        cpu.tick();
+    }
+}
+
+// Every demo program plus the top-level stress test
+static std::vector<std::string> programFiles() {
+    std::vector<std::string> files;
+    for (const auto& e : std::filesystem::directory_iterator(SCS_PROGRAMS_DIR)) {
+        if (e.path().extension() == ".txt") files.push_back(e.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    files.push_back(SCS_PROGRAMS_DIR "/../program.txt");
+    return files;
+}
+
+static void runProgramAndDrain(CPU& cpu, const std::vector<Line>& prog) {
+    cpu.loadProgram(toProgram(prog));
     const int max_cycles = static_cast<int>(prog.size()) + 20;
     runCPU(cpu, max_cycles);
 }
@@ -46,7 +94,7 @@ static void runProgramAndDrain(CPU& cpu, const std::vector<Instruction>& prog) {
 static void test_alu_forwarding() {
     std::cout << "[TEST] alu_forwarding\n";
     CPU cpu;
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 1, 0, 5, 0, "addi $1,$0,5"),
         I(Opcode::ADDI, 0, 2, 0, 7, 0, "addi $2,$0,7"),
         I(Opcode::ADD,  1, 2, 3, 0, 0, "add  $3,$1,$2"),
@@ -68,7 +116,7 @@ static void test_xor_rtype_and_forwarding() {
     // r2 = 0b110011 (51)
     // r3 = r1 ^ r2 = 0b011001 (25)
     // r4 = r3 ^ r1 = 0b110011 (51)  (checks EX forwarding)
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 1, 0, 42, 0, "addi $1,$0,42"),
         I(Opcode::ADDI, 0, 2, 0, 51, 0, "addi $2,$0,51"),
         I(Opcode::XOR,  1, 2, 3, 0,  0, "xor  $3,$1,$2"),
@@ -87,7 +135,7 @@ static void test_load_use_stall_and_mem_to_ex_forward() {
     CPU cpu;
     cpu.setMemWord(0, 42);
 
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::LW,   0, 1, 0, 0, 0, "lw   $1,0($0)"),
         I(Opcode::ADD,  1, 1, 2, 0, 0, "add  $2,$1,$1"),
         I(Opcode::ADDI, 2, 3, 0, 1, 0, "addi $3,$2,1"),
@@ -103,7 +151,7 @@ static void test_store_data_forwarding() {
     std::cout << "[TEST] store_data_forwarding\n";
     CPU cpu;
 
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 1, 0, 99, 0, "addi $1,$0,99"),
         I(Opcode::SW,   0, 1, 0, 0,  0, "sw   $1,0($0)"),
         I(Opcode::LW,   0, 2, 0, 0,  0, "lw   $2,0($0)"),
@@ -125,7 +173,7 @@ static void test_branch_taken_flush() {
     // 3: (flushed)
     // 4: (flushed)
     // 5: r3=789
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 1, 0, 1,   0, "addi $1,$0,1"),
         I(Opcode::ADDI, 0, 2, 0, 1,   0, "addi $2,$0,1"),
         I(Opcode::BEQ,  1, 2, 0, 2,   0, "beq  $1,$2,2"),
@@ -142,7 +190,7 @@ static void test_branch_not_taken_with_forward_to_branch() {
     std::cout << "[TEST] branch_not_taken_with_forward_to_branch\n";
     CPU cpu;
 
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 1, 0, 5, 0, "addi $1,$0,5"),
         I(Opcode::ADDI, 0, 2, 0, 6, 0, "addi $2,$0,6"),
         I(Opcode::SUB,  2, 1, 3, 0, 0, "sub  $3,$2,$1"), // r3=1
@@ -172,7 +220,7 @@ static void test_jal_jr_control_hazards() {
     // 6: nop
     // end:
     // 7: addi r3,333
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::JAL, 0,0,0,0,4, "jal 4"),
         I(Opcode::ADDI,0,1,0,111,0, "addi $1,$0,111"),
         I(Opcode::J,   0,0,0,0,7, "j 7"),
@@ -200,7 +248,7 @@ static void test_branch_after_load_use_stall() {
     // 2: addi r2,111        => flushed
     // 3: addi r2,222
     // This requires a load-use stall because the branch reads r1.
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::LW,   0, 1, 0, 0, 0, "lw   $1,0($0)"),
         I(Opcode::BEQ,  1, 0, 0, 1, 0, "beq  $1,$0,1"),
         I(Opcode::ADDI, 0, 2, 0, 111, 0, "addi $2,$0,111"),
@@ -220,7 +268,7 @@ static void test_store_after_load_stall_and_forward() {
     // 0: lw r1,0(r0)    => r1=77
     // 1: sw r1,4(r0)    => must store 77 (requires load-use stall)
     // 2: lw r2,4(r0)    => r2=77
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::LW, 0, 1, 0, 0, 0, "lw   $1,0($0)"),
         I(Opcode::SW, 0, 1, 0, 4, 0, "sw   $1,4($0)"),
         I(Opcode::LW, 0, 2, 0, 4, 0, "lw   $2,4($0)"),
@@ -236,7 +284,7 @@ static void test_zero_register_immutable() {
     std::cout << "[TEST] zero_register_immutable\n";
     CPU cpu;
 
-    std::vector<Instruction> p = {
+    std::vector<Line> p = {
         I(Opcode::ADDI, 0, 0, 0, 123, 0, "addi $0,$0,123"),
         I(Opcode::ADDI, 0, 1, 0, 5,   0, "addi $1,$0,5"),
         I(Opcode::ADD,  1, 0, 0, 0,   0, "add  $0,$1,$0"),
@@ -247,6 +295,1740 @@ static void test_zero_register_immutable() {
     EXPECT_EQ(cpu.getReg(1), 5);
 }
 
+static void test_program_text_table() {
+    std::cout << "[TEST] program_text_table\n";
+
+    // Loader keeps the source line, the latch only carries the index handle
+    const Program loaded = ProgramLoader::loadFromFile(SCS_PROGRAMS_DIR "/04_branch_taken_flush.txt");
+    EXPECT_EQ((int)loaded.size(), 6);
+    EXPECT_EQ(std::string(loaded.text(2)), std::string("beq  $1, $2, 5"));
+    EXPECT_EQ(loaded[2].index, 2);
+    EXPECT_EQ(loaded[2].imm, 2);
+
+    // Without text the table falls back to disassembly in loader syntax
+    const Program bare(std::vector<Instruction>{
+        I(Opcode::ADDI, 0, 1, 0, 5).ins,
+        I(Opcode::BEQ,  1, 2, 0, 1).ins,
+        I(Opcode::LW,   3, 4, 0, 8).ins,
+    });
+    EXPECT_EQ(std::string(bare.text(0)), std::string("addi $1, $0, 5"));
+    EXPECT_EQ(std::string(bare.text(1)), std::string("beq $1, $2, 3"));
+    EXPECT_EQ(std::string(bare.text(2)), std::string("lw $4, 8($3)"));
+    EXPECT_EQ(std::string(bare.text(-1)), std::string(""));
+
+    // Pipeline latches point back into the table
+    CPU cpu;
+    cpu.loadProgram(loaded);
+    cpu.tick();
+    EXPECT_EQ(std::string(cpu.program().text(cpu.pipeline().if_id.cur().rawInstr)), std::string("addi $1, $0, 1"));
+}
+
+static void test_latch_hold_and_bubble() {
+    std::cout << "[TEST] latch_hold_and_bubble\n";
+    Latch<IF_ID> l;
+
+    l.next().pc = 7;
+    l.next().valid = true;
+    l.commit();
+    EXPECT_EQ(l.cur().pc, 7);
+
+    // Held latch keeps its bank even if next() was scribbled on
+    l.next().pc = 8;
+    l.hold();
+    l.commit();
+    EXPECT_EQ(l.cur().pc, 7);
+    EXPECT_EQ(l.cur().valid, true);
+
+    // Bubble invalidates what gets latched, held or not
+    l.next().pc = 9;
+    l.next().valid = true;
+    l.bubble();
+    l.commit();
+    EXPECT_EQ(l.cur().pc, 9);
+    EXPECT_EQ(l.cur().valid, false);
+}
+
+static void test_functional_matches_pipeline() {
+    std::cout << "[TEST] functional_matches_pipeline\n";
+
+    for (const auto& file : programFiles()) {
+        const Program prog = ProgramLoader::loadFromFile(file);
+
+        CPU cpu;
+        cpu.loadProgram(prog);
+        runToHalt(cpu);
+
+        FunctionalCPU iss;
+        iss.loadProgram(prog);
+        iss.run(100000);
+
+        EXPECT_EQ(cpu.isHalted(), true);
+        EXPECT_EQ(iss.isHalted(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(iss.getReg(r), cpu.getReg(r));
+        EXPECT_EQ(iss.memory() == cpu.memory(), true);
+    }
+}
+
+static void test_functional_step_budget() {
+    std::cout << "[TEST] functional_step_budget\n";
+    FunctionalCPU iss;
+
+    // 0: r1=3  1: r2+=2  2: r1-=1  3: bne r1,r0 -> 1
+    iss.loadProgram(toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 3),
+        I(Opcode::ADDI, 2, 2, 0, 2),
+        I(Opcode::ADDI, 1, 1, 0, -1),
+        I(Opcode::BNE,  1, 0, 0, -3),
+    }));
+
+    EXPECT_EQ(iss.step(), true);
+    EXPECT_EQ(iss.pc, 1);
+    EXPECT_EQ(iss.getReg(1), 3);
+
+    // 1, 2, 3 (taken back to 1), 1
+    EXPECT_EQ((int)iss.run(4), 4);
+    EXPECT_EQ(iss.pc, 2);
+    EXPECT_EQ(iss.getReg(2), 4);
+
+    iss.run(1000);
+    EXPECT_EQ(iss.isHalted(), true);
+    EXPECT_EQ((int)iss.retired, 10);
+    EXPECT_EQ(iss.getReg(2), 6);
+    EXPECT_EQ(iss.step(), false);
+}
+
+// Counted loop with ALU work, a store/load pair and a taken backward branch
+static std::vector<Line> countedLoop(int iterations) {
+    return {
+        I(Opcode::ADDI, 0, 1, 0, iterations),
+        I(Opcode::ADDI, 2, 2, 0, 1),
+        I(Opcode::ADD,  3, 2, 3),
+        I(Opcode::SW,   0, 3, 0, 5),
+        I(Opcode::LW,   0, 4, 0, 5),
+        I(Opcode::ADDI, 1, 1, 0, -1),
+        I(Opcode::BNE,  1, 0, 0, -6),
+    };
+}
+
+static void test_arch_state_handover() {
+    std::cout << "[TEST] arch_state_handover\n";
+    const Program prog = toProgram(countedLoop(50));
+
+    // Run 100 instructions functionally, then finish on the pipeline
+    FunctionalCPU iss;
+    iss.loadProgram(prog);
+    iss.run(100);
+
+    CPU cpu;
+    cpu.loadProgram(prog);
+    cpu.setArchState(iss.pc, iss.regFile(), iss.memory());
+    runToHalt(cpu);
+
+    // Drain mid-run must leave a precise pc to resume from
+    CPU part;
+    part.loadProgram(prog);
+    for (int i = 0; i < 37; ++i) part.tick();
+    part.drain();
+    FunctionalCPU rest;
+    rest.loadProgram(prog);
+    rest.setArchState(part.pc, part.regFile(), part.memory());
+    rest.run(100000);
+
+    CPU full;
+    full.loadProgram(prog);
+    runToHalt(full);
+
+    EXPECT_EQ((int)full.retired, 1 + 50 * 6);
+    for (int r = 0; r < 32; ++r) {
+        EXPECT_EQ(cpu.getReg(r), full.getReg(r));
+        EXPECT_EQ(rest.getReg(r), full.getReg(r));
+    }
+    EXPECT_EQ(cpu.getMemWord(5), full.getMemWord(5));
+    EXPECT_EQ(rest.getMemWord(5), full.getMemWord(5));
+}
+
+static void test_sampled_cpi_estimate() {
+    std::cout << "[TEST] sampled_cpi_estimate\n";
+    const Program prog = toProgram(countedLoop(5000));
+
+    CPU full;
+    full.loadProgram(prog);
+    runToHalt(full, 1000000);
+    const double trueCpi = double(full.clock) / double(full.retired);
+
+    SamplingConfig cfg;
+    cfg.period = 3000;
+    cfg.warmupInstrs = 200;
+    cfg.sampleInstrs = 300;
+    SampledSimulation sim(cfg);
+    sim.loadProgram(prog);
+    const SamplingResult res = sim.run();
+
+    EXPECT_EQ(res.halted, true);
+    EXPECT_EQ(res.instructions, full.retired);
+    EXPECT_EQ(res.sampleCpi.size() >= 8, true);
+    EXPECT_EQ(std::fabs(res.cpiMean - trueCpi) < 0.05, true);
+    EXPECT_EQ(res.detailedInstrs < res.instructions / 4, true);
+    for (int r = 0; r < 32; ++r) EXPECT_EQ(sim.functional().getReg(r), full.getReg(r));
+}
+
+static void test_jit_matches_interpreter() {
+    std::cout << "[TEST] jit_matches_interpreter\n";
+
+    std::vector<Program> progs;
+    for (const auto& file : programFiles()) progs.push_back(ProgramLoader::loadFromFile(file));
+    progs.push_back(toProgram(countedLoop(300)));
+
+    for (const Program& prog : progs) {
+        FunctionalCPU ref;
+        ref.loadProgram(prog);
+        ref.run(1000000);
+
+        FunctionalCPU jit;
+        jit.setBackend(FunctionalCPU::Backend::Jit);
+        jit.loadProgram(prog);
+        jit.run(1000000);
+
+        EXPECT_EQ(jit.isHalted(), true);
+        EXPECT_EQ(jit.retired, ref.retired);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(jit.getReg(r), ref.getReg(r));
+        for (int a = 0; a < 64; ++a) EXPECT_EQ(jit.getMemWord(a), ref.getMemWord(a));
+    }
+}
+
+static void test_jit_budget_chaining_and_reload() {
+    std::cout << "[TEST] jit_budget_chaining_and_reload\n";
+
+    FunctionalCPU jit;
+    jit.setBackend(FunctionalCPU::Backend::Jit);
+    jit.loadProgram(toProgram(countedLoop(100)));
+
+    FunctionalCPU ref;
+    ref.loadProgram(toProgram(countedLoop(100)));
+
+    // Odd budgets split blocks, the tail of each run is interpreted
+    for (uint64_t chunk : {1u, 5u, 13u, 64u, 1000u}) {
+        EXPECT_EQ(jit.run(chunk), ref.run(chunk));
+        EXPECT_EQ(jit.pc, ref.pc);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(jit.getReg(r), ref.getReg(r));
+    }
+
+    if (jit.jitActive()) {
+        EXPECT_EQ(jit.jitCache()->chainedExits() > 0, true);
+    }
+
+    // Reloading must not run translations of the previous program
+    jit.loadProgram(toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 42),
+        I(Opcode::JAL,  0, 0, 0, 0, 3),
+        I(Opcode::J,    0, 0, 0, 0, 5),
+        I(Opcode::JR,   31),
+    }));
+    jit.reset(true);
+    jit.run(100);
+    EXPECT_EQ(jit.isHalted(), true);
+    EXPECT_EQ(jit.getReg(1), 42);
+    EXPECT_EQ(jit.getReg(31), 2);
+    EXPECT_EQ(jit.getReg(2), 0);
+}
+
+static void test_batch_matches_serial() {
+    std::cout << "[TEST] batch_matches_serial\n";
+
+    std::vector<std::shared_ptr<const Program>> progs;
+    for (const auto& file : programFiles()) {
+        progs.push_back(std::make_shared<const Program>(ProgramLoader::loadFromFile(file)));
+    }
+    progs.push_back(std::make_shared<const Program>(toProgram(countedLoop(200))));
+
+    // Every program on every engine, with distinct initial memory per job
+    std::vector<SimJob> jobs;
+    for (int rep = 0; rep < 3; ++rep) {
+        for (const auto& prog : progs) {
+            for (EngineKind e : {EngineKind::Pipeline, EngineKind::ISS, EngineKind::JIT, EngineKind::OoO}) {
+                SimJob j;
+                j.program = prog;
+                j.config.engine = e;
+                j.config.memRanges = {{0, 16}};
+                j.initMem = {{10, rep}, {11, (int)jobs.size()}};
+                jobs.push_back(std::move(j));
+            }
+        }
+    }
+
+    BatchRunner runner(4);
+    const std::vector<SimResult> batch = runner.run(jobs);
+    EXPECT_EQ(batch.size(), jobs.size());
+
+    uint64_t instrs = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const SimResult ref = simulate(*jobs[i].program, jobs[i].config, jobs[i].initMem);
+        EXPECT_EQ(batch[i].halted, ref.halted);
+        EXPECT_EQ(batch[i].instructions, ref.instructions);
+        EXPECT_EQ(batch[i].cycles, ref.cycles);
+        EXPECT_EQ(batch[i].regs == ref.regs, true);
+        EXPECT_EQ(batch[i].memory == ref.memory, true);
+        instrs += ref.instructions;
+    }
+
+    const BatchProgress p = runner.progress();
+    EXPECT_EQ(p.completedJobs, (uint64_t)jobs.size());
+    EXPECT_EQ(p.totalJobs, (uint64_t)jobs.size());
+    EXPECT_EQ(p.instructions, instrs);
+
+    // A job whose engine rejects its config fails alone
+    {
+        std::vector<SimJob> bad = {jobs[0], jobs[0], jobs[2], jobs[3]};
+        bad[1].config.predictor.btbEntries = 3;
+        bad[3].config.ooo.robEntries = 0;
+        const std::vector<SimResult> res = runner.run(bad);
+        EXPECT_EQ(res[1].error.find("power of two") != std::string::npos, true);
+        EXPECT_EQ(res[3].error.find("non-zero") != std::string::npos, true);
+        EXPECT_EQ(res[0].error.empty() && res[2].error.empty(), true);
+        EXPECT_EQ(res[2].regs == batch[2].regs, true);
+        EXPECT_EQ(runner.progress().completedJobs, (uint64_t)4);
+    }
+
+    // More workers than jobs leaves most of them with nothing to steal
+    BatchRunner wide(8);
+    EXPECT_EQ(wide.run({jobs[0]}).size(), (size_t)1);
+    EXPECT_EQ(wide.run({}).size(), (size_t)0);
+}
+
+static void test_wide_lanes_match_cpu() {
+    std::cout << "[TEST] wide_lanes_match_cpu\n";
+
+    // Loop trip count, call and exit path all depend on the lane's memory
+    const Program divergent = toProgram({
+        I(Opcode::LW,   0, 1, 0, 0),
+        I(Opcode::LW,   0, 5, 0, 2),
+        I(Opcode::BEQ,  1, 0, 0, 4),
+        I(Opcode::ADD,  2, 1, 2),
+        I(Opcode::ADDI, 1, 1, 0, -1),
+        I(Opcode::SLT,  5, 2, 6),
+        I(Opcode::BNE,  1, 0, 0, -4),
+        I(Opcode::SW,   0, 2, 0, 1),
+        I(Opcode::LW,   0, 3, 0, 1),
+        I(Opcode::ADD,  3, 3, 4),
+        I(Opcode::BEQ,  6, 0, 0, 2),
+        I(Opcode::JAL,  0, 0, 0, 0, 15),
+        I(Opcode::J,    0, 0, 0, 0, 17),
+        I(Opcode::XOR,  4, 5, 7),
+        I(Opcode::J,    0, 0, 0, 0, 17),
+        I(Opcode::ORI,  4, 8, 0, 5),
+        I(Opcode::JR,   31),
+    });
+
+    std::vector<std::pair<Program, int>> cases = {{divergent, 37}};
+    for (const auto& file : programFiles()) cases.push_back({ProgramLoader::loadFromFile(file), 3});
+
+    for (WideCPU::Kernel k : {WideCPU::Kernel::Scalar, WideCPU::Kernel::SSE2, WideCPU::Kernel::AVX2}) {
+        for (const auto& [prog, lanes] : cases) {
+            WideCPU wide(lanes);
+            if (!wide.setKernel(k)) continue;
+            wide.loadProgram(prog);
+            for (int l = 0; l < lanes; ++l) {
+                wide.setMemWord(l, 0, l % 7);
+                wide.setMemWord(l, 2, l * 3 - 50);
+            }
+
+            // A short first run leaves lanes mid-flight, the second one finishes them
+            wide.run(5);
+            wide.run(100000);
+            EXPECT_EQ(wide.allHalted(), true);
+
+            for (int l = 0; l < lanes; ++l) {
+                CPU cpu;
+                cpu.loadProgram(prog);
+                cpu.setMemWord(0, l % 7);
+                cpu.setMemWord(2, l * 3 - 50);
+                runToHalt(cpu);
+
+                EXPECT_EQ(wide.retired(l), cpu.retired);
+                EXPECT_EQ(wide.cycles(l), (uint64_t)cpu.clock);
+                for (int r = 0; r < 32; ++r) EXPECT_EQ(wide.getReg(l, r), cpu.getReg(r));
+                for (int a = 0; a < 16; ++a) EXPECT_EQ(wide.getMemWord(l, a), cpu.getMemWord(a));
+            }
+        }
+    }
+}
+
+static void test_workloads_hit_target_size() {
+    std::cout << "[TEST] workloads_hit_target_size\n";
+
+    for (WorkloadKind kind : {WorkloadKind::Loop, WorkloadKind::LoadHeavy,
+                              WorkloadKind::BranchHeavy, WorkloadKind::CallHeavy}) {
+        EXPECT_EQ(parseWorkload(workloadName(kind)) == kind, true);
+
+        const Program prog = makeWorkload(kind, 5000);
+        FunctionalCPU iss;
+        iss.loadProgram(prog);
+        iss.run(100000);
+        EXPECT_EQ(iss.isHalted(), true);
+        EXPECT_EQ(iss.retired > 4500 && iss.retired < 5500, true);
+
+        CPU cpu;
+        cpu.loadProgram(prog);
+        runToHalt(cpu);
+        EXPECT_EQ(cpu.retired, iss.retired);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(cpu.getReg(r), iss.getReg(r));
+    }
+}
+
+static void test_perf_counters() {
+    std::cout << "[TEST] perf_counters\n";
+    if (!kPerfCounters) return;
+
+    // One load-use stall, the dependent add then reads the load through MEM/WB
+    CPU cpu;
+    cpu.loadProgram(toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 9),
+        I(Opcode::SW,   0, 1, 0, 3),
+        I(Opcode::LW,   0, 2, 0, 3),
+        I(Opcode::ADD,  2, 1, 3),
+        I(Opcode::BEQ,  3, 3, 0, 2),
+        I(Opcode::ADDI, 0, 4, 0, 1),
+        I(Opcode::ADDI, 0, 5, 0, 1),
+        I(Opcode::NOP),
+    }));
+    runToHalt(cpu);
+
+    const PerfCounters& st = cpu.stats();
+    EXPECT_EQ(st.cycles, (uint64_t)cpu.clock);
+    EXPECT_EQ(st.loadUseStalls, (uint64_t)1);
+    EXPECT_EQ(st.redirects, (uint64_t)1);
+    EXPECT_EQ(st.flushed, (uint64_t)2);
+    EXPECT_EQ(st.fwdMemWb >= 1, true);
+    EXPECT_EQ(st.fwdExMem >= 2, true);
+
+    // Invariants over the corpus
+    for (const auto& file : programFiles()) {
+        CPU c;
+        c.loadProgram(ProgramLoader::loadFromFile(file));
+        runToHalt(c);
+        const PerfCounters& s = c.stats();
+        EXPECT_EQ(s.cycles, (uint64_t)c.clock);
+        EXPECT_EQ(s.bubblesWB, s.cycles - c.retired);
+        EXPECT_EQ(s.flushed <= 2 * s.redirects, true);
+    }
+
+    cpu.reset(true);
+    EXPECT_EQ(cpu.stats().cycles, (uint64_t)0);
+}
+
+static void test_sparse_memory() {
+    std::cout << "[TEST] sparse_memory\n";
+
+    // Stack below zero, data far up, and a read of a page nobody wrote
+    const Program prog = toProgram({
+        I(Opcode::ADDI, 0, 29, 0, -16),
+        I(Opcode::ADDI, 0, 1, 0, 0x40000000),
+        I(Opcode::ADDI, 0, 2, 0, 7),
+        I(Opcode::SW,   29, 2, 0, 0),
+        I(Opcode::SW,   1, 2, 0, 5),
+        I(Opcode::LW,   29, 3, 0, 0),
+        I(Opcode::LW,   1, 4, 0, 5),
+        I(Opcode::LW,   1, 5, 0, 100000),
+        I(Opcode::ADD,  3, 4, 6),
+        I(Opcode::SW,   29, 6, 0, -1),
+    });
+
+    CPU cpu;
+    cpu.loadProgram(prog);
+    EXPECT_EQ(cpu.memory().residentPages(), (size_t)0);
+    runToHalt(cpu);
+
+    EXPECT_EQ(cpu.getReg(6), 14);
+    EXPECT_EQ(cpu.getReg(5), 0);
+    EXPECT_EQ(cpu.getMemWord(-17), 14);
+    EXPECT_EQ(cpu.getMemWord(0x40000005), 7);
+
+    // Only writes allocate: the top page and the one at 0x40000000
+    EXPECT_EQ(cpu.memory().residentPages(), (size_t)2);
+    EXPECT_EQ(cpu.memory().size(), (size_t)2 * Memory::kPageWords);
+
+    Memory copy = cpu.memory();
+    EXPECT_EQ(copy == cpu.memory(), true);
+    copy.writeNext(3, 1);
+    copy.commit();
+    EXPECT_EQ(copy == cpu.memory(), false);
+    EXPECT_EQ(copy.residentPages(), (size_t)3);
+
+    for (auto backend : {FunctionalCPU::Backend::Interpreter, FunctionalCPU::Backend::Jit}) {
+        FunctionalCPU iss;
+        iss.setBackend(backend);
+        iss.loadProgram(prog);
+        iss.run(100);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(iss.getReg(r), cpu.getReg(r));
+        EXPECT_EQ(iss.memory() == cpu.memory(), true);
+    }
+
+    WideCPU wide(3);
+    wide.loadProgram(prog);
+    wide.run(100);
+    for (int l = 0; l < 3; ++l) {
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(wide.getReg(l, r), cpu.getReg(r));
+        EXPECT_EQ(wide.getMemWord(l, -17), 14);
+        EXPECT_EQ(wide.getMemWord(l, 0x40000005), 7);
+    }
+
+    cpu.reset(true);
+    EXPECT_EQ(cpu.memory().residentPages(), (size_t)0);
+}
+
+static void test_snapshot_restore() {
+    std::cout << "[TEST] snapshot_restore\n";
+
+    const Program prog = makeWorkload(WorkloadKind::LoadHeavy, 3000);
+    CPU cpu;
+    cpu.loadProgram(prog);
+    for (int a = 0; a < 8 * (int)Memory::kPageWords; a += 64) cpu.setMemWord(a, a);
+    runCPU(cpu, 700);
+
+    // Many snapshots, each followed by a bit of execution that writes memory
+    std::vector<CPU::Snapshot> snaps;
+    std::vector<int> clocks;
+    for (int i = 0; i < 200; ++i) {
+        snaps.push_back(cpu.snapshot());
+        clocks.push_back(cpu.clock);
+        runCPU(cpu, 3);
+        cpu.setMemWord(i * 64, -i);
+    }
+    runToHalt(cpu);
+    const CPU::Snapshot end = cpu.snapshot();
+
+    // Restoring the first snapshot replays into exactly the same end state
+    cpu.restore(snaps.front());
+    EXPECT_EQ(cpu.clock, clocks.front());
+    EXPECT_EQ(cpu.getMemWord(64), 64);
+    for (int i = 0; i < 200; ++i) {
+        runCPU(cpu, 3);
+        cpu.setMemWord(i * 64, -i);
+    }
+    runToHalt(cpu);
+    EXPECT_EQ(cpu.clock, end.clock);
+    EXPECT_EQ(cpu.retired, end.retired);
+    EXPECT_EQ(cpu.memory() == end.mem, true);
+    for (int r = 0; r < 32; ++r) EXPECT_EQ(cpu.getReg(r), end.regs.read(r));
+    if (kPerfCounters) EXPECT_EQ(cpu.stats().loadUseStalls, end.perf.loadUseStalls);
+
+    // Writes after a restore never reach the snapshot
+    cpu.restore(snaps[100]);
+    EXPECT_EQ(cpu.getMemWord(99 * 64), -99);
+    EXPECT_EQ(cpu.getMemWord(100 * 64), 100 * 64);
+    cpu.setMemWord(100 * 64, 12345);
+    cpu.setMemWord(1 << 20, 1);
+    EXPECT_EQ(snaps[100].mem.read(100 * 64), 100 * 64);
+    EXPECT_EQ(snaps[100].mem.read(1 << 20), 0);
+    EXPECT_EQ(cpu.memory().residentPages(), snaps[100].mem.residentPages() + 1);
+}
+
+static void test_step_back() {
+    std::cout << "[TEST] step_back\n";
+
+    for (const auto& file : programFiles()) {
+        CPU cpu;
+        cpu.loadProgram(ProgramLoader::loadFromFile(file));
+        cpu.enableJournal();
+
+        std::vector<CPU::Snapshot> history;
+        while (!cpu.isHalted()) {
+            history.push_back(cpu.snapshot());
+            cpu.tick();
+        }
+        const CPU::Snapshot end = cpu.snapshot();
+        EXPECT_EQ(cpu.journalDepth(), (uint64_t)history.size());
+
+        // Walk all the way back, every cycle must match what it was going forward
+        for (size_t i = history.size(); i-- > 0;) {
+            EXPECT_EQ(cpu.stepBack(), (uint64_t)1);
+            const CPU::Snapshot& h = history[i];
+            EXPECT_EQ(cpu.pc, h.pc);
+            EXPECT_EQ(cpu.clock, h.clock);
+            EXPECT_EQ(cpu.retired, h.retired);
+            EXPECT_EQ(cpu.memory() == h.mem, true);
+            for (int r = 0; r < 32; ++r) EXPECT_EQ(cpu.getReg(r), h.regs.read(r));
+            if (kPerfCounters) EXPECT_EQ(cpu.stats().fwdExMem, h.perf.fwdExMem);
+
+            const PipelineRegisters& p = cpu.pipeline();
+            EXPECT_EQ(p.if_id.cur().valid, h.pipe.if_id.cur().valid);
+            EXPECT_EQ(p.id_ex.cur().valid, h.pipe.id_ex.cur().valid);
+            EXPECT_EQ(p.ex_mem.cur().valid, h.pipe.ex_mem.cur().valid);
+            EXPECT_EQ(p.mem_wb.cur().valid, h.pipe.mem_wb.cur().valid);
+            if (p.id_ex.cur().valid) EXPECT_EQ(p.id_ex.cur().val_rt, h.pipe.id_ex.cur().val_rt);
+            if (p.mem_wb.cur().valid) EXPECT_EQ(p.mem_wb.cur().alu_result, h.pipe.mem_wb.cur().alu_result);
+        }
+        EXPECT_EQ(cpu.stepBack(), (uint64_t)0);
+
+        // Running forward again ends in the same place
+        runToHalt(cpu);
+        EXPECT_EQ(cpu.clock, end.clock);
+        EXPECT_EQ(cpu.memory() == end.mem, true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(cpu.getReg(r), end.regs.read(r));
+    }
+
+    // A small budget keeps only the most recent cycles
+    CPU cpu;
+    cpu.loadProgram(makeWorkload(WorkloadKind::Loop, 50000));
+    cpu.enableJournal(2 * CommitJournal::kChunkBytes);
+    runToHalt(cpu);
+    const uint64_t depth = cpu.journalDepth();
+    EXPECT_EQ(depth > 0 && depth < (uint64_t)cpu.clock, true);
+    const int clock = cpu.clock;
+    EXPECT_EQ(cpu.stepBack(depth + 10), depth);
+    EXPECT_EQ(cpu.clock, clock - (int)depth);
+}
+
+static void test_cache_model() {
+    std::cout << "[TEST] cache_model\n";
+
+    // 4 sets of 2 ways, lines of 2 words: words 0, 8, 16 all map to set 0
+    CacheConfig cc;
+    cc.sizeBytes = 64;
+    cc.ways = 2;
+    cc.lineBytes = 8;
+    for (Replacement repl : {Replacement::LRU, Replacement::PLRU}) {
+        cc.replacement = repl;
+        Cache c(cc);
+        EXPECT_EQ(c.access(0, false).hit, false);
+        EXPECT_EQ(c.access(1, false).hit, true);     // same line
+        EXPECT_EQ(c.access(8, true).hit, false);
+        EXPECT_EQ(c.access(0, false).hit, true);     // 8 is now least recent
+        const Cache::Outcome o = c.access(16, false);
+        EXPECT_EQ(o.hit, false);
+        EXPECT_EQ(o.writeback, true);                // dirty line of word 8
+        EXPECT_EQ(o.victimAddr, (uint32_t)8);
+        EXPECT_EQ(c.access(0, false).hit, true);
+        EXPECT_EQ(c.stats().misses(), (uint64_t)3);
+        EXPECT_EQ(c.stats().writebacks, (uint64_t)1);
+    }
+
+    cc.writePolicy = WritePolicy::WriteThrough;
+    Cache wt(cc);
+    EXPECT_EQ(wt.access(4, true).forward, true);
+    EXPECT_EQ(wt.access(4, false).hit, false);       // no write-allocate
+
+    // Straight-line code, no L2: every first touch of a line costs the memory latency
+    CacheHierarchyConfig hc;
+    hc.l1i = cc;
+    hc.l1d = cc;
+    hc.l1i.writePolicy = hc.l1d.writePolicy = WritePolicy::WriteBack;
+    hc.memoryLatency = 10;
+    const Program prog = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 5),
+        I(Opcode::SW,   0, 1, 0, 40),
+        I(Opcode::LW,   0, 2, 0, 41),
+        I(Opcode::ADD,  2, 1, 3),
+        I(Opcode::LW,   0, 4, 0, 100),
+        I(Opcode::ADD,  4, 3, 5),
+    });
+
+    CPU plain;
+    plain.loadProgram(prog);
+    runToHalt(plain);
+
+    CPU cpu;
+    cpu.loadProgram(prog);
+    cpu.setCaches(hc);
+    runToHalt(cpu);
+
+    const CacheHierarchy* ch = cpu.caches();
+    EXPECT_EQ(ch->l1i().stats().misses(), (uint64_t)3);
+    EXPECT_EQ(ch->l1d().stats().misses(), (uint64_t)2);
+    EXPECT_EQ(ch->l1d().stats().hits(), (uint64_t)1);
+    EXPECT_EQ(cpu.retired, plain.retired);
+    for (int r = 0; r < 32; ++r) EXPECT_EQ(cpu.getReg(r), plain.getReg(r));
+    EXPECT_EQ(cpu.clock > plain.clock && cpu.clock <= plain.clock + 10 * 5, true);
+    if (kPerfCounters) {
+        // Instruction misses keep filling while a data miss freezes the pipeline
+        const PerfCounters& st = cpu.stats();
+        EXPECT_EQ(st.memStallCycles, (uint64_t)20);
+        EXPECT_EQ(st.fetchStallCycles <= 30, true);
+        EXPECT_EQ((uint64_t)cpu.clock, (uint64_t)plain.clock + st.memStallCycles + st.fetchStallCycles);
+        EXPECT_EQ(st.bubblesWB, st.cycles - cpu.retired);
+    }
+
+    // Caches change timing only, and stepping back crosses frozen cycles
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        CPU ref;
+        ref.loadProgram(p);
+        runToHalt(ref);
+
+        CPU c;
+        c.loadProgram(p);
+        c.setCaches(defaultCacheHierarchy());
+        c.enableJournal();
+        std::vector<int> pcs;
+        while (!c.isHalted()) {
+            pcs.push_back(c.pc);
+            c.tick();
+        }
+        EXPECT_EQ(c.retired, ref.retired);
+        EXPECT_EQ(c.clock >= ref.clock, true);
+        EXPECT_EQ(c.memory() == ref.memory(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(c.getReg(r), ref.getReg(r));
+
+        for (size_t i = pcs.size(); i-- > 0;) {
+            c.stepBack();
+            EXPECT_EQ(c.pc, pcs[i]);
+        }
+        EXPECT_EQ(c.clock, 0);
+        EXPECT_EQ(c.retired, (uint64_t)0);
+    }
+}
+
+static void test_branch_predictor() {
+    std::cout << "[TEST] branch_predictor\n";
+
+    PredictorConfig dyn;
+    dyn.btbEntries = 256;
+    dyn.rasDepth = 16;
+
+    // Prediction changes timing only
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        CPU ref;
+        ref.loadProgram(p);
+        runToHalt(ref);
+
+        for (PredictorKind kind : {PredictorKind::NotTaken, PredictorKind::BackwardTaken,
+                                   PredictorKind::Bimodal, PredictorKind::GShare}) {
+            dyn.kind = kind;
+            CPU c;
+            c.loadProgram(p);
+            c.setPredictor(dyn);
+            runToHalt(c);
+            EXPECT_EQ(c.retired, ref.retired);
+            EXPECT_EQ(c.memory() == ref.memory(), true);
+            for (int r = 0; r < 32; ++r) EXPECT_EQ(c.getReg(r), ref.getReg(r));
+        }
+    }
+
+    for (WorkloadKind wk : {WorkloadKind::Loop, WorkloadKind::BranchHeavy, WorkloadKind::CallHeavy}) {
+        const Program prog = makeWorkload(wk, 5000);
+        CPU ref;
+        ref.loadProgram(prog);
+        runToHalt(ref, 1000000);
+        EXPECT_EQ(ref.branchPredictor().stats().mispredicts() > 0, true);
+
+        dyn.kind = PredictorKind::GShare;
+        CPU c;
+        c.loadProgram(prog);
+        c.setPredictor(dyn);
+        runToHalt(c, 1000000);
+        const PredictorStats& st = c.branchPredictor().stats();
+        EXPECT_EQ(st.total(), ref.branchPredictor().stats().total());
+        EXPECT_EQ(c.retired, ref.retired);
+        EXPECT_EQ(c.clock < ref.clock, true);
+        EXPECT_EQ(st.mispredicts() * 2 < ref.branchPredictor().stats().mispredicts(), true);
+        // EX redirects exactly the mispredicted transfers
+        if (kPerfCounters) EXPECT_EQ(c.stats().redirects, st.mispredicts());
+        if (wk == WorkloadKind::CallHeavy) {
+            EXPECT_EQ(st.returns > 0, true);
+            EXPECT_EQ(st.returnMispredicts * 10 < st.returns, true);
+        }
+    }
+
+    // A BTB size that is not a power of two is rejected
+    bool threw = false;
+    try {
+        PredictorConfig bad;
+        bad.btbEntries = 100;
+        BranchPredictor bp(bad);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_EQ(threw, true);
+}
+
+static void test_branch_in_id() {
+    std::cout << "[TEST] branch_in_id\n";
+
+    auto run = [](const Program& prog, BranchStage stage, const PredictorConfig& pc = {}) {
+        auto cpu = std::make_unique<CPU>();
+        cpu->loadProgram(prog);
+        cpu->setBranchStage(stage);
+        cpu->setPredictor(pc);
+        runToHalt(*cpu, 1000000);
+        return cpu;
+    };
+
+    // Same results everywhere, fewer cycles over the whole set
+    uint64_t exCycles = 0, idCycles = 0;
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        const auto ex = run(p, BranchStage::EX);
+        const auto id = run(p, BranchStage::ID);
+        EXPECT_EQ(id->retired, ex->retired);
+        EXPECT_EQ(id->memory() == ex->memory(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(id->getReg(r), ex->getReg(r));
+        exCycles += ex->clock;
+        idCycles += id->clock;
+    }
+    EXPECT_EQ(idCycles < exCycles, true);
+
+    // A taken branch with ready operands costs one bubble instead of two
+    const Program taken = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 1),
+        I(Opcode::ADDI, 0, 2, 0, 1),
+        I(Opcode::ADDI, 0, 9, 0, 0),
+        I(Opcode::BEQ,  1, 2, 0, 1),
+        I(Opcode::ADDI, 0, 3, 0, 123),
+        I(Opcode::ADDI, 0, 4, 0, 7),
+    });
+    const auto tEx = run(taken, BranchStage::EX);
+    const auto tId = run(taken, BranchStage::ID);
+    EXPECT_EQ(tId->getReg(3), 0);
+    EXPECT_EQ(tId->getReg(4), 7);
+    EXPECT_EQ(tId->clock + 1, tEx->clock);
+
+    // One stall behind an ALU result in EX, two behind a load
+    const Program onAlu = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 5),
+        I(Opcode::BNE,  1, 0, 0, 1),
+        I(Opcode::ADDI, 0, 3, 0, 123),
+        I(Opcode::ADDI, 0, 4, 0, 7),
+    });
+    const Program onLoad = toProgram({
+        I(Opcode::LW,   0, 1, 0, 0),
+        I(Opcode::BEQ,  1, 0, 0, 1),
+        I(Opcode::ADDI, 0, 3, 0, 123),
+        I(Opcode::ADDI, 0, 4, 0, 7),
+    });
+    int expectStalls = 1;
+    for (const Program* p : {&onAlu, &onLoad}) {
+        const auto id = run(*p, BranchStage::ID);
+        EXPECT_EQ(id->getReg(3), 0);
+        EXPECT_EQ(id->getReg(4), 7);
+        if (kPerfCounters) {
+            EXPECT_EQ(id->stats().branchStalls, (uint64_t)expectStalls);
+            EXPECT_EQ(id->stats().loadUseStalls, (uint64_t)0);
+            EXPECT_EQ(id->stats().redirects, (uint64_t)1);
+        }
+        ++expectStalls;
+    }
+
+    // Calls and returns. Behind a trained predictor there is little left to
+    // save, so only the static case has to get faster.
+    PredictorConfig dyn;
+    dyn.kind = PredictorKind::GShare;
+    dyn.btbEntries = 256;
+    dyn.rasDepth = 16;
+    const Program calls = makeWorkload(WorkloadKind::CallHeavy, 3000);
+    const auto ex = run(calls, BranchStage::EX);
+    const auto id = run(calls, BranchStage::ID);
+    const auto idDyn = run(calls, BranchStage::ID, dyn);
+    EXPECT_EQ(id->clock < ex->clock, true);
+    for (const CPU* c : {id.get(), idDyn.get()}) {
+        EXPECT_EQ(c->retired, ex->retired);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(c->getReg(r), ex->getReg(r));
+    }
+    EXPECT_EQ(idDyn->branchPredictor().stats().returnMispredicts * 10 <
+              idDyn->branchPredictor().stats().returns, true);
+}
+
+static void test_dual_issue() {
+    std::cout << "[TEST] dual_issue\n";
+
+    PredictorConfig dyn;
+    dyn.kind = PredictorKind::GShare;
+    dyn.btbEntries = 256;
+    dyn.rasDepth = 16;
+
+    auto run = [](const Program& prog, int width, const PredictorConfig& pc = {}) {
+        auto cpu = std::make_unique<CPU>();
+        cpu->loadProgram(prog);
+        cpu->setIssueWidth(width);
+        cpu->setPredictor(pc);
+        runToHalt(*cpu, 1000000);
+        return cpu;
+    };
+    auto sameState = [](const CPU& a, const CPU& b) {
+        EXPECT_EQ(a.retired, b.retired);
+        EXPECT_EQ(a.memory() == b.memory(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(a.getReg(r), b.getReg(r));
+    };
+
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        const auto one = run(p, 1);
+        const auto two = run(p, 2);
+        sameState(*one, *two);
+        EXPECT_EQ(two->clock <= one->clock, true);
+    }
+
+    // IPC above one once branches stop flushing both lanes
+    for (WorkloadKind wk : {WorkloadKind::LoadHeavy, WorkloadKind::BranchHeavy, WorkloadKind::CallHeavy}) {
+        const Program prog = makeWorkload(wk, 5000);
+        const auto one = run(prog, 1, dyn);
+        const auto two = run(prog, 2, dyn);
+        sameState(*one, *two);
+        EXPECT_EQ(two->retired > (uint64_t)two->clock, true);
+    }
+
+    // Independent pair, pair reading the older one's result, two memory
+    // operations, and a pair writing the same register
+    const Program pairs = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 5),    // pair
+        I(Opcode::ADDI, 0, 2, 0, 6),
+        I(Opcode::ADD,  1, 2, 3),       // split, XOR reads $3
+        I(Opcode::XOR,  1, 3, 4),       // pair
+        I(Opcode::ADDI, 0, 7, 0, 9),
+        I(Opcode::SW,   0, 3, 0, 10),   // split, one memory port
+        I(Opcode::LW,   0, 5, 0, 10),   // pair
+        I(Opcode::ADDI, 0, 8, 0, 3),
+        I(Opcode::ADDI, 0, 6, 0, 1),    // pair, the younger write wins
+        I(Opcode::ADDI, 0, 6, 0, 2),
+    });
+    auto cpu = run(pairs, 2);
+    EXPECT_EQ(cpu->getReg(3), 11);
+    EXPECT_EQ(cpu->getReg(4), 5 ^ 11);
+    EXPECT_EQ(cpu->getReg(5), 11);
+    EXPECT_EQ(cpu->getReg(6), 2);
+    if (kPerfCounters) {
+        EXPECT_EQ(cpu->stats().pairsIssued, (uint64_t)4);
+        EXPECT_EQ(cpu->stats().issueSplits, (uint64_t)2);
+    }
+
+    // Stepping back undoes both write ports and both lanes
+    CPU c;
+    c.loadProgram(makeWorkload(WorkloadKind::CallHeavy, 2000));
+    c.setIssueWidth(2);
+    c.enableJournal();
+    std::vector<int> pcs;
+    while (!c.isHalted()) {
+        pcs.push_back(c.pc);
+        c.tick();
+    }
+    const auto ref = run(makeWorkload(WorkloadKind::CallHeavy, 2000), 1);
+    sameState(c, *ref);
+    for (size_t i = pcs.size(); i-- > 0;) {
+        c.stepBack();
+        EXPECT_EQ(c.pc, pcs[i]);
+    }
+    EXPECT_EQ(c.retired, (uint64_t)0);
+    for (int r = 0; r < 32; ++r) EXPECT_EQ(c.getReg(r), 0);
+
+    bool threw = false;
+    try {
+        c.setIssueWidth(3);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_EQ(threw, true);
+
+    // Pairs resolve branches in EX, ID resolution is refused in either order
+    auto throws = [](auto&& f) {
+        try {
+            f();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    EXPECT_EQ(throws([&] { c.setBranchStage(BranchStage::ID); }), true);
+    EXPECT_EQ(c.branchStage() == BranchStage::EX, true);
+    const CPU::Snapshot dual = c.snapshot();
+    c.setIssueWidth(1);
+    c.setBranchStage(BranchStage::ID);
+    EXPECT_EQ(throws([&] { c.setIssueWidth(2); }), true);
+    EXPECT_EQ(throws([&] { c.restore(dual); }), true);
+    EXPECT_EQ(c.issueWidth(), 1);
+    SimConfig cfg;
+    cfg.branchStage = BranchStage::ID;
+    cfg.issueWidth = 2;
+    EXPECT_EQ(throws([&] { simulate(makeWorkload(WorkloadKind::Loop, 100), cfg); }), true);
+}
+
+static void test_ooo_core() {
+    std::cout << "[TEST] ooo_core\n";
+
+    PredictorConfig dyn;
+    dyn.kind = PredictorKind::GShare;
+    dyn.btbEntries = 256;
+    dyn.rasDepth = 16;
+
+    auto runOoO = [](const Program& prog, const OoOConfig& cfg = {}, const PredictorConfig& pc = {}) {
+        auto core = std::make_unique<OoOCPU>(cfg, pc);
+        core->loadProgram(prog);
+        core->run(1000000);
+        return core;
+    };
+    auto runPipe = [](const Program& prog) {
+        auto cpu = std::make_unique<CPU>();
+        cpu->loadProgram(prog);
+        runToHalt(*cpu, 1000000);
+        return cpu;
+    };
+    auto sameState = [](const OoOCPU& a, const CPU& b) {
+        EXPECT_EQ(a.isHalted(), true);
+        EXPECT_EQ(a.retired, b.retired);
+        EXPECT_EQ(a.memory() == b.memory(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(a.getReg(r), b.getReg(r));
+    };
+
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        sameState(*runOoO(p), *runPipe(p));
+        sameState(*runOoO(p, {}, dyn), *runPipe(p));
+    }
+
+    // Wider than the pipeline once the predictor hides the branches
+    for (WorkloadKind wk : {WorkloadKind::Loop, WorkloadKind::LoadHeavy, WorkloadKind::BranchHeavy,
+                            WorkloadKind::CallHeavy}) {
+        const Program prog = makeWorkload(wk, 5000);
+        const auto pipe = runPipe(prog);
+        const auto core = runOoO(prog, {}, dyn);
+        sameState(*core, *pipe);
+        EXPECT_EQ(core->clock < (uint64_t)pipe->clock, true);
+    }
+    EXPECT_EQ(runOoO(toProgram(countedLoop(2000)), {}, dyn)->ipc() > 1.0, true);
+
+    // A small window runs into every structure
+    OoOConfig tiny;
+    tiny.width = 2;
+    tiny.robEntries = 4;
+    tiny.rsEntries = 2;
+    tiny.lsqEntries = 1;
+    const Program loads = makeWorkload(WorkloadKind::LoadHeavy, 3000);
+    const auto small = runOoO(loads, tiny, dyn);
+    sameState(*small, *runPipe(loads));
+    EXPECT_EQ(small->stats().robFullStalls + small->stats().rsFullStalls > 0, true);
+    EXPECT_EQ(small->stats().lsqFullStalls > 0, true);
+    EXPECT_EQ(small->avgRobOccupancy() <= 4.0, true);
+
+    // The load takes the queued store's data, then a mispredicted branch
+    // squashes the store behind it
+    const Program fwd = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 7),
+        I(Opcode::SW,   0, 1, 0, 20),
+        I(Opcode::LW,   0, 2, 0, 20),
+        I(Opcode::BEQ,  0, 0, 0, 1),
+        I(Opcode::SW,   0, 1, 0, 21),
+        I(Opcode::ADD,  2, 2, 3),
+    });
+    const auto f = runOoO(fwd);
+    EXPECT_EQ(f->getReg(2), 7);
+    EXPECT_EQ(f->getReg(3), 14);
+    EXPECT_EQ(f->getMemWord(21), 0);
+    EXPECT_EQ(f->stats().loadForwards, (uint64_t)1);
+    EXPECT_EQ(f->stats().mispredicts, (uint64_t)1);
+    EXPECT_EQ(f->stats().squashed > 0, true);
+
+    // Every single-machine engine behind the common interface
+    const Program call = makeWorkload(WorkloadKind::CallHeavy, 2000);
+    const auto ref = runPipe(call);
+    for (EngineKind k : {EngineKind::Pipeline, EngineKind::ISS, EngineKind::JIT, EngineKind::OoO}) {
+        SimConfig cfg;
+        cfg.engine = k;
+        const auto eng = makeEngine(cfg);
+        EXPECT_EQ(eng->kind() == k, true);
+        eng->loadProgram(call);
+        eng->run(UINT64_MAX);
+        EXPECT_EQ(eng->isHalted(), true);
+        EXPECT_EQ(eng->instructions(), ref->retired);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(eng->getReg(r), ref->getReg(r));
+        EXPECT_EQ(eng->hasCycles(), k == EngineKind::Pipeline || k == EngineKind::OoO);
+    }
+
+    int throws = 0;
+    try {
+        SimConfig cfg;
+        cfg.engine = EngineKind::Wide;
+        makeEngine(cfg);
+    } catch (const std::runtime_error&) {
+        ++throws;
+    }
+    try {
+        OoOConfig bad;
+        bad.robEntries = 0;
+        OoOCPU core(bad);
+    } catch (const std::runtime_error&) {
+        ++throws;
+    }
+    EXPECT_EQ(throws, 2);
+}
+
+static void test_multicore_mesi() {
+    std::cout << "[TEST] multicore_mesi\n";
+
+    // One core alone computes what a lone CPU computes
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        MultiCoreSystem one(MultiCoreConfig{1, {}});
+        one.loadProgram(p);
+        one.run(1000000);
+        CPU cpu;
+        cpu.loadProgram(p);
+        runToHalt(cpu, 1000000);
+        EXPECT_EQ(one.isHalted(), true);
+        EXPECT_EQ(one.core(0).retired, cpu.retired);
+        EXPECT_EQ(one.memory() == cpu.memory(), true);
+        for (int r = 0; r < 32; ++r) EXPECT_EQ(one.core(0).getReg(r), cpu.getReg(r));
+    }
+
+    // Core 1 spins on a flag, then reads the data core 0 wrote before it
+    MultiCoreSystem sys;
+    sys.loadProgram(0, toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 42),
+        I(Opcode::SW,   0, 1, 0, 100),
+        I(Opcode::ADDI, 0, 2, 0, 1),
+        I(Opcode::SW,   0, 2, 0, 200),
+    }));
+    sys.loadProgram(1, toProgram({
+        I(Opcode::LW,   0, 3, 0, 200),
+        I(Opcode::BEQ,  3, 0, 0, -2),
+        I(Opcode::LW,   0, 4, 0, 100),
+    }));
+    sys.run(100000);
+    EXPECT_EQ(sys.isHalted(), true);
+    EXPECT_EQ(sys.core(1).getReg(4), 42);
+    EXPECT_EQ(sys.getMemWord(200), 1);
+    EXPECT_EQ(sys.bus().stats(1).busReads >= 2, true);
+    EXPECT_EQ(sys.bus().stats(1).invalidationsReceived >= 1, true);
+    EXPECT_EQ(sys.bus().stats(0).invalidationsSent, sys.bus().stats(1).invalidationsReceived);
+    EXPECT_EQ(sys.bus().stats(0).interventions >= 1, true);
+    EXPECT_EQ(sys.bus().stats(0).snoopWritebacks >= 1, true);
+
+    // Two counters in one line ping-pong between the L1s, in two lines they do not
+    auto counter = [](int addr) {
+        return toProgram({
+            I(Opcode::ADDI, 0, 5, 0, 200),
+            I(Opcode::LW,   0, 1, 0, addr),
+            I(Opcode::ADDI, 1, 1, 0, 1),
+            I(Opcode::SW,   0, 1, 0, addr),
+            I(Opcode::ADDI, 5, 5, 0, -1),
+            I(Opcode::BNE,  5, 0, 0, -5),
+        });
+    };
+    auto race = [&](int addr0, int addr1) {
+        auto s = std::make_unique<MultiCoreSystem>();
+        s->loadProgram(0, counter(addr0));
+        s->loadProgram(1, counter(addr1));
+        s->run(1000000);
+        EXPECT_EQ(s->isHalted(), true);
+        EXPECT_EQ(s->getMemWord(addr0), 200);
+        EXPECT_EQ(s->getMemWord(addr1), 200);
+        return s;
+    };
+    const auto falseSharing = race(300, 301);
+    const auto apart = race(300, 340);
+    uint64_t inv = 0;
+    uint64_t wait = 0;
+    for (int c = 0; c < 2; ++c) {
+        EXPECT_EQ(apart->bus().stats(c).invalidationsSent, (uint64_t)0);
+        EXPECT_EQ(apart->bus().stats(c).transactions(), (uint64_t)1);
+        inv += falseSharing->bus().stats(c).invalidationsSent;
+        wait += falseSharing->bus().stats(c).busWaitCycles;
+    }
+    EXPECT_EQ(inv > 100, true);
+    EXPECT_EQ(wait > 0, true);
+    EXPECT_EQ(falseSharing->clock > apart->clock, true);
+
+    // One program, a different entry pc per core; a reset replays the run exactly
+    MultiCoreSystem entry(MultiCoreConfig{3, {}});
+    entry.loadProgram(toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 7),
+        I(Opcode::SW,   0, 1, 0, 10),
+        I(Opcode::J,    0, 0, 0, 0, 5),
+        I(Opcode::ADDI, 0, 1, 0, 9),
+        I(Opcode::SW,   0, 1, 0, 11),
+    }), {0, 3});
+    entry.run(100000);
+    EXPECT_EQ(entry.core(0).getReg(1), 7);
+    EXPECT_EQ(entry.core(1).getReg(1), 9);
+    EXPECT_EQ(entry.core(2).getReg(1), 7);
+    EXPECT_EQ(entry.getMemWord(10), 7);
+    EXPECT_EQ(entry.getMemWord(11), 9);
+    const uint64_t cycles = entry.clock;
+    const uint64_t retired = entry.retired();
+    entry.reset(true);
+    EXPECT_EQ(entry.getMemWord(10), 0);
+    entry.run(100000);
+    EXPECT_EQ(entry.clock, cycles);
+    EXPECT_EQ(entry.retired(), retired);
+
+    bool threw = false;
+    try {
+        MultiCoreConfig wt;
+        wt.coherence.l1d.writePolicy = WritePolicy::WriteThrough;
+        MultiCoreSystem bad(wt);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_EQ(threw, true);
+}
+
+static void test_multicore_parallel() {
+    std::cout << "[TEST] multicore_parallel\n";
+
+    // Every core bumps a word of its own, all in one line, and a racy shared
+    // counter; core 0 also publishes a flag the others wait for
+    auto kernel = [](int c) {
+        std::vector<Line> l;
+        if (c == 0) {
+            l.push_back(I(Opcode::ADDI, 0, 6, 0, 1));
+            l.push_back(I(Opcode::SW,   0, 6, 0, 600));
+        } else {
+            l.push_back(I(Opcode::LW,   0, 6, 0, 600));
+            l.push_back(I(Opcode::BEQ,  6, 0, 0, -2));
+        }
+        l.push_back(I(Opcode::ADDI, 0, 5, 0, 60));
+        l.push_back(I(Opcode::LW,   0, 1, 0, 300 + c));
+        l.push_back(I(Opcode::ADDI, 1, 1, 0, 1));
+        l.push_back(I(Opcode::SW,   0, 1, 0, 300 + c));
+        l.push_back(I(Opcode::LW,   0, 2, 0, 500));
+        l.push_back(I(Opcode::ADD,  2, 1, 2));
+        l.push_back(I(Opcode::SW,   0, 2, 0, 500));
+        l.push_back(I(Opcode::ADDI, 5, 5, 0, -1));
+        l.push_back(I(Opcode::BNE,  5, 0, 0, -8));
+        return toProgram(l);
+    };
+    auto build = [&](unsigned threads, uint32_t quantum) {
+        MultiCoreConfig cfg;
+        cfg.cores = 6;
+        cfg.threads = threads;
+        cfg.quantum = quantum;
+        auto sys = std::make_unique<MultiCoreSystem>(cfg);
+        for (int c = 0; c < cfg.cores; ++c) sys->loadProgram(c, kernel(c));
+        sys->run(1000000);
+        EXPECT_EQ(sys->isHalted(), true);
+        for (int c = 0; c < cfg.cores; ++c) EXPECT_EQ(sys->getMemWord(300 + c), 60);
+        return sys;
+    };
+    auto same = [](const MultiCoreSystem& a, const MultiCoreSystem& b) {
+        EXPECT_EQ(a.clock, b.clock);
+        EXPECT_EQ(a.memory() == b.memory(), true);
+        for (int c = 0; c < a.cores(); ++c) {
+            EXPECT_EQ(a.core(c).clock, b.core(c).clock);
+            EXPECT_EQ(a.core(c).retired, b.core(c).retired);
+            for (int r = 0; r < 32; ++r) EXPECT_EQ(a.core(c).getReg(r), b.core(c).getReg(r));
+            std::vector<uint64_t> va, vb;
+            a.bus().stats(c).forEach([&](const char*, uint64_t v) { va.push_back(v); });
+            b.bus().stats(c).forEach([&](const char*, uint64_t v) { vb.push_back(v); });
+            EXPECT_EQ(va == vb, true);
+        }
+    };
+
+    // Quantum 1 is exact on any number of threads, and so is stepping by tick()
+    const auto serial = build(1, 1);
+    same(*serial, *build(3, 1));
+    same(*serial, *build(6, 1));
+    MultiCoreSystem stepped(MultiCoreConfig{6, {}, 1, 1});
+    for (int c = 0; c < 6; ++c) stepped.loadProgram(c, kernel(c));
+    while (!stepped.isHalted()) stepped.tick();
+    same(*serial, stepped);
+    EXPECT_EQ(serial->bus().stats(1).invalidationsReceived > 0, true);
+
+    // Longer quanta are approximate but still independent of the thread count
+    const auto lax = build(1, 50);
+    same(*lax, *build(4, 50));
+    EXPECT_EQ(lax->bus().isLax(), true);
+    EXPECT_EQ(lax->bus().stats(0).transactions() > 0, true);
+
+    // Data segments reach the shared memory whether or not the cores work on views
+    for (const auto& [threads, quantum] : {std::pair{1u, 1u}, std::pair{1u, 4u}, std::pair{2u, 1u}}) {
+        Program prog = toProgram({
+            I(Opcode::LW, 0, 1, 0, 100),
+            I(Opcode::LW, 0, 2, 0, 101),
+        });
+        prog.appendData(100, {7, 8});
+        MultiCoreSystem sys(MultiCoreConfig{2, {}, threads, quantum});
+        sys.loadProgram(prog);
+        for (int round = 0; round < 2; ++round) {
+            EXPECT_EQ(sys.getMemWord(100), 7);
+            sys.run(1000);
+            for (int c = 0; c < 2; ++c) {
+                EXPECT_EQ(sys.core(c).getReg(1), 7);
+                EXPECT_EQ(sys.core(c).getReg(2), 8);
+            }
+            sys.setMemWord(100, 0);
+            sys.reset(true);
+        }
+        sys.loadProgram(1, prog);
+        sys.run(1000);
+        EXPECT_EQ(sys.core(0).getReg(1), 7);
+    }
+
+    bool threw = false;
+    try {
+        MultiCoreSystem bad(MultiCoreConfig{2, {}, 1, 0});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_EQ(threw, true);
+}
+
+static void test_multicore_rewind() {
+    std::cout << "[TEST] multicore_rewind\n";
+
+    const Program store = toProgram({
+        I(Opcode::ADDI, 0, 1, 0, 9),
+        I(Opcode::SW,   0, 1, 0, 5),
+    });
+
+    // Attached without a queue, a core rewinds its stores in the shared memory
+    Memory shared;
+    SnoopBus bus(1);
+    CPU cpu;
+    cpu.loadProgram(store);
+    cpu.attachShared(shared, bus, 0);
+    cpu.enableJournal();
+    while (!cpu.isHalted()) {
+        cpu.tick();
+        bus.resolve();
+    }
+    EXPECT_EQ(shared.read(5), 9);
+    EXPECT_EQ(cpu.stepBack(cpu.journalDepth()) > 0, true);
+    EXPECT_EQ(shared.read(5), 0);
+
+    // The stores of a system's core are the system's to commit, with or
+    // without views: no journal and no restore
+    for (uint32_t quantum : {1u, 4u}) {
+        MultiCoreSystem sys(MultiCoreConfig{1, {}, 1, quantum});
+        sys.loadProgram(store);
+        CPU& core = sys.core(0);
+        const CPU::Snapshot start = core.snapshot();
+        bool journalThrew = false;
+        bool restoreThrew = false;
+        try { core.enableJournal(); } catch (const std::runtime_error&) { journalThrew = true; }
+        try { core.restore(start); } catch (const std::runtime_error&) { restoreThrew = true; }
+        EXPECT_EQ(journalThrew, true);
+        EXPECT_EQ(restoreThrew, true);
+        sys.run(1000);
+        EXPECT_EQ(core.stepBack(), (uint64_t)0);
+        EXPECT_EQ(sys.getMemWord(5), 9);
+    }
+}
+
+static void test_pipeline_trace() {
+    std::cout << "[TEST] pipeline_trace\n";
+    const std::string path = (std::filesystem::temp_directory_path() / "scs_pipeline_trace.bin").string();
+
+    // Runs prog with a trace and checks every decoded cycle against the CPU
+    // stepped alongside it; returns the file size per cycle
+    auto check = [&](const Program& prog, int width, bool caches) {
+        CPU cpu;
+        cpu.loadProgram(prog);
+        cpu.setIssueWidth(width);
+        if (caches) cpu.setCaches(defaultCacheHierarchy());
+        TraceConfig tc;
+        tc.chunkCycles = 4096;
+        tc.ringCycles = 256;
+        cpu.enableTrace(path, tc);
+
+        auto at = [](const auto& l) { return l.cur().valid ? l.cur().pc : -1; };
+        std::vector<std::array<int, 8>> latches;
+        std::vector<std::array<int, 32>> regs;
+        while (!cpu.isHalted() && cpu.clock < 1000000) {
+            const PipelineRegisters& p = cpu.pipeline();
+            latches.push_back({at(p.if_id), at(p.id_ex), at(p.ex_mem), at(p.mem_wb),
+                               width == 2 ? at(p.if_id2) : -1, width == 2 ? at(p.id_ex2) : -1,
+                               width == 2 ? at(p.ex_mem2) : -1, width == 2 ? at(p.mem_wb2) : -1});
+            cpu.tick();
+            regs.push_back(cpu.regFile().getRegs());
+        }
+        EXPECT_EQ(cpu.trace()->cycles(), (uint64_t)cpu.clock);
+        cpu.disableTrace();
+
+        TraceReader r(path);
+        EXPECT_EQ(r.cycles(), (uint64_t)cpu.clock);
+        EXPECT_EQ(r.chunks(), (size_t)(cpu.clock + 4095) / 4096);
+
+        std::array<int, 32> shadow{};
+        std::map<int, int> stores;   // last value written to each word
+        uint64_t stalls = 0, frozen = 0, next = 0;
+        std::vector<TraceCycle> cycles;
+        for (size_t i = 0; i < r.chunks(); ++i) {
+            r.read(i, cycles);
+            for (const TraceCycle& c : cycles) {
+                EXPECT_EQ(c.cycle, next);
+                if (c.cycle != next++ || c.cycle >= latches.size()) return 0.0;
+                for (int l = 0; l < TraceCycle::kLatches; ++l) EXPECT_EQ(c.latch[l], latches[c.cycle][l]);
+                for (int w = 0; w < c.regWrites; ++w) shadow[c.regIdx[w]] = c.regValue[w];
+                EXPECT_EQ(shadow == regs[c.cycle], true);
+                if (c.memWrite) stores[c.memAddr] = c.memValue;
+                stalls += (c.flags & TraceCycle::kStall) != 0;
+                frozen += (c.flags & TraceCycle::kFrozen) != 0;
+            }
+        }
+        EXPECT_EQ(next, (uint64_t)cpu.clock);
+        for (const auto& [addr, value] : stores) EXPECT_EQ(cpu.getMemWord(addr), value);
+        if (kPerfCounters) {
+            EXPECT_EQ(stalls, cpu.stats().loadUseStalls + cpu.stats().branchStalls);
+            EXPECT_EQ(frozen, cpu.stats().memStallCycles);
+        }
+        return double(std::filesystem::file_size(path)) / double(cpu.clock);
+    };
+
+    for (const auto& file : programFiles()) {
+        const Program p = ProgramLoader::loadFromFile(file);
+        check(p, 1, false);
+        check(p, 2, true);
+    }
+    check(makeWorkload(WorkloadKind::LoadHeavy, 20000), 1, true);
+    check(makeWorkload(WorkloadKind::BranchHeavy, 20000), 2, false);
+    const double perCycle = check(makeWorkload(WorkloadKind::Loop, 100000), 1, false);
+    EXPECT_EQ(perCycle < 3.5, true);
+
+    // A run through the engine closes its trace, and fails if it could not be written
+    {
+        SimConfig cfg;
+        cfg.engine = EngineKind::Pipeline;
+        cfg.tracePath = path;
+        const SimResult res = simulate(makeWorkload(WorkloadKind::Loop, 1000), cfg);
+        EXPECT_EQ(TraceReader(path).cycles(), res.cycles);
+
+        // A version 1 file, from before the start block, is refused by its version
+        {
+            std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+            const uint8_t v1[4] = {1, 0, 0, 0};
+            f.seekp(8);
+            f.write(reinterpret_cast<const char*>(v1), sizeof(v1));
+        }
+        std::string msg;
+        try { TraceReader old(path); } catch (const std::runtime_error& e) { msg = e.what(); }
+        EXPECT_EQ(msg.find("version 1") != std::string::npos, true);
+
+        if (std::filesystem::exists("/dev/full")) {
+            cfg.tracePath = "/dev/full";
+            bool threw = false;
+            try { simulate(makeWorkload(WorkloadKind::Loop, 1000), cfg); } catch (const std::runtime_error&) { threw = true; }
+            EXPECT_EQ(threw, true);
+        }
+    }
+
+    // Chunks decode on their own; without the index they are found by their headers
+    {
+        CPU cpu;
+        cpu.loadProgram(makeWorkload(WorkloadKind::CallHeavy, 20000));
+        TraceConfig tc;
+        tc.chunkCycles = 1000;
+        cpu.enableTrace(path, tc);
+        // Going back a cycle starts a new chunk at the repeated cycle, from
+        // a state block holding what the rewind restored
+        runToHalt(cpu, 2500);
+        cpu.enableJournal();
+        cpu.tick();
+        cpu.stepBack();
+        const std::array<int, 32> rewound = cpu.regFile().getRegs();
+        runToHalt(cpu, 500);
+        // So does a word written from outside the pipeline
+        cpu.setMemWord(4000, 77);
+        const uint64_t written = (uint64_t)cpu.clock;
+        runToHalt(cpu);
+        const int end = cpu.clock;
+        cpu.disableTrace();
+
+        TraceReader r(path);
+        const size_t n = r.chunks();
+        EXPECT_EQ(r.cycles(), (uint64_t)end + 1);
+        EXPECT_EQ(r.chunk(3).firstCycle, (uint64_t)2500);
+        EXPECT_EQ(r.find(2500), (size_t)3);
+        EXPECT_EQ(r.find(1500), (size_t)1);
+        EXPECT_EQ(r.find((uint64_t)end), n);
+        TraceState st;
+        EXPECT_EQ(r.readState(2, st), false);
+        EXPECT_EQ(r.readState(3, st), true);
+        EXPECT_EQ(st.regs == rewound, true);
+        const size_t w = r.find(written);
+        EXPECT_EQ(r.chunk(w).firstCycle, written);
+        EXPECT_EQ(r.readState(w, st), true);
+        EXPECT_EQ(std::count(st.memory.begin(), st.memory.end(), std::pair<int32_t, int32_t>(4000, 77)), 1);
+
+        std::vector<TraceCycle> a, b;
+        r.read(n - 2, a);
+        const size_t cut = r.chunk(n - 1).offset;
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::vector<char> bytes(cut + 10);
+            in.read(bytes.data(), (std::streamsize)bytes.size());
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), (std::streamsize)bytes.size());
+        }
+        TraceReader truncated(path);
+        EXPECT_EQ(truncated.chunks(), n - 1);
+        truncated.read(n - 2, b);
+        EXPECT_EQ(a == b, true);
+        for (size_t i = 0; i + 1 < n; ++i) EXPECT_EQ(truncated.chunk(i).state, r.chunk(i).state);
+    }
+    std::filesystem::remove(path);
+}
+
+static void test_trace_replay() {
+    std::cout << "[TEST] trace_replay\n";
+    const std::string path = (std::filesystem::temp_directory_path() / "scs_trace_replay.bin").string();
+
+    // What the CPU held at the start of every cycle, the replay has to show the same
+    CPU cpu;
+    cpu.loadProgram(makeWorkload(WorkloadKind::LoadHeavy, 20000));
+    cpu.setCaches(defaultCacheHierarchy());
+    cpu.setMemWord(7, 42);   // written before tracing started
+    TraceConfig tc;
+    tc.chunkCycles = 1000;
+    cpu.enableTrace(path, tc);
+    std::vector<std::array<int, 32>> regs;
+    std::vector<int> ifId;
+    std::vector<std::pair<uint64_t, Memory>> mems;
+    while (!cpu.isHalted()) {
+        regs.push_back(cpu.regFile().getRegs());
+        ifId.push_back(cpu.pipeline().if_id.cur().valid ? cpu.pipeline().if_id.cur().pc : -1);
+        if (cpu.clock % 997 == 0) mems.emplace_back(cpu.clock, cpu.memory());
+        cpu.tick();
+    }
+    cpu.disableTrace();
+
+    TraceReplay replay(path);
+    const uint64_t length = replay.length();
+    EXPECT_EQ(length, (uint64_t)regs.size());
+    EXPECT_EQ(replay.trace().chunks() > 3, true);
+    EXPECT_EQ(replay.memory().read(7), 42);
+
+    // Jumps in both directions, inside a chunk and across chunks
+    uint64_t n = 0;
+    for (int i = 0; i < 300; ++i) {
+        n = (n * 7919 + (i % 3 ? 1 : 104729)) % length;
+        replay.seek(n);
+        EXPECT_EQ(replay.position(), n);
+        EXPECT_EQ(replay.cycle().cycle, n);
+        EXPECT_EQ(replay.cycle().latch[0], ifId[n]);
+        EXPECT_EQ(replay.regs() == regs[n], true);
+    }
+    for (const auto& [clock, m] : mems) {
+        replay.seek(clock);
+        EXPECT_EQ(replay.memory() == m, true);
+    }
+    replay.seek(length + 5);
+    EXPECT_EQ(replay.position(), length - 1);
+
+    // A rewind, and a word written from outside, replay as the CPU saw them
+    {
+        CPU live;
+        live.loadProgram(makeWorkload(WorkloadKind::Loop, 2000));
+        live.enableTrace(path);
+        std::vector<std::pair<std::array<int, 32>, Memory>> seen;
+        auto step = [&] {
+            seen.emplace_back(live.regFile().getRegs(), live.memory());
+            live.tick();
+        };
+        while (live.clock < 150) step();
+        live.enableJournal();
+        for (int i = 0; i < 20; ++i) step();
+        EXPECT_EQ(live.stepBack(20), (uint64_t)20);
+        for (int i = 0; i < 100; ++i) step();
+        live.setMemWord(3, 99);
+        while (!live.isHalted()) step();
+        live.disableTrace();
+
+        TraceReplay r(path);
+        EXPECT_EQ(r.length(), (uint64_t)seen.size());
+        int wrong = 0;
+        for (uint64_t i = 0; i < r.length(); ++i) {
+            r.seek(i);
+            wrong += r.regs() != seen[i].first || !(r.memory() == seen[i].second);
+        }
+        EXPECT_EQ(wrong, 0);
+        r.seek(170);
+        EXPECT_EQ(r.cycle().cycle, (uint64_t)150);
+    }
+    std::filesystem::remove(path);
+}
+
+static void test_program_image() {
+    std::cout << "[TEST] program_image\n";
+    const std::string path = (std::filesystem::temp_directory_path() / "scs_program_image.img").string();
+
+    // Every sample program runs the same from its image
+    for (const auto& file : programFiles()) {
+        const Program text = ProgramLoader::loadFromFile(file);
+        ProgramLoader::writeImage(text, path);
+        EXPECT_EQ(ProgramLoader::isImage(path), true);
+        const Program image = ProgramLoader::loadFromFile(path);
+        EXPECT_EQ(image.size(), text.size());
+        EXPECT_EQ(image.hasText(), true);
+        for (size_t i = 0; i < text.size(); ++i) {
+            EXPECT_EQ(std::memcmp(&image[i], &text[i], sizeof(Instruction)), 0);
+            EXPECT_EQ(std::string(image.text((int)i)), std::string(text.text((int)i)));
+        }
+        CPU a, b;
+        a.loadProgram(text);
+        b.loadProgram(image);
+        runToHalt(a);
+        runToHalt(b);
+        EXPECT_EQ(b.clock, a.clock);
+        EXPECT_EQ(b.regFile().getRegs() == a.regFile().getRegs(), true);
+    }
+
+    // Data segments load with the program and again on a reset that clears memory
+    Program prog = makeWorkload(WorkloadKind::Loop, 1000);
+    prog.appendData(200, {5, 6, 7});
+    prog.appendData(-1, {9});
+    ProgramLoader::writeImage(prog, path, false);
+    const Program image = ProgramLoader::loadImage(path);
+    EXPECT_EQ(image.hasText(), false);
+    EXPECT_EQ(std::string(image.text(0)), disassemble(prog[0]));
+    EXPECT_EQ((int)image.dataSegments(), 2);
+    CPU cpu;
+    cpu.loadProgram(image);
+    cpu.setMemWord(201, 0);
+    cpu.reset(true);
+    EXPECT_EQ(cpu.getMemWord(201), 6);
+    EXPECT_EQ(cpu.getMemWord(-1), 9);
+    FunctionalCPU iss;
+    iss.loadProgram(image);
+    EXPECT_EQ(iss.getMemWord(202), 7);
+
+    // Appending unshares a copy, the mapped original stays as it was
+    Program copy = image;
+    copy.append(I(Opcode::NOP).ins);
+    EXPECT_EQ(copy.size(), image.size() + 1);
+    EXPECT_EQ(copy.dataSegments(), image.dataSegments());
+    EXPECT_EQ(std::string(copy.text(0)), std::string(image.text(0)));
+
+    // So is one with an opcode or register the engines could not index by
+    for (size_t field : {offsetof(Instruction, op), offsetof(Instruction, rs), offsetof(Instruction, rd)}) {
+        const Program one = toProgram({I(Opcode::ADD, 1, 2, 3)});
+        ProgramLoader::writeImage(one, path, false);
+        std::vector<char> file(std::filesystem::file_size(path));
+        std::ifstream(path, std::ios::binary).read(file.data(), (std::streamsize)file.size());
+        const char* raw = reinterpret_cast<const char*>(&one[0]);
+        const auto at = std::search(file.begin(), file.end(), raw, raw + sizeof(Instruction));
+        EXPECT_EQ(at != file.end(), true);
+        if (at == file.end()) continue;
+        at[field] = 40;
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(file.data(), (std::streamsize)file.size());
+        std::string msg;
+        try { ProgramLoader::loadImage(path); } catch (const std::runtime_error& e) { msg = e.what(); }
+        EXPECT_EQ(msg.find("out of range") != std::string::npos, true);
+    }
+
+    // A truncated image is rejected
+    const auto bytes = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, bytes - 64);
+    bool threw = false;
+    try { ProgramLoader::loadFromFile(path); } catch (const std::runtime_error&) { threw = true; }
+    EXPECT_EQ(threw, true);
+    std::filesystem::remove(path);
+}
+
+static void test_assembler() {
+    std::cout << "[TEST] assembler\n";
+
+    // Labels in both directions, data labels as numbers, .space gaps, hex
+    const Program p = ProgramLoader::assemble(
+        "        .data 0x10\n"
+        "a:      .word 3, b   // b's address\n"
+        "        .space 2\n"
+        "b:      .word -1\n"
+        "        .text\n"
+        "top:    LW   $1, a($0)\n"
+        "        beq  $1, $0, out\n"
+        "        addi $1, $1, -1\n"
+        "        sw   $1, a($0)\n"
+        "        j top\n"
+        "out:    addi $2, $0, b\n");
+    EXPECT_EQ((int)p.size(), 6);
+    EXPECT_EQ(p[1].imm, 3);          // to index 5
+    EXPECT_EQ(p[4].addr, 0);
+    EXPECT_EQ(p[5].imm, 20);
+    EXPECT_EQ(std::string(p.text(0)), std::string("LW   $1, a($0)"));
+    EXPECT_EQ((int)p.dataSegments(), 2);
+    EXPECT_EQ(p.dataSegment(0).address, 16);
+    EXPECT_EQ(p.dataWords(p.dataSegment(0))[1], 20);
+    EXPECT_EQ(p.dataSegment(1).address, 20);
+    CPU cpu;
+    cpu.loadProgram(p);
+    runToHalt(cpu);
+    EXPECT_EQ(cpu.getMemWord(16), 0);
+    EXPECT_EQ(cpu.getReg(2), 20);
+
+    CPU sample;
+    sample.loadProgram(ProgramLoader::loadFromFile(SCS_PROGRAMS_DIR "/07_labels_data.txt"));
+    runToHalt(sample);
+    EXPECT_EQ(sample.getReg(2), 100);
+    EXPECT_EQ(sample.getMemWord(21), 200);
+
+    // Every error is reported, in source order, with its position
+    std::string msg;
+    try {
+        ProgramLoader::assemble("add $1, $2\nj nowhere\nx: nop\nx: lw $1, 4($40)\n");
+    } catch (const std::runtime_error& e) {
+        msg = e.what();
+    }
+    EXPECT_EQ(msg, std::string("Line 1, col 11: missing register\n"
+                               "Line 2, col 3: undefined label: nowhere\n"
+                               "Line 4, col 1: duplicate label: x\n"
+                               "Line 4, col 13: register out of range: $40"));
+}
+
+static void test_mips_binary() {
+    std::cout << "[TEST] mips_binary\n";
+
+    // A loop summing 5..1 and a call, as a cross compiler would lay it out
+    // from 0x400000 with nops in the delay slots
+    const std::vector<uint32_t> code = {
+        0x24020005,   // addiu $2, $0, 5
+        0x00001821,   // addu  $3, $0, $0
+        0x00621821,   // loop: addu $3, $3, $2
+        0x2442ffff,   // addiu $2, $2, -1
+        0x1440fffd,   // bne   $2, $0, loop
+        0x00000000,   // nop
+        0x0c100009,   // jal   f
+        0x00000000,   // nop
+        0x0810000c,   // j     end
+        0xac030008,   // f: sw $3, 8($0)
+        0x8c040008,   // lw    $4, 8($0)
+        0x03e00008,   // jr    $31
+        0x3405ffff,   // end: ori $5, $0, 0xffff
+    };
+    std::vector<uint8_t> be, le;
+    for (uint32_t w : code) {
+        for (int s = 24; s >= 0; s -= 8) be.push_back(uint8_t(w >> s));
+        for (int s = 0; s <= 24; s += 8) le.push_back(uint8_t(w >> s));
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "scs_mips.bin").string();
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(be.data()), be.size());
+
+    MipsFormat format;
+    format.base = 0x400000;
+    const Program bin = ProgramLoader::loadBinary(path, format);
+    format.bigEndian = false;
+    const Program mipsel = ProgramLoader::decodeBinary(le.data(), le.size(), format);
+    const Program text = ProgramLoader::assemble(
+        "addi $2, $0, 5\nadd $3, $0, $0\nadd $3, $3, $2\naddi $2, $2, -1\nbne $2, $0, 2\nnop\n"
+        "jal 9\nnop\nj 12\nsw $3, 8($0)\nlw $4, 8($0)\njr $31\nori $5, $0, 65535\n");
+    EXPECT_EQ(bin.size(), text.size());
+    EXPECT_EQ(mipsel.size(), text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        EXPECT_EQ(std::memcmp(&bin[i], &text[i], sizeof(Instruction)), 0);
+        EXPECT_EQ(std::memcmp(&mipsel[i], &text[i], sizeof(Instruction)), 0);
+    }
+    EXPECT_EQ(std::string(bin.text(6)), std::string("jal 9"));
+
+    CPU cpu;
+    cpu.loadProgram(bin);
+    runToHalt(cpu);
+    EXPECT_EQ(cpu.getReg(3), 15);
+    EXPECT_EQ(cpu.getReg(4), 15);
+    EXPECT_EQ(cpu.getReg(5), 65535);
+    EXPECT_EQ(cpu.getReg(31), 7);   // the index after the jal, not pc + 8
+    EXPECT_EQ(cpu.getMemWord(8), 15);
+
+    // Words outside the subset or leaving the code are all reported with their address
+    const uint8_t bad[] = {0x3c, 0x1c, 0x00, 0x42,   // lui $28, 0x42
+                           0x00, 0x00, 0x00, 0x00,
+                           0x08, 0x00, 0x00, 0x00,   // j 0, below the load address
+                           0x10, 0x00, 0xff, 0xfb};  // beq $0, $0, -5, before the first word
+    format.bigEndian = true;
+    std::string msg;
+    try { ProgramLoader::decodeBinary(bad, sizeof(bad), format); } catch (const std::runtime_error& e) { msg = e.what(); }
+    EXPECT_EQ(msg, std::string("0x00400000: unsupported instruction 0x3c1c0042 (lui)\n"
+                               "0x00400008: jump outside the code 0x08000000 (j)\n"
+                               "0x0040000c: branch outside the code 0x1000fffb (beq)"));
+    std::filesystem::remove(path);
+}
+
 } // namespace
 
 int main() {
@@ -260,6 +2042,34 @@ int main() {
     test_branch_after_load_use_stall();
     test_store_after_load_stall_and_forward();
     test_zero_register_immutable();
+    test_program_text_table();
+    test_latch_hold_and_bubble();
+    test_functional_matches_pipeline();
+    test_functional_step_budget();
+    test_arch_state_handover();
+    test_sampled_cpi_estimate();
+    test_jit_matches_interpreter();
+    test_jit_budget_chaining_and_reload();
+    test_batch_matches_serial();
+    test_wide_lanes_match_cpu();
+    test_workloads_hit_target_size();
+    test_perf_counters();
+    test_sparse_memory();
+    test_snapshot_restore();
+    test_step_back();
+    test_cache_model();
+    test_branch_predictor();
+    test_branch_in_id();
+    test_dual_issue();
+    test_ooo_core();
+    test_multicore_mesi();
+    test_multicore_parallel();
+    test_multicore_rewind();
+    test_pipeline_trace();
+    test_trace_replay();
+    test_program_image();
+    test_assembler();
+    test_mips_binary();
 
     if (g_failures == 0) {
         std::cout << "\nALL TESTS PASSED\n";